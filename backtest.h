@@ -0,0 +1,408 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "itch_feed.h"
+#include "order_book.h"
+
+/**
+ * Latency-Modelled Backtester
+ *
+ * Replays one instrument's historical L3 events (a recorded ITCH feed) into
+ * an OrderBook and lets a strategy trade against them through the book's own
+ * matching: the strategy's orders rest in the same queues as the feed's and
+ * cross through AddOrder/MatchOrders, not a separate fill model.
+ *
+ * Time is the feed's. A strategy action issued at time t reaches the book
+ * at t + latency (+ uniform jitter), just before the first feed event
+ * stamped at or after that instant. The strategy is called after every
+ * event of its instrument and sees the book as of that event.
+ *
+ * Strategy orders fill three ways:
+ * - Aggressively, when they arrive crossing the book
+ * - Passively, when a feed add or replace crosses them
+ * - From the queue, when the feed executes an order the strategy order
+ *   would have traded before (better price, or same price and earlier in
+ *   the queue). The historical execution still applies in full, so this is
+ *   the usual optimistic queue model: liquidity is not taken from the feed
+ *
+ * Design Notes:
+ * - The strategy is a template parameter called directly, no virtual calls:
+ *   OnFill(sim, fill) for each fill, then OnEvent(sim), after each event
+ * - Feed orders the strategy consumed show up later as unknown references
+ *   in the handler's stats; that is the simulation's market impact
+ * - Strategy order ids live above StrategyIdBase, clear of feed references
+ */
+
+enum class BacktestOrderStatus {
+    Pending,    // Issued, not yet at the book
+    Resting,
+    Filled,
+    Cancelled,  // Cancelled, or a FillAndKill remainder
+};
+
+/**
+ * One strategy order from decision to completion
+ */
+struct BacktestOrder {
+    OrderId id = 0;
+    OrderType type = OrderType::GoodTilCancel;
+    Side side = Side::Buy;
+    Price price = 0;
+    Quantity quantity = 0;
+    BacktestOrderStatus status = BacktestOrderStatus::Pending;
+    std::uint64_t decidedAt = 0;        // Feed time when the strategy issued it
+    std::uint64_t arrivedAt = 0;        // Feed time when it reached the book
+    double decisionMid = 0;             // Mid price at decision, 0 if a side was empty
+    std::optional<Quantity> queueAhead; // Quantity ahead when it came to rest
+    Quantity filled = 0;
+    std::int64_t notional = 0;
+
+    double GetAveragePrice() const {
+        return filled ? static_cast<double>(notional) / static_cast<double>(filled) : 0.0;
+    }
+
+    /**
+     * @returns ticks paid relative to the decision mid, positive when worse
+     * (0 if unfilled or there was no mid)
+     */
+    double GetSlippage() const {
+        if (!filled || decisionMid == 0) return 0.0;
+        const double difference = GetAveragePrice() - decisionMid;
+        return side == Side::Buy ? difference : -difference;
+    }
+};
+
+enum class BacktestFillKind {
+    Aggressive,
+    Passive,
+    Queue,
+};
+
+struct BacktestFill {
+    OrderId id = 0;
+    Side side = Side::Buy;
+    Price price = 0;
+    Quantity quantity = 0;
+    std::uint64_t time = 0;
+    BacktestFillKind kind = BacktestFillKind::Aggressive;
+};
+
+struct BacktestConfig {
+    std::uint16_t locate = 1;                   // Instrument (ITCH stock locate) to trade
+    std::uint64_t orderLatencyNanos = 50'000;   // Decision to arrival at the book
+    std::uint64_t cancelLatencyNanos = 50'000;
+    std::uint64_t latencyJitterNanos = 0;       // Uniform extra latency per action
+    std::uint64_t seed = 1;                     // Jitter generator seed
+    bool queueFills = true;                     // Fill from the queue when the feed executes behind us
+    bool keepFills = true;                      // Keep every fill for GetFills(); off bounds memory
+};
+
+struct BacktestStats {
+    std::uint64_t events = 0;          // Feed events of the traded instrument
+    std::uint64_t otherEvents = 0;     // Other instruments' events, skipped
+    std::uint64_t ordersSubmitted = 0;
+    std::uint64_t ordersArrived = 0;
+    std::uint64_t cancelsArrived = 0;
+    std::uint64_t fills = 0;
+    std::uint64_t aggressiveFills = 0;
+    std::uint64_t passiveFills = 0;
+    std::uint64_t queueFills = 0;
+    Quantity filledQuantity = 0;
+    std::uint64_t firstEventTime = 0;
+    std::uint64_t lastEventTime = 0;
+
+    /**
+     * Adds another run's counters (event times are left alone)
+     */
+    void Merge(const BacktestStats& other) {
+        events += other.events;
+        otherEvents += other.otherEvents;
+        ordersSubmitted += other.ordersSubmitted;
+        ordersArrived += other.ordersArrived;
+        cancelsArrived += other.cancelsArrived;
+        fills += other.fills;
+        aggressiveFills += other.aggressiveFills;
+        passiveFills += other.passiveFills;
+        queueFills += other.queueFills;
+        filledQuantity += other.filledQuantity;
+    }
+};
+
+template <typename Strategy>
+class Backtester {
+public:
+    static constexpr OrderId StrategyIdBase = 1ULL << 62;
+
+    Backtester(Strategy& strategy, const BacktestConfig& config = BacktestConfig())
+        : strategy(strategy), config(config), book(handler.Book(config.locate)), random(config.seed) {}
+
+    Backtester(const Backtester&) = delete;
+    Backtester& operator=(const Backtester&) = delete;
+
+    // Strategy-facing interface
+
+    /**
+     * Issues an order now; it reaches the book after the order latency
+     * @returns the order's id
+     */
+    OrderId Submit(OrderType type, Side side, Price price, Quantity quantity) {
+        if (quantity == 0) throw std::runtime_error("Backtester: order quantity must be non-zero");
+        BacktestOrder order;
+        order.id = StrategyIdBase + orders.size();
+        order.type = type;
+        order.side = side;
+        order.price = price;
+        order.quantity = quantity;
+        order.decidedAt = now;
+        const std::optional<Price> bid = book.GetBestPrice(Side::Buy);
+        const std::optional<Price> ask = book.GetBestPrice(Side::Sell);
+        if (bid && ask) order.decisionMid = (static_cast<double>(*bid) + static_cast<double>(*ask)) / 2;
+        orders.push_back(order);
+        ++stats.ordersSubmitted;
+        Schedule(order.id, false, config.orderLatencyNanos);
+        return order.id;
+    }
+
+    /**
+     * Issues a cancel now; it reaches the book after the cancel latency and
+     * does nothing if the order has filled by then
+     */
+    void Cancel(OrderId id) {
+        GetOrder(id);
+        Schedule(id, true, config.cancelLatencyNanos);
+    }
+
+    /**
+     * @throws std::runtime_error if id is not a strategy order
+     */
+    const BacktestOrder& GetOrder(OrderId id) const {
+        if (id < StrategyIdBase || id - StrategyIdBase >= orders.size()) {
+            throw std::runtime_error("Backtester: unknown strategy order " + std::to_string(id));
+        }
+        return orders[id - StrategyIdBase];
+    }
+
+    const OrderBook& GetBook() const { return book; }
+    std::uint64_t GetTime() const { return now; }
+    std::string_view GetSymbol() const { return handler.GetSymbol(config.locate); }
+
+    // Running
+
+    /**
+     * Replays length-prefixed feed messages in [data, data + length)
+     */
+    void Run(const char* data, std::size_t length) {
+        std::size_t offset = 0;
+        while (offset + 2 <= length) {
+            const std::size_t size = ReadBigEndian16(data + offset);
+            if (offset + 2 + size > length) break;
+            Step(data + offset + 2, size);
+            offset += 2 + size;
+        }
+    }
+
+    void RunFile(const std::string& path) {
+        const MappedFeed feed(path);
+        Run(feed.GetData(), feed.GetSize());
+    }
+
+    const BacktestStats& GetStats() const { return stats; }
+    const ItchStats& GetFeedStats() const { return handler.GetStats(); }
+    const std::vector<BacktestOrder>& GetOrders() const { return orders; }
+    const std::vector<BacktestFill>& GetFills() const { return fills; }  // Empty when keepFills is off
+
+private:
+    struct Action {
+        std::uint64_t arrival;
+        std::uint64_t sequence;  // Keeps equal arrivals in issue order
+        OrderId id;
+        bool cancel;
+
+        bool operator>(const Action& other) const {
+            return arrival != other.arrival ? arrival > other.arrival : sequence > other.sequence;
+        }
+    };
+
+    void Schedule(OrderId id, bool cancel, std::uint64_t latency) {
+        if (config.latencyJitterNanos) latency += random() % (config.latencyJitterNanos + 1);
+        pending.push(Action{now + latency, nextSequence++, id, cancel});
+    }
+
+    void Step(const char* message, std::size_t length) {
+        if (length < ItchLayout::HeaderSize) {
+            handler.Apply(message, length);  // Counted as inconsistent
+            return;
+        }
+        if (ReadBigEndian16(message + 1) != config.locate) {
+            if (message[0] == 'R') handler.Apply(message, length);  // Keeps symbol names
+            ++stats.otherEvents;
+            return;
+        }
+        const std::uint64_t timestamp = ReadBigEndian48(message + 5);
+        if (stats.events++ == 0) stats.firstEventTime = timestamp;
+        stats.lastEventTime = timestamp;
+        while (!pending.empty() && pending.top().arrival <= timestamp) {
+            const Action action = pending.top();
+            pending.pop();
+            now = action.arrival;
+            if (action.cancel) {
+                ArriveCancel(action.id);
+            } else {
+                ArriveOrder(action.id);
+            }
+        }
+        now = timestamp;
+
+        const char type = message[0];
+        if (config.queueFills && (type == 'E' || type == 'C') && length >= ItchLayout::OrderExecutedSize &&
+            !resting.empty()) {
+            FillFromQueue(ReadBigEndian64(message + 11), ReadBigEndian32(message + 19));
+        }
+        const std::uint64_t crosses = handler.GetStats().crosses;
+        handler.Apply(message, length);
+        if (handler.GetStats().crosses != crosses) Reconcile();  // A feed order crossed ours
+
+        // Callbacks run last: the strategy may submit, which grows orders
+        for (; notified < fills.size(); ++notified) {
+            const BacktestFill fill = fills[notified];
+            strategy.OnFill(*this, fill);
+        }
+        if (!config.keepFills) {
+            fills.clear();
+            notified = 0;
+        }
+        strategy.OnEvent(*this);
+    }
+
+    void ArriveOrder(OrderId id) {
+        BacktestOrder& order = orders[id - StrategyIdBase];
+        order.arrivedAt = now;
+        ++stats.ordersArrived;
+        const Trades trades =
+            book.AddOrder(Order(order.type, order.id, order.side, order.price, order.quantity));
+        // The incoming order is the aggressor and trades at the resting prices
+        for (const Trade& trade : trades) {
+            const TradeInfo& resting = order.side == Side::Buy ? trade.GetAskTrade() : trade.GetBidTrade();
+            Record(order, resting.price, resting.quantity, BacktestFillKind::Aggressive);
+        }
+        if (!trades.empty()) Reconcile();  // It may have crossed one of our own resting orders
+        if (const std::optional<QueuePosition> position = book.GetQueuePosition(id)) {
+            order.status = BacktestOrderStatus::Resting;
+            order.queueAhead = position->ahead;
+            resting.push_back(id);
+        } else {
+            order.status = order.filled == order.quantity ? BacktestOrderStatus::Filled : BacktestOrderStatus::Cancelled;
+        }
+    }
+
+    void ArriveCancel(OrderId id) {
+        BacktestOrder& order = orders[id - StrategyIdBase];
+        if (order.status != BacktestOrderStatus::Resting) return;
+        ++stats.cancelsArrived;
+        book.CancelOrder(id);
+        order.status = BacktestOrderStatus::Cancelled;
+        Forget(id);
+    }
+
+    /**
+     * The feed is about to execute `quantity` of order `executed`; every
+     * resting strategy order on that side that would have traded first
+     * fills, up to the same quantity
+     */
+    void FillFromQueue(OrderId executed, Quantity quantity) {
+        const std::optional<Order> target = book.FindOrder(executed);
+        if (!target) return;
+        const std::optional<QueuePosition> targetPosition = book.GetQueuePosition(executed);
+        const Side side = target->GetSide();
+        const Price price = target->GetPrice();
+        for (std::size_t i = 0; i < resting.size();) {
+            BacktestOrder& order = orders[resting[i] - StrategyIdBase];
+            bool ahead = false;
+            if (order.side == side) {
+                ahead = side == Side::Buy ? order.price > price : order.price < price;
+                if (order.price == price) ahead = book.GetQueuePosition(order.id)->ahead < targetPosition->ahead;
+            }
+            if (!ahead) {
+                ++i;
+                continue;
+            }
+            const Quantity take = std::min(quantity, order.quantity - order.filled);
+            book.ExecuteOrder(order.id, take);
+            Record(order, order.price, take, BacktestFillKind::Queue);
+            if (order.filled == order.quantity) {
+                order.status = BacktestOrderStatus::Filled;
+                resting[i] = resting.back();
+                resting.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    /**
+     * Picks up passive fills of resting strategy orders after a cross
+     */
+    void Reconcile() {
+        for (std::size_t i = 0; i < resting.size();) {
+            BacktestOrder& order = orders[resting[i] - StrategyIdBase];
+            const std::optional<Order> live = book.FindOrder(order.id);
+            const Quantity remaining = live ? live->GetRemainingQuantity() : 0;
+            if (order.quantity - order.filled > remaining) {
+                Record(order, order.price, order.quantity - order.filled - remaining, BacktestFillKind::Passive);
+            }
+            if (!live) {
+                order.status = BacktestOrderStatus::Filled;
+                resting[i] = resting.back();
+                resting.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    void Record(BacktestOrder& order, Price price, Quantity quantity, BacktestFillKind kind) {
+        order.filled += quantity;
+        order.notional += static_cast<std::int64_t>(price) * static_cast<std::int64_t>(quantity);
+        fills.push_back(BacktestFill{order.id, order.side, price, quantity, now, kind});
+        ++stats.fills;
+        stats.filledQuantity += quantity;
+        if (kind == BacktestFillKind::Aggressive) ++stats.aggressiveFills;
+        if (kind == BacktestFillKind::Passive) ++stats.passiveFills;
+        if (kind == BacktestFillKind::Queue) ++stats.queueFills;
+    }
+
+    void Forget(OrderId id) {
+        for (std::size_t i = 0; i < resting.size(); ++i) {
+            if (resting[i] == id) {
+                resting[i] = resting.back();
+                resting.pop_back();
+                return;
+            }
+        }
+    }
+
+    Strategy& strategy;
+    BacktestConfig config;
+    ItchFeedHandler handler;
+    OrderBook& book;
+    std::mt19937_64 random;
+    std::uint64_t now = 0;
+    std::uint64_t nextSequence = 0;
+
+    std::vector<BacktestOrder> orders;  // Indexed by id - StrategyIdBase
+    std::vector<OrderId> resting;       // Strategy orders in the book, unordered
+    std::vector<BacktestFill> fills;
+    std::size_t notified = 0;           // Fills already passed to OnFill
+    std::priority_queue<Action, std::vector<Action>, std::greater<Action>> pending;
+    BacktestStats stats;
+};
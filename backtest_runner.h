@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backtest.h"
+#include "itch_feed.h"
+#include "latency_recorder.h"
+
+/**
+ * Parallel Backtest Runner
+ *
+ * Splits a backtest over many recorded days into (day file, instrument)
+ * jobs and runs them on a pool of worker threads. Every job builds its own
+ * Backtester (its own book and strategy instance), so jobs share nothing but
+ * the read-only feed mappings, and results are merged once all are done.
+ *
+ * Design Notes:
+ * - Workers take the next job from an atomic index, largest file first, so
+ *   a long day started late does not leave the other cores idle at the end
+ * - A worker holds one job's state at a time: one book, one strategy and its
+ *   orders; fills are not kept (BacktestConfig::keepFills is forced off), so
+ *   memory per worker is bounded by a single instrument-day
+ * - Feed files are mapped, not read: workers replaying the same day share
+ *   its pages through the page cache
+ */
+
+struct BacktestJob {
+    std::string path;      // One recorded day
+    std::uint16_t locate;  // Instrument within it
+};
+
+/**
+ * Strategy-independent summary of one job's strategy orders
+ */
+struct BacktestSummary {
+    std::uint64_t orders = 0;
+    Quantity filled = 0;
+    double slippageTicks = 0;   // Sum of slippage * filled quantity; divide by filled
+    std::uint64_t rested = 0;   // Orders that came to rest
+    Quantity queueAhead = 0;    // Sum of quantity ahead on arrival over rested orders
+
+    void Merge(const BacktestSummary& other) {
+        orders += other.orders;
+        filled += other.filled;
+        slippageTicks += other.slippageTicks;
+        rested += other.rested;
+        queueAhead += other.queueAhead;
+    }
+
+    double GetAverageSlippage() const { return filled ? slippageTicks / static_cast<double>(filled) : 0.0; }
+};
+
+template <typename Strategy>
+struct BacktestJobResult {
+    BacktestJob job;
+    std::string symbol;
+    BacktestStats stats;
+    BacktestSummary summary;
+    Strategy strategy;         // Final state, for strategy-specific figures
+    std::uint64_t nanos = 0;      // Wall time of the job
+    std::uint64_t cpuNanos = 0;   // CPU time of the worker thread during the job
+    std::uint32_t worker = 0;
+};
+
+struct BacktestRunnerConfig {
+    std::size_t workers = 4;
+    BacktestConfig backtest;   // locate is set per job
+};
+
+/**
+ * @returns the stock locates named by Stock Directory messages in a feed
+ */
+inline std::vector<std::uint16_t> FindItchLocates(const char* data, std::size_t length) {
+    std::vector<bool> seen(ItchFeedHandler::MaxLocates);
+    std::vector<std::uint16_t> locates;
+    std::size_t offset = 0;
+    while (offset + 2 <= length) {
+        const std::size_t size = ReadBigEndian16(data + offset);
+        if (offset + 2 + size > length) break;
+        const char* message = data + offset + 2;
+        if (size >= ItchLayout::StockDirectorySize && message[0] == 'R') {
+            const std::uint16_t locate = ReadBigEndian16(message + 1);
+            if (!seen[locate]) {
+                seen[locate] = true;
+                locates.push_back(locate);
+            }
+        }
+        offset += 2 + size;
+    }
+    return locates;
+}
+
+/**
+ * @returns one job per (file, instrument in its Stock Directory), largest files first
+ */
+inline std::vector<BacktestJob> MakeBacktestJobs(const std::vector<std::string>& paths) {
+    std::vector<std::pair<std::uint64_t, BacktestJob>> sized;
+    for (const std::string& path : paths) {
+        const MappedFeed feed(path);
+        for (std::uint16_t locate : FindItchLocates(feed.GetData(), feed.GetSize())) {
+            sized.push_back({feed.GetSize(), BacktestJob{path, locate}});
+        }
+    }
+    std::stable_sort(sized.begin(), sized.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    std::vector<BacktestJob> jobs;
+    jobs.reserve(sized.size());
+    for (auto& [size, job] : sized) jobs.push_back(std::move(job));
+    return jobs;
+}
+
+template <typename Strategy>
+class BacktestRunner {
+public:
+    explicit BacktestRunner(const BacktestRunnerConfig& config) : config(config) {
+        if (config.workers == 0) throw std::runtime_error("BacktestRunner: at least one worker is required");
+        this->config.backtest.keepFills = false;
+    }
+
+    /**
+     * Runs every job, each with a strategy copied from prototype; returns
+     * when all are done
+     * @returns results in job order
+     * @throws the first exception a job threw, after the workers have stopped
+     */
+    std::vector<BacktestJobResult<Strategy>> Run(const std::vector<BacktestJob>& jobs, const Strategy& prototype) {
+        std::vector<BacktestJobResult<Strategy>> results(jobs.size(), BacktestJobResult<Strategy>{{}, {}, {}, {}, prototype});
+        std::atomic<std::size_t> next{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        workerNanos.assign(config.workers, 0);
+
+        auto work = [&](std::uint32_t worker) {
+            while (!failed.load(std::memory_order_relaxed)) {
+                const std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+                if (index >= jobs.size()) return;
+                try {
+                    RunJob(jobs[index], results[index], worker);
+                    workerNanos[worker] += results[index].cpuNanos;
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        const std::uint64_t start = NowNanos();
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < config.workers; ++i) threads.emplace_back(work, static_cast<std::uint32_t>(i));
+        work(0);
+        for (std::thread& thread : threads) thread.join();
+        wallNanos = NowNanos() - start;
+        if (error) std::rethrow_exception(error);
+        return results;
+    }
+
+    /**
+     * CPU time each worker spent inside jobs during the last Run(); their sum
+     * over wall time * workers is how well the pool used its cores
+     */
+    const std::vector<std::uint64_t>& GetWorkerNanos() const { return workerNanos; }
+    std::uint64_t GetWallNanos() const { return wallNanos; }
+
+private:
+    void RunJob(const BacktestJob& job, BacktestJobResult<Strategy>& result, std::uint32_t worker) {
+        const std::uint64_t start = NowNanos();
+        const std::uint64_t cpuStart = ThreadCpuNanos();
+        BacktestConfig backtest = config.backtest;
+        backtest.locate = job.locate;
+        Backtester<Strategy> sim(result.strategy, backtest);
+        sim.RunFile(job.path);
+
+        result.job = job;
+        result.symbol = sim.GetSymbol();
+        result.stats = sim.GetStats();
+        for (const BacktestOrder& order : sim.GetOrders()) {
+            ++result.summary.orders;
+            result.summary.filled += order.filled;
+            result.summary.slippageTicks += order.GetSlippage() * static_cast<double>(order.filled);
+            if (order.queueAhead) {
+                ++result.summary.rested;
+                result.summary.queueAhead += *order.queueAhead;
+            }
+        }
+        result.worker = worker;
+        result.nanos = NowNanos() - start;
+        result.cpuNanos = ThreadCpuNanos() - cpuStart;
+    }
+
+    static std::uint64_t ThreadCpuNanos() {
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return static_cast<std::uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<std::uint64_t>(now.tv_nsec);
+    }
+
+    BacktestRunnerConfig config;
+    std::vector<std::uint64_t> workerNanos;
+    std::uint64_t wallNanos = 0;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * BroadcastRing is a single-writer, many-reader ring where every reader sees
+ * every element. The writer never waits for readers: a reader that falls a
+ * full ring behind is told it was overrun instead of holding the writer up.
+ *
+ * Each slot carries its own sequence word used as a seqlock:
+ * - odd  (2s + 1): slot is being overwritten with element s
+ * - even (2s + 2): slot holds element s
+ * Readers copy the element and re-check the word, so a torn read caused by
+ * a concurrent overwrite is detected and reported as an overrun.
+ *
+ * The ring holds no pointers, so it can live in shared memory.
+ */
+template <typename T, std::size_t Capacity>
+class BroadcastRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "Elements are copied with memcpy");
+
+public:
+    enum class ReadResult {
+        Ok,
+        NotReady,  // Element not published yet
+        Overrun    // Element already overwritten; the reader fell too far behind
+    };
+
+    /**
+     * Writer side: publishes value as the next sequence number
+     * @returns the sequence number assigned to value
+     */
+    std::uint64_t Publish(const T& value) {
+        const std::uint64_t sequence = cursor.load(std::memory_order_relaxed);
+        Slot& slot = slots[sequence & (Capacity - 1)];
+        slot.version.store(2 * sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&slot.value, &value, sizeof(T));
+        slot.version.store(2 * sequence + 2, std::memory_order_release);
+        cursor.store(sequence + 1, std::memory_order_release);
+        return sequence;
+    }
+
+    /**
+     * @returns the sequence number the next Publish will use
+     */
+    std::uint64_t GetCursor() const { return cursor.load(std::memory_order_acquire); }
+
+    /**
+     * Reader side: copies element `sequence` into out
+     */
+    ReadResult TryRead(std::uint64_t sequence, T& out) const {
+        const Slot& slot = slots[sequence & (Capacity - 1)];
+        const std::uint64_t expected = 2 * sequence + 2;
+        const std::uint64_t before = slot.version.load(std::memory_order_acquire);
+        if (before < expected) return ReadResult::NotReady;  // Older lap, or being written now
+        if (before != expected) return ReadResult::Overrun;
+
+        std::memcpy(&out, &slot.value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) != expected) return ReadResult::Overrun;
+        return ReadResult::Ok;
+    }
+
+    static constexpr std::size_t GetCapacity() { return Capacity; }
+
+private:
+    static constexpr std::size_t CacheLineSize = 64;
+
+    struct Slot {
+        std::atomic<std::uint64_t> version{0};
+        T value;
+    };
+
+    alignas(CacheLineSize) std::atomic<std::uint64_t> cursor{0};
+    alignas(CacheLineSize) Slot slots[Capacity];
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Coroutine Support
+ *
+ * Session logic (logon, heartbeats, sequence recovery) reads best as straight
+ * line code that waits for the next message. Task is a minimal coroutine type
+ * for that: the owner resumes it whenever something the coroutine waits for
+ * has happened, and checks Done() afterwards.
+ *
+ * Frames come from FramePool, a per-thread free list of size-classed blocks,
+ * so starting and finishing sessions does not touch the global allocator once
+ * the pool has warmed up.
+ */
+
+struct FramePoolStats {
+    std::uint64_t allocations = 0;    // Frames handed out
+    std::uint64_t chunks = 0;         // Chunks requested from the global allocator
+    std::uint64_t oversized = 0;      // Frames too large to pool
+    std::uint64_t framesInUse = 0;
+};
+
+/**
+ * FramePool hands out coroutine frames from per-size-class free lists.
+ *
+ * Design Notes:
+ * - Sizes are rounded up to Granularity; each class has its own free list
+ * - Empty classes are refilled by carving a ChunkSize block, which stays
+ *   owned by the pool for the lifetime of the thread
+ * - Not thread-safe by design: a frame must be freed on the thread that
+ *   allocated it, which holds for coroutines resumed by one event loop
+ */
+class FramePool {
+public:
+    static constexpr std::size_t Granularity = 64;
+    static constexpr std::size_t MaxPooledSize = 4096;
+    static constexpr std::size_t ChunkSize = 64 * 1024;
+
+    static FramePool& Local() {
+        thread_local FramePool pool;
+        return pool;
+    }
+
+    void* Allocate(std::size_t size) {
+        ++stats.allocations;
+        ++stats.framesInUse;
+        if (size > MaxPooledSize) {
+            ++stats.oversized;
+            return ::operator new(size);
+        }
+        FreeBlock*& head = freeLists[ClassOf(size)];
+        if (!head) Refill(ClassOf(size));
+        FreeBlock* block = head;
+        head = block->next;
+        return block;
+    }
+
+    void Deallocate(void* frame, std::size_t size) noexcept {
+        --stats.framesInUse;
+        if (size > MaxPooledSize) {
+            ::operator delete(frame);
+            return;
+        }
+        FreeBlock*& head = freeLists[ClassOf(size)];
+        head = new (frame) FreeBlock{head};
+    }
+
+    const FramePoolStats& GetStats() const { return stats; }
+
+private:
+    static constexpr std::size_t ClassCount = MaxPooledSize / Granularity;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static std::size_t ClassOf(std::size_t size) { return (size + Granularity - 1) / Granularity - 1; }
+
+    void Refill(std::size_t sizeClass) {
+        const std::size_t blockSize = (sizeClass + 1) * Granularity;
+        chunks.push_back(std::make_unique<std::byte[]>(ChunkSize));
+        ++stats.chunks;
+        std::byte* chunk = chunks.back().get();
+        for (std::size_t offset = 0; offset + blockSize <= ChunkSize; offset += blockSize) {
+            freeLists[sizeClass] = new (chunk + offset) FreeBlock{freeLists[sizeClass]};
+        }
+    }
+
+    FreeBlock* freeLists[ClassCount] = {};
+    std::vector<std::unique_ptr<std::byte[]>> chunks;
+    FramePoolStats stats;
+};
+
+/**
+ * Task is a coroutine owned by whoever called it.
+ *
+ * It does not run until the first Resume(), stays suspended at the end so
+ * the owner can observe Done(), and is destroyed with its owner. An
+ * exception escaping the body is rethrown from Resume().
+ */
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        static void* operator new(std::size_t size) { return FramePool::Local().Allocate(size); }
+        static void operator delete(void* frame, std::size_t size) noexcept {
+            FramePool::Local().Deallocate(frame, size);
+        }
+
+        std::exception_ptr exception;
+    };
+
+    Task() = default;
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool Done() const { return !handle || handle.done(); }
+
+    /**
+     * Continues the coroutine from its current suspension point
+     */
+    void Resume() {
+        if (Done()) return;
+        handle.resume();
+        if (handle.done() && handle.promise().exception) {
+            std::rethrow_exception(std::exchange(handle.promise().exception, nullptr));
+        }
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
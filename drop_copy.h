@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#endif
+
+#include "broadcast_ring.h"
+#include "protocol.h"
+
+/**
+ * Drop-Copy Stream
+ *
+ * Back-office, risk and surveillance each want a copy of every fill. The
+ * matching thread writes one ExecutionReport per side of every trade into a
+ * BroadcastRing and never looks at who is reading:
+ * - Each consumer owns a read cursor, so adding consumers adds no work to
+ *   the writer
+ * - The writer never waits; a consumer that falls a ring behind is overrun,
+ *   counts the reports it lost and resynchronizes
+ * - Consumers publish their cursor and loss count so a monitor can see lag
+ *   building up before reports are lost
+ *
+ * On Linux the ring lives in /dev/shm (see DropCopyRegion) so consumers can
+ * be separate processes.
+ */
+
+/**
+ * One side of one trade
+ */
+struct ExecutionReport {
+    std::uint64_t matchId;    // Shared by both sides of a trade; engine-wide, from 1
+    std::uint64_t timestamp;  // NowNanos() when the command that traded was matched
+    SessionId session;        // Owner of orderId; 0 if the engine does not know it
+    OrderId orderId;
+    OrderId contraOrderId;
+    Quantity quantity;
+    Price price;
+    Side side;
+    bool aggressor;  // orderId was the incoming order
+};
+
+using ExecutionReportRing = BroadcastRing<ExecutionReport, 1 << 16>;
+
+#if defined(__linux__)
+
+/**
+ * DropCopyRegion is the layout of the shared file: consumer slots followed
+ * by the ring. Like ShmRegion it holds no pointers.
+ */
+struct DropCopyRegion {
+    static constexpr std::uint64_t Magic = 0x4f424f4f4b444350ULL;  // "OBOOKDCP"
+    static constexpr std::uint32_t Version = 1;
+    static constexpr std::uint32_t MaxConsumers = 16;
+    static constexpr std::size_t MaxNameLength = 32;
+
+    enum ConsumerState : std::uint32_t {
+        Free = 0,
+        Active
+    };
+
+    struct alignas(64) ConsumerSlot {
+        std::atomic<std::uint32_t> state{Free};
+        char name[MaxNameLength] = {};
+        std::atomic<std::uint64_t> cursor{0};  // Next sequence the consumer will read
+        std::atomic<std::uint64_t> missed{0};  // Reports lost to overruns
+    };
+
+    std::atomic<std::uint64_t> magic{0};
+    std::uint32_t version;
+    ConsumerSlot consumers[MaxConsumers];
+    ExecutionReportRing ring;
+
+    static std::string Path(const std::string& name) {
+        return "/dev/shm/" + name;
+    }
+
+    /**
+     * Maps the region file, creating and initializing it when create is true
+     */
+    static DropCopyRegion* Map(const std::string& name, bool create) {
+        const std::string path = Path(name);
+        int fd = open(path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC) : (O_RDWR | O_CLOEXEC), 0600);
+        if (fd < 0) throw std::runtime_error("DropCopyRegion: cannot open " + path + ": " + std::strerror(errno));
+        if (create && ftruncate(fd, sizeof(DropCopyRegion)) < 0) {
+            close(fd);
+            throw std::runtime_error("DropCopyRegion: cannot size " + path + ": " + std::strerror(errno));
+        }
+        void* memory = mmap(nullptr, sizeof(DropCopyRegion), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) {
+            throw std::runtime_error("DropCopyRegion: cannot map " + path + ": " + std::strerror(errno));
+        }
+
+        if (create) {
+            DropCopyRegion* region = new (memory) DropCopyRegion();
+            region->version = Version;
+            region->magic.store(Magic, std::memory_order_release);  // Last: consumers treat a matching magic as "ready"
+            return region;
+        }
+        auto* region = static_cast<DropCopyRegion*>(memory);
+        if (region->magic.load(std::memory_order_acquire) != Magic || region->version != Version) {
+            munmap(memory, sizeof(DropCopyRegion));
+            throw std::runtime_error("DropCopyRegion: " + path + " is not an initialized drop-copy region");
+        }
+        return region;
+    }
+};
+
+struct DropCopyConsumerStatus {
+    std::string name;
+    std::uint64_t cursor;
+    std::uint64_t lag;     // Reports published but not yet read
+    std::uint64_t missed;
+    bool slow;             // Lost reports, or more than half a ring behind
+};
+
+/**
+ * DropCopyPublisher owns the region; the matching thread writes to GetRing()
+ */
+class DropCopyPublisher {
+public:
+    explicit DropCopyPublisher(const std::string& name) : name(name), region(DropCopyRegion::Map(name, true)) {}
+
+    ~DropCopyPublisher() {
+        munmap(region, sizeof(DropCopyRegion));
+        unlink(DropCopyRegion::Path(name).c_str());
+    }
+
+    DropCopyPublisher(const DropCopyPublisher&) = delete;
+    DropCopyPublisher& operator=(const DropCopyPublisher&) = delete;
+
+    ExecutionReportRing& GetRing() { return region->ring; }
+
+    /**
+     * Snapshot of every attached consumer. Reads only what consumers
+     * publish, so it may run on any thread without touching the writer.
+     */
+    std::vector<DropCopyConsumerStatus> GetConsumers() const {
+        std::vector<DropCopyConsumerStatus> result;
+        const std::uint64_t published = region->ring.GetCursor();
+        for (const DropCopyRegion::ConsumerSlot& slot : region->consumers) {
+            if (slot.state.load(std::memory_order_acquire) != DropCopyRegion::Active) continue;
+            const std::uint64_t cursor = slot.cursor.load(std::memory_order_acquire);
+            const std::uint64_t missed = slot.missed.load(std::memory_order_relaxed);
+            const std::uint64_t lag = published > cursor ? published - cursor : 0;
+            result.push_back(DropCopyConsumerStatus{slot.name, cursor, lag, missed,
+                                                    missed > 0 || lag > SlowLag});
+        }
+        return result;
+    }
+
+private:
+    static constexpr std::uint64_t SlowLag = ExecutionReportRing::GetCapacity() / 2;
+
+    std::string name;
+    DropCopyRegion* region;
+};
+
+/**
+ * DropCopyConsumer attaches to a publisher's region under a name and reads
+ * every report published after it attached
+ */
+class DropCopyConsumer {
+public:
+    DropCopyConsumer(const std::string& regionName, const std::string& consumerName)
+        : region(DropCopyRegion::Map(regionName, false)) {
+        for (std::uint32_t i = 0; i < DropCopyRegion::MaxConsumers; ++i) {
+            std::uint32_t expected = DropCopyRegion::Free;
+            if (region->consumers[i].state.compare_exchange_strong(expected, DropCopyRegion::Active,
+                                                                   std::memory_order_acq_rel)) {
+                slot = &region->consumers[i];
+                break;
+            }
+        }
+        if (!slot) {
+            munmap(region, sizeof(DropCopyRegion));
+            throw std::runtime_error("DropCopyConsumer: all consumer slots are in use");
+        }
+        std::memset(slot->name, 0, DropCopyRegion::MaxNameLength);
+        std::memcpy(slot->name, consumerName.data(), std::min(consumerName.size(), DropCopyRegion::MaxNameLength - 1));
+        sequence = region->ring.GetCursor();
+        slot->missed.store(0, std::memory_order_relaxed);
+        slot->cursor.store(sequence, std::memory_order_release);
+    }
+
+    ~DropCopyConsumer() {
+        slot->state.store(DropCopyRegion::Free, std::memory_order_release);
+        munmap(region, sizeof(DropCopyRegion));
+    }
+
+    DropCopyConsumer(const DropCopyConsumer&) = delete;
+    DropCopyConsumer& operator=(const DropCopyConsumer&) = delete;
+
+    /**
+     * Calls handler(const ExecutionReport&) for up to maxBatch reports and
+     * publishes the cursor once per batch. After an overrun it resumes half
+     * a ring behind the writer, the oldest point that is unlikely to be
+     * overwritten again at once.
+     * @returns the number of reports handled
+     */
+    template <typename Handler>
+    std::size_t Poll(Handler&& handler, std::size_t maxBatch = 256) {
+        const ExecutionReportRing& ring = region->ring;
+        ExecutionReport report;
+        std::size_t handled = 0;
+        while (handled < maxBatch) {
+            const auto result = ring.TryRead(sequence, report);
+            if (result == ExecutionReportRing::ReadResult::NotReady) break;
+            if (result == ExecutionReportRing::ReadResult::Overrun) {
+                const std::uint64_t resume = ring.GetCursor() - ExecutionReportRing::GetCapacity() / 2;
+                missed += resume - sequence;
+                sequence = resume;
+                slot->missed.store(missed, std::memory_order_relaxed);
+                continue;
+            }
+            handler(report);
+            ++sequence;
+            ++handled;
+        }
+        if (handled > 0) slot->cursor.store(sequence, std::memory_order_release);
+        return handled;
+    }
+
+    std::uint64_t GetMissed() const { return missed; }
+
+private:
+    DropCopyRegion* region;
+    DropCopyRegion::ConsumerSlot* slot = nullptr;
+    std::uint64_t sequence = 0;
+    std::uint64_t missed = 0;
+};
+
+#endif  // __linux__
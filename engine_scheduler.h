@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "latency_recorder.h"
+#include "matching_engine.h"
+#include "protocol.h"
+#include "spsc_queue.h"
+
+/**
+ * Work-Stealing Engine Scheduler
+ *
+ * Runs one MatchingEngine per instrument on a pool of worker threads. The
+ * unit of work is the instrument, never the order: each instrument has its
+ * own command queue and book, and exactly one worker drains it at a time,
+ * so every book sees its commands in submission order however instruments
+ * move between workers.
+ *
+ * Instruments start spread round-robin over the workers. A worker that
+ * finds nothing to do looks for the most loaded peer and, if that peer has
+ * a backlog on an instrument it is not processing right now, takes the
+ * whole instrument over. The hottest instrument keeps its worker; the ones
+ * queued up behind it move to idle cores.
+ *
+ * Design Notes:
+ * - Ownership is an owner index plus a claimed flag per instrument; a worker
+ *   processes an instrument only while holding the flag, and a thief moves
+ *   it only while holding the flag, so the engine is handed over with
+ *   release/acquire ordering and never shared
+ * - Each worker's instrument list is guarded by a mutex that is only
+ *   contended during a steal; the owner copies the list once per sweep
+ * - Submit() is single-producer: one thread feeds every instrument queue
+ */
+
+using InstrumentId = std::uint32_t;
+
+struct EngineSchedulerConfig {
+    std::size_t workers = 4;
+    std::size_t queueCapacity = 1 << 14;  // Per instrument
+    std::size_t batchSize = 64;           // Commands taken from one instrument before moving to the next
+    std::size_t minStealBacklog = 64;     // Queued commands an instrument needs before it is worth moving
+    std::uint64_t minResidencyNanos = 1'000'000;  // An instrument stays this long after moving, to stop ping-pong
+    bool stealing = true;
+    std::vector<int> cpus;                // Empty, or one CPU per worker
+};
+
+struct EngineWorkerStats {
+    std::uint64_t commands = 0;
+    std::uint64_t busyNanos = 0;     // Time spent matching
+    std::uint64_t runNanos = 0;      // Time from Start() to the worker exiting
+    std::uint64_t stolen = 0;        // Instruments this worker took from peers
+    std::uint64_t lost = 0;          // Instruments peers took from this worker
+    std::uint64_t instruments = 0;   // Owned when the worker exited
+
+    double GetUtilization() const {
+        return runNanos ? static_cast<double>(busyNanos) / static_cast<double>(runNanos) : 0.0;
+    }
+};
+
+struct InstrumentStats {
+    std::uint64_t commands = 0;
+    std::uint64_t events = 0;
+    std::uint64_t migrations = 0;
+    std::uint64_t eventChecksum = 0;  // FNV-1a over every event, in order; equal runs match event for event
+    std::uint32_t owner = 0;          // Worker that owned the instrument last
+};
+
+class EngineScheduler {
+public:
+    EngineScheduler(std::size_t instrumentCount, const EngineSchedulerConfig& config)
+        : config(config), workers(config.workers) {
+        if (config.workers == 0) throw std::runtime_error("EngineScheduler: at least one worker is required");
+        if (!config.cpus.empty() && config.cpus.size() != config.workers) {
+            throw std::runtime_error("EngineScheduler: give one CPU per worker or none");
+        }
+#if defined(__linux__)
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        for (int cpu : config.cpus) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)) {
+                throw std::runtime_error("EngineScheduler: CPU " + std::to_string(cpu) + " is not available");
+            }
+        }
+#endif
+        instruments.reserve(instrumentCount);
+        for (std::size_t i = 0; i < instrumentCount; ++i) {
+            instruments.push_back(std::make_unique<Instrument>(config.queueCapacity));
+            const auto owner = static_cast<std::uint32_t>(i % config.workers);
+            instruments[i]->owner.store(owner, std::memory_order_relaxed);
+            instruments[i]->stats.owner = owner;
+            workers[owner].owned.push_back(instruments[i].get());
+        }
+    }
+
+    ~EngineScheduler() { Stop(); }
+
+    EngineScheduler(const EngineScheduler&) = delete;
+    EngineScheduler& operator=(const EngineScheduler&) = delete;
+
+    void Start() {
+        if (!threads.empty()) throw std::runtime_error("EngineScheduler: already started");
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+            threads.emplace_back([this, i] { RunWorker(static_cast<std::uint32_t>(i)); });
+        }
+    }
+
+    /**
+     * Queues a command for an instrument, spinning while its queue is full.
+     * Must always be called from the same thread.
+     */
+    void Submit(InstrumentId instrument, const Command& command) {
+        if (instrument >= instruments.size()) throw std::runtime_error("EngineScheduler: unknown instrument");
+        SpscQueue<Command>& queue = instruments[instrument]->queue;
+        while (!queue.TryPush(command)) {
+            if (threads.empty()) throw std::runtime_error("EngineScheduler: queue full and no workers running");
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Processes everything submitted so far, then joins the workers
+     */
+    void Stop() {
+        stopping.store(true, std::memory_order_release);
+        for (std::thread& thread : threads) thread.join();
+        threads.clear();
+    }
+
+    /**
+     * Only meaningful after Stop()
+     */
+    const EngineWorkerStats& GetWorkerStats(std::size_t worker) const { return workers[worker].stats; }
+    const InstrumentStats& GetInstrumentStats(InstrumentId instrument) const { return instruments[instrument]->stats; }
+    const MatchingEngine& GetEngine(InstrumentId instrument) const { return instruments[instrument]->engine; }
+    std::size_t GetWorkerCount() const { return workers.size(); }
+    std::size_t GetInstrumentCount() const { return instruments.size(); }
+
+private:
+    struct alignas(64) Instrument {
+        explicit Instrument(std::size_t capacity) : queue(capacity) {}
+
+        SpscQueue<Command> queue;
+        std::atomic<bool> claimed{false};
+        std::atomic<std::uint32_t> owner{0};
+        MatchingEngine engine;
+        InstrumentStats stats;  // Written by whichever worker holds the claim
+        std::uint64_t arrivedAt = 0;  // NowNanos() of the last migration; guarded by the owner's mutex
+    };
+
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::vector<Instrument*> owned;  // Guarded by mutex
+        EngineWorkerStats stats;         // Written only by the worker thread
+    };
+
+    static bool TryClaim(Instrument& instrument) {
+        return !instrument.claimed.load(std::memory_order_relaxed) &&
+               !instrument.claimed.exchange(true, std::memory_order_acquire);
+    }
+
+    static void Release(Instrument& instrument) { instrument.claimed.store(false, std::memory_order_release); }
+
+    void RunWorker(std::uint32_t self) {
+#if defined(__linux__)
+        if (!config.cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(config.cpus[self], &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+#endif
+        Worker& worker = workers[self];
+        std::vector<Instrument*> sweep;
+        sweep.reserve(instruments.size());
+        const std::uint64_t start = NowNanos();
+        unsigned idleSpins = 0;
+        while (true) {
+            // Read before sweeping: a worker leaves only after a sweep that began
+            // once the producer was done and found nothing
+            const bool stop = stopping.load(std::memory_order_acquire);
+            {
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                sweep.assign(worker.owned.begin(), worker.owned.end());
+            }
+            bool worked = false;
+            for (Instrument* instrument : sweep) worked |= Drain(self, *instrument);
+            if (worked) {
+                idleSpins = 0;
+                continue;
+            }
+            if (stop) break;
+            if (config.stealing && TrySteal(self)) continue;
+            if (++idleSpins < 64) {
+                CpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        worker.stats.runNanos = NowNanos() - start;
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.stats.instruments = worker.owned.size();
+    }
+
+    /**
+     * Processes up to one batch of the instrument's queue
+     * @returns true if any command was processed
+     */
+    bool Drain(std::uint32_t self, Instrument& instrument) {
+        if (!TryClaim(instrument)) return false;
+        if (instrument.owner.load(std::memory_order_relaxed) != self) {  // Stolen since the sweep began
+            Release(instrument);
+            return false;
+        }
+        Command command;
+        std::size_t processed = 0;
+        std::uint64_t begin = 0;
+        InstrumentStats& stats = instrument.stats;
+        while (processed < config.batchSize && instrument.queue.TryPop(command)) {
+            if (processed == 0) begin = NowNanos();
+            instrument.engine.Process(command, [&stats](const Event& event) {
+                ++stats.events;
+                stats.eventChecksum = Checksum(stats.eventChecksum, event);
+            });
+            ++processed;
+        }
+        if (processed > 0) {
+            stats.commands += processed;
+            EngineWorkerStats& workerStats = workers[self].stats;
+            workerStats.commands += processed;
+            workerStats.busyNanos += NowNanos() - begin;
+        }
+        Release(instrument);
+        return processed > 0;
+    }
+
+    /**
+     * Takes the most backlogged instrument from the most loaded peer,
+     * provided the peer is busy with another of its instruments
+     * @returns true if an instrument moved to this worker
+     */
+    bool TrySteal(std::uint32_t self) {
+        std::size_t victim = workers.size();
+        std::size_t victimBacklog = 0;
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+            if (i == self) continue;
+            std::unique_lock<std::mutex> lock(workers[i].mutex, std::try_to_lock);
+            if (!lock.owns_lock()) continue;
+            std::size_t backlog = 0;
+            std::size_t busy = 0;
+            for (Instrument* instrument : workers[i].owned) {
+                const std::size_t queued = instrument->queue.Size();
+                backlog += queued;
+                busy += queued > 0;
+            }
+            if (busy >= 2 && backlog > victimBacklog) {
+                victim = i;
+                victimBacklog = backlog;
+            }
+        }
+        if (victim == workers.size()) return false;
+
+        Instrument* taken = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(workers[victim].mutex);
+            std::vector<Instrument*>& owned = workers[victim].owned;
+            const std::uint64_t now = NowNanos();
+            std::vector<Instrument*>::iterator best = owned.end();
+            std::size_t bestQueued = 0;
+            for (auto it = owned.begin(); it != owned.end(); ++it) {
+                const std::size_t queued = (*it)->queue.Size();
+                if (queued >= config.minStealBacklog && queued > bestQueued &&
+                    now - (*it)->arrivedAt >= config.minResidencyNanos &&
+                    !(*it)->claimed.load(std::memory_order_relaxed)) {
+                    best = it;
+                    bestQueued = queued;
+                }
+            }
+            if (best == owned.end() || !TryClaim(**best)) return false;
+            taken = *best;
+            *best = owned.back();
+            owned.pop_back();
+            taken->owner.store(self, std::memory_order_relaxed);
+            taken->arrivedAt = now;
+            ++taken->stats.migrations;
+            taken->stats.owner = self;
+            Release(*taken);
+            ++workers[victim].stats.lost;  // Counted under the victim's mutex; read only after join
+        }
+        std::lock_guard<std::mutex> lock(workers[self].mutex);
+        workers[self].owned.push_back(taken);
+        ++workers[self].stats.stolen;
+        return true;
+    }
+
+    static std::uint64_t Checksum(std::uint64_t hash, const Event& event) {
+        const std::uint64_t fields[] = {static_cast<std::uint64_t>(event.type), static_cast<std::uint64_t>(event.reason),
+                                        event.orderId, static_cast<std::uint64_t>(event.price), event.quantity};
+        if (hash == 0) hash = 14695981039346656037ULL;
+        for (std::uint64_t field : fields) {
+            hash ^= field;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    EngineSchedulerConfig config;
+    std::vector<std::unique_ptr<Instrument>> instruments;
+    std::vector<Worker> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping{false};
+};
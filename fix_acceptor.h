@@ -0,0 +1,932 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "coroutine.h"
+#include "fix_protocol.h"
+#include "latency_recorder.h"
+#include "matching_engine.h"
+
+/**
+ * FIX 4.4 Acceptor
+ *
+ * Accepts FIX sessions over TCP and drives the same MatchingEngine as the
+ * binary gateway. One thread owns the sockets and the engine (epoll, edge
+ * triggered); messages are matched as soon as they are parsed.
+ *
+ * Session layer:
+ * - Each session is one coroutine (RunSession) that awaits its next message
+ *   or deadline. The transport resumes it per parsed message, a coarse timer
+ *   scan resumes it when its deadline passes. Frames come from the per-thread
+ *   FramePool, so thousands of sessions cost one small block each.
+ * - Logon (A) must be the first message; one session per SenderCompID
+ * - Heartbeats (0) are sent every HeartBtInt; a peer silent for longer gets
+ *   a TestRequest (1) and is logged out if it stays silent another interval
+ * - Inbound gaps trigger one ResendRequest (2); later messages are dropped
+ *   until the peer has resent or gap-filled the missing range
+ * - ResendRequests are answered from a per-session store of the last
+ *   resendStoreSize application messages (PossDupFlag=Y); administrative
+ *   and expired messages are covered by SequenceReset-GapFill
+ * - Logout (5) is answered and the connection closed
+ *
+ * Application layer:
+ * - NewOrderSingle (D), OrderCancelRequest (F), OrderCancelReplaceRequest (G)
+ * - ExecutionReports (8) for New, Trade, Canceled, Replaced and Rejected,
+ *   OrderCancelReject (9) for refused cancels/replaces
+ * - OrderStatusRequest (H), answered with an ExecutionReport (ExecType I);
+ *   finished orders are looked up in the engine's status history by the
+ *   ClOrdID they were entered with
+ *
+ * Engine OrderIds are a hash of (SenderCompID, ClOrdID); replaced orders
+ * keep their engine OrderId and are found through an alias of the new ClOrdID.
+ * Duplicate ClOrdIDs are only detected among live orders.
+ */
+
+struct FixAcceptorConfig {
+    std::string bindAddress = "0.0.0.0";
+    std::uint16_t port = 9878;  // 0 picks an ephemeral port (see GetPort)
+    std::string senderCompId = "ORDERBOOK";
+    std::int64_t priceScale = 1;  // Ticks per price unit; a power of ten
+    std::size_t sessionBufferSize = 1 << 16;
+    std::size_t resendStoreSize = 256;  // Application messages kept per session for ResendRequests
+    bool cancelOnDisconnect = true;     // Pull a session's resting orders when it closes
+    int maxEventsPerWait = 256;
+};
+
+struct FixAcceptorStats {
+    std::uint64_t sessionsAccepted = 0;
+    std::uint64_t sessionsClosed = 0;
+    std::uint64_t messagesIn = 0;
+    std::uint64_t messagesOut = 0;
+    std::uint64_t executionReports = 0;
+    std::uint64_t sessionRejects = 0;
+    std::uint64_t resendRequestsSent = 0;
+    std::uint64_t messagesResent = 0;
+    std::uint64_t ordersCancelledOnDisconnect = 0;
+    FramePoolStats framePool;  // Snapshot taken when Run() returns
+};
+
+class FixAcceptor {
+public:
+    explicit FixAcceptor(const FixAcceptorConfig& config) : config(config) {
+        std::int64_t scale = config.priceScale;
+        while (scale > 1 && scale % 10 == 0) scale /= 10;
+        if (scale != 1) throw std::invalid_argument("FixAcceptor: price scale must be a power of ten");
+
+        listenFd = CreateListenSocket();
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (wakeFd < 0 || epollFd < 0) {
+            throw std::runtime_error("FixAcceptor: failed to create eventfd/epoll: " + std::string(std::strerror(errno)));
+        }
+        Watch(listenFd, EPOLLIN | EPOLLET, ListenToken);
+        Watch(wakeFd, EPOLLIN | EPOLLET, WakeToken);
+    }
+
+    ~FixAcceptor() {
+        for (auto& [id, session] : sessions) close(session.fd);
+        close(epollFd);
+        close(wakeFd);
+        close(listenFd);
+    }
+
+    FixAcceptor(const FixAcceptor&) = delete;
+    FixAcceptor& operator=(const FixAcceptor&) = delete;
+
+    /**
+     * Runs the event loop on the calling thread until Stop() is called
+     */
+    void Run() {
+        running.store(true);
+        std::vector<epoll_event> events(config.maxEventsPerWait);
+
+        while (running.load(std::memory_order_relaxed)) {
+            int n = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), TimerIntervalMs);
+            if (n < 0 && errno != EINTR) {
+                throw std::runtime_error("FixAcceptor: epoll_wait failed: " + std::string(std::strerror(errno)));
+            }
+            for (int i = 0; i < n; ++i) {
+                const std::uint64_t token = events[i].data.u64;
+                if (token == ListenToken) {
+                    AcceptSessions();
+                } else if (token == WakeToken) {
+                    std::uint64_t value;
+                    [[maybe_unused]] ssize_t r = read(wakeFd, &value, sizeof(value));
+                } else {
+                    HandleSessionEvent(token, events[i].events);
+                }
+            }
+            CheckTimers();
+            FlushDirtySessions();
+        }
+
+        // Session frames belong to this thread's FramePool, so they must not
+        // outlive Run()
+        for (auto& [id, session] : sessions) session.task = Task();
+        stats.framePool = FramePool::Local().GetStats();
+    }
+
+    /**
+     * Requests shutdown. Safe to call from any thread or a signal handler.
+     */
+    void Stop() {
+        running.store(false);
+        std::uint64_t one = 1;
+        [[maybe_unused]] ssize_t n = write(wakeFd, &one, sizeof(one));
+    }
+
+    std::uint16_t GetPort() const {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+    /**
+     * Only meaningful once Run() has returned
+     */
+    const FixAcceptorStats& GetStats() const { return stats; }
+
+private:
+    static constexpr std::uint64_t ListenToken = 0;
+    static constexpr std::uint64_t WakeToken = 1;
+    static constexpr SessionId FirstSessionId = 2;  // Session ids double as epoll tokens
+    static constexpr int TimerIntervalMs = 100;
+    static constexpr std::uint64_t LogonTimeoutNanos = 10'000'000'000ULL;
+    static constexpr std::size_t MaxIdLength = 32;
+
+    enum class SessionState {
+        AwaitingLogon,
+        Active,
+        Closing  // Logout sent; close once output is flushed
+    };
+
+    /**
+     * An application message kept for ResendRequests: its original
+     * SendingTime followed by the fields after the standard header
+     */
+    struct SentMessage {
+        std::uint64_t seqNum;
+        std::size_t offset;  // Into Session::sentBytes
+        std::size_t length;
+        char msgType;
+    };
+
+    struct Session {
+        int fd = -1;
+        SessionState state = SessionState::AwaitingLogon;
+        Task task;                 // RunSession; done once the session is over
+        bool delivered = false;    // Set when the task is resumed with a message, clear on a timeout
+        std::uint64_t deadline = 0;
+        std::string targetCompId;  // The peer's SenderCompID, set at logon
+        std::uint64_t heartbeatNanos = 30'000'000'000ULL;
+        std::uint64_t expectedSeqNum = 1;
+        std::uint64_t gapEnd = 0;  // Highest MsgSeqNum seen past a gap; recovering while >= expectedSeqNum
+        std::uint64_t nextSeqNum = 1;
+        std::uint64_t lastReceived = 0;
+        std::uint64_t lastSent = 0;
+        std::vector<char> input;
+        std::size_t inputEnd = 0;
+        std::vector<char> output;
+        std::size_t outputOffset = 0;
+        bool dirty = false;
+        std::vector<SentMessage> sent;
+        std::vector<char> sentBytes;
+    };
+
+    /**
+     * Awaited by RunSession: suspends until the transport delivers the next
+     * message (true, the message is in `message`) or the deadline passes (false)
+     */
+    struct NextMessage {
+        Session& session;
+        std::uint64_t deadline;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<>) const noexcept {
+            session.deadline = deadline;
+            session.delivered = false;
+        }
+        bool await_resume() const noexcept { return session.delivered; }
+    };
+
+    /**
+     * What the acceptor remembers about a live order to fill in
+     * ExecutionReports; identifiers are stored inline, not as strings
+     */
+    struct FixOrder {
+        SessionId session = 0;
+        Side side = Side::Buy;
+        Price price = 0;
+        Quantity orderQty = 0;
+        Quantity cumQty = 0;
+        std::int64_t notional = 0;  // Sum of fill price * quantity, in ticks
+        OrderId alias = 0;          // Hashed key of the current ClOrdID after a replace
+        char finalStatus = 0;       // OrdStatus(39) of a finished order reported from the engine's history
+        char clOrdId[MaxIdLength] = {};
+        char symbol[MaxIdLength] = {};
+
+        std::string_view ClOrdId() const { return clOrdId; }
+        std::string_view Symbol() const { return symbol; }
+    };
+
+    static void CopyId(char (&out)[MaxIdLength], std::string_view value) {
+        std::memset(out, 0, MaxIdLength);
+        std::memcpy(out, value.data(), std::min(value.size(), MaxIdLength - 1));
+    }
+
+    /**
+     * @returns an identifier from a peer's message fit to send back, "NONE"
+     * if it is longer than any identifier the acceptor accepts
+     */
+    static std::string_view EchoId(std::string_view value) {
+        return value.size() < MaxIdLength ? value : std::string_view("NONE");
+    }
+
+    int CreateListenSocket() {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw std::runtime_error("FixAcceptor: socket() failed: " + std::string(std::strerror(errno)));
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config.port);
+        if (inet_pton(AF_INET, config.bindAddress.c_str(), &addr.sin_addr) != 1) {
+            close(fd);
+            throw std::runtime_error("FixAcceptor: invalid bind address " + config.bindAddress);
+        }
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+            std::string error = std::strerror(errno);
+            close(fd);
+            throw std::runtime_error("FixAcceptor: cannot listen on " + config.bindAddress + ":" +
+                                     std::to_string(config.port) + ": " + error);
+        }
+        return fd;
+    }
+
+    void Watch(int fd, std::uint32_t events, std::uint64_t token) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = token;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            throw std::runtime_error("FixAcceptor: epoll_ctl failed: " + std::string(std::strerror(errno)));
+        }
+    }
+
+    // ---------------------------------------------------------------------
+    // Transport
+    // ---------------------------------------------------------------------
+
+    void AcceptSessions() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            SessionId id = nextSessionId++;
+            Session& session = sessions[id];
+            session.fd = fd;
+            session.input.resize(config.sessionBufferSize);
+            session.lastReceived = session.lastSent = NowNanos();
+            Watch(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, id);
+            ++stats.sessionsAccepted;
+            session.task = RunSession(id);
+            session.task.Resume();  // Runs up to the wait for Logon
+        }
+    }
+
+    void HandleSessionEvent(SessionId id, std::uint32_t mask) {
+        auto it = sessions.find(id);
+        if (it == sessions.end()) return;
+        if (mask & EPOLLOUT) {
+            if (!FlushSession(it->second)) return CloseSession(id);
+            if (it->second.state == SessionState::Closing && it->second.output.empty()) return CloseSession(id);
+        }
+        if (mask & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            if (!ReadSession(id)) return CloseSession(id);
+        }
+    }
+
+    /**
+     * Reads until EAGAIN, handling every complete message
+     * @returns false if the session must be closed
+     */
+    bool ReadSession(SessionId id) {
+        while (true) {
+            Session& session = sessions.at(id);
+            if (session.inputEnd == session.input.size()) return false;  // Message larger than the buffer
+
+            ssize_t n = recv(session.fd, session.input.data() + session.inputEnd,
+                             session.input.size() - session.inputEnd, 0);
+            if (n == 0) return false;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            session.inputEnd += static_cast<std::size_t>(n);
+            session.lastReceived = NowNanos();
+            if (!ParseMessages(id)) return false;
+            if (session.state == SessionState::Closing) return !session.output.empty();  // Flush the Logout first
+        }
+    }
+
+    /**
+     * Resumes the session's task once per complete message. The task never
+     * closes its own session; the session is closed once the task is done.
+     * @returns false on a framing error
+     */
+    bool ParseMessages(SessionId id) {
+        Session& session = sessions.at(id);
+        std::size_t begin = 0;
+        while (session.state != SessionState::Closing) {
+            std::size_t consumed = 0;
+            FixParseStatus status = ParseFixMessage(session.input.data() + begin, session.inputEnd - begin,
+                                                    message, consumed);
+            if (status == FixParseStatus::Incomplete) break;
+            if (status == FixParseStatus::Malformed) return false;
+            ++stats.messagesIn;
+            session.delivered = true;
+            session.task.Resume();
+            if (session.task.Done()) session.state = SessionState::Closing;
+            begin += consumed;
+        }
+
+        std::memmove(session.input.data(), session.input.data() + begin, session.inputEnd - begin);
+        session.inputEnd -= begin;
+        return true;
+    }
+
+    void Send(SessionId id, Session& session) {
+        std::string_view bytes = writer.Finish();
+        if (bytes.empty()) {
+            // A field did not fit: the peer would see a sequence gap, so end the session
+            SendLogout(id, session, "Outgoing message too long");
+            return;
+        }
+        session.output.insert(session.output.end(), bytes.begin(), bytes.end());
+        session.lastSent = NowNanos();
+        ++stats.messagesOut;
+        if (!session.dirty) {
+            session.dirty = true;
+            dirtySessions.push_back(id);
+        }
+    }
+
+    void FlushDirtySessions() {
+        for (SessionId id : dirtySessions) {
+            auto it = sessions.find(id);
+            if (it == sessions.end()) continue;
+            it->second.dirty = false;
+            if (!FlushSession(it->second) ||
+                (it->second.state == SessionState::Closing && it->second.output.empty())) {
+                CloseSession(id);
+            }
+        }
+        dirtySessions.clear();
+    }
+
+    /**
+     * @returns false if the socket failed; EAGAIN leaves data queued until EPOLLOUT
+     */
+    bool FlushSession(Session& session) {
+        while (session.outputOffset < session.output.size()) {
+            ssize_t n = send(session.fd, session.output.data() + session.outputOffset,
+                             session.output.size() - session.outputOffset, MSG_NOSIGNAL);
+            if (n > 0) {
+                session.outputOffset += static_cast<std::size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        session.output.clear();
+        session.outputOffset = 0;
+        return true;
+    }
+
+    void CloseSession(SessionId id) {
+        auto it = sessions.find(id);
+        if (it == sessions.end()) return;
+        if (it->second.state != SessionState::AwaitingLogon) logons.erase(it->second.targetCompId);
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        close(it->second.fd);
+        sessions.erase(it);
+        ++stats.sessionsClosed;
+        if (config.cancelOnDisconnect) CancelSessionOrders(id);
+    }
+
+    /**
+     * Cancels everything the closed session still has resting. The owner is
+     * gone, so no ExecutionReports are sent; the orders are just forgotten.
+     */
+    void CancelSessionOrders(SessionId id) {
+        MassCancelFilter filter;
+        filter.owner = id;
+        stats.ordersCancelledOnDisconnect += engine.MassCancel(filter, 0, [this](const Event& event) {
+            auto it = orders.find(event.orderId);
+            if (it != orders.end()) Erase(it);
+        });
+    }
+
+    // ---------------------------------------------------------------------
+    // Session layer
+    // ---------------------------------------------------------------------
+
+    void Begin(Session& session, std::string_view msgType) {
+        sendingTime = clock.Now();
+        writer.Begin(msgType, config.senderCompId, session.targetCompId, session.nextSeqNum++, sendingTime);
+    }
+
+    /**
+     * Sends an application message and keeps it for ResendRequests
+     */
+    void SendApplication(SessionId id, Session& session, char msgType) {
+        if (writer.Overflowed()) return Send(id, session);  // Not kept: Send ends the session
+        const std::string_view fields = writer.Fields();
+        if (session.sent.size() >= config.resendStoreSize) {
+            // Forget the older half at once so trimming stays amortized O(1)
+            const std::size_t drop = std::max<std::size_t>(session.sent.size() / 2, 1);
+            const std::size_t bytes = drop < session.sent.size() ? session.sent[drop].offset : session.sentBytes.size();
+            session.sent.erase(session.sent.begin(), session.sent.begin() + static_cast<std::ptrdiff_t>(drop));
+            session.sentBytes.erase(session.sentBytes.begin(), session.sentBytes.begin() + static_cast<std::ptrdiff_t>(bytes));
+            for (SentMessage& stored : session.sent) stored.offset -= bytes;
+        }
+        if (config.resendStoreSize > 0) {
+            session.sent.push_back(SentMessage{session.nextSeqNum - 1, session.sentBytes.size(),
+                                               sendingTime.size() + fields.size(), msgType});
+            session.sentBytes.insert(session.sentBytes.end(), sendingTime.begin(), sendingTime.end());
+            session.sentBytes.insert(session.sentBytes.end(), fields.begin(), fields.end());
+        }
+        Send(id, session);
+    }
+
+    void SendLogout(SessionId id, Session& session, std::string_view text) {
+        Begin(session, "5");
+        if (!text.empty()) writer.Add(58, text);
+        Send(id, session);
+        session.state = SessionState::Closing;
+    }
+
+    void SendSessionReject(SessionId id, Session& session, std::uint64_t refSeqNum, int reason, std::string_view text) {
+        Begin(session, "3");
+        writer.Add(45, refSeqNum);
+        writer.Add(373, reason);
+        writer.Add(58, text);
+        Send(id, session);
+        ++stats.sessionRejects;
+    }
+
+    /**
+     * The whole life of one session, from Logon to Logout
+     */
+    Task RunSession(SessionId id) {
+        Session& session = sessions.at(id);
+        if (!co_await NextMessage{session, NowNanos() + LogonTimeoutNanos} || !HandleLogon(id, session)) {
+            co_return;  // Not a session we accept; dropped without a reply
+        }
+
+        std::uint64_t testRequestDeadline = 0;  // Non-zero while a TestRequest is outstanding
+        while (true) {
+            const std::uint64_t heartbeatDue = session.lastSent + session.heartbeatNanos;
+            const std::uint64_t silenceLimit =
+                testRequestDeadline ? testRequestDeadline
+                                    : session.lastReceived + session.heartbeatNanos + session.heartbeatNanos / 5;
+
+            if (co_await NextMessage{session, std::min(heartbeatDue, silenceLimit)}) {
+                testRequestDeadline = 0;
+                if (!HandleMessage(id, session)) co_return;
+                continue;
+            }
+
+            const std::uint64_t now = NowNanos();
+            if (now >= silenceLimit) {
+                if (testRequestDeadline) {
+                    SendLogout(id, session, "Heartbeat timeout");
+                    co_return;
+                }
+                Begin(session, "1");
+                writer.Add(112, ++nextTestRequestId);
+                Send(id, session);
+                testRequestDeadline = now + session.heartbeatNanos;
+            } else if (now >= heartbeatDue) {
+                Begin(session, "0");
+                Send(id, session);
+            }
+        }
+    }
+
+    /**
+     * @returns false if the first message is not an acceptable Logon
+     */
+    bool HandleLogon(SessionId id, Session& session) {
+        const std::string_view sender = message.Get(49);
+        std::uint64_t seqNum = 0;
+        std::uint32_t heartbeatSeconds = 0;
+        if (message.GetType() != "A" || !message.GetInteger(34, seqNum) || sender.empty() ||
+            sender.size() >= MaxIdLength || message.Get(56) != config.senderCompId ||
+            !message.GetInteger(108, heartbeatSeconds) || heartbeatSeconds == 0) {
+            return false;
+        }
+        session.targetCompId = sender;
+        if (!logons.emplace(session.targetCompId, id).second) {
+            session.targetCompId.clear();
+            return false;  // Already logged on elsewhere
+        }
+        session.state = SessionState::Active;
+        session.heartbeatNanos = heartbeatSeconds * 1'000'000'000ULL;
+        session.expectedSeqNum = seqNum + 1;
+
+        Begin(session, "A");
+        writer.Add(98, 0);
+        writer.Add(108, heartbeatSeconds);
+        Send(id, session);
+        return true;
+    }
+
+    /**
+     * Handles one message of a logged-on session
+     * @returns false once the session is over (a Logout has been sent)
+     */
+    bool HandleMessage(SessionId id, Session& session) {
+        const std::string_view type = message.GetType();
+        std::uint64_t seqNum = 0;
+        if (type.empty() || !message.GetInteger(34, seqNum)) {
+            SendLogout(id, session, "Missing MsgType(35) or MsgSeqNum(34)");
+            return false;
+        }
+        if (message.Get(49) != session.targetCompId || message.Get(56) != config.senderCompId) {
+            SendLogout(id, session, "CompID mismatch");
+            return false;
+        }
+        if (type == "4") {  // SequenceReset: applies regardless of MsgSeqNum
+            std::uint64_t newSeqNum = 0;
+            if (message.GetInteger(36, newSeqNum) && newSeqNum >= session.expectedSeqNum) {
+                session.expectedSeqNum = newSeqNum;
+            }
+            return true;
+        }
+        if (seqNum < session.expectedSeqNum) {
+            if (message.Get(43) == "Y") return true;  // Possible duplicate we already processed
+            SendLogout(id, session, "MsgSeqNum too low");
+            return false;
+        }
+        if (type == "2") AnswerResendRequest(id, session);  // Honored even while our own inbound has a gap
+        if (seqNum > session.expectedSeqNum) {
+            if (type == "5") {
+                SendLogout(id, session, "");
+                return false;
+            }
+            // Ask once for everything from the gap onwards and drop messages
+            // until the peer has resent the range in order
+            if (session.gapEnd < session.expectedSeqNum) {
+                Begin(session, "2");
+                writer.Add(7, session.expectedSeqNum);
+                writer.Add(16, 0);
+                Send(id, session);
+                ++stats.resendRequestsSent;
+            }
+            session.gapEnd = std::max(session.gapEnd, seqNum);
+            return true;
+        }
+        session.expectedSeqNum = seqNum + 1;
+
+        if (type == "0" || type == "2") return true;
+        if (type == "1") {
+            if (message.Get(112).size() >= MaxIdLength) {
+                SendSessionReject(id, session, seqNum, 5, "TestReqID(112) is limited to 31 characters");
+                return true;
+            }
+            Begin(session, "0");
+            writer.Add(112, message.Get(112));
+            Send(id, session);
+            return true;
+        }
+        if (type == "5") {
+            SendLogout(id, session, "");
+            return false;
+        }
+        if (type == "D" || type == "F" || type == "G") {
+            HandleOrderMessage(id, session, type);
+            return true;
+        }
+        if (type == "H") {
+            HandleStatusRequest(id);
+            return true;
+        }
+        SendSessionReject(id, session, seqNum, 11, "Unsupported MsgType(35)");
+        return true;
+    }
+
+    /**
+     * Resends stored application messages in [BeginSeqNo(7), EndSeqNo(16)]
+     * and gap-fills everything else in the range
+     */
+    void AnswerResendRequest(SessionId id, Session& session) {
+        std::uint64_t beginSeqNum = 0;
+        std::uint64_t endSeqNum = 0;
+        message.GetInteger(7, beginSeqNum);
+        message.GetInteger(16, endSeqNum);
+        const std::uint64_t lastSent = session.nextSeqNum - 1;
+        if (endSeqNum == 0 || endSeqNum > lastSent) endSeqNum = lastSent;
+        beginSeqNum = std::max<std::uint64_t>(beginSeqNum, 1);
+
+        std::uint64_t gapStart = beginSeqNum;
+        auto it = std::lower_bound(session.sent.begin(), session.sent.end(), beginSeqNum,
+                                   [](const SentMessage& stored, std::uint64_t seqNum) { return stored.seqNum < seqNum; });
+        for (; it != session.sent.end() && it->seqNum <= endSeqNum; ++it) {
+            if (it->seqNum > gapStart) SendGapFill(id, session, gapStart, it->seqNum);
+
+            const std::string_view stored(session.sentBytes.data() + it->offset, it->length);
+            const std::string_view originalTime = stored.substr(0, FixClock::Length);
+            sendingTime = clock.Now();
+            writer.Begin(std::string_view(&it->msgType, 1), config.senderCompId, session.targetCompId, it->seqNum,
+                         sendingTime);
+            writer.Add(43, 'Y');
+            writer.Add(122, originalTime);
+            writer.AddFields(stored.substr(originalTime.size()));
+            Send(id, session);
+            ++stats.messagesResent;
+            gapStart = it->seqNum + 1;
+        }
+        if (gapStart <= endSeqNum) SendGapFill(id, session, gapStart, endSeqNum + 1);
+    }
+
+    void SendGapFill(SessionId id, Session& session, std::uint64_t seqNum, std::uint64_t newSeqNum) {
+        writer.Begin("4", config.senderCompId, session.targetCompId, seqNum, clock.Now());
+        writer.Add(43, 'Y');
+        writer.Add(123, 'Y');
+        writer.Add(36, newSeqNum);
+        Send(id, session);
+    }
+
+    /**
+     * Resumes every session whose deadline has passed. Runs at most once per
+     * TimerIntervalMs; session deadlines are seconds apart.
+     */
+    void CheckTimers() {
+        const std::uint64_t now = NowNanos();
+        if (now < nextTimerCheck) return;
+        nextTimerCheck = now + TimerIntervalMs * 1'000'000ULL;
+
+        std::vector<SessionId> finished;
+        for (auto& [id, session] : sessions) {
+            if (session.state == SessionState::Closing || now < session.deadline) continue;
+            session.task.Resume();  // Not delivered: a timeout
+            if (session.task.Done()) {
+                session.state = SessionState::Closing;
+                if (session.output.empty()) finished.push_back(id);  // Otherwise closed once flushed
+            }
+        }
+        for (SessionId id : finished) CloseSession(id);
+    }
+
+    // ---------------------------------------------------------------------
+    // Application layer
+    // ---------------------------------------------------------------------
+
+    OrderId Resolve(OrderId key) const {
+        auto it = aliases.find(key);
+        return it == aliases.end() ? key : it->second;
+    }
+
+    void HandleOrderMessage(SessionId id, Session& session, std::string_view type) {
+        Command command{};
+        const char* error = FixToCommand(message, session.targetCompId, config.priceScale, command);
+        command.session = id;
+
+        // A FixOrder describing the request, used for reports when it is refused
+        FixOrder request;
+        request.session = id;
+        request.side = command.side;
+        request.price = command.price;
+        request.orderQty = command.quantity;
+        CopyId(request.clOrdId, message.Get(11));
+        CopyId(request.symbol, message.Get(55));
+        if (!error && (message.Get(11).size() >= MaxIdLength || message.Get(55).size() >= MaxIdLength)) {
+            error = "ClOrdID(11) and Symbol(55) are limited to 31 characters";
+        }
+
+        if (type == "D") {
+            if (!error && (orders.count(command.orderId) || aliases.count(command.orderId))) {
+                error = "Duplicate ClOrdID(11)";
+            }
+            if (error) return SendExecutionReport(command.orderId, request, '8', {}, 0, 0, error);
+            orders.emplace(command.orderId, request);
+            return Match(command, {});
+        }
+
+        const OrderId newKey = MakeFixOrderId(session.targetCompId, message.Get(11));
+        if (!error) command.orderId = Resolve(command.orderId);
+        auto it = error ? orders.end() : orders.find(command.orderId);
+        if (!error && it == orders.end()) error = "Unknown order";
+        if (!error && type == "G") {
+            if (orders.count(newKey) || aliases.count(newKey)) {
+                error = "Duplicate ClOrdID(11)";
+            } else if (command.quantity <= it->second.cumQty) {
+                error = "OrderQty(38) must exceed CumQty";
+            }
+        }
+        if (error) {
+            return SendCancelReject(id, session, it == orders.end() ? nullptr : &it->second,
+                                    command.orderId, type == "F" ? 1 : 2, error);
+        }
+        if (type == "G") command.quantity -= it->second.cumQty;  // Engine works in remaining quantity
+        Match(command, newKey);
+    }
+
+    /**
+     * Answers an OrderStatusRequest: live orders from what the acceptor
+     * tracks, finished ones from the engine's order status history
+     */
+    void HandleStatusRequest(SessionId id) {
+        const std::string_view clOrdId = message.Get(11);
+        const OrderId key = Resolve(MakeFixOrderId(sessions.at(id).targetCompId, clOrdId));
+        if (auto it = orders.find(key); it != orders.end()) {
+            return SendExecutionReport(key, it->second, 'I', {}, 0, 0, {});
+        }
+
+        FixOrder report;
+        report.session = id;
+        CopyId(report.clOrdId, clOrdId);
+        CopyId(report.symbol, message.Get(55));
+        const std::optional<OrderStatus> status = clOrdId.empty() ? std::nullopt : engine.GetOrderStatus(key);
+        if (!status) {
+            report.finalStatus = '8';
+            return SendExecutionReport(key, report, 'I', {}, 0, 0, "Unknown order");
+        }
+        report.side = status->side;
+        report.price = status->price;
+        report.orderQty = status->quantity;
+        report.cumQty = status->filled;
+        report.notional = status->notional;
+        report.finalStatus = status->state == OrderState::Filled      ? '2'
+                             : status->state == OrderState::Cancelled ? '4'
+                                                                      : '8';
+        SendExecutionReport(key, report, 'I', {}, 0, 0, {});
+    }
+
+    /**
+     * Runs a command through the engine and reports every outcome
+     */
+    void Match(const Command& command, OrderId newKey) {
+        events.clear();
+        engine.Process(command, [this](const Event& event) { events.push_back(event); });
+
+        for (const Event& event : events) {
+            auto it = orders.find(event.orderId);
+            if (it == orders.end()) continue;
+            FixOrder& order = it->second;
+
+            switch (event.type) {
+            case MessageType::Ack:
+                if (command.type == CommandType::Add) {
+                    SendExecutionReport(event.orderId, order, '0', {}, 0, 0, {});
+                } else {
+                    char original[MaxIdLength];
+                    std::memcpy(original, order.clOrdId, MaxIdLength);
+                    if (order.alias) aliases.erase(order.alias);
+                    aliases.emplace(newKey, event.orderId);
+                    order.alias = newKey;
+                    order.side = command.side;
+                    order.price = command.price;
+                    order.orderQty = order.cumQty + command.quantity;
+                    CopyId(order.clOrdId, message.Get(11));
+                    SendExecutionReport(event.orderId, order, '5', original, 0, 0, {});
+                }
+                break;
+            case MessageType::CancelAck: {
+                char original[MaxIdLength];
+                std::memcpy(original, order.clOrdId, MaxIdLength);
+                CopyId(order.clOrdId, message.Get(11));
+                SendExecutionReport(event.orderId, order, '4', original, 0, 0, {});
+                Erase(it);
+                break;
+            }
+            case MessageType::Fill:
+                order.cumQty += event.quantity;
+                order.notional += static_cast<std::int64_t>(event.price) * event.quantity;
+                SendExecutionReport(event.orderId, order, 'F', {}, event.quantity, event.price, {});
+                if (order.cumQty >= order.orderQty) Erase(it);
+                break;
+            case MessageType::Expired:
+                SendExecutionReport(event.orderId, order, '4', {}, 0, 0, "Unfilled IOC quantity canceled");
+                Erase(it);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    void Erase(std::unordered_map<OrderId, FixOrder>::iterator it) {
+        if (it->second.alias) aliases.erase(it->second.alias);
+        orders.erase(it);
+    }
+
+    static char OrdStatus(const FixOrder& order, char execType) {
+        if (order.finalStatus) return order.finalStatus;
+        if (execType == '4' || execType == '8') return execType;
+        if (order.cumQty == 0) return '0';
+        return order.cumQty < order.orderQty ? '1' : '2';
+    }
+
+    void SendExecutionReport(OrderId orderId, const FixOrder& order, char execType, std::string_view origClOrdId,
+                             Quantity lastQty, Price lastPx, std::string_view text) {
+        auto it = sessions.find(order.session);
+        if (it == sessions.end() || it->second.state != SessionState::Active) return;  // Owner disconnected
+        Session& session = it->second;
+        const bool terminal = execType == '4' || execType == '8' || order.finalStatus;
+
+        Begin(session, "8");
+        writer.Add(37, orderId);
+        writer.Add(11, order.ClOrdId());
+        if (!origClOrdId.empty()) writer.Add(41, origClOrdId);
+        writer.Add(17, ++nextExecId);
+        writer.Add(150, execType);
+        writer.Add(39, OrdStatus(order, execType));
+        if (!order.Symbol().empty()) writer.Add(55, order.Symbol());
+        writer.Add(54, order.side == Side::Buy ? '1' : '2');
+        writer.Add(38, order.orderQty);
+        writer.AddPrice(44, order.price, config.priceScale);
+        if (execType == 'F') {
+            writer.Add(32, lastQty);
+            writer.AddPrice(31, lastPx, config.priceScale);
+        }
+        writer.Add(151, terminal ? 0 : order.orderQty - order.cumQty);
+        writer.Add(14, order.cumQty);
+        // Two extra decimals so the average of several fill prices is not truncated to a tick
+        writer.AddPrice(6, order.cumQty ? order.notional * 100 / order.cumQty : 0, config.priceScale * 100);
+        if (!text.empty()) writer.Add(58, text);
+        SendApplication(order.session, session, '8');
+        ++stats.executionReports;
+    }
+
+    void SendCancelReject(SessionId id, Session& session, const FixOrder* order, OrderId orderId,
+                          int responseTo, std::string_view text) {
+        Begin(session, "9");
+        if (order) {
+            writer.Add(37, orderId);
+        } else {
+            writer.Add(37, std::string_view("NONE"));
+        }
+        writer.Add(11, EchoId(message.Get(11)));
+        writer.Add(41, EchoId(message.Get(41)));
+        writer.Add(39, order ? OrdStatus(*order, '0') : '8');
+        writer.Add(434, responseTo);
+        if (!order) writer.Add(102, 1);  // Unknown order
+        writer.Add(58, text);
+        SendApplication(id, session, '9');
+    }
+
+    FixAcceptorConfig config;
+    int listenFd = -1;
+    int wakeFd = -1;
+    int epollFd = -1;
+    std::atomic<bool> running{false};
+
+    MatchingEngine engine;
+    std::vector<Event> events;  // Reused per command
+    FixMessage message;         // The message being handled; views into a session's input buffer
+    FixWriter writer;
+    FixClock clock;
+    std::string_view sendingTime;  // Of the message being written; valid until the next clock.Now()
+    std::uint64_t nextExecId = 0;
+    std::uint64_t nextTestRequestId = 0;
+    std::uint64_t nextTimerCheck = 0;
+
+    std::unordered_map<SessionId, Session> sessions;
+    std::unordered_map<std::string, SessionId> logons;  // SenderCompID -> logged-on session
+    std::unordered_map<OrderId, FixOrder> orders;
+    std::unordered_map<OrderId, OrderId> aliases;  // Hashed replacement ClOrdID -> engine OrderId
+    std::vector<SessionId> dirtySessions;
+    SessionId nextSessionId = FirstSessionId;
+    FixAcceptorStats stats;
+};
+
+#endif  // __linux__
@@ -0,0 +1,511 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "order_book.h"
+#include "protocol.h"
+
+/**
+ * FIX 4.4 Tag=Value Codec
+ *
+ * Parsing never allocates: a message is framed in place, its fields are
+ * recorded as (tag, pointer, length) views into the receive buffer, and
+ * numeric values are converted with std::from_chars.
+ *
+ * Field splitting is SIMD-accelerated. The whole message is first turned
+ * into a bitmap of SOH positions (16 bytes per compare with SSE2/NEON),
+ * then each set bit ends one field; the short tag before '=' is parsed
+ * with scalar code while it is scanned.
+ */
+
+constexpr char Soh = '\x01';
+
+/**
+ * FixField is a view of one tag=value pair inside a message buffer
+ */
+struct FixField {
+    std::uint32_t tag;
+    std::uint32_t length;
+    const char* value;
+
+    std::string_view View() const { return std::string_view(value, length); }
+};
+
+/**
+ * FixMessage is a parsed message: a fixed-capacity array of field views.
+ * It does not own the bytes it points into.
+ */
+class FixMessage {
+public:
+    static constexpr std::size_t MaxFields = 128;
+
+    void Clear() { count = 0; }
+
+    bool Add(std::uint32_t tag, const char* value, std::uint32_t length) {
+        if (count == MaxFields) return false;
+        fields[count++] = FixField{tag, length, value};
+        return true;
+    }
+
+    /**
+     * @returns the first field with this tag, or nullptr
+     */
+    const FixField* Find(std::uint32_t tag) const {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (fields[i].tag == tag) return &fields[i];
+        }
+        return nullptr;
+    }
+
+    std::string_view Get(std::uint32_t tag) const {
+        const FixField* field = Find(tag);
+        return field ? field->View() : std::string_view();
+    }
+
+    template <typename Integer>
+    bool GetInteger(std::uint32_t tag, Integer& out) const {
+        const FixField* field = Find(tag);
+        if (!field) return false;
+        auto [end, ec] = std::from_chars(field->value, field->value + field->length, out);
+        return ec == std::errc() && end == field->value + field->length;
+    }
+
+    /**
+     * @returns the MsgType (35) value, e.g. "D"
+     */
+    std::string_view GetType() const { return Get(35); }
+
+    std::size_t Size() const { return count; }
+    const FixField& operator[](std::size_t i) const { return fields[i]; }
+
+private:
+    FixField fields[MaxFields];
+    std::size_t count = 0;
+};
+
+/**
+ * Fills `bits` with one bit per byte of [data, data + length), set where
+ * the byte equals SOH. bits must hold (length + 63) / 64 words.
+ */
+template <bool UseSimd = true>
+inline void BuildSohBitmap(const char* data, std::size_t length, std::uint64_t* bits) {
+    std::size_t i = 0;
+    if constexpr (UseSimd) {
+#if defined(__SSE2__)
+        const __m128i soh = _mm_set1_epi8(Soh);
+        for (; i + 64 <= length; i += 64) {
+            std::uint64_t word = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16 * lane));
+                auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, soh)));
+                word |= static_cast<std::uint64_t>(mask) << (16 * lane);
+            }
+            bits[i / 64] = word;
+        }
+#elif defined(__aarch64__)
+        static const std::uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+        const uint8x16_t weight = vld1q_u8(weights);
+        const uint8x16_t soh = vdupq_n_u8(static_cast<std::uint8_t>(Soh));
+        for (; i + 64 <= length; i += 64) {
+            std::uint64_t word = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                uint8x16_t chunk = vld1q_u8(reinterpret_cast<const std::uint8_t*>(data + i + 16 * lane));
+                uint8x16_t hits = vandq_u8(vceqq_u8(chunk, soh), weight);
+                std::uint64_t mask = vaddv_u8(vget_low_u8(hits)) |
+                                     (static_cast<std::uint64_t>(vaddv_u8(vget_high_u8(hits))) << 8);
+                word |= mask << (16 * lane);
+            }
+            bits[i / 64] = word;
+        }
+#endif
+    }
+    // Scalar tail (or the whole message when SIMD is off/unavailable)
+    for (; i < length; i += 64) {
+        std::uint64_t word = 0;
+        const std::size_t limit = std::min<std::size_t>(64, length - i);
+        for (std::size_t b = 0; b < limit; ++b) {
+            word |= static_cast<std::uint64_t>(data[i + b] == Soh) << b;
+        }
+        bits[i / 64] = word;
+    }
+}
+
+/**
+ * @returns the FIX checksum (byte sum mod 256) of [data, data + length)
+ */
+inline std::uint32_t FixChecksum(const char* data, std::size_t length) {
+    std::uint32_t sum = 0;
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(chunk, zero));
+    }
+    sum = static_cast<std::uint32_t>(_mm_cvtsi128_si64(acc) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)));
+#endif
+    for (; i < length; ++i) sum += static_cast<unsigned char>(data[i]);
+    return sum & 0xff;
+}
+
+enum class FixParseStatus {
+    Ok,
+    Incomplete,  // Need more bytes
+    Malformed    // Framing is broken; the stream cannot be resynchronized
+};
+
+/**
+ * Frames and splits one message at the start of [data, data + length).
+ * On Ok, `consumed` is the size of the message and `message` holds views
+ * into data (valid as long as those bytes are).
+ */
+template <bool UseSimd = true>
+inline FixParseStatus ParseFixMessage(const char* data, std::size_t length, FixMessage& message,
+                                      std::size_t& consumed, bool verifyChecksum = true) {
+    // Header: "8=FIX.4.4<SOH>9=<len><SOH>"
+    constexpr std::string_view BeginString = "8=FIX.4.4\x01" "9=";
+    if (length < BeginString.size()) return FixParseStatus::Incomplete;
+    if (std::memcmp(data, BeginString.data(), BeginString.size()) != 0) return FixParseStatus::Malformed;
+
+    const char* lengthStart = data + BeginString.size();
+    const char* lengthEnd = static_cast<const char*>(std::memchr(lengthStart, Soh, length - BeginString.size()));
+    if (!lengthEnd) return length - BeginString.size() > 8 ? FixParseStatus::Malformed : FixParseStatus::Incomplete;
+    std::size_t bodyLength = 0;
+    auto [end, ec] = std::from_chars(lengthStart, lengthEnd, bodyLength);
+    if (ec != std::errc() || end != lengthEnd || bodyLength > 1 << 16) return FixParseStatus::Malformed;
+
+    // Body, then "10=NNN<SOH>"
+    const std::size_t bodyStart = static_cast<std::size_t>(lengthEnd + 1 - data);
+    const std::size_t trailerStart = bodyStart + bodyLength;
+    const std::size_t total = trailerStart + 7;
+    if (length < total) return FixParseStatus::Incomplete;
+    if (std::memcmp(data + trailerStart, "10=", 3) != 0 || data[total - 1] != Soh) return FixParseStatus::Malformed;
+
+    if (verifyChecksum) {
+        std::uint32_t declared = 0;
+        auto [checkEnd, checkEc] = std::from_chars(data + trailerStart + 3, data + total - 1, declared);
+        if (checkEc != std::errc() || checkEnd != data + total - 1 || FixChecksum(data, trailerStart) != declared) {
+            return FixParseStatus::Malformed;
+        }
+    }
+
+    // Split the body into fields using the SOH bitmap
+    constexpr std::size_t MaxWords = ((1 << 16) + 64) / 64;
+    std::uint64_t bits[MaxWords];
+    BuildSohBitmap<UseSimd>(data + bodyStart, bodyLength, bits);
+
+    message.Clear();
+    message.Add(9, lengthStart, static_cast<std::uint32_t>(lengthEnd - lengthStart));
+    std::size_t fieldStart = 0;
+    for (std::size_t word = 0; word * 64 < bodyLength; ++word) {
+        std::uint64_t mask = bits[word];
+        while (mask) {
+            const std::size_t fieldEnd = word * 64 + static_cast<std::size_t>(__builtin_ctzll(mask));
+            mask &= mask - 1;
+
+            const char* p = data + bodyStart + fieldStart;
+            const char* stop = data + bodyStart + fieldEnd;
+            std::uint32_t tag = 0;
+            while (p < stop && *p >= '0' && *p <= '9') tag = tag * 10 + static_cast<std::uint32_t>(*p++ - '0');
+            if (p == stop || *p != '=' || tag == 0) return FixParseStatus::Malformed;
+            ++p;
+            if (!message.Add(tag, p, static_cast<std::uint32_t>(stop - p))) return FixParseStatus::Malformed;
+            fieldStart = fieldEnd + 1;
+        }
+    }
+    if (fieldStart != bodyLength) return FixParseStatus::Malformed;  // Body must end with SOH
+
+    consumed = total;
+    return FixParseStatus::Ok;
+}
+
+/**
+ * Parses a FIX decimal price into integer ticks, where `scale` is the
+ * number of ticks per unit (1 for integer prices, 100 for cents, ...)
+ * @returns false if the value is malformed, out of range or finer than a tick
+ */
+inline bool ParseFixPrice(std::string_view text, std::int64_t scale, Price& out) {
+    bool negative = !text.empty() && text.front() == '-';
+    if (negative) text.remove_prefix(1);
+    const std::size_t dot = text.find('.');
+    std::int64_t whole = 0;
+    std::string_view wholeText = text.substr(0, dot);
+    if (wholeText.empty()) return false;
+    auto [end, ec] = std::from_chars(wholeText.data(), wholeText.data() + wholeText.size(), whole);
+    if (ec != std::errc() || end != wholeText.data() + wholeText.size() || whole < 0) return false;
+    // Keeps whole * scale plus any fraction (less than scale) inside int64; such a
+    // price is far outside Price's range anyway
+    if (scale <= 0 || whole >= std::numeric_limits<std::int64_t>::max() / scale) return false;
+
+    std::int64_t ticks = whole * scale;
+    if (dot != std::string_view::npos) {
+        std::int64_t place = scale;
+        for (char c : text.substr(dot + 1)) {
+            if (c < '0' || c > '9') return false;
+            const std::int64_t digit = c - '0';
+            if (place % 10 != 0) {
+                if (digit != 0) return false;  // Finer than a tick
+                continue;
+            }
+            place /= 10;
+            ticks += digit * place;
+        }
+    }
+    if (negative) ticks = -ticks;
+    if (ticks > std::numeric_limits<Price>::max() || ticks < std::numeric_limits<Price>::min()) return false;
+    out = static_cast<Price>(ticks);
+    return true;
+}
+
+/**
+ * FixWriter builds one outgoing message in a caller-provided buffer.
+ * BodyLength and CheckSum are filled in by Finish. A field that would run
+ * past Capacity is not written and fails the whole message (Finish then
+ * returns nothing), so a value copied from a peer can never overrun it.
+ */
+class FixWriter {
+public:
+    static constexpr std::size_t Capacity = 1024;
+
+    /**
+     * Starts a message; the standard header up to MsgSeqNum is written here
+     */
+    void Begin(std::string_view msgType, std::string_view senderCompId, std::string_view targetCompId,
+               std::uint64_t seqNum, std::string_view sendingTime) {
+        // Leave room for "8=FIX.4.4|9=NNNNN|" in front of the body
+        position = HeaderReserve;
+        overflowed = false;
+        Add(35, msgType);
+        Add(49, senderCompId);
+        Add(56, targetCompId);
+        Add(34, seqNum);
+        Add(52, sendingTime);
+        fieldsStart = position;
+    }
+
+    void Add(std::uint32_t tag, std::string_view value) {
+        if (!Reserve(MaxTagLength + value.size() + 1)) return;
+        WriteTag(tag);
+        std::memcpy(buffer + position, value.data(), value.size());
+        position += value.size();
+        buffer[position++] = Soh;
+    }
+
+    template <typename Integer, typename = std::enable_if_t<std::is_integral_v<Integer>>>
+    void Add(std::uint32_t tag, Integer value) {
+        if (!Reserve(MaxTagLength + MaxNumberLength + 1)) return;
+        WriteTag(tag);
+        auto [end, ec] = std::to_chars(buffer + position, buffer + Capacity, value);
+        position = static_cast<std::size_t>(end - buffer);
+        buffer[position++] = Soh;
+    }
+
+    void Add(std::uint32_t tag, char value) {
+        if (!Reserve(MaxTagLength + 2)) return;
+        WriteTag(tag);
+        buffer[position++] = value;
+        buffer[position++] = Soh;
+    }
+
+    /**
+     * Appends fields that are already encoded ("tag=value<SOH>..."), e.g. from Fields()
+     */
+    void AddFields(std::string_view fields) {
+        if (!Reserve(fields.size())) return;
+        std::memcpy(buffer + position, fields.data(), fields.size());
+        position += fields.size();
+    }
+
+    /**
+     * @returns the fields added after the standard header (valid until Finish)
+     */
+    std::string_view Fields() const { return std::string_view(buffer + fieldsStart, position - fieldsStart); }
+
+    /**
+     * Adds a price given in ticks, rendered as a decimal with `scale` ticks per unit
+     */
+    void AddPrice(std::uint32_t tag, std::int64_t ticks, std::int64_t scale) {
+        // Sign, whole part, point and as many decimals as scale has digits
+        if (!Reserve(MaxTagLength + 2 * MaxNumberLength + 3)) return;
+        WriteTag(tag);
+        if (ticks < 0) {
+            buffer[position++] = '-';
+            ticks = -ticks;
+        }
+        auto [end, ec] = std::to_chars(buffer + position, buffer + Capacity, ticks / scale);
+        position = static_cast<std::size_t>(end - buffer);
+        if (scale > 1) {
+            buffer[position++] = '.';
+            for (std::int64_t place = scale / 10, rest = ticks % scale; place > 0; place /= 10) {
+                buffer[position++] = static_cast<char>('0' + (rest / place) % 10);
+            }
+        }
+        buffer[position++] = Soh;
+    }
+
+    /**
+     * @returns true if a field did not fit since Begin; the message is then unusable
+     */
+    bool Overflowed() const { return overflowed; }
+
+    /**
+     * Completes header and trailer
+     * @returns view of the finished message (valid until the next Begin),
+     * empty if a field did not fit
+     */
+    std::string_view Finish() {
+        if (overflowed) return {};
+        const std::size_t bodyLength = position - HeaderReserve;
+        char prefix[HeaderReserve];
+        std::size_t prefixLength = 0;
+        constexpr std::string_view BeginString = "8=FIX.4.4\x01" "9=";
+        std::memcpy(prefix, BeginString.data(), BeginString.size());
+        prefixLength = BeginString.size();
+        auto [end, ec] = std::to_chars(prefix + prefixLength, prefix + HeaderReserve, bodyLength);
+        prefixLength = static_cast<std::size_t>(end - prefix);
+        prefix[prefixLength++] = Soh;
+
+        start = HeaderReserve - prefixLength;
+        std::memcpy(buffer + start, prefix, prefixLength);
+
+        const std::uint32_t checksum = FixChecksum(buffer + start, position - start);
+        std::memcpy(buffer + position, "10=", 3);
+        buffer[position + 3] = static_cast<char>('0' + checksum / 100);
+        buffer[position + 4] = static_cast<char>('0' + checksum / 10 % 10);
+        buffer[position + 5] = static_cast<char>('0' + checksum % 10);
+        buffer[position + 6] = Soh;
+        position += 7;
+        return std::string_view(buffer + start, position - start);
+    }
+
+private:
+    static constexpr std::size_t HeaderReserve = 20;
+    static constexpr std::size_t Slack = 16;
+    static constexpr std::size_t MaxTagLength = 11;     // Ten digits and '='
+    static constexpr std::size_t MaxNumberLength = 20;  // Any 64-bit integer
+
+    /**
+     * @returns true if size more bytes fit; otherwise marks the message failed
+     */
+    bool Reserve(std::size_t size) {
+        if (overflowed || size > Capacity - position) overflowed = true;
+        return !overflowed;
+    }
+
+    void WriteTag(std::uint32_t tag) {
+        auto [end, ec] = std::to_chars(buffer + position, buffer + Capacity, tag);
+        position = static_cast<std::size_t>(end - buffer);
+        buffer[position++] = '=';
+    }
+
+    char buffer[Capacity + Slack];  // Slack holds the CheckSum trailer after fields that ran to Capacity
+    std::size_t position = HeaderReserve;
+    bool overflowed = false;
+    std::size_t fieldsStart = HeaderReserve;
+    std::size_t start = 0;
+};
+
+/**
+ * Formats UTC time as a FIX UTCTimestamp ("YYYYMMDD-HH:MM:SS.sss"),
+ * re-rendering the date/time part only when the second changes
+ */
+class FixClock {
+public:
+    static constexpr std::size_t Length = 21;
+
+    std::string_view Now() {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        if (ts.tv_sec != cachedSecond) {
+            cachedSecond = ts.tv_sec;
+            std::tm utc;
+            gmtime_r(&ts.tv_sec, &utc);
+            std::strftime(text, sizeof(text), "%Y%m%d-%H:%M:%S", &utc);
+        }
+        const long millis = ts.tv_nsec / 1000000;
+        text[17] = '.';
+        text[18] = static_cast<char>('0' + millis / 100);
+        text[19] = static_cast<char>('0' + millis / 10 % 10);
+        text[20] = static_cast<char>('0' + millis % 10);
+        return std::string_view(text, Length);
+    }
+
+private:
+    time_t cachedSecond = -1;
+    char text[32] = {};
+};
+
+/**
+ * 64-bit FNV-1a, used to turn (SenderCompID, ClOrdID) into an engine OrderId
+ * without storing the strings
+ */
+inline std::uint64_t Fnv1a(std::string_view text, std::uint64_t hash = 14695981039346656037ULL) {
+    for (char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline OrderId MakeFixOrderId(std::string_view senderCompId, std::string_view clOrdId) {
+    return Fnv1a(clOrdId, Fnv1a("\x01", Fnv1a(senderCompId)));
+}
+
+/**
+ * Translates an application message (NewOrderSingle, OrderCancelRequest or
+ * OrderCancelReplaceRequest) into a Command. Replace requests carry the new
+ * total OrderQty; the caller converts it to remaining quantity.
+ * @returns nullptr on success, otherwise a reason suitable for tag 58 (Text)
+ */
+inline const char* FixToCommand(const FixMessage& message, std::string_view senderCompId,
+                                std::int64_t priceScale, Command& command) {
+    const std::string_view type = message.GetType();
+    const std::string_view clOrdId = message.Get(11);
+    if (clOrdId.empty()) return "Missing ClOrdID(11)";
+
+    const std::string_view side = message.Get(54);
+    if (side != "1" && side != "2") return "Side(54) must be 1 (Buy) or 2 (Sell)";
+    command.side = side == "1" ? Side::Buy : Side::Sell;
+    command.orderType = OrderType::GoodTilCancel;
+    command.price = 0;
+    command.quantity = 0;
+
+    if (type == "D") {
+        command.type = CommandType::Add;
+        command.orderId = MakeFixOrderId(senderCompId, clOrdId);
+        if (message.Get(40) != "2") return "Only limit orders (OrdType(40)=2) are supported";
+        const std::string_view timeInForce = message.Get(59);
+        if (timeInForce == "3") {
+            command.orderType = OrderType::FillAndKill;
+        } else if (!timeInForce.empty() && timeInForce != "0" && timeInForce != "1") {
+            return "TimeInForce(59) must be 0 (Day), 1 (GTC) or 3 (IOC)";
+        }
+    } else if (type == "F" || type == "G") {
+        const std::string_view original = message.Get(41);
+        if (original.empty()) return "Missing OrigClOrdID(41)";
+        command.type = type == "F" ? CommandType::Cancel : CommandType::Modify;
+        command.orderId = MakeFixOrderId(senderCompId, original);
+        if (type == "F") return nullptr;
+    } else {
+        return "Unsupported MsgType(35)";
+    }
+
+    if (!message.GetInteger(38, command.quantity) || command.quantity == 0) return "Invalid OrderQty(38)";
+    if (!ParseFixPrice(message.Get(44), priceScale, command.price)) return "Invalid Price(44)";
+    return nullptr;
+}
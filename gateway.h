@@ -0,0 +1,580 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "drop_copy.h"
+#include "journal.h"
+#include "market_data.h"
+#include "matching_engine.h"
+#include "protocol.h"
+#include "spsc_queue.h"
+
+/**
+ * TCP Gateway Architecture
+ *
+ * The gateway splits order entry across two threads:
+ * 1. I/O thread - owns every socket, driven by edge-triggered epoll.
+ *    It frames and decodes client messages into Commands and encodes
+ *    Events back onto the owning session's socket.
+ * 2. Matching thread - owns the MatchingEngine (and therefore the OrderBook).
+ *    It never touches a socket.
+ *
+ * The threads talk only through two SpscQueues (commands in, events out),
+ * so the matching thread never blocks on the network. When the I/O thread
+ * is parked in epoll_wait the matching thread wakes it through an eventfd;
+ * while the I/O thread is busy that write is skipped entirely.
+ *
+ * Accepted commands are journaled by the I/O thread with one write per
+ * loop iteration. When market data is enabled the matching thread also
+ * publishes trades and level changes over UDP (see market_data.h),
+ * flushing one datagram batch per matching batch. With a drop-copy name
+ * every fill is also copied to a shared-memory ring (see drop_copy.h). See
+ * uring_gateway.h for the single-threaded io_uring backend that shares this
+ * configuration.
+ */
+
+enum class IoBackend {
+    Epoll,
+    IoUring
+};
+
+struct GatewayConfig {
+    IoBackend backend = IoBackend::Epoll;
+    std::string bindAddress = "0.0.0.0";
+    std::uint16_t port = 9000;            // 0 picks an ephemeral port (see GetPort)
+    std::string journalPath;              // Empty disables journaling
+    std::string marketDataAddress;        // Empty disables the UDP market-data publisher
+    std::uint16_t marketDataPort = 9100;
+    std::uint16_t retransmitPort = 9101;
+    std::string dropCopyName;             // Empty disables the drop-copy stream; else a /dev/shm name
+    bool cancelOnDisconnect = true;       // Pull a session's resting orders when it drops
+    std::size_t queueCapacity = 1 << 16;  // Per direction
+    std::size_t sessionBufferSize = 1 << 16;
+    std::size_t maxPendingOutput = 4 << 20;  // Unsent response bytes before a session that stopped reading is dropped
+    int maxEventsPerWait = 256;
+};
+
+struct GatewayStats {
+    std::uint64_t sessionsAccepted = 0;
+    std::uint64_t sessionsClosed = 0;
+    std::uint64_t commandsIn = 0;
+    std::uint64_t eventsOut = 0;
+    std::uint64_t malformed = 0;
+    std::uint64_t disconnectCancels = 0;  // Sessions whose orders were pulled when they dropped
+    std::uint64_t slowReaders = 0;  // Sessions dropped for leaving more than maxPendingOutput unsent
+    std::uint64_t syscalls = 0;  // Every system call on the order path, all threads
+};
+
+class Gateway {
+public:
+    explicit Gateway(const GatewayConfig& config)
+        : config(config), inbound(config.queueCapacity), outbound(config.queueCapacity) {
+        if (!config.journalPath.empty()) journal = std::make_unique<Journal>(config.journalPath);
+        if (!config.dropCopyName.empty()) dropCopy = std::make_unique<DropCopyPublisher>(config.dropCopyName);
+        listenFd = CreateListenSocket();
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (wakeFd < 0 || epollFd < 0) {
+            throw std::runtime_error("Gateway: failed to create eventfd/epoll: " + std::string(std::strerror(errno)));
+        }
+        Watch(listenFd, EPOLLIN | EPOLLET, ListenToken);
+        Watch(wakeFd, EPOLLIN | EPOLLET, WakeToken);
+    }
+
+    ~Gateway() {
+        for (auto& [id, session] : sessions) close(session.fd);
+        close(epollFd);
+        close(wakeFd);
+        close(listenFd);
+    }
+
+    Gateway(const Gateway&) = delete;
+    Gateway& operator=(const Gateway&) = delete;
+
+    /**
+     * Runs the I/O loop on the calling thread and the matching loop on a
+     * dedicated thread. Returns after Stop() is called.
+     */
+    void Run() {
+        running.store(true);
+        std::thread matcher([this] { RunMatchingLoop(); });
+        RunIoLoop();
+        matcher.join();
+        stats.syscalls += wakeups.load();
+    }
+
+    /**
+     * Requests shutdown. Safe to call from any thread or a signal handler.
+     */
+    void Stop() {
+        running.store(false);
+        Wake();
+    }
+
+    /**
+     * @returns the bound port, useful when configured with port 0
+     */
+    std::uint16_t GetPort() const {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+    /**
+     * Only meaningful once Run() has returned
+     */
+    const GatewayStats& GetStats() const { return stats; }
+
+private:
+    static constexpr std::uint64_t ListenToken = 0;
+    static constexpr std::uint64_t WakeToken = 1;
+    static constexpr SessionId FirstSessionId = 2;  // Session ids double as epoll tokens
+    static constexpr std::size_t MatchingBatchSize = 256;
+
+    /**
+     * Per-connection state, touched only by the I/O thread
+     */
+    struct Session {
+        int fd = -1;
+        std::vector<char> input;
+        std::size_t inputBegin = 0;
+        std::size_t inputEnd = 0;
+        std::vector<char> output;
+        std::size_t outputOffset = 0;
+        bool pending = false;  // Unparsed or unread input remains; revisit without waiting for epoll
+        bool dirty = false;    // Has output queued this iteration
+    };
+
+    int CreateListenSocket() {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw std::runtime_error("Gateway: socket() failed: " + std::string(std::strerror(errno)));
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config.port);
+        if (inet_pton(AF_INET, config.bindAddress.c_str(), &addr.sin_addr) != 1) {
+            close(fd);
+            throw std::runtime_error("Gateway: invalid bind address " + config.bindAddress);
+        }
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+            std::string error = std::strerror(errno);
+            close(fd);
+            throw std::runtime_error("Gateway: cannot listen on " + config.bindAddress + ":" +
+                                     std::to_string(config.port) + ": " + error);
+        }
+        return fd;
+    }
+
+    void Watch(int fd, std::uint32_t events, std::uint64_t token) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = token;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            throw std::runtime_error("Gateway: epoll_ctl failed: " + std::string(std::strerror(errno)));
+        }
+    }
+
+    void Wake() {
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+        std::uint64_t one = 1;
+        [[maybe_unused]] ssize_t n = write(wakeFd, &one, sizeof(one));
+    }
+
+    // ---------------------------------------------------------------------
+    // Matching thread
+    // ---------------------------------------------------------------------
+
+    void RunMatchingLoop() {
+        if (config.marketDataAddress.empty()) {
+            NoMarketData none;
+            return RunMatchingLoop(none, [] {});
+        }
+        MarketDataConfig marketDataConfig;
+        marketDataConfig.address = config.marketDataAddress;
+        marketDataConfig.port = config.marketDataPort;
+        marketDataConfig.retransmitAddress = config.bindAddress;
+        marketDataConfig.retransmitPort = config.retransmitPort;
+        MarketDataPublisher publisher(marketDataConfig);
+        RunMatchingLoop(publisher, [&publisher] {
+            publisher.Flush();
+            publisher.ServiceRetransmissions();
+        });
+    }
+
+    /**
+     * @param endBatch called after every batch of commands
+     */
+    template <typename MarketData, typename EndBatch>
+    void RunMatchingLoop(MarketData& marketData, EndBatch&& endBatch) {
+        MatchingEngine engine;
+        if (dropCopy) engine.SetDropCopy(&dropCopy->GetRing());
+        Command command;
+        unsigned idleSpins = 0;
+
+        auto emit = [this](const Event& event) {
+            while (!outbound.TryPush(event)) {
+                if (!running.load(std::memory_order_relaxed)) return;  // Shutting down; drop it
+                // The I/O thread is behind; make sure it is awake and let it drain
+                WakeIoThread();
+                std::this_thread::yield();
+            }
+        };
+
+        while (running.load(std::memory_order_relaxed)) {
+            std::size_t processed = 0;
+            while (processed < MatchingBatchSize && inbound.TryPop(command)) {
+                engine.Process(command, emit, marketData);
+                ++processed;
+            }
+            if (processed > 0) {
+                endBatch();
+                WakeIoThread();
+                idleSpins = 0;
+            } else if (++idleSpins > 1024) {
+                endBatch();  // Keeps answering retransmission requests while idle
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /**
+     * Writes the eventfd only if the I/O thread announced it is about to
+     * block, so a busy gateway pays no wake-up syscalls at all. Called after
+     * pushing to outbound: the fence keeps the flag load from being satisfied
+     * before the push is visible (a store followed by a load of another
+     * location may otherwise reorder, even with seq_cst on the load alone).
+     * It pairs with the fence in RunIoLoop, so either this thread sees the
+     * flag set or the I/O thread's re-check sees the event.
+     */
+    void WakeIoThread() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ioSleeping.load(std::memory_order_relaxed) && ioSleeping.exchange(false)) {
+            Wake();
+        }
+    }
+
+    // ---------------------------------------------------------------------
+    // I/O thread
+    // ---------------------------------------------------------------------
+
+    void RunIoLoop() {
+        std::vector<epoll_event> events(config.maxEventsPerWait);
+
+        while (running.load(std::memory_order_relaxed)) {
+            int timeout = 0;
+            if (pendingSessions.empty() && pendingDisconnects.empty()) {
+                // Announce the intent to sleep, then re-check the queue. The
+                // fence (paired with WakeIoThread's) orders the flag store before
+                // the re-check loads; without it both threads could read stale
+                // values and an event would wait out the timeout below.
+                ioSleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (outbound.Size() == 0) timeout = 100;
+            }
+
+            ++stats.syscalls;
+            int n = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), timeout);
+            ioSleeping.store(false, std::memory_order_relaxed);
+            if (n < 0 && errno != EINTR) {
+                throw std::runtime_error("Gateway: epoll_wait failed: " + std::string(std::strerror(errno)));
+            }
+
+            for (int i = 0; i < n; ++i) {
+                const std::uint64_t token = events[i].data.u64;
+                if (token == ListenToken) {
+                    AcceptSessions();
+                } else if (token == WakeToken) {
+                    std::uint64_t value;
+                    ++stats.syscalls;
+                    [[maybe_unused]] ssize_t r = read(wakeFd, &value, sizeof(value));
+                } else {
+                    HandleSessionEvent(token, events[i].events);
+                }
+            }
+
+            DrainOutbound();
+            RetryPendingSessions();
+            FlushDirtySessions();
+            FlushJournal();
+        }
+
+        // Deliver whatever the matching thread produced before it stopped
+        DrainOutbound();
+        FlushDirtySessions();
+        FlushJournal();
+    }
+
+    void FlushJournal() {
+        if (!journal || !journal->HasPending()) return;
+        const std::uint64_t before = journal->GetSyncWriteCount();
+        journal->FlushSync();
+        stats.syscalls += journal->GetSyncWriteCount() - before;
+    }
+
+    void AcceptSessions() {
+        while (true) {
+            ++stats.syscalls;
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return;  // EAGAIN: backlog drained; anything else is retried on the next edge
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            stats.syscalls += 2;  // setsockopt + epoll_ctl
+
+            SessionId id = nextSessionId++;
+            Session& session = sessions[id];
+            session.fd = fd;
+            session.input.resize(config.sessionBufferSize);
+            session.output.reserve(config.sessionBufferSize);
+            Watch(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, id);
+            ++stats.sessionsAccepted;
+        }
+    }
+
+    void HandleSessionEvent(SessionId id, std::uint32_t mask) {
+        auto it = sessions.find(id);
+        if (it == sessions.end()) return;
+        Session& session = it->second;
+
+        if (mask & EPOLLOUT) {
+            if (!FlushSession(session)) return CloseSession(id);
+        }
+        if (mask & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            if (!ReadSession(id, session)) return CloseSession(id);
+        }
+    }
+
+    /**
+     * Reads until EAGAIN (required with edge triggering) or until the input
+     * buffer is full, decoding frames as it goes
+     * @returns false if the session must be closed
+     */
+    bool ReadSession(SessionId id, Session& session) {
+        while (true) {
+            if (!ParseFrames(id, session)) return false;
+            if (session.pending) return true;  // Inbound queue full; resume later
+
+            if (session.inputEnd == session.input.size()) {
+                // No room to read; the socket may still hold data we will
+                // not be told about again, so revisit once frames drain
+                session.pending = true;
+                pendingSessions.push_back(id);
+                return true;
+            }
+
+            ++stats.syscalls;
+            ssize_t n = recv(session.fd, session.input.data() + session.inputEnd,
+                             session.input.size() - session.inputEnd, 0);
+            if (n > 0) {
+                session.inputEnd += static_cast<std::size_t>(n);
+                continue;
+            }
+            if (n == 0) return false;  // Orderly shutdown by peer
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    /**
+     * Decodes complete frames into the inbound queue
+     * @returns false on a framing error that makes the stream unrecoverable
+     */
+    bool ParseFrames(SessionId id, Session& session) {
+        while (session.inputEnd - session.inputBegin >= sizeof(MessageHeader)) {
+            const char* frame = session.input.data() + session.inputBegin;
+            std::uint16_t length;
+            std::memcpy(&length, frame, sizeof(length));
+            if (length < sizeof(MessageHeader) || length > MaxMessageSize) return false;
+            if (session.inputEnd - session.inputBegin < length) break;
+
+            Command command;
+            if (!DecodeCommand(frame, length, id, command)) {
+                ++stats.malformed;
+                Event reject{MessageType::Reject, RejectReason::Malformed, id, 0, 0, 0, 0};
+                AppendEvent(id, session, reject);
+            } else if (!inbound.TryPush(command)) {
+                if (!session.pending) {
+                    session.pending = true;
+                    pendingSessions.push_back(id);
+                }
+                break;
+            } else {
+                ++stats.commandsIn;
+                if (journal && !journal->Append(command)) {
+                    FlushJournal();
+                    journal->Append(command);
+                }
+            }
+            session.inputBegin += length;
+        }
+
+        // Compact so the next recv has contiguous space
+        if (session.inputBegin == session.inputEnd) {
+            session.inputBegin = session.inputEnd = 0;
+        } else if (session.inputBegin > 0) {
+            std::memmove(session.input.data(), session.input.data() + session.inputBegin,
+                         session.inputEnd - session.inputBegin);
+            session.inputEnd -= session.inputBegin;
+            session.inputBegin = 0;
+        }
+        return true;
+    }
+
+    /**
+     * Queues the cancel-on-disconnect for a dropped session. It goes through
+     * the matching thread like any command, so its cancels reach market data
+     * and the journal; a full queue defers it to the next loop iteration.
+     */
+    void SubmitDisconnect(SessionId id) {
+        const Command command = MakeCancelOnDisconnect(id);
+        if (!inbound.TryPush(command)) {
+            pendingDisconnects.push_back(id);
+            return;
+        }
+        ++stats.disconnectCancels;
+        if (journal && !journal->Append(command)) {
+            FlushJournal();
+            journal->Append(command);
+        }
+    }
+
+    void RetryPendingSessions() {
+        if (!pendingDisconnects.empty()) {
+            std::vector<SessionId> retry;
+            retry.swap(pendingDisconnects);
+            for (SessionId id : retry) SubmitDisconnect(id);
+        }
+        if (pendingSessions.empty()) return;
+        std::vector<SessionId> retry;
+        retry.swap(pendingSessions);
+        for (SessionId id : retry) {
+            auto it = sessions.find(id);
+            if (it == sessions.end()) continue;
+            it->second.pending = false;
+            if (!ReadSession(id, it->second)) CloseSession(id);
+        }
+    }
+
+    void DrainOutbound() {
+        Event event;
+        while (outbound.TryPop(event)) {
+            auto it = sessions.find(event.session);
+            if (it == sessions.end()) continue;  // Session went away; nobody to tell
+            AppendEvent(event.session, it->second, event);
+            ++stats.eventsOut;
+        }
+    }
+
+    void AppendEvent(SessionId id, Session& session, const Event& event) {
+        if (!session.dirty) {
+            session.dirty = true;
+            dirtySessions.push_back(id);
+        }
+        char buffer[MaxMessageSize];
+        std::size_t length = EncodeEvent(event, buffer);
+        session.output.insert(session.output.end(), buffer, buffer + length);
+    }
+
+    /**
+     * Writes all sessions that received events this iteration, one send()
+     * per session regardless of how many events were batched for it. A session
+     * still holding more than maxPendingOutput afterwards is not reading its
+     * responses and is dropped rather than buffered without bound.
+     */
+    void FlushDirtySessions() {
+        for (SessionId id : dirtySessions) {
+            auto it = sessions.find(id);
+            if (it == sessions.end()) continue;
+            Session& session = it->second;
+            session.dirty = false;
+            if (!FlushSession(session)) {
+                CloseSession(id);
+            } else if (session.output.size() - session.outputOffset > config.maxPendingOutput) {
+                ++stats.slowReaders;
+                CloseSession(id);
+            }
+        }
+        dirtySessions.clear();
+    }
+
+    /**
+     * @returns false if the socket failed; EAGAIN leaves data queued until EPOLLOUT
+     */
+    bool FlushSession(Session& session) {
+        while (session.outputOffset < session.output.size()) {
+            ++stats.syscalls;
+            ssize_t n = send(session.fd, session.output.data() + session.outputOffset,
+                             session.output.size() - session.outputOffset, MSG_NOSIGNAL);
+            if (n > 0) {
+                session.outputOffset += static_cast<std::size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        session.output.clear();
+        session.outputOffset = 0;
+        return true;
+    }
+
+    void CloseSession(SessionId id) {
+        auto it = sessions.find(id);
+        if (it == sessions.end()) return;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        close(it->second.fd);
+        stats.syscalls += 2;
+        sessions.erase(it);
+        ++stats.sessionsClosed;
+        if (config.cancelOnDisconnect) SubmitDisconnect(id);
+    }
+
+    GatewayConfig config;
+    int listenFd = -1;
+    int wakeFd = -1;
+    int epollFd = -1;
+
+    std::atomic<bool> running{false};
+    std::atomic<bool> ioSleeping{false};
+    std::atomic<std::uint64_t> wakeups{0};
+    std::unique_ptr<Journal> journal;
+    std::unique_ptr<DropCopyPublisher> dropCopy;  // Written only by the matching thread
+
+    SpscQueue<Command> inbound;  // I/O thread -> matching thread
+    SpscQueue<Event> outbound;   // Matching thread -> I/O thread
+
+    // I/O thread state
+    std::unordered_map<SessionId, Session> sessions;
+    std::vector<SessionId> pendingSessions;
+    std::vector<SessionId> pendingDisconnects;  // Cancel-on-disconnects waiting for queue space
+    std::vector<SessionId> dirtySessions;
+    SessionId nextSessionId = FirstSessionId;
+    GatewayStats stats;
+};
+
+#endif  // __linux__
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Handle Pool
+ *
+ * A HandlePool stores elements in one vector and names them by 32-bit
+ * index, so structures that link elements together (the book's order
+ * queues, owner lists and order -> level references) pay four bytes a link
+ * instead of eight. Freed slots are reused newest first, while they are
+ * still in cache. The typed Handle keeps an order handle from being used
+ * on the level pool and vice versa.
+ *
+ * Build with ORDER_BOOK_HANDLE_CHECKS defined to check every access: each
+ * slot then counts how often it has been released, a handle carries the
+ * count from when it was allocated, and using a handle after its element
+ * was released (or releasing it twice) throws instead of silently reaching
+ * whatever now lives in the slot. The checks double the handle's size.
+ */
+
+#if defined(ORDER_BOOK_HANDLE_CHECKS)
+inline constexpr bool HandleChecks = true;
+#else
+inline constexpr bool HandleChecks = false;
+#endif
+
+template <typename Tag>
+class Handle {
+public:
+    constexpr Handle() = default;
+
+    bool IsNull() const { return index == NullIndex; }
+    std::uint32_t Index() const { return index; }
+    bool operator==(const Handle&) const = default;
+
+private:
+    template <typename, typename>
+    friend class HandlePool;
+
+    static constexpr std::uint32_t NullIndex = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t index = NullIndex;
+#if defined(ORDER_BOOK_HANDLE_CHECKS)
+    std::uint32_t generation = 0;
+#endif
+};
+
+template <typename Tag, typename Element>
+class HandlePool {
+public:
+    using HandleType = Handle<Tag>;
+
+    /**
+     * @returns a handle to a free slot. A reused slot keeps whatever the
+     * previous element left in it; the caller resets what it needs.
+     * @throws std::runtime_error once every 32-bit index is in use
+     */
+    HandleType Allocate() {
+        HandleType handle;
+        if (!freeSlots.empty()) {
+            handle.index = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            if (elements.size() == HandleType::NullIndex) throw std::runtime_error("HandlePool: out of handles");
+            handle.index = static_cast<std::uint32_t>(elements.size());
+            elements.emplace_back();
+#if defined(ORDER_BOOK_HANDLE_CHECKS)
+            generations.push_back(0);
+#endif
+        }
+#if defined(ORDER_BOOK_HANDLE_CHECKS)
+        handle.generation = generations[handle.index];
+#endif
+        return handle;
+    }
+
+    void Release(HandleType handle) {
+        Check(handle);
+#if defined(ORDER_BOOK_HANDLE_CHECKS)
+        ++generations[handle.index];
+#endif
+        freeSlots.push_back(handle.index);
+    }
+
+    Element& operator[](HandleType handle) {
+        Check(handle);
+        return elements[handle.index];
+    }
+
+    const Element& operator[](HandleType handle) const {
+        Check(handle);
+        return elements[handle.index];
+    }
+
+    /**
+     * Throws if handle is null or stale; does nothing unless
+     * ORDER_BOOK_HANDLE_CHECKS is defined. For arrays kept in step with the
+     * pool's slots.
+     */
+    void Check([[maybe_unused]] HandleType handle) const {
+#if defined(ORDER_BOOK_HANDLE_CHECKS)
+        if (handle.index >= elements.size()) throw std::runtime_error("HandlePool: null or out-of-range handle");
+        if (handle.generation != generations[handle.index]) {
+            throw std::runtime_error("HandlePool: handle " + std::to_string(handle.index) + " used after release");
+        }
+#endif
+    }
+
+    /**
+     * @returns the number of slots, live or free; indices run below this
+     */
+    std::size_t Capacity() const { return elements.size(); }
+
+private:
+    std::vector<Element> elements;
+    std::vector<std::uint32_t> freeSlots;
+#if defined(ORDER_BOOK_HANDLE_CHECKS)
+    std::vector<std::uint32_t> generations;  // Releases per slot
+#endif
+};
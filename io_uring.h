@@ -0,0 +1,272 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+/**
+ * IoUring is a minimal wrapper over the raw io_uring system calls, so the
+ * gateway does not depend on liburing being installed.
+ *
+ * Only what the gateway needs is exposed: SQE acquisition, batched submit
+ * (one io_uring_enter per call), completion iteration, fixed-buffer
+ * registration and provided-buffer rings for multishot receive.
+ *
+ * Not thread-safe: one ring per thread.
+ */
+class IoUring {
+public:
+    explicit IoUring(unsigned entries) {
+        io_uring_params params{};
+        // A single issuer with deferred task work keeps completions on our
+        // thread and out of interrupt context; older kernels reject the flags.
+        // The ring starts disabled so the issuing thread is bound in Enable(),
+        // which lets one thread construct it and another run it.
+        params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED;
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0 && errno == EINVAL) {
+            params = io_uring_params{};
+            ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        } else {
+            disabled = true;
+        }
+        if (ringFd < 0) Fail("io_uring_setup");
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+            close(ringFd);
+            throw std::runtime_error("IoUring: kernel lacks IORING_FEAT_SINGLE_MMAP");
+        }
+
+        ringSize = std::max(params.sq_off.array + params.sq_entries * sizeof(std::uint32_t),
+                            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        ringMemory = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ringFd, IORING_OFF_SQ_RING);
+        if (ringMemory == MAP_FAILED) Fail("mmap(SQ/CQ ring)");
+
+        sqeSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqeSize, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) Fail("mmap(SQEs)");
+
+        char* base = static_cast<char*>(ringMemory);
+        sqHead = reinterpret_cast<std::uint32_t*>(base + params.sq_off.head);
+        sqTail = reinterpret_cast<std::uint32_t*>(base + params.sq_off.tail);
+        sqMask = *reinterpret_cast<std::uint32_t*>(base + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        cqHead = reinterpret_cast<std::uint32_t*>(base + params.cq_off.head);
+        cqTail = reinterpret_cast<std::uint32_t*>(base + params.cq_off.tail);
+        cqMask = *reinterpret_cast<std::uint32_t*>(base + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+        // Identity-map the SQ index array once so submission is just a tail bump
+        auto* array = reinterpret_cast<std::uint32_t*>(base + params.sq_off.array);
+        for (std::uint32_t i = 0; i < sqEntries; ++i) array[i] = i;
+        localTail = *sqTail;
+    }
+
+    ~IoUring() {
+        if (sqes) munmap(sqes, sqeSize);
+        if (ringMemory) munmap(ringMemory, ringSize);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * Binds the ring to the calling thread; call before the first Submit
+     */
+    void Enable() {
+        if (!disabled) return;
+        if (Register(IORING_REGISTER_ENABLE_RINGS, nullptr, 0) < 0) Fail("IORING_REGISTER_ENABLE_RINGS");
+        disabled = false;
+    }
+
+    /**
+     * @returns a zeroed SQE, submitting queued entries first if the SQ is full
+     */
+    io_uring_sqe* GetSqe() {
+        if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+            Submit(0);
+        }
+        io_uring_sqe* sqe = &sqes[localTail & sqMask];
+        std::memset(sqe, 0, sizeof(*sqe));
+        ++localTail;
+        return sqe;
+    }
+
+    /**
+     * Publishes queued SQEs and optionally waits for completions,
+     * all in a single io_uring_enter call
+     */
+    void Submit(unsigned waitFor) {
+        const std::uint32_t toSubmit = localTail - *sqTail;
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        while (true) {
+            ++syscalls;
+            long r = syscall(__NR_io_uring_enter, ringFd, toSubmit, waitFor, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r >= 0) return;
+            if (errno == EINTR) {
+                if (waitFor == 0) return;
+                continue;
+            }
+            if (errno == EBUSY || errno == EAGAIN) return;  // CQ overflow pending; caller drains then retries
+            Fail("io_uring_enter");
+        }
+    }
+
+    bool HasCompletions() const {
+        return *cqHead != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    }
+
+    /**
+     * Invokes handler(const io_uring_cqe&) for each ready completion
+     * @returns number of completions consumed
+     */
+    template <typename Handler>
+    unsigned ForEachCompletion(Handler&& handler) {
+        std::uint32_t head = *cqHead;
+        const std::uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        for (; head != tail; ++head, ++count) {
+            handler(cqes[head & cqMask]);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    /**
+     * Registers fixed buffers for IORING_OP_READ_FIXED/WRITE_FIXED.
+     * The kernel pins them once instead of mapping user pages on every I/O.
+     */
+    void RegisterBuffers(const iovec* buffers, unsigned count) {
+        ++syscalls;
+        if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, buffers, count) < 0) {
+            Fail("IORING_REGISTER_BUFFERS");
+        }
+    }
+
+    int Register(unsigned opcode, void* arg, unsigned count) {
+        ++syscalls;
+        return static_cast<int>(syscall(__NR_io_uring_register, ringFd, opcode, arg, count));
+    }
+
+    std::uint64_t GetSyscallCount() const { return syscalls; }
+
+private:
+    [[noreturn]] static void Fail(const char* what) {
+        throw std::runtime_error(std::string("IoUring: ") + what + " failed: " + std::strerror(errno));
+    }
+
+    int ringFd = -1;
+    void* ringMemory = nullptr;
+    std::size_t ringSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    std::size_t sqeSize = 0;
+
+    std::uint32_t* sqHead = nullptr;
+    std::uint32_t* sqTail = nullptr;
+    std::uint32_t sqMask = 0;
+    std::uint32_t sqEntries = 0;
+    std::uint32_t localTail = 0;
+
+    std::uint32_t* cqHead = nullptr;
+    std::uint32_t* cqTail = nullptr;
+    std::uint32_t cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    std::uint64_t syscalls = 0;
+    bool disabled = false;
+};
+
+/**
+ * ProvidedBufferRing is a kernel-registered pool of receive buffers.
+ * Multishot receives pick a free buffer at completion time, so an idle
+ * session pins no memory; the consumer hands each buffer back with Recycle.
+ */
+class ProvidedBufferRing {
+public:
+    ProvidedBufferRing(IoUring& ring, std::uint16_t groupId, std::uint16_t count, std::uint32_t bufferSize)
+        : ring(ring), groupId(groupId), count(count), mask(static_cast<std::uint16_t>(count - 1)), bufferSize(bufferSize) {
+        if (count == 0 || (count & (count - 1)) != 0) {
+            throw std::invalid_argument("ProvidedBufferRing: count must be a power of two");
+        }
+        ringBytes = count * sizeof(io_uring_buf);
+        ringMemory = static_cast<io_uring_buf_ring*>(mmap(nullptr, ringBytes, PROT_READ | PROT_WRITE,
+                                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        storageBytes = static_cast<std::size_t>(count) * bufferSize;
+        storage = static_cast<char*>(mmap(nullptr, storageBytes, PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+        if (ringMemory == MAP_FAILED || storage == MAP_FAILED) {
+            throw std::runtime_error("ProvidedBufferRing: mmap failed");
+        }
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<std::uint64_t>(ringMemory);
+        reg.ring_entries = count;
+        reg.bgid = groupId;
+        if (ring.Register(IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            throw std::runtime_error("ProvidedBufferRing: IORING_REGISTER_PBUF_RING failed: " +
+                                     std::string(std::strerror(errno)));
+        }
+
+        for (std::uint16_t id = 0; id < count; ++id) Recycle(id);
+        Publish();
+    }
+
+    ~ProvidedBufferRing() {
+        // Unregister first so a still-armed receive cannot pick a buffer we unmap
+        io_uring_buf_reg reg{};
+        reg.bgid = groupId;
+        ring.Register(IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(storage, storageBytes);
+        munmap(ringMemory, ringBytes);
+    }
+
+    ProvidedBufferRing(const ProvidedBufferRing&) = delete;
+    ProvidedBufferRing& operator=(const ProvidedBufferRing&) = delete;
+
+    std::uint16_t GetGroupId() const { return groupId; }
+    char* GetBuffer(std::uint16_t id) { return storage + static_cast<std::size_t>(id) * bufferSize; }
+
+    /**
+     * Queues a buffer for reuse; it becomes visible to the kernel on Publish
+     */
+    void Recycle(std::uint16_t id) {
+        // Index the ring as a plain array: in C++ the header's flexible-array
+        // wrapper contains an empty struct of size 1, which shifts `bufs`
+        io_uring_buf& buf = reinterpret_cast<io_uring_buf*>(ringMemory)[localTail & mask];
+        buf.addr = reinterpret_cast<std::uint64_t>(GetBuffer(id));
+        buf.len = bufferSize;
+        buf.bid = id;
+        ++localTail;
+    }
+
+    void Publish() {
+        __atomic_store_n(&ringMemory->tail, localTail, __ATOMIC_RELEASE);
+    }
+
+private:
+    IoUring& ring;
+    std::uint16_t groupId;
+    std::uint16_t count;
+    std::uint16_t mask;
+    std::uint32_t bufferSize;
+    std::uint16_t localTail = 0;
+    io_uring_buf_ring* ringMemory = nullptr;
+    std::size_t ringBytes = 0;
+    char* storage = nullptr;
+    std::size_t storageBytes = 0;
+};
+
+#endif  // __linux__
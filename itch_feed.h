@@ -0,0 +1,389 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "order_book.h"
+
+/**
+ * ITCH-Style Market Data Feed
+ *
+ * Decodes a NASDAQ TotalView-ITCH 5.0 style binary stream and rebuilds one
+ * OrderBook per instrument with the book's level-3 operations. The file
+ * format is the usual one for recorded ITCH: every message is preceded by
+ * a 2-byte big-endian length. All integers are big-endian; prices carry
+ * four implied decimals and are used directly as ticks.
+ *
+ * Handled messages (others are skipped by length):
+ * - R Stock Directory  names the instrument behind a stock locate
+ * - A/F Add Order      L3 add (F carries an MPID, ignored)
+ * - E/C Order Executed L3 execute, the order keeps its queue position
+ * - X Order Cancel     L3 partial cancel
+ * - D Order Delete     L3 delete
+ * - U Order Replace    L3 replace with a new order reference number
+ *
+ * Books are indexed directly by stock locate (a dense 16-bit id assigned
+ * by the exchange), so routing a message is one array access.
+ */
+
+/**
+ * Unaligned big-endian (network order) field access
+ */
+inline std::uint16_t ReadBigEndian16(const char* p) {
+    std::uint16_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __builtin_bswap16(value);
+}
+
+inline std::uint32_t ReadBigEndian32(const char* p) {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __builtin_bswap32(value);
+}
+
+inline std::uint64_t ReadBigEndian48(const char* p) {
+    return (static_cast<std::uint64_t>(ReadBigEndian16(p)) << 32) | ReadBigEndian32(p + 2);
+}
+
+inline std::uint64_t ReadBigEndian64(const char* p) {
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __builtin_bswap64(value);
+}
+
+inline void WriteBigEndian16(char* p, std::uint16_t value) {
+    value = __builtin_bswap16(value);
+    std::memcpy(p, &value, sizeof(value));
+}
+
+inline void WriteBigEndian32(char* p, std::uint32_t value) {
+    value = __builtin_bswap32(value);
+    std::memcpy(p, &value, sizeof(value));
+}
+
+inline void WriteBigEndian48(char* p, std::uint64_t value) {
+    WriteBigEndian16(p, static_cast<std::uint16_t>(value >> 32));
+    WriteBigEndian32(p + 2, static_cast<std::uint32_t>(value));
+}
+
+inline void WriteBigEndian64(char* p, std::uint64_t value) {
+    value = __builtin_bswap64(value);
+    std::memcpy(p, &value, sizeof(value));
+}
+
+/**
+ * Message sizes (excluding the length prefix) and field offsets.
+ * Every message starts with type(1) locate(2) tracking(2) timestamp(6).
+ */
+struct ItchLayout {
+    static constexpr std::size_t HeaderSize = 11;
+    static constexpr std::size_t StockDirectorySize = 39;
+    static constexpr std::size_t AddOrderSize = 36;
+    static constexpr std::size_t AddOrderMpidSize = 40;
+    static constexpr std::size_t OrderExecutedSize = 31;
+    static constexpr std::size_t OrderExecutedPriceSize = 36;
+    static constexpr std::size_t OrderCancelSize = 23;
+    static constexpr std::size_t OrderDeleteSize = 19;
+    static constexpr std::size_t OrderReplaceSize = 35;
+};
+
+struct ItchStats {
+    std::uint64_t messages = 0;
+    std::uint64_t adds = 0;
+    std::uint64_t executions = 0;
+    std::uint64_t cancels = 0;
+    std::uint64_t deletes = 0;
+    std::uint64_t replaces = 0;
+    std::uint64_t skipped = 0;        // Message types the handler does not use
+    std::uint64_t unknownOrders = 0;  // Reference numbers not in the book
+    std::uint64_t inconsistent = 0;   // Truncated messages or quantities larger than the order
+    std::uint64_t crosses = 0;        // Adds that traded; a correct feed never crosses
+};
+
+/**
+ * MappedFeed maps a whole recorded feed file read-only for one sequential pass
+ */
+class MappedFeed {
+public:
+    explicit MappedFeed(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("MappedFeed: cannot open " + path + ": " + std::strerror(errno));
+        struct stat info;
+        if (fstat(fd, &info) < 0 || info.st_size == 0) {
+            close(fd);
+            return;
+        }
+        const auto length = static_cast<std::size_t>(info.st_size);
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE | MapPopulate, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("MappedFeed: cannot map " + path + ": " + std::strerror(errno));
+        }
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        memory = mapped;
+        size = length;
+    }
+
+    ~MappedFeed() {
+        if (memory) munmap(memory, size);
+    }
+
+    MappedFeed(const MappedFeed&) = delete;
+    MappedFeed& operator=(const MappedFeed&) = delete;
+
+    const char* GetData() const { return static_cast<const char*>(memory); }
+    std::size_t GetSize() const { return size; }
+
+private:
+#if defined(MAP_POPULATE)
+    static constexpr int MapPopulate = MAP_POPULATE;
+#else
+    static constexpr int MapPopulate = 0;
+#endif
+
+    void* memory = nullptr;
+    std::size_t size = 0;
+};
+
+class ItchFeedHandler {
+public:
+    static constexpr std::size_t MaxLocates = 1 << 16;
+
+    ItchFeedHandler() : books(MaxLocates), symbols(MaxLocates) {}
+
+    /**
+     * Applies one message (without its length prefix)
+     */
+    void Apply(const char* message, std::size_t length) {
+        ++stats.messages;
+        if (length < ItchLayout::HeaderSize) {
+            ++stats.inconsistent;
+            return;
+        }
+        const std::uint16_t locate = ReadBigEndian16(message + 1);
+
+        switch (message[0]) {
+        case 'R':
+            if (!CheckSize(length, ItchLayout::StockDirectorySize)) return;
+            std::memcpy(symbols[locate].data(), message + 11, 8);
+            return;
+        case 'A':
+        case 'F': {
+            if (!CheckSize(length, ItchLayout::AddOrderSize)) return;
+            ++stats.adds;
+            const Side side = message[19] == 'B' ? Side::Buy : Side::Sell;
+            Trades trades = Book(locate).AddOrder(Order(
+                OrderType::GoodTilCancel, ReadBigEndian64(message + 11), side,
+                static_cast<Price>(ReadBigEndian32(message + 32)), ReadBigEndian32(message + 20)));
+            if (!trades.empty()) ++stats.crosses;
+            return;
+        }
+        case 'E':
+        case 'C':
+            if (!CheckSize(length, ItchLayout::OrderExecutedSize)) return;
+            ++stats.executions;
+            Reduce(locate, ReadBigEndian64(message + 11), ReadBigEndian32(message + 19), true);
+            return;
+        case 'X':
+            if (!CheckSize(length, ItchLayout::OrderCancelSize)) return;
+            ++stats.cancels;
+            Reduce(locate, ReadBigEndian64(message + 11), ReadBigEndian32(message + 19), false);
+            return;
+        case 'D': {
+            if (!CheckSize(length, ItchLayout::OrderDeleteSize)) return;
+            ++stats.deletes;
+            OrderBook& book = Book(locate);
+            const OrderId id = ReadBigEndian64(message + 11);
+            if (!book.Contains(id)) {
+                ++stats.unknownOrders;
+                return;
+            }
+            book.CancelOrder(id);
+            return;
+        }
+        case 'U': {
+            if (!CheckSize(length, ItchLayout::OrderReplaceSize)) return;
+            ++stats.replaces;
+            OrderBook& book = Book(locate);
+            const OrderId id = ReadBigEndian64(message + 11);
+            if (!book.Contains(id)) {
+                ++stats.unknownOrders;
+                return;
+            }
+            Trades trades = book.ReplaceOrder(id, ReadBigEndian64(message + 19),
+                                              static_cast<Price>(ReadBigEndian32(message + 31)),
+                                              ReadBigEndian32(message + 27));
+            if (!trades.empty()) ++stats.crosses;
+            return;
+        }
+        default:
+            ++stats.skipped;
+            return;
+        }
+    }
+
+    /**
+     * Applies every complete length-prefixed message in [data, data + length)
+     * @returns bytes consumed; a trailing partial message is left unconsumed
+     */
+    std::size_t ApplyBuffer(const char* data, std::size_t length) {
+        std::size_t offset = 0;
+        while (offset + 2 <= length) {
+            const std::size_t size = ReadBigEndian16(data + offset);
+            if (offset + 2 + size > length) break;
+            Apply(data + offset + 2, size);
+            offset += 2 + size;
+        }
+        return offset;
+    }
+
+    /**
+     * Maps a recorded feed file and applies all of it
+     * @returns bytes applied
+     */
+    std::size_t ApplyFile(const std::string& path) {
+        const MappedFeed feed(path);
+        return ApplyBuffer(feed.GetData(), feed.GetSize());
+    }
+
+    /**
+     * @returns the book for a stock locate, or nullptr if it saw no orders
+     */
+    const OrderBook* GetBook(std::uint16_t locate) const { return books[locate].get(); }
+
+    /**
+     * @returns the queue position of an order in a stock locate's book, empty
+     * if the book or the order is unknown
+     */
+    std::optional<QueuePosition> GetQueuePosition(std::uint16_t locate, OrderId id) const {
+        const OrderBook* book = books[locate].get();
+        return book ? book->GetQueuePosition(id) : std::nullopt;
+    }
+
+    /**
+     * @returns the symbol from the Stock Directory (space padded), empty if none was seen
+     */
+    std::string_view GetSymbol(std::uint16_t locate) const {
+        const auto& symbol = symbols[locate];
+        std::size_t length = 0;
+        while (length < symbol.size() && symbol[length] != '\0' && symbol[length] != ' ') ++length;
+        return std::string_view(symbol.data(), length);
+    }
+
+    const ItchStats& GetStats() const { return stats; }
+
+    /**
+     * @returns the book for a stock locate, created on first use; lets a
+     * simulator enter its own orders among the feed's
+     */
+    OrderBook& Book(std::uint16_t locate) {
+        if (!books[locate]) books[locate] = std::make_unique<OrderBook>();
+        return *books[locate];
+    }
+
+private:
+    bool CheckSize(std::size_t length, std::size_t expected) {
+        if (length >= expected) return true;
+        ++stats.inconsistent;
+        return false;
+    }
+
+    void Reduce(std::uint16_t locate, OrderId id, Quantity quantity, bool executed) {
+        OrderBook& book = Book(locate);
+        try {
+            const bool found = executed ? book.ExecuteOrder(id, quantity) : book.ReduceOrder(id, quantity);
+            if (!found) ++stats.unknownOrders;
+        } catch (const std::runtime_error&) {
+            ++stats.inconsistent;  // More shares than the order has left
+        }
+    }
+
+    std::vector<std::unique_ptr<OrderBook>> books;  // By stock locate
+    std::vector<std::array<char, 8>> symbols;       // By stock locate
+    ItchStats stats;
+};
+
+/**
+ * ItchWriter encodes length-prefixed ITCH messages into a byte buffer,
+ * used to produce sample feeds and test input
+ */
+class ItchWriter {
+public:
+    void StockDirectory(std::uint16_t locate, std::uint64_t timestamp, std::string_view symbol) {
+        char* p = Begin('R', ItchLayout::StockDirectorySize, locate, timestamp);
+        std::memset(p + 11, ' ', 8);
+        std::memcpy(p + 11, symbol.data(), std::min<std::size_t>(symbol.size(), 8));
+        p[19] = 'Q';  // Market category; remaining directory fields are left zero
+    }
+
+    void AddOrder(std::uint16_t locate, std::uint64_t timestamp, OrderId id, Side side,
+                  std::uint32_t shares, std::string_view symbol, std::uint32_t price) {
+        char* p = Begin('A', ItchLayout::AddOrderSize, locate, timestamp);
+        WriteBigEndian64(p + 11, id);
+        p[19] = side == Side::Buy ? 'B' : 'S';
+        WriteBigEndian32(p + 20, shares);
+        std::memset(p + 24, ' ', 8);
+        std::memcpy(p + 24, symbol.data(), std::min<std::size_t>(symbol.size(), 8));
+        WriteBigEndian32(p + 32, price);
+    }
+
+    void OrderExecuted(std::uint16_t locate, std::uint64_t timestamp, OrderId id, std::uint32_t shares,
+                       std::uint64_t matchNumber) {
+        char* p = Begin('E', ItchLayout::OrderExecutedSize, locate, timestamp);
+        WriteBigEndian64(p + 11, id);
+        WriteBigEndian32(p + 19, shares);
+        WriteBigEndian64(p + 23, matchNumber);
+    }
+
+    void OrderCancel(std::uint16_t locate, std::uint64_t timestamp, OrderId id, std::uint32_t shares) {
+        char* p = Begin('X', ItchLayout::OrderCancelSize, locate, timestamp);
+        WriteBigEndian64(p + 11, id);
+        WriteBigEndian32(p + 19, shares);
+    }
+
+    void OrderDelete(std::uint16_t locate, std::uint64_t timestamp, OrderId id) {
+        char* p = Begin('D', ItchLayout::OrderDeleteSize, locate, timestamp);
+        WriteBigEndian64(p + 11, id);
+    }
+
+    void OrderReplace(std::uint16_t locate, std::uint64_t timestamp, OrderId id, OrderId newId,
+                      std::uint32_t shares, std::uint32_t price) {
+        char* p = Begin('U', ItchLayout::OrderReplaceSize, locate, timestamp);
+        WriteBigEndian64(p + 11, id);
+        WriteBigEndian64(p + 19, newId);
+        WriteBigEndian32(p + 27, shares);
+        WriteBigEndian32(p + 31, price);
+    }
+
+    const std::vector<char>& GetBuffer() const { return buffer; }
+    void Clear() { buffer.clear(); }
+
+private:
+    char* Begin(char type, std::size_t size, std::uint16_t locate, std::uint64_t timestamp) {
+        const std::size_t offset = buffer.size();
+        buffer.resize(offset + 2 + size);
+        char* p = buffer.data() + offset;
+        WriteBigEndian16(p, static_cast<std::uint16_t>(size));
+        p += 2;
+        std::memset(p, 0, size);
+        p[0] = type;
+        WriteBigEndian16(p + 1, locate);
+        WriteBigEndian48(p + 5, timestamp);
+        return p;
+    }
+
+    std::vector<char> buffer;
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "latency_recorder.h"
+#include "protocol.h"
+
+/**
+ * Journal is an append-only log of every command accepted by a gateway,
+ * enough to rebuild the book by replaying it through a MatchingEngine.
+ *
+ * Records are fixed-size and written in large batches from one of two
+ * buffers: while one buffer is being written the other keeps filling.
+ * Backends choose how a sealed batch reaches the disk (FlushSync for a
+ * plain write, or Seal/Release around an asynchronous io_uring write).
+ * The journal is write-behind: acknowledgements do not wait for it.
+ */
+
+struct JournalRecord {
+    std::uint64_t timestamp;
+    Command command;
+};
+
+static_assert(std::is_trivially_copyable_v<JournalRecord>);
+
+class Journal {
+public:
+    static constexpr unsigned BufferCount = 2;
+
+    /**
+     * A sealed batch ready to be written at a fixed file offset
+     */
+    struct Segment {
+        unsigned bufferIndex;
+        const char* data;
+        std::size_t length;
+        std::uint64_t fileOffset;
+    };
+
+    Journal(const std::string& path, std::size_t bufferSize = 1 << 20)
+        : bufferSize(bufferSize - bufferSize % sizeof(JournalRecord)) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Journal: cannot open " + path + ": " + std::strerror(errno));
+        }
+        for (auto& buffer : buffers) buffer = std::make_unique<char[]>(this->bufferSize);
+    }
+
+    ~Journal() {
+        if (fd >= 0) close(fd);
+    }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /**
+     * @returns false if the active buffer is full; seal and write it first
+     */
+    bool Append(const Command& command) {
+        if (used[active] + sizeof(JournalRecord) > bufferSize) return false;
+        JournalRecord record{NowNanos(), command};
+        std::memcpy(buffers[active].get() + used[active], &record, sizeof(record));
+        used[active] += sizeof(record);
+        return true;
+    }
+
+    bool HasPending() const { return used[active] > 0; }
+
+    /**
+     * Sealing needs the other buffer to be free, i.e. no write in flight
+     */
+    bool CanSeal() const { return !inFlight[active ^ 1]; }
+
+    /**
+     * Hands the active buffer to the caller for writing and switches
+     * appends to the other buffer. Call Release once the write finished.
+     */
+    Segment Seal() {
+        Segment segment{active, buffers[active].get(), used[active], fileOffset};
+        inFlight[active] = true;
+        fileOffset += used[active];
+        active ^= 1;
+        return segment;
+    }
+
+    void Release(unsigned bufferIndex) {
+        used[bufferIndex] = 0;
+        inFlight[bufferIndex] = false;
+    }
+
+    /**
+     * Writes the active buffer with a blocking pwrite. Works whether or not
+     * the other buffer is still being written asynchronously.
+     */
+    void FlushSync() {
+        if (!HasPending()) return;
+        const char* data = buffers[active].get();
+        std::size_t written = 0;
+        while (written < used[active]) {
+            ++writes;
+            ssize_t n = pwrite(fd, data + written, used[active] - written,
+                               static_cast<off_t>(fileOffset + written));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Journal: write failed: " + std::string(std::strerror(errno)));
+            }
+            written += static_cast<std::size_t>(n);
+        }
+        fileOffset += used[active];
+        used[active] = 0;
+    }
+
+    int GetFd() const { return fd; }
+    char* GetBuffer(unsigned index) { return buffers[index].get(); }
+    std::size_t GetBufferSize() const { return bufferSize; }
+    std::uint64_t GetBytesWritten() const { return fileOffset; }
+    std::uint64_t GetSyncWriteCount() const { return writes; }
+
+    /**
+     * Reads every record of a journal file in order
+     * @returns number of records replayed
+     */
+    template <typename Handler>
+    static std::size_t Replay(const std::string& path, Handler&& handler) {
+        int in = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0) throw std::runtime_error("Journal: cannot open " + path + ": " + std::strerror(errno));
+
+        constexpr std::size_t ChunkRecords = 4096;
+        auto chunk = std::make_unique<JournalRecord[]>(ChunkRecords);
+        std::size_t count = 0;
+        std::size_t carry = 0;  // Bytes of a partial record kept at the chunk start
+        while (true) {
+            char* bytes = reinterpret_cast<char*>(chunk.get());
+            ssize_t n = read(in, bytes + carry, ChunkRecords * sizeof(JournalRecord) - carry);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            std::size_t available = carry + static_cast<std::size_t>(n);
+            std::size_t records = available / sizeof(JournalRecord);
+            for (std::size_t i = 0; i < records; ++i) handler(chunk[i]);
+            count += records;
+            carry = available - records * sizeof(JournalRecord);
+            std::memmove(bytes, bytes + records * sizeof(JournalRecord), carry);
+        }
+        close(in);
+        return count;
+    }
+
+private:
+    int fd = -1;
+    std::size_t bufferSize;
+    std::unique_ptr<char[]> buffers[BufferCount];
+    std::size_t used[BufferCount] = {0, 0};
+    bool inFlight[BufferCount] = {false, false};
+    unsigned active = 0;
+    std::uint64_t fileOffset = 0;
+    std::uint64_t writes = 0;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+ * @returns monotonic time in nanoseconds, the unit used by every benchmark
+ */
+inline std::uint64_t NowNanos() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * LatencyRecorder collects raw latency samples and reports percentiles.
+ * Samples are kept verbatim (reserve up front) so percentiles are exact.
+ */
+class LatencyRecorder {
+public:
+    explicit LatencyRecorder(std::size_t expectedSamples = 0) {
+        samples.reserve(expectedSamples);
+    }
+
+    void Record(std::uint64_t nanos) {
+        samples.push_back(nanos);
+        sorted = false;
+    }
+
+    void Merge(const LatencyRecorder& other) {
+        samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+        sorted = false;
+    }
+
+    std::size_t Count() const { return samples.size(); }
+
+    /**
+     * @param fraction in [0, 1], e.g. 0.99 for p99
+     */
+    std::uint64_t Percentile(double fraction) {
+        if (samples.empty()) return 0;
+        Sort();
+        std::size_t index = static_cast<std::size_t>(fraction * static_cast<double>(samples.size() - 1));
+        return samples[index];
+    }
+
+    /**
+     * Prints count, min, p50/p90/p99/p99.9/p99.99 and max in microseconds
+     */
+    void Print(std::ostream& out) {
+        if (samples.empty()) {
+            out << "no samples\n";
+            return;
+        }
+        Sort();
+        auto us = [](std::uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+        out << "samples=" << samples.size()
+            << " min=" << us(samples.front()) << "us"
+            << " p50=" << us(Percentile(0.50)) << "us"
+            << " p90=" << us(Percentile(0.90)) << "us"
+            << " p99=" << us(Percentile(0.99)) << "us"
+            << " p99.9=" << us(Percentile(0.999)) << "us"
+            << " p99.99=" << us(Percentile(0.9999)) << "us"
+            << " max=" << us(samples.back()) << "us\n";
+    }
+
+private:
+    void Sort() {
+        if (!sorted) {
+            std::sort(samples.begin(), samples.end());
+            sorted = true;
+        }
+    }
+
+    std::vector<std::uint64_t> samples;
+    bool sorted = true;
+};
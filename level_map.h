@@ -0,0 +1,833 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Storage for a level container's (price, level) nodes. Nodes are recycled,
+ * not freed, so a reference to a level stays valid while the level exists
+ * and containers only move node pointers around.
+ */
+template <typename Node>
+class LevelNodePool {
+public:
+    template <typename Key>
+    Node* Allocate(Key key) {
+        if (spare.empty()) {
+            nodes.push_back(std::make_unique<Node>());
+            nodes.back()->first = key;
+            return nodes.back().get();
+        }
+        Node* node = spare.back();
+        spare.pop_back();
+        node->first = key;
+        return node;
+    }
+
+    void Release(Node* node) {
+        node->second = {};
+        spare.push_back(node);
+    }
+
+private:
+    std::vector<std::unique_ptr<Node>> nodes;  // Every node ever allocated
+    std::vector<Node*> spare;                  // Released nodes, reused before allocating
+};
+
+/**
+ * Hybrid Price-Level Container
+ *
+ * HybridLevelMap is an ordered map from an integer price to a level, kept
+ * best price first (ascending, or descending for bids). It keeps a window
+ * of WindowTicks consecutive prices starting just ahead of the best price
+ * in a dense array, where finding, adding and removing a level is O(1),
+ * and every other level in a std::map, so the price range is not bounded.
+ *
+ * Design Notes:
+ * - Invariant: no overflow level lies in the window's price range, so the
+ *   order is the overflow levels ahead of the window, the window (found by
+ *   a bitmap scan) and the overflow levels behind it
+ * - Levels ahead of the window are transient (an aggressive order resting
+ *   its remainder for a moment, or the market jumping), so the window only
+ *   moves when a level is inserted: a price just ahead of it, a second one
+ *   far ahead of it, an empty window, or a best price that has drifted
+ *   three quarters of the way into it re-centre it on the best price,
+ *   moving the levels that leave it to the overflow map and the overflow
+ *   levels it now covers into it
+ * - Levels live in a LevelNodePool; the window and the overflow map only
+ *   hold node pointers
+ * - The array is allocated on the first insert, so an unused side costs
+ *   nothing
+ *
+ * The interface is the subset of std::map the book uses: value_type is
+ * std::pair<Key, Value> (with a mutable but never modified key), and
+ * insertion invalidates iterators, since it may move levels between the
+ * window and the overflow map. Erasing does not move other levels.
+ */
+template <typename Key, typename Value, bool Descending, std::size_t WindowTicks = 1024>
+class HybridLevelMap {
+    static_assert(std::is_integral_v<Key> && sizeof(Key) <= 4, "HybridLevelMap: keys must be 32-bit integers");
+    static_assert(std::has_single_bit(WindowTicks) && WindowTicks >= 64,
+                  "HybridLevelMap: the window must be a power of two of at least 64 ticks");
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<Key, Value>;
+    using Compare = std::conditional_t<Descending, std::greater<Key>, std::less<Key>>;
+
+private:
+    using Overflow = std::map<Key, value_type*, Compare>;
+    static constexpr std::int64_t Window = static_cast<std::int64_t>(WindowTicks);
+    static constexpr std::int64_t Margin = Window / 4;  // Room kept ahead of the best price after re-centring
+    static constexpr std::uint32_t None = static_cast<std::uint32_t>(WindowTicks);
+
+public:
+    template <bool Const>
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = HybridLevelMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iterator() = default;
+
+        // A mutable iterator converts to a const one
+        template <bool OtherConst, typename = std::enable_if_t<Const && !OtherConst>>
+        Iterator(const Iterator<OtherConst>& other) : map(other.map), offset(other.offset), overflow(other.overflow) {}
+
+        reference operator*() const { return *Node(); }
+        pointer operator->() const { return Node(); }
+
+        Iterator& operator++() {
+            if (offset != None) {
+                offset = map->NextOffset(offset + 1);
+                if (offset == None) overflow = map->AfterWindow();
+            } else {
+                const bool ahead = map->IsAhead(overflow->first);
+                ++overflow;
+                if (ahead && !map->IsAhead(overflow)) offset = map->first;  // None if the window is empty
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return offset == other.offset && (offset != None || overflow == other.overflow);
+        }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class HybridLevelMap;
+        template <bool>
+        friend class Iterator;
+
+        Iterator(const HybridLevelMap* map, std::uint32_t offset, typename Overflow::const_iterator overflow)
+            : map(map), offset(offset), overflow(overflow) {}
+
+        value_type* Node() const { return offset != None ? map->slots[offset] : overflow->second; }
+
+        const HybridLevelMap* map = nullptr;
+        std::uint32_t offset = None;  // Window offset, or None when in the overflow map
+        typename Overflow::const_iterator overflow;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    HybridLevelMap() = default;
+    HybridLevelMap(const HybridLevelMap&) = delete;
+    HybridLevelMap& operator=(const HybridLevelMap&) = delete;
+
+    bool empty() const { return windowCount == 0 && overflow.empty(); }
+    std::size_t size() const { return windowCount + overflow.size(); }
+
+    iterator begin() { return Mutable(std::as_const(*this).begin()); }
+    iterator end() { return iterator(this, None, overflow.end()); }
+    const_iterator end() const { return const_iterator(this, None, overflow.end()); }
+
+    const_iterator begin() const {
+        return const_iterator(this, IsAhead(overflow.begin()) ? None : first, overflow.begin());
+    }
+
+    /**
+     * @returns the level at key, inserting an empty one if there is none
+     */
+    Value& operator[](Key key) {
+        const std::int64_t rank = Rank(key);
+        if (slots.empty()) {
+            slots.assign(WindowTicks, nullptr);
+            scratch.assign(WindowTicks, nullptr);
+            occupied.assign(WindowTicks / 64, 0);
+            scratchBits.assign(WindowTicks / 64, 0);
+            base = rank - Margin;
+        }
+        std::int64_t offset = rank - base;
+        if (offset < 0 || offset >= Window) {
+            const std::int64_t best = overflow.empty() ? rank : std::min(rank, Rank(overflow.begin()->first));
+            if (windowCount == 0) {
+                // Nothing in the window: move it to the touch, unless this level is far behind it
+                if (rank - best < Window / 2) Recentre(best - Margin);
+            } else if (offset < 0) {
+                // A level far ahead stays in the overflow map unless another is already there
+                if (offset >= -Margin || IsAhead(overflow.begin())) Recentre(best - Margin);
+            } else if (first >= WindowTicks * 3 / 4) {
+                Recentre(base + first - Margin);
+            }
+            offset = rank - base;
+        }
+
+        if (offset >= 0 && offset < Window) {
+            value_type*& slot = slots[static_cast<std::size_t>(offset)];
+            if (!slot) {
+                slot = pool.Allocate(key);
+                Occupy(static_cast<std::uint32_t>(offset));
+            }
+            return slot->second;
+        }
+        const auto it = overflow.lower_bound(key);
+        if (it != overflow.end() && it->first == key) return it->second->second;
+        value_type* node = pool.Allocate(key);
+        Spill(node, it);
+        return node->second;
+    }
+
+    iterator find(Key key) { return Mutable(std::as_const(*this).find(key)); }
+
+    const_iterator find(Key key) const {
+        const std::int64_t offset = Rank(key) - base;
+        if (!slots.empty() && offset >= 0 && offset < Window) {
+            if (!slots[static_cast<std::size_t>(offset)]) return end();
+            return const_iterator(this, static_cast<std::uint32_t>(offset), overflow.end());
+        }
+        return const_iterator(this, None, overflow.find(key));
+    }
+
+    /**
+     * @returns the first level not better than key
+     */
+    iterator lower_bound(Key key) { return Mutable(Seek(key, false)); }
+    const_iterator lower_bound(Key key) const { return Seek(key, false); }
+
+    /**
+     * @returns the first level worse than key
+     */
+    iterator upper_bound(Key key) { return Mutable(Seek(key, true)); }
+    const_iterator upper_bound(Key key) const { return Seek(key, true); }
+
+    /**
+     * Removes a level
+     * @returns the level after it
+     */
+    iterator erase(const_iterator position) {
+        if (position.offset != None) {
+            const std::uint32_t offset = position.offset;
+            pool.Release(slots[offset]);
+            slots[offset] = nullptr;
+            occupied[offset / 64] &= ~(std::uint64_t{1} << (offset % 64));
+            --windowCount;
+            const std::uint32_t next = NextOffset(offset + 1);
+            if (offset == first) first = next;
+            return iterator(this, next, next == None ? AfterWindow() : overflow.end());
+        }
+        const bool ahead = IsAhead(position->first);
+        pool.Release(position.overflow->second);
+        const auto next = std::next(position.overflow);
+        spareEntries.push_back(overflow.extract(position.overflow));
+        return iterator(this, ahead && !IsAhead(next) ? first : None, next);
+    }
+
+    iterator erase(const_iterator from, const_iterator to) {
+        iterator it = Mutable(from);
+        while (it != to) it = erase(it);
+        return it;
+    }
+
+    std::size_t erase(Key key) {
+        const_iterator it = std::as_const(*this).find(key);
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+private:
+    static std::int64_t Rank(Key key) { return Descending ? -static_cast<std::int64_t>(key) : key; }
+    static Key KeyOf(std::int64_t rank) { return static_cast<Key>(Descending ? -rank : rank); }
+
+    bool IsAhead(Key key) const { return Rank(key) < base; }
+    bool IsAhead(typename Overflow::const_iterator it) const { return it != overflow.end() && IsAhead(it->first); }
+
+    /**
+     * @returns the first overflow level at or behind rank
+     */
+    typename Overflow::const_iterator OverflowFrom(std::int64_t rank) const {
+        if (overflow.empty() || rank > Rank(overflow.rbegin()->first)) return overflow.end();
+        if (rank <= Rank(overflow.begin()->first)) return overflow.begin();
+        return overflow.lower_bound(KeyOf(rank));
+    }
+
+    typename Overflow::const_iterator AfterWindow() const { return OverflowFrom(base + Window); }
+
+    /**
+     * @returns the first occupied window offset at or after offset, or None
+     */
+    std::uint32_t NextOffset(std::uint32_t offset) const {
+        if (windowCount == 0 || offset >= WindowTicks) return None;
+        std::size_t word = offset / 64;
+        std::uint64_t bits = occupied[word] & (~std::uint64_t{0} << (offset % 64));
+        while (bits == 0) {
+            if (++word == occupied.size()) return None;
+            bits = occupied[word];
+        }
+        return static_cast<std::uint32_t>(word * 64 + static_cast<std::size_t>(std::countr_zero(bits)));
+    }
+
+    void Occupy(std::uint32_t offset) {
+        occupied[offset / 64] |= std::uint64_t{1} << (offset % 64);
+        ++windowCount;
+        if (offset < first) first = offset;
+    }
+
+    iterator Mutable(const_iterator it) { return iterator(this, it.offset, it.overflow); }
+
+    const_iterator Seek(Key key, bool after) const {
+        const std::int64_t rank = Rank(key) + (after ? 1 : 0);
+        const auto bound = after ? overflow.upper_bound(key) : overflow.lower_bound(key);
+        if (rank < base) {
+            // Ahead of the window: an overflow level, else the window's first
+            return const_iterator(this, IsAhead(bound) ? None : first, bound);
+        }
+        if (rank - base < Window) {
+            const std::uint32_t offset = NextOffset(static_cast<std::uint32_t>(rank - base));
+            if (offset != None) return const_iterator(this, offset, bound);
+        }
+        return const_iterator(this, None, bound);
+    }
+
+    /**
+     * Moves the window to start at rank newBase: levels that leave it go to
+     * the overflow map, overflow levels it now covers come in.
+     * O(window + levels moved * log levels).
+     */
+    void Recentre(std::int64_t newBase) {
+        if (newBase == base) return;
+        // scratch and scratchBits are clear between calls: every level is
+        // taken out of slots as it moves, so they are clear again after the swap
+        std::uint32_t count = 0;
+        std::uint32_t best = None;
+        auto place = [&](std::int64_t offset, value_type* node) {
+            scratch[static_cast<std::size_t>(offset)] = node;
+            scratchBits[static_cast<std::size_t>(offset) / 64] |= std::uint64_t{1} << (offset % 64);
+            best = std::min(best, static_cast<std::uint32_t>(offset));
+            ++count;
+        };
+        auto hint = overflow.cend();
+        for (std::size_t word = 0; word < occupied.size(); ++word) {
+            for (std::uint64_t bits = std::exchange(occupied[word], 0); bits; bits &= bits - 1) {
+                const std::size_t offset = word * 64 + static_cast<std::size_t>(std::countr_zero(bits));
+                value_type* node = std::exchange(slots[offset], nullptr);
+                const std::int64_t moved = base + static_cast<std::int64_t>(offset) - newBase;
+                if (moved >= 0 && moved < Window) {
+                    place(moved, node);
+                } else {
+                    hint = std::next(Spill(node, hint));  // Levels leave in order, so each goes after the last
+                }
+            }
+        }
+        base = newBase;
+        for (auto it = OverflowFrom(base); it != overflow.end() && Rank(it->first) - base < Window;) {
+            place(Rank(it->first) - base, it->second);
+            spareEntries.push_back(overflow.extract(it++));
+        }
+        slots.swap(scratch);
+        occupied.swap(scratchBits);
+        windowCount = count;
+        first = best;
+    }
+
+    /**
+     * Adds a level to the overflow map, reusing a map node if one is spare
+     * @param hint the position the level goes before, if known
+     */
+    typename Overflow::iterator Spill(value_type* node, typename Overflow::const_iterator hint) {
+        if (spareEntries.empty()) return overflow.emplace_hint(hint, node->first, node);
+        typename Overflow::node_type entry = std::move(spareEntries.back());
+        spareEntries.pop_back();
+        entry.key() = node->first;
+        entry.mapped() = node;
+        return overflow.insert(hint, std::move(entry));
+    }
+
+    std::vector<value_type*> slots;          // Window: level at rank base + offset, or nullptr
+    std::vector<value_type*> scratch;        // Second window buffer for re-centring
+    std::vector<std::uint64_t> occupied;     // Bit per window offset
+    std::vector<std::uint64_t> scratchBits;  // Second bitmap for re-centring
+    std::int64_t base = 0;                   // Rank of window offset 0
+    std::uint32_t first = None;              // Best occupied offset
+    std::uint32_t windowCount = 0;
+    Overflow overflow;                       // Levels outside the window, best first
+    LevelNodePool<value_type> pool;
+    std::vector<typename Overflow::node_type> spareEntries;  // Extracted overflow map nodes, reused first
+};
+
+/**
+ * B+tree Price-Level Container
+ *
+ * BTreeLevelMap is the same ordered map as HybridLevelMap, built for
+ * instruments whose levels are spread thinly over a wide price range: no
+ * window to keep dense, and no node per level to chase as in std::map.
+ *
+ * Design Notes:
+ * - Keys are stored as ranks (the price, bitwise inverted for bids) so
+ *   both sides search in ascending order
+ * - An inner node is two cache lines: 15 separator keys and the key count,
+ *   then 16 child links as 32-bit indices into the node pool
+ * - A leaf is three: 14 keys and the count, then 14 level node pointers
+ *   and the links of the ordered leaf list that iteration walks
+ * - Within a node the position of a key is found by comparing it with all
+ *   16 key slots at once (four SSE2 compares) and counting the smaller ones
+ * - A node is split when it is full and freed when it is empty, without
+ *   merging underfull siblings: books grow and shrink around the touch, so
+ *   levels soon refill them, and the tree stays as shallow as its largest
+ *   size needed
+ * - Level nodes come from a LevelNodePool, so they never move
+ *
+ * Erasing a level invalidates iterators to the levels after it in the same
+ * leaf (its return value stays valid), and inserting invalidates all.
+ */
+template <typename Key, typename Value, bool Descending>
+class BTreeLevelMap {
+    static_assert(std::is_integral_v<Key> && std::is_signed_v<Key> && sizeof(Key) == 4,
+                  "BTreeLevelMap: keys must be signed 32-bit integers");
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<Key, Value>;
+
+private:
+    static constexpr std::uint32_t LeafKeys = 14;
+    static constexpr std::uint32_t InnerKeys = 15;  // Separators; an inner node has up to 16 children
+    static constexpr std::uint32_t Null = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::size_t MaxHeight = 32;    // Each level of the tree needs a full root split
+
+    struct alignas(64) Inner {
+        std::int32_t keys[InnerKeys] = {};  // Separator i is the smallest rank under child i + 1
+        std::uint32_t count = 0;            // Separators; children = count + 1
+        std::uint32_t children[InnerKeys + 1] = {};
+    };
+
+    struct alignas(64) Leaf {
+        std::int32_t keys[LeafKeys] = {};
+        std::uint32_t count = 0;
+        std::uint32_t reserved = 0;         // Read, and masked off, by the 16-key search
+        value_type* values[LeafKeys] = {};
+        std::uint32_t next = Null;
+        std::uint32_t prev = Null;
+    };
+
+    static_assert(sizeof(Inner) == 128 && sizeof(Leaf) == 192, "BTreeLevelMap: nodes must fill whole cache lines");
+
+public:
+    template <bool Const>
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = BTreeLevelMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iterator() = default;
+
+        // A mutable iterator converts to a const one
+        template <bool OtherConst, typename = std::enable_if_t<Const && !OtherConst>>
+        Iterator(const Iterator<OtherConst>& other) : map(other.map), leaf(other.leaf), slot(other.slot) {}
+
+        reference operator*() const { return *map->leaves[leaf].values[slot]; }
+        pointer operator->() const { return map->leaves[leaf].values[slot]; }
+
+        Iterator& operator++() {
+            if (++slot == map->leaves[leaf].count) {
+                leaf = map->leaves[leaf].next;
+                slot = 0;
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const { return leaf == other.leaf && slot == other.slot; }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class BTreeLevelMap;
+        template <bool>
+        friend class Iterator;
+
+        Iterator(const BTreeLevelMap* map, std::uint32_t leaf, std::uint32_t slot) : map(map), leaf(leaf), slot(slot) {}
+
+        const BTreeLevelMap* map = nullptr;
+        std::uint32_t leaf = Null;  // Null at the end
+        std::uint32_t slot = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    BTreeLevelMap() = default;
+    BTreeLevelMap(const BTreeLevelMap&) = delete;
+    BTreeLevelMap& operator=(const BTreeLevelMap&) = delete;
+
+    bool empty() const { return count == 0; }
+    std::size_t size() const { return count; }
+
+    iterator begin() { return iterator(this, head, 0); }
+    iterator end() { return iterator(this, Null, 0); }
+    const_iterator begin() const { return const_iterator(this, head, 0); }
+    const_iterator end() const { return const_iterator(this, Null, 0); }
+
+    /**
+     * @returns the level at key, inserting an empty one if there is none
+     */
+    Value& operator[](Key key) {
+        const std::int32_t rank = Rank(key);
+        if (root == Null) {
+            root = NewLeaf();
+            head = root;
+        }
+        std::uint32_t leaf = FindLeaf(rank);
+        std::uint32_t slot = Search(leaves[leaf].keys, leaves[leaf].count, rank, false);
+        if (slot < leaves[leaf].count && leaves[leaf].keys[slot] == rank) return leaves[leaf].values[slot]->second;
+
+        if (leaves[leaf].count == LeafKeys) {
+            Path path;
+            Descend(rank, &path);
+            const std::uint32_t right = SplitLeaf(leaf);
+            if (slot > LeafKeys / 2) {
+                leaf = right;
+                slot -= LeafKeys / 2;
+            }
+            // The separator is taken after the insert, which may add right's smallest key
+            Insert(leaves[leaf], slot, rank, pool.Allocate(key));
+            AddChild(path, leaves[right].keys[0], right);
+        } else {
+            Insert(leaves[leaf], slot, rank, pool.Allocate(key));
+        }
+        ++count;
+        return leaves[leaf].values[slot]->second;
+    }
+
+    iterator find(Key key) { return Mutable(std::as_const(*this).find(key)); }
+
+    const_iterator find(Key key) const {
+        if (root == Null) return end();
+        const std::int32_t rank = Rank(key);
+        const Leaf& leaf = leaves[FindLeaf(rank)];
+        const std::uint32_t slot = Search(leaf.keys, leaf.count, rank, false);
+        if (slot == leaf.count || leaf.keys[slot] != rank) return end();
+        return const_iterator(this, static_cast<std::uint32_t>(&leaf - leaves.data()), slot);
+    }
+
+    /**
+     * @returns the first level not better than key
+     */
+    iterator lower_bound(Key key) { return Mutable(Seek(key, false)); }
+    const_iterator lower_bound(Key key) const { return Seek(key, false); }
+
+    /**
+     * @returns the first level worse than key
+     */
+    iterator upper_bound(Key key) { return Mutable(Seek(key, true)); }
+    const_iterator upper_bound(Key key) const { return Seek(key, true); }
+
+    /**
+     * Removes a level
+     * @returns the level after it
+     */
+    iterator erase(const_iterator position) {
+        Leaf& leaf = leaves[position.leaf];
+        pool.Release(leaf.values[position.slot]);
+        --count;
+        if (leaf.count > 1) {
+            std::copy(leaf.keys + position.slot + 1, leaf.keys + leaf.count, leaf.keys + position.slot);
+            std::copy(leaf.values + position.slot + 1, leaf.values + leaf.count, leaf.values + position.slot);
+            --leaf.count;
+            if (position.slot < leaf.count) return iterator(this, position.leaf, position.slot);
+            return iterator(this, leaf.next, 0);
+        }
+        const std::uint32_t next = leaf.next;
+        RemoveLeaf(position.leaf);
+        return iterator(this, next, 0);
+    }
+
+    iterator erase(const_iterator from, const_iterator to) {
+        // Erasing shifts later levels of a leaf, so count the range first
+        std::size_t levels = 0;
+        for (const_iterator it = from; it != to; ++it) ++levels;
+        iterator it = Mutable(from);
+        while (levels-- > 0) it = erase(it);
+        return it;
+    }
+
+    std::size_t erase(Key key) {
+        const_iterator it = std::as_const(*this).find(key);
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+private:
+    // Inner nodes from the root down to a leaf's parent, with the child taken from each
+    struct Path {
+        std::array<std::uint32_t, MaxHeight> nodes;
+        std::array<std::uint32_t, MaxHeight> children;
+    };
+
+    static std::int32_t Rank(Key key) { return Descending ? ~static_cast<std::int32_t>(key) : key; }
+
+    /**
+     * @returns how many of the first count keys are below rank (at or
+     * below it if inclusive); keys are sorted, so this is rank's position
+     */
+    static std::uint32_t Search(const std::int32_t* keys, std::uint32_t count, std::int32_t rank, bool inclusive) {
+#if defined(__SSE2__)
+        // Both node types keep 16 readable key slots; those past count are masked off
+        const __m128i target = _mm_set1_epi32(rank);
+        std::uint32_t mask = 0;
+        for (int lane = 0; lane < 4; ++lane) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + 4 * lane));
+            const __m128i below = inclusive ? _mm_andnot_si128(_mm_cmpgt_epi32(chunk, target), _mm_set1_epi32(-1))
+                                            : _mm_cmplt_epi32(chunk, target);
+            mask |= static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(below))) << (4 * lane);
+        }
+        return static_cast<std::uint32_t>(std::popcount(mask & ((1u << count) - 1)));
+#else
+        std::uint32_t position = 0;
+        while (position < count && (inclusive ? keys[position] <= rank : keys[position] < rank)) ++position;
+        return position;
+#endif
+    }
+
+    /**
+     * @returns the leaf whose range covers rank, recording the way down in path if given
+     */
+    std::uint32_t Descend(std::int32_t rank, Path* path) const {
+        std::uint32_t node = root;
+        for (std::size_t depth = 0; depth < height; ++depth) {
+            const Inner& inner = inners[node];
+            const std::uint32_t child = Search(inner.keys, inner.count, rank, true);
+            if (path) {
+                path->nodes[depth] = node;
+                path->children[depth] = child;
+            }
+            node = inner.children[child];
+        }
+        return node;
+    }
+
+    /**
+     * @returns the leaf whose range covers rank; most activity is at the
+     * touch, so the first leaf is tried before descending
+     */
+    std::uint32_t FindLeaf(std::int32_t rank) const {
+        const Leaf& first = leaves[head];
+        if (first.count > 0 && rank <= first.keys[first.count - 1]) return head;
+        return Descend(rank, nullptr);
+    }
+
+    const_iterator Seek(Key key, bool after) const {
+        if (root == Null) return end();
+        const std::int32_t rank = Rank(key);
+        const Leaf& leaf = leaves[FindLeaf(rank)];
+        const std::uint32_t slot = Search(leaf.keys, leaf.count, rank, after);
+        if (slot == leaf.count) return const_iterator(this, leaf.next, 0);
+        return const_iterator(this, static_cast<std::uint32_t>(&leaf - leaves.data()), slot);
+    }
+
+    iterator Mutable(const_iterator it) { return iterator(this, it.leaf, it.slot); }
+
+    static void Insert(Leaf& leaf, std::uint32_t slot, std::int32_t rank, value_type* value) {
+        std::copy_backward(leaf.keys + slot, leaf.keys + leaf.count, leaf.keys + leaf.count + 1);
+        std::copy_backward(leaf.values + slot, leaf.values + leaf.count, leaf.values + leaf.count + 1);
+        leaf.keys[slot] = rank;
+        leaf.values[slot] = value;
+        ++leaf.count;
+    }
+
+    /**
+     * Moves the upper half of a full leaf into a new leaf after it
+     * @returns the new leaf
+     */
+    std::uint32_t SplitLeaf(std::uint32_t index) {
+        const std::uint32_t right = NewLeaf();
+        Leaf& leaf = leaves[index];
+        Leaf& sibling = leaves[right];
+        constexpr std::uint32_t Keep = LeafKeys / 2;
+        std::copy(leaf.keys + Keep, leaf.keys + LeafKeys, sibling.keys);
+        std::copy(leaf.values + Keep, leaf.values + LeafKeys, sibling.values);
+        sibling.count = LeafKeys - Keep;
+        leaf.count = Keep;
+        sibling.next = leaf.next;
+        sibling.prev = index;
+        if (leaf.next != Null) leaves[leaf.next].prev = right;
+        leaf.next = right;
+        return right;
+    }
+
+    /**
+     * Adds child, whose smallest rank is separator, after the node path
+     * ends at, splitting full inner nodes on the way up
+     */
+    void AddChild(const Path& path, std::int32_t separator, std::uint32_t child) {
+        for (std::size_t depth = height; depth-- > 0;) {
+            const std::uint32_t node = path.nodes[depth];
+            const std::uint32_t at = path.children[depth];  // The new child goes after this one
+            if (inners[node].count < InnerKeys) {
+                Inner& inner = inners[node];
+                std::copy_backward(inner.keys + at, inner.keys + inner.count, inner.keys + inner.count + 1);
+                std::copy_backward(inner.children + at + 1, inner.children + inner.count + 1,
+                                   inner.children + inner.count + 2);
+                inner.keys[at] = separator;
+                inner.children[at + 1] = child;
+                ++inner.count;
+                return;
+            }
+
+            // Full: lay out all 16 separators and 17 children, keep the lower
+            // half, move the upper half to a new node and pass the middle up
+            std::array<std::int32_t, InnerKeys + 1> keys;
+            std::array<std::uint32_t, InnerKeys + 2> children;
+            const Inner& full = inners[node];
+            std::copy(full.keys, full.keys + at, keys.begin());
+            keys[at] = separator;
+            std::copy(full.keys + at, full.keys + InnerKeys, keys.begin() + at + 1);
+            std::copy(full.children, full.children + at + 1, children.begin());
+            children[at + 1] = child;
+            std::copy(full.children + at + 1, full.children + InnerKeys + 1, children.begin() + at + 2);
+
+            const std::uint32_t right = NewInner();
+            Inner& inner = inners[node];
+            Inner& sibling = inners[right];
+            constexpr std::uint32_t Keep = (InnerKeys + 1) / 2;
+            std::copy(keys.begin(), keys.begin() + Keep, inner.keys);
+            std::copy(children.begin(), children.begin() + Keep + 1, inner.children);
+            inner.count = Keep;
+            std::copy(keys.begin() + Keep + 1, keys.end(), sibling.keys);
+            std::copy(children.begin() + Keep + 1, children.end(), sibling.children);
+            sibling.count = InnerKeys - Keep;
+            separator = keys[Keep];
+            child = right;
+        }
+
+        const std::uint32_t top = NewInner();
+        Inner& inner = inners[top];
+        inner.keys[0] = separator;
+        inner.children[0] = root;
+        inner.children[1] = child;
+        inner.count = 1;
+        root = top;
+        ++height;
+    }
+
+    /**
+     * Unlinks an emptied leaf and frees it, and then each ancestor left
+     * without children
+     */
+    void RemoveLeaf(std::uint32_t index) {
+        Path path;
+        if (height > 0) Descend(leaves[index].keys[0], &path);  // The leaf still holds its last key
+
+        Leaf& leaf = leaves[index];
+        if (leaf.prev != Null) leaves[leaf.prev].next = leaf.next;
+        if (leaf.next != Null) leaves[leaf.next].prev = leaf.prev;
+        if (head == index) head = leaf.next;
+        leaf = Leaf{};
+        freeLeaves.push_back(index);
+
+        std::size_t depth = height;
+        while (depth-- > 0) {
+            Inner& inner = inners[path.nodes[depth]];
+            if (inner.count > 0) {
+                // Drop the child and a separator next to it; its range joins a neighbour's
+                const std::uint32_t at = path.children[depth];
+                const std::uint32_t key = at > 0 ? at - 1 : 0;
+                std::copy(inner.keys + key + 1, inner.keys + inner.count, inner.keys + key);
+                std::copy(inner.children + at + 1, inner.children + inner.count + 1, inner.children + at);
+                --inner.count;
+                break;
+            }
+            inner = Inner{};
+            freeInners.push_back(path.nodes[depth]);
+        }
+        if (depth == static_cast<std::size_t>(-1)) {
+            root = Null;  // Every node on the path is gone, so the tree was this one leaf
+            height = 0;
+            return;
+        }
+        while (height > 0 && inners[root].count == 0) {
+            // A root with one child adds nothing
+            const std::uint32_t child = inners[root].children[0];
+            inners[root] = Inner{};
+            freeInners.push_back(root);
+            root = child;
+            --height;
+        }
+    }
+
+    std::uint32_t NewLeaf() {
+        if (!freeLeaves.empty()) {
+            const std::uint32_t index = freeLeaves.back();
+            freeLeaves.pop_back();
+            return index;
+        }
+        leaves.emplace_back();
+        return static_cast<std::uint32_t>(leaves.size() - 1);
+    }
+
+    std::uint32_t NewInner() {
+        if (!freeInners.empty()) {
+            const std::uint32_t index = freeInners.back();
+            freeInners.pop_back();
+            return index;
+        }
+        inners.emplace_back();
+        return static_cast<std::uint32_t>(inners.size() - 1);
+    }
+
+    std::vector<Leaf> leaves;
+    std::vector<Inner> inners;
+    std::vector<std::uint32_t> freeLeaves;
+    std::vector<std::uint32_t> freeInners;
+    std::uint32_t root = Null;
+    std::uint32_t head = Null;  // First leaf, holding the best level
+    std::size_t height = 0;     // Inner node levels above the leaves
+    std::size_t count = 0;
+    LevelNodePool<value_type> pool;
+};
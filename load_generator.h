@@ -0,0 +1,249 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "latency_recorder.h"
+#include "protocol.h"
+
+/**
+ * LoadGenerator drives a Gateway over TCP and measures round-trip latency
+ * (request sent -> Ack/CancelAck/Reject received) per request.
+ *
+ * Each connection keeps a fixed window of requests in flight. The send
+ * timestamp travels in clientTag, so no per-request bookkeeping is needed.
+ * Prices straddle a common mid so that a large share of orders cross and
+ * the book stays bounded; a fraction of requests cancel earlier orders.
+ */
+
+struct LoadGeneratorConfig {
+    std::string host = "127.0.0.1";
+    std::uint16_t port = 9000;
+    std::size_t connections = 4;
+    std::size_t requestsPerConnection = 100000;
+    std::size_t window = 16;            // In-flight requests per connection
+    std::uint32_t cancelEvery = 4;      // Every Nth request is a cancel (0 disables)
+    std::uint32_t seed = 42;
+};
+
+struct LoadReport {
+    std::uint64_t requests = 0;
+    std::uint64_t acks = 0;
+    std::uint64_t rejects = 0;
+    std::uint64_t fills = 0;
+    double seconds = 0;
+    LatencyRecorder roundTrip;
+
+    void Print(std::ostream& out) {
+        out << "requests=" << requests << " acks=" << acks << " rejects=" << rejects
+            << " fills=" << fills << " seconds=" << seconds
+            << " throughput=" << (seconds > 0 ? static_cast<double>(requests) / seconds : 0) << " req/s\n";
+        out << "round trip: ";
+        roundTrip.Print(out);
+    }
+};
+
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const LoadGeneratorConfig& config) : config(config), random(config.seed) {}
+
+    LoadReport Run() {
+        LoadReport report;
+        report.roundTrip = LatencyRecorder(config.connections * config.requestsPerConnection);
+
+        std::vector<Connection> connections(config.connections);
+        std::vector<pollfd> pollFds(config.connections);
+        for (std::size_t i = 0; i < connections.size(); ++i) {
+            connections[i].fd = Connect();
+            connections[i].index = i;
+            pollFds[i] = pollfd{connections[i].fd, POLLIN, 0};
+        }
+
+        const std::uint64_t start = NowNanos();
+        for (Connection& c : connections) FillWindow(c, report);
+
+        std::size_t finished = 0;
+        while (finished < connections.size()) {
+            if (poll(pollFds.data(), pollFds.size(), 1000) < 0 && errno != EINTR) {
+                throw std::runtime_error("LoadGenerator: poll failed: " + std::string(std::strerror(errno)));
+            }
+            for (std::size_t i = 0; i < connections.size(); ++i) {
+                if (!(pollFds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                Connection& c = connections[i];
+                if (!Receive(c, report)) {
+                    throw std::runtime_error("LoadGenerator: gateway closed the connection");
+                }
+                FillWindow(c, report);
+                if (c.done) continue;
+                if (c.sent == config.requestsPerConnection && c.inFlight == 0) {
+                    c.done = true;
+                    ++finished;
+                }
+            }
+        }
+        report.seconds = static_cast<double>(NowNanos() - start) / 1e9;
+
+        for (Connection& c : connections) close(c.fd);
+        return report;
+    }
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::size_t index = 0;
+        std::size_t sent = 0;
+        std::size_t inFlight = 0;
+        bool done = false;
+        std::vector<OrderId> recentOrders;  // Candidates for cancellation
+        std::vector<char> input = std::vector<char>(1 << 16);
+        std::size_t inputEnd = 0;
+    };
+
+    int Connect() {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw std::runtime_error("LoadGenerator: socket() failed");
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config.port);
+        if (inet_pton(AF_INET, config.host.c_str(), &addr.sin_addr) != 1 ||
+            connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close(fd);
+            throw std::runtime_error("LoadGenerator: cannot connect to " + config.host + ":" +
+                                     std::to_string(config.port));
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return fd;
+    }
+
+    /**
+     * Tops the connection up to `window` requests in flight with one send()
+     */
+    void FillWindow(Connection& c, LoadReport& report) {
+        char batch[MaxMessageSize * 64];
+        std::size_t length = 0;
+        while (c.inFlight < config.window && c.sent < config.requestsPerConnection &&
+               length + MaxMessageSize <= sizeof(batch)) {
+            length += EncodeNextRequest(c, batch + length);
+            ++c.sent;
+            ++c.inFlight;
+            ++report.requests;
+        }
+        SendAll(c.fd, batch, length);
+    }
+
+    std::size_t EncodeNextRequest(Connection& c, char* out) {
+        const std::uint64_t now = NowNanos();
+        // Order ids are unique across connections: connection index in the top bits
+        const OrderId id = (static_cast<OrderId>(c.index + 1) << 40) | c.sent;
+
+        if (config.cancelEvery != 0 && c.sent % config.cancelEvery == config.cancelEvery - 1 &&
+            !c.recentOrders.empty()) {
+            auto m = MakeMessage<CancelOrderMessage>();
+            m.clientTag = now;
+            m.orderId = c.recentOrders[random() % c.recentOrders.size()];
+            std::memcpy(out, &m, sizeof(m));
+            return sizeof(m);
+        }
+
+        auto m = MakeMessage<NewOrderMessage>();
+        m.clientTag = now;
+        m.orderId = id;
+        m.side = static_cast<std::uint8_t>(random() & 1);
+        m.orderType = (random() % 8 == 0) ? 1 : 0;
+        // Buys skew up and sells skew down so that roughly half of them cross
+        const Price offset = static_cast<Price>(random() % 5);
+        m.price = m.side == 0 ? 98 + offset : 102 - offset;
+        m.quantity = 1 + random() % 100;
+        std::memcpy(out, &m, sizeof(m));
+
+        if (c.recentOrders.size() < 64) {
+            c.recentOrders.push_back(id);
+        } else {
+            c.recentOrders[random() % c.recentOrders.size()] = id;
+        }
+        return sizeof(m);
+    }
+
+    static void SendAll(int fd, const char* data, std::size_t length) {
+        while (length > 0) {
+            ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("LoadGenerator: send failed: " + std::string(std::strerror(errno)));
+            }
+            data += n;
+            length -= static_cast<std::size_t>(n);
+        }
+    }
+
+    /**
+     * Reads whatever is available and consumes complete response frames
+     * @returns false if the peer closed the connection
+     */
+    bool Receive(Connection& c, LoadReport& report) {
+        ssize_t n = recv(c.fd, c.input.data() + c.inputEnd, c.input.size() - c.inputEnd, MSG_DONTWAIT);
+        if (n == 0) return false;
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        c.inputEnd += static_cast<std::size_t>(n);
+
+        const std::uint64_t now = NowNanos();
+        std::size_t offset = 0;
+        while (c.inputEnd - offset >= sizeof(MessageHeader)) {
+            MessageHeader header;
+            std::memcpy(&header, c.input.data() + offset, sizeof(header));
+            if (c.inputEnd - offset < header.length) break;
+            if (header.length < sizeof(MessageHeader)) return false;
+
+            const char* frame = c.input.data() + offset;
+            switch (header.type) {
+            case MessageType::Ack:
+            case MessageType::CancelAck: {
+                AckMessage m;  // CancelAckMessage has the same layout
+                std::memcpy(&m, frame, sizeof(m));
+                report.roundTrip.Record(now - m.clientTag);
+                ++report.acks;
+                --c.inFlight;
+                break;
+            }
+            case MessageType::Reject: {
+                RejectMessage m;
+                std::memcpy(&m, frame, sizeof(m));
+                report.roundTrip.Record(now - m.clientTag);
+                ++report.rejects;
+                --c.inFlight;
+                break;
+            }
+            case MessageType::Fill:
+                ++report.fills;
+                break;
+            default:
+                break;
+            }
+            offset += header.length;
+        }
+        std::memmove(c.input.data(), c.input.data() + offset, c.inputEnd - offset);
+        c.inputEnd -= offset;
+        return true;
+    }
+
+    LoadGeneratorConfig config;
+    std::mt19937_64 random;
+};
+
+#endif  // __linux__
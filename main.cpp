@@ -1,501 +1,2490 @@
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <map>
-#include <set>
-#include <list>
-#include <cmath>
-#include <ctime>
-#include <deque>
-#include <queue>
-#include <stack>
-#include <limits>
-#include <string>
-#include <vector>
-#include <numeric>
-#include <algorithm>
-#include <unordered_map>
-#include <memory>
-#include <variant>
-#include <optional>
-#include <tuple>
-#include <iostream>
+#include <random>
 #include <sstream>
 #include <string>
 #include <memory>
+#include <thread>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if defined(__linux__)
+#include <sys/wait.h>
+#endif
+
+#include "order_book.h"
+#include "backtest.h"
+#include "backtest_runner.h"
+#include "engine_scheduler.h"
+#include "fix_acceptor.h"
+#include "fix_protocol.h"
+#include "gateway.h"
+#include "itch_feed.h"
+#include "journal.h"
+#include "latency_recorder.h"
+#include "load_generator.h"
+#include "pipeline.h"
+#include "shm_transport.h"
+#include "text_command.h"
+#include "trade_analytics.h"
+#include "uring_gateway.h"
 
 /**
- * OrderBook System Architecture
- * 
- * This implementation represents a limit order book system commonly used in financial trading.
- * The system maintains two primary order lists:
- * 1. Bids (buy orders) - sorted in descending order by price
- * 2. Asks (sell orders) - sorted in ascending order by price
- * 
- * Key Components:
- * - Order matching engine with price-time priority
- * - Support for GoodTilCancel and FillAndKill order types
- * - Real-time order book level information
- * - Order modification and cancellation capabilities
- * 
- * Performance Considerations:
- * - Uses std::map for price levels (O(log n) for insertions/deletions)
- * - Uses std::list for orders at each price level (O(1) for insertions/deletions)
- * - Uses std::unordered_map for order lookup by ID (O(1) average case)
- */
-
-enum class OrderType {
-    GoodTilCancel,
-    FillAndKill
-};
+ * Looks up "--name value" on the command line
+ * @returns the value, or fallback if the option is absent
+ */
+static std::string GetOption(int argc, char* argv[], const std::string& name, const std::string& fallback) {
+    for (int i = 2; i + 1 < argc; ++i) {
+        if (name == argv[i]) return argv[i + 1];
+    }
+    return fallback;
+}
+
+static std::uint64_t GetNumericOption(int argc, char* argv[], const std::string& name, std::uint64_t fallback) {
+    return std::stoull(GetOption(argc, argv, name, std::to_string(fallback)));
+}
 
 /**
- * Side indicates whether the order is a buy or sell order
+ * One step of a random order flow around a mid price of 1000: 30% cancels of
+ * live orders, the rest adds that often cross (10% of them FillAndKill)
  */
-enum class Side {
-    Buy,
-    Sell
-};
+static Command MakeRandomCommand(std::mt19937_64& random, std::vector<OrderId>& live, std::uint64_t i) {
+    Command command{};
+    const int kind = static_cast<int>(random() % 10);
+    if (kind < 3 && !live.empty()) {
+        const std::size_t index = random() % live.size();
+        command.type = CommandType::Cancel;
+        command.orderId = live[index];
+        live[index] = live.back();
+        live.pop_back();
+    } else {
+        command.type = CommandType::Add;
+        command.orderType = kind == 9 ? OrderType::FillAndKill : OrderType::GoodTilCancel;
+        command.side = (random() & 1) ? Side::Buy : Side::Sell;
+        command.orderId = i + 1;
+        command.price = 1000 + static_cast<Price>(random() % 20) - (command.side == Side::Buy ? 12 : 8);
+        command.quantity = 1 + random() % 100;
+        if (command.orderType == OrderType::GoodTilCancel) live.push_back(command.orderId);
+    }
+    return command;
+}
 
-// Type aliases for better code readability and maintenance
-using Price = std::int32_t;     // Signed integer for price to allow for negative values
-using Quantity = std::uint64_t;  // Unsigned integer for quantity (cannot be negative)
-using OrderId = std::uint64_t;   // Unique identifier for orders
+#if defined(__linux__)
+template <typename GatewayType>
+static GatewayType* runningGateway = nullptr;
+
+static void PrintGatewayStats(const GatewayStats& stats) {
+    std::cout << "sessions=" << stats.sessionsAccepted << " commands=" << stats.commandsIn
+              << " events=" << stats.eventsOut << " malformed=" << stats.malformed
+              << " disconnectCancels=" << stats.disconnectCancels << " slowReaders=" << stats.slowReaders
+              << " syscalls=" << stats.syscalls << " syscalls/command="
+              << (stats.commandsIn ? static_cast<double>(stats.syscalls) / static_cast<double>(stats.commandsIn) : 0)
+              << "\n";
+}
+
+template <typename GatewayType>
+static int ServeGateway(const GatewayConfig& config) {
+    GatewayType gateway(config);
+    runningGateway<GatewayType> = &gateway;
+    std::signal(SIGINT, [](int) { runningGateway<GatewayType>->Stop(); });
+    std::signal(SIGTERM, [](int) { runningGateway<GatewayType>->Stop(); });
+
+    std::cout << "Gateway listening on " << config.bindAddress << ":" << gateway.GetPort() << "\n";
+    gateway.Run();
+
+    std::cout << "Gateway stopped. ";
+    PrintGatewayStats(gateway.GetStats());
+    return 0;
+}
+
+static IoBackend ParseIoBackend(const std::string& name) {
+    if (name == "epoll") return IoBackend::Epoll;
+    if (name == "uring") return IoBackend::IoUring;
+    throw std::invalid_argument("unknown I/O backend '" + name + "' (expected epoll or uring)");
+}
+
+static GatewayConfig ParseGatewayConfig(int argc, char* argv[]) {
+    GatewayConfig config;
+    config.backend = ParseIoBackend(GetOption(argc, argv, "--io", "epoll"));
+    config.bindAddress = GetOption(argc, argv, "--bind", config.bindAddress);
+    config.port = static_cast<std::uint16_t>(GetNumericOption(argc, argv, "--port", config.port));
+    config.journalPath = GetOption(argc, argv, "--journal", config.journalPath);
+    config.marketDataAddress = GetOption(argc, argv, "--market-data", config.marketDataAddress);
+    config.marketDataPort = static_cast<std::uint16_t>(GetNumericOption(argc, argv, "--md-port", config.marketDataPort));
+    config.retransmitPort =
+        static_cast<std::uint16_t>(GetNumericOption(argc, argv, "--retransmit-port", config.retransmitPort));
+    config.dropCopyName = GetOption(argc, argv, "--drop-copy", config.dropCopyName);
+    config.cancelOnDisconnect = GetNumericOption(argc, argv, "--cancel-on-disconnect", 1) != 0;
+    config.maxPendingOutput = GetNumericOption(argc, argv, "--max-pending-output", config.maxPendingOutput);
+    return config;
+}
 
 /**
- * LevelInfo represents aggregated information for a price level
- * Contains the price and total quantity of all orders at that price
+ * Runs the TCP order-entry gateway until SIGINT/SIGTERM
+ * Usage: main gateway [--io epoll|uring] [--bind <address>] [--port <port>] [--journal <path>]
+ *                     [--market-data <address> [--md-port <port>] [--retransmit-port <port>]]
+ *                     [--cancel-on-disconnect 0|1] [--max-pending-output <bytes>]
  */
-struct LevelInfo {
-    Price price;
-    Quantity quantity;
+static int RunGateway(int argc, char* argv[]) {
+    GatewayConfig config = ParseGatewayConfig(argc, argv);
+    if (config.backend == IoBackend::IoUring) return ServeGateway<UringGateway>(config);
+    return ServeGateway<Gateway>(config);
+}
 
-    LevelInfo(Price p, Quantity q) : price(p), quantity(q) {}
-};
+static LoadGeneratorConfig ParseLoadGeneratorConfig(int argc, char* argv[]) {
+    LoadGeneratorConfig config;
+    config.host = GetOption(argc, argv, "--host", config.host);
+    config.port = static_cast<std::uint16_t>(GetNumericOption(argc, argv, "--port", config.port));
+    config.connections = GetNumericOption(argc, argv, "--connections", config.connections);
+    config.requestsPerConnection = GetNumericOption(argc, argv, "--requests", config.requestsPerConnection);
+    config.window = GetNumericOption(argc, argv, "--window", config.window);
+    return config;
+}
+
+/**
+ * Runs an in-process gateway on an ephemeral loopback port, drives it with
+ * the load generator and reports throughput, latency and gateway-side
+ * syscalls per command
+ */
+template <typename GatewayType>
+static void BenchmarkGateway(const char* name, GatewayConfig config, LoadGeneratorConfig load) {
+    config.bindAddress = "127.0.0.1";
+    config.port = 0;
+    GatewayType gateway(config);
+    load.host = config.bindAddress;
+    load.port = gateway.GetPort();
 
-using LevelInfos = std::vector<LevelInfo>;
+    std::thread server([&gateway] { gateway.Run(); });
+    LoadReport report = LoadGenerator(load).Run();
+    gateway.Stop();
+    server.join();
+
+    std::cout << "== " << name << " ==\n";
+    report.Print(std::cout);
+    PrintGatewayStats(gateway.GetStats());
+}
 
 /**
- * OrderbookLevelInfos provides a snapshot of the entire order book
- * Contains vectors of LevelInfo for both bid and ask sides
+ * Compares the epoll and io_uring backends under identical load
+ * Usage: main gatewaybench [--journal <path>] [--connections <n>] [--requests <n>] [--window <n>]
  */
-class OrderbookLevelInfos {
-public:
-    OrderbookLevelInfos(const LevelInfos& bids, const LevelInfos& asks) 
-        : bids(bids), asks(asks) {}
+static int RunGatewayBenchmark(int argc, char* argv[]) {
+    GatewayConfig config = ParseGatewayConfig(argc, argv);
+    LoadGeneratorConfig load = ParseLoadGeneratorConfig(argc, argv);
+    BenchmarkGateway<Gateway>("epoll", config, load);
+    BenchmarkGateway<UringGateway>("io_uring", config, load);
+    return 0;
+}
 
-    const LevelInfos& GetBids() const { return bids; }
-    const LevelInfos& GetAsks() const { return asks; }
+/**
+ * Rebuilds the book from a gateway journal and prints its final state
+ * Usage: main replay <journal>
+ */
+static int RunJournalReplay(int argc, char* argv[]) {
+    if (argc < 3) throw std::invalid_argument("usage: replay <journal>");
+    MatchingEngine engine;
+    std::uint64_t events = 0;
+    std::size_t records = Journal::Replay(argv[2], [&](const JournalRecord& record) {
+        engine.Process(record.command, [&](const Event&) { ++events; });
+    });
+    std::cout << "Replayed " << records << " commands (" << events << " events). Resting orders: "
+              << engine.GetBook().Size() << "\n";
+    return 0;
+}
 
-private:
-    LevelInfos bids;  // Bid price levels sorted high to low
-    LevelInfos asks;  // Ask price levels sorted low to high
-};
+/**
+ * Drives a running gateway and reports round-trip latency percentiles
+ * Usage: main loadgen [--host <address>] [--port <port>] [--connections <n>]
+ *                     [--requests <n per connection>] [--window <n>]
+ */
+static int RunLoadGenerator(int argc, char* argv[]) {
+    LoadGenerator generator(ParseLoadGeneratorConfig(argc, argv));
+    LoadReport report = generator.Run();
+    report.Print(std::cout);
+    return 0;
+}
+static MarketDataConfig ParseMarketDataConfig(int argc, char* argv[]) {
+    MarketDataConfig config;
+    config.address = GetOption(argc, argv, "--group", config.address);
+    config.port = static_cast<std::uint16_t>(GetNumericOption(argc, argv, "--md-port", config.port));
+    config.retransmitAddress = GetOption(argc, argv, "--retransmit-host", config.retransmitAddress);
+    config.retransmitPort =
+        static_cast<std::uint16_t>(GetNumericOption(argc, argv, "--retransmit-port", config.retransmitPort));
+    return config;
+}
 
 /**
- * Order class represents a single order in the system
- * Contains all essential order information and methods to manage its lifecycle
+ * Prints a market-data feed (e.g. from gateway --market-data) until interrupted
+ * Usage: main mdlisten [--group <address>] [--md-port <port>] [--retransmit-host <address>] [--retransmit-port <port>]
  */
-class Order {
-public:
-    Order(OrderType type, OrderId id, Side s, Price p, Quantity q) 
-        : orderType(type), orderId(id), side(s), price(p),
-          initialQuantity(q), remainingQuantity(q) {}
-
-    // Getters for order properties
-    OrderId GetOrderId() const { return orderId; }
-    Side GetSide() const { return side; }
-    Price GetPrice() const { return price; }
-    OrderType GetOrderType() const { return orderType; }
-    Quantity GetInitialQuantity() const { return initialQuantity; }
-    Quantity GetRemainingQuantity() const { return remainingQuantity; }
-    Quantity GetFilledQuantity() const { return initialQuantity - remainingQuantity; }
-    bool IsFilled() const { return remainingQuantity == 0; }
+static int RunMarketDataListener(int argc, char* argv[]) {
+    const MarketDataConfig config = ParseMarketDataConfig(argc, argv);
+    MarketDataReceiver receiver(config, config.retransmitPort);
+    std::cout << "Listening for market data on " << config.address << ":" << config.port << "\n";
+    while (true) {
+        std::size_t delivered = receiver.Poll([&](const MarketDataMessage& message) {
+            const char* side = message.side == 0 ? "BUY" : "SELL";
+            if (message.type == MarketDataType::Trade) {
+                std::cout << receiver.GetExpectedSequence() << " TRADE " << message.quantity << "@" << message.price
+                          << " aggressor=" << side << "\n";
+            } else {
+                std::cout << receiver.GetExpectedSequence() << " LEVEL " << side << " " << message.price
+                          << " qty=" << message.quantity << "\n";
+            }
+        });
+        if (delivered == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
 
-    /**
-     * Fill a portion of the order
-     * @throws std::runtime_error if fill quantity exceeds remaining quantity
-     */
-    void Fill(Quantity quantity) {
-        if (quantity > remainingQuantity) {
-            throw std::runtime_error(
-                "Order (" + std::to_string(orderId) + 
-                ") cannot be filled for more than its remaining quantity.");
+/**
+ * Drives a MatchingEngine with random orders while publishing its market
+ * data over UDP to a receiver thread in the same process. Reports publish
+ * rate and packet efficiency, gap recovery on the receiver, and checks the
+ * depth rebuilt from the feed against the engine's book.
+ * Usage: main mdbench [--commands <n>] [--batch <commands per flush>] [--group <address>] [--md-port <port>]
+ */
+static int RunMarketDataBenchmark(int argc, char* argv[]) {
+    MarketDataConfig config = ParseMarketDataConfig(argc, argv);
+    config.retransmitPort = 0;
+    const std::uint64_t commands = GetNumericOption(argc, argv, "--commands", 2000000);
+    const std::uint64_t batch = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--batch", 64), 1);
+
+    MarketDataPublisher publisher(config);
+    MarketDataReceiver receiver(config, publisher.GetRetransmitPort());
+    std::atomic<std::uint64_t> target{0};    // Set once publishing is done
+    std::atomic<std::uint64_t> progress{0};  // Receiver's next expected sequence; only the consumer touches it
+    std::map<Price, Quantity> bids, asks;
+    std::thread consumer([&] {
+        while (true) {
+            const std::uint64_t done = target.load(std::memory_order_acquire);
+            if (done != 0 && receiver.GetExpectedSequence() >= done) return;
+            std::size_t delivered = receiver.Poll([&](const MarketDataMessage& message) {
+                if (message.type != MarketDataType::Level) return;
+                auto& levels = message.side == 0 ? bids : asks;
+                if (message.quantity == 0) {
+                    levels.erase(message.price);
+                } else {
+                    levels[message.price] = message.quantity;
+                }
+            });
+            progress.store(receiver.GetExpectedSequence(), std::memory_order_release);
+            if (delivered == 0) std::this_thread::yield();
+        }
+    });
+
+    MatchingEngine engine;
+    std::mt19937_64 random(11);
+    std::vector<OrderId> live;
+    auto ignore = [](const Event&) {};
+    const std::uint64_t start = NowNanos();
+    for (std::uint64_t i = 0; i < commands; ++i) {
+        engine.Process(MakeRandomCommand(random, live, i), ignore, publisher);
+        if ((i + 1) % batch == 0) {
+            publisher.Flush();
+            publisher.ServiceRetransmissions();
         }
-        remainingQuantity -= quantity;
     }
+    publisher.Flush();
+    const double seconds = static_cast<double>(NowNanos() - start) / 1e9;
 
-private:
-    OrderType orderType;
-    OrderId orderId;
-    Side side;
-    Price price;
-    Quantity initialQuantity;
-    Quantity remainingQuantity;
-};
+    // Let the receiver catch up, answering its gap fills
+    target.store(publisher.GetNextSequence(), std::memory_order_release);
+    const std::uint64_t deadline = NowNanos() + 5'000'000'000ULL;
+    while (progress.load(std::memory_order_acquire) < publisher.GetNextSequence() && NowNanos() < deadline) {
+        if (publisher.ServiceRetransmissions() == 0) std::this_thread::yield();
+    }
+    if (progress.load(std::memory_order_acquire) < publisher.GetNextSequence()) {
+        target.store(1, std::memory_order_release);  // Release the consumer
+    }
+    consumer.join();
+    const bool caughtUp = receiver.GetExpectedSequence() >= publisher.GetNextSequence();
+
+    const MarketDataStats& stats = publisher.GetStats();
+    const MarketDataReceiverStats& received = receiver.GetStats();
+    constexpr double UdpIpHeaderBytes = 28;
+    const double packets = static_cast<double>(stats.packets ? stats.packets : 1);
+    std::cout << "commands=" << commands << " events=" << stats.messages << " seconds=" << seconds
+              << " events/sec=" << static_cast<std::uint64_t>(static_cast<double>(stats.messages) / seconds) << "\n"
+              << "packets=" << stats.packets << " events/packet=" << static_cast<double>(stats.messages) / packets
+              << " bytes/packet=" << static_cast<double>(stats.bytes) / packets << " payload efficiency="
+              << static_cast<double>(stats.messages * sizeof(MarketDataMessage)) /
+                     (static_cast<double>(stats.bytes) + UdpIpHeaderBytes * packets)
+              << " sendErrors=" << stats.sendErrors << "\n"
+              << "receiver: delivered=" << received.messages << " gaps=" << received.gaps
+              << " requests=" << received.requests << " retransmitted=" << stats.retransmittedMessages
+              << " lost=" << received.lostMessages << " duplicates=" << received.duplicates << "\n";
+
+    OrderbookLevelInfos book = engine.GetBook().GetOrderInfos();
+    auto matches = [](const LevelInfos& expected, const std::map<Price, Quantity>& actual) {
+        if (expected.size() != actual.size()) return false;
+        for (const LevelInfo& level : expected) {
+            auto it = actual.find(level.price);
+            if (it == actual.end() || it->second != level.quantity) return false;
+        }
+        return true;
+    };
+    const bool consistent = caughtUp && matches(book.GetBids(), bids) && matches(book.GetAsks(), asks);
+    std::cout << "rebuilt depth " << (consistent ? "matches" : "DOES NOT match") << " the engine book ("
+              << book.GetBids().size() << " bid / " << book.GetAsks().size() << " ask levels)\n";
+    return consistent ? 0 : 1;
+}
 
-// Smart pointer aliases for memory management
-using OrderPtr = std::shared_ptr<Order>;
-using OrderList = std::list<OrderPtr>;
+static volatile std::sig_atomic_t dropCopyStopped = 0;
 
 /**
- * OrderModify represents a request to modify an existing order
- * Used to change price or quantity of an existing order
+ * Prints the drop-copy stream of a gateway started with --drop-copy until interrupted
+ * Usage: main dropcopy [--name <region name in /dev/shm>] [--consumer <label>]
  */
-class OrderModify {
-public:
-    OrderModify(OrderId id, Side s, Price p, Quantity q) 
-        : orderId(id), side(s), price(p), quantity(q) {}
+static int RunDropCopyListener(int argc, char* argv[]) {
+    DropCopyConsumer consumer(GetOption(argc, argv, "--name", "orderbook-dropcopy"),
+                              GetOption(argc, argv, "--consumer", "dropcopy"));
+    std::signal(SIGINT, [](int) { dropCopyStopped = 1; });
+    std::signal(SIGTERM, [](int) { dropCopyStopped = 1; });
+    while (!dropCopyStopped) {
+        std::size_t handled = consumer.Poll([](const ExecutionReport& report) {
+            std::cout << report.matchId << " session=" << report.session << " order=" << report.orderId
+                      << (report.side == Side::Buy ? " BUY " : " SELL ") << report.quantity << "@" << report.price
+                      << " contra=" << report.contraOrderId << (report.aggressor ? " aggressor" : "") << "\n";
+        });
+        if (handled == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::cout << "missed=" << consumer.GetMissed() << "\n";
+    return 0;
+}
 
-    OrderId GetOrderId() const { return orderId; }
-    Side GetSide() const { return side; }
-    Price GetPrice() const { return price; }
-    Quantity GetQuantity() const { return quantity; }
+static std::uint64_t ThreadCpuNanos() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1'000'000'000ULL + static_cast<std::uint64_t>(ts.tv_nsec);
+}
 
-    /**
-     * Creates a new Order object with modified parameters
-     */
-    OrderPtr ToOrderPtr(OrderType type) const {
-        return std::make_shared<Order>(type, orderId, side, price, quantity);
+/**
+ * Measures what the drop copy costs the matching thread: the same random
+ * order flow is matched without it, with it and no readers, and with
+ * --consumers reader threads (one of them deliberately slow with --slow).
+ * Cost is the matching thread's CPU time, which readers cannot inflate.
+ * Usage: main dropcopybench [--commands <n>] [--consumers <n>] [--slow 0|1]
+ */
+static int RunDropCopyBenchmark(int argc, char* argv[]) {
+    const std::uint64_t commands = GetNumericOption(argc, argv, "--commands", 2000000);
+    const std::size_t consumerCount = GetNumericOption(argc, argv, "--consumers", 3);
+    const bool withSlowConsumer = GetNumericOption(argc, argv, "--slow", 1) != 0;
+    const std::string name = "orderbook-dropcopy-bench-" + std::to_string(getpid());
+
+    // @returns matching-thread CPU nanoseconds per command
+    auto match = [&](ExecutionReportRing* ring) {
+        MatchingEngine engine;
+        engine.SetDropCopy(ring);
+        std::mt19937_64 random(11);
+        std::vector<OrderId> live;
+        auto ignore = [](const Event&) {};
+        const std::uint64_t start = ThreadCpuNanos();
+        for (std::uint64_t i = 0; i < commands; ++i) engine.Process(MakeRandomCommand(random, live, i), ignore);
+        return static_cast<double>(ThreadCpuNanos() - start) / static_cast<double>(commands);
+    };
+
+    const double baseline = match(nullptr);
+    DropCopyPublisher publisher(name);
+    const double unread = match(&publisher.GetRing());
+
+    struct Reader {
+        std::uint64_t reports = 0;
+        std::uint64_t quantity = 0;
+        std::uint64_t missed = 0;
+    };
+    std::vector<Reader> readers(consumerCount + (withSlowConsumer ? 1 : 0));
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> attached{0};
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+        threads.emplace_back([&, i] {
+            const bool slow = i == consumerCount;
+            DropCopyConsumer consumer(name, slow ? "slow" : "reader-" + std::to_string(i));
+            attached.fetch_add(1);
+            Reader& reader = readers[i];
+            auto count = [&](const ExecutionReport& report) {
+                ++reader.reports;
+                reader.quantity += report.quantity;
+            };
+            while (!done.load(std::memory_order_acquire)) {
+                if (consumer.Poll(count) == 0) std::this_thread::yield();
+                if (slow) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            while (consumer.Poll(count) > 0) {}
+            reader.missed = consumer.GetMissed();
+        });
     }
+    while (attached.load() < readers.size()) std::this_thread::yield();
 
-private:
-    OrderId orderId;
-    Side side;
-    Price price;
-    Quantity quantity;
-};
+    const std::uint64_t first = publisher.GetRing().GetCursor();
+    const double read = match(&publisher.GetRing());
+    const std::uint64_t published = publisher.GetRing().GetCursor() - first;
+    const std::vector<DropCopyConsumerStatus> status = publisher.GetConsumers();
+    done.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) thread.join();
+
+    std::cout << "commands=" << commands << " reports=" << published << " matching CPU ns/command: without="
+              << baseline << " unread=" << unread << " with " << readers.size() << " consumers=" << read << "\n";
+    for (const DropCopyConsumerStatus& consumer : status) {
+        std::cout << consumer.name << ": lag=" << consumer.lag << " missed=" << consumer.missed
+                  << (consumer.slow ? " SLOW" : "") << "\n";
+    }
+    bool complete = true;
+    for (std::size_t i = 0; i < consumerCount; ++i) {
+        complete = complete && readers[i].reports == published && readers[i].quantity == readers[0].quantity;
+    }
+    if (withSlowConsumer) {
+        const Reader& slow = readers.back();
+        std::cout << "slow consumer read " << slow.reports << " and was overrun for " << slow.missed << " of "
+                  << published << " reports\n";
+    }
+    std::cout << "fast consumers " << (complete ? "received every report" : "LOST reports") << "\n";
+    return complete ? 0 : 1;
+}
+
+static ShmServer* runningShmServer = nullptr;
 
 /**
- * TradeInfo represents one side of a trade (either buy or sell)
- * Contains the order ID, executed price, and quantity
+ * Serves co-located clients over shared memory until SIGINT/SIGTERM
+ * Usage: main shm-server [--name <region name in /dev/shm>]
  */
-struct TradeInfo {
-    OrderId orderId;
-    Price price;
-    Quantity quantity;
+static int RunShmServer(int argc, char* argv[]) {
+    const std::string name = GetOption(argc, argv, "--name", "orderbook");
+    ShmServer server(name);
+    runningShmServer = &server;
+    std::signal(SIGINT, [](int) { runningShmServer->Stop(); });
+    std::signal(SIGTERM, [](int) { runningShmServer->Stop(); });
 
-    TradeInfo(OrderId id, Price p, Quantity q) 
-        : orderId(id), price(p), quantity(q) {}
-};
+    std::cout << "Shared-memory server on " << ShmRegion::Path(name) << "\n";
+    server.Run();
+    std::cout << "Shared-memory server stopped. commands=" << server.GetCommandsProcessed()
+              << " clientsReclaimed=" << server.GetClientsReclaimed() << "\n";
+    return 0;
+}
 
 /**
- * Trade represents a matched trade between a buy and sell order
- * Contains TradeInfo for both sides of the trade
+ * Forks a shared-memory server and measures client round trips against it:
+ * each iteration submits an order (or cancels the previous one) and spins
+ * until the matching Ack/CancelAck arrives on the broadcast ring
+ * Usage: main shmbench [--name <region>] [--iterations <n>]
  */
-class Trade {
-public:
-    Trade(const TradeInfo& bid, const TradeInfo& ask) 
-        : bidTrade(bid), askTrade(ask) {}
+static int RunShmBenchmark(int argc, char* argv[]) {
+    const std::string name = GetOption(argc, argv, "--name", "orderbook-bench");
+    const std::uint64_t iterations = GetNumericOption(argc, argv, "--iterations", 1000000);
+    const std::uint64_t warmup = iterations / 10;
 
-    const TradeInfo& GetBidTrade() const { return bidTrade; }
-    const TradeInfo& GetAskTrade() const { return askTrade; }
+    pid_t server = fork();
+    if (server < 0) throw std::runtime_error("fork failed");
+    if (server == 0) {
+        ShmServer(name).Run();
+        _exit(0);
+    }
 
-private:
-    TradeInfo bidTrade;
-    TradeInfo askTrade;
-};
+    // The server may not have created and initialized the region yet
+    std::unique_ptr<ShmClient> client;
+    for (int attempt = 0; !client; ++attempt) {
+        try {
+            client = std::make_unique<ShmClient>(name);
+        } catch (const std::runtime_error&) {
+            if (attempt == 1000) throw;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    LatencyRecorder roundTrip(iterations);
+    LatencyRecorder submitCost(iterations);
+    Event event;
+    for (std::uint64_t i = 0; i < warmup + iterations; ++i) {
+        const OrderId id = i / 2 + 1;
+        const std::uint64_t tag = NowNanos();
+        bool submitted = (i % 2 == 0)
+            ? client->SubmitNewOrder(tag, OrderType::GoodTilCancel, Side::Buy, id, 100, 10)
+            : client->SubmitCancel(tag, id);
+        if (!submitted) throw std::runtime_error("inbound ring unexpectedly full");
+        if (i >= warmup) submitCost.Record(NowNanos() - tag);
+
+        do {
+            while (!client->Poll(event)) CpuRelax();
+        } while (event.clientTag != tag);
+
+        if (i >= warmup) roundTrip.Record(NowNanos() - tag);
+    }
+
+    client->RequestServerStop();
+    const std::uint64_t missed = client->GetEventsMissed();
+    client.reset();
+    waitpid(server, nullptr, 0);
+
+    std::cout << "shared-memory submit (client side): ";
+    submitCost.Print(std::cout);
+    std::cout << "shared-memory ping-pong (submit -> ack): ";
+    roundTrip.Print(std::cout);
+    std::cout << "events missed: " << missed << "\n";
+    return 0;
+}
 
-using Trades = std::vector<Trade>;
+static FixAcceptor* runningFixAcceptor = nullptr;
 
 /**
- * OrderBook is the main class that manages the entire order book system
- * Handles order addition, modification, cancellation, and matching
+ * Serves FIX 4.4 sessions until SIGINT/SIGTERM
+ * Usage: main fix [--bind <address>] [--port <port>] [--comp-id <SenderCompID>] [--price-scale <ticks per unit>]
+ *                 [--cancel-on-disconnect 0|1]
  */
-class OrderBook {
-private:
-    /**
-     * OrderEntry stores an order and its location in the order list
-     * Used for efficient order cancellation and modification
-     */
-    struct OrderEntry {
-        OrderPtr order;
-        typename OrderList::iterator location;
+static int RunFixAcceptor(int argc, char* argv[]) {
+    FixAcceptorConfig config;
+    config.bindAddress = GetOption(argc, argv, "--bind", config.bindAddress);
+    config.port = static_cast<std::uint16_t>(GetNumericOption(argc, argv, "--port", config.port));
+    config.senderCompId = GetOption(argc, argv, "--comp-id", config.senderCompId);
+    config.priceScale = static_cast<std::int64_t>(GetNumericOption(argc, argv, "--price-scale", config.priceScale));
+    config.cancelOnDisconnect = GetNumericOption(argc, argv, "--cancel-on-disconnect", 1) != 0;
+
+    FixAcceptor acceptor(config);
+    runningFixAcceptor = &acceptor;
+    std::signal(SIGINT, [](int) { runningFixAcceptor->Stop(); });
+    std::signal(SIGTERM, [](int) { runningFixAcceptor->Stop(); });
+
+    std::cout << "FIX acceptor " << config.senderCompId << " listening on " << config.bindAddress << ":"
+              << acceptor.GetPort() << "\n";
+    acceptor.Run();
+
+    const FixAcceptorStats& stats = acceptor.GetStats();
+    std::cout << "FIX acceptor stopped. sessions=" << stats.sessionsAccepted << " in=" << stats.messagesIn
+              << " out=" << stats.messagesOut << " executionReports=" << stats.executionReports
+              << " sessionRejects=" << stats.sessionRejects
+              << " cancelledOnDisconnect=" << stats.ordersCancelledOnDisconnect << "\n";
+    return 0;
+}
 
-        OrderEntry(OrderPtr o, typename OrderList::iterator loc) 
-            : order(o), location(loc) {}
+/**
+ * Multiplexes many FIX sessions on one acceptor thread: every session logs
+ * on, then each round sends a NewOrderSingle and its cancel and waits for
+ * both ExecutionReports on every session
+ * Usage: main fixsessions [--sessions <n>] [--rounds <n>]
+ */
+static int RunFixSessionBenchmark(int argc, char* argv[]) {
+    const std::size_t sessionCount = GetNumericOption(argc, argv, "--sessions", 2000);
+    const std::size_t rounds = GetNumericOption(argc, argv, "--rounds", 50);
+
+    FixAcceptorConfig config;
+    config.bindAddress = "127.0.0.1";
+    config.port = 0;
+    config.sessionBufferSize = 1 << 12;
+    FixAcceptor acceptor(config);
+    std::thread server([&] { acceptor.Run(); });
+
+    struct Client {
+        int fd;
+        std::string compId;
+        std::uint64_t seqNum = 1;
+        std::vector<char> input = std::vector<char>(1 << 16);
+        std::size_t inputEnd = 0;
     };
+    std::vector<Client> clients(sessionCount);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    double logonSeconds = 0;
+    double seconds = 0;
+    LatencyRecorder roundTimes(rounds);
+    try {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(acceptor.GetPort());
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        for (std::size_t i = 0; i < sessionCount; ++i) {
+            Client& client = clients[i];
+            client.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (client.fd < 0 || connect(client.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                throw std::runtime_error("fixsessions: connect failed: " + std::string(std::strerror(errno)));
+            }
+            int one = 1;
+            setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            client.compId = "C" + std::to_string(i);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u64 = i;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, client.fd, &ev);
+        }
+
+        FixWriter writer;
+        FixClock clock;
+        FixMessage message;
+        std::vector<epoll_event> ready(256);
+        auto send = [&](Client& client, std::string_view bytes) {
+            if (write(client.fd, bytes.data(), bytes.size()) != static_cast<ssize_t>(bytes.size())) {
+                throw std::runtime_error("fixsessions: short write");
+            }
+        };
+        // Reads until `count` messages have arrived across all sessions
+        auto receive = [&](std::size_t count) {
+            while (count > 0) {
+                int n = epoll_wait(epollFd, ready.data(), static_cast<int>(ready.size()), 5000);
+                if (n <= 0) throw std::runtime_error("fixsessions: timed out waiting for the acceptor");
+                for (int i = 0; i < n; ++i) {
+                    Client& client = clients[ready[i].data.u64];
+                    ssize_t r = read(client.fd, client.input.data() + client.inputEnd, client.input.size() - client.inputEnd);
+                    if (r < 0) throw std::runtime_error("fixsessions: read failed: " + std::string(std::strerror(errno)));
+                    if (r == 0) {  // Expected only after Logout; otherwise the wait times out
+                        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+                        continue;
+                    }
+                    client.inputEnd += static_cast<std::size_t>(r);
+                    std::size_t begin = 0;
+                    std::size_t consumed = 0;
+                    while (ParseFixMessage(client.input.data() + begin, client.inputEnd - begin, message, consumed) ==
+                           FixParseStatus::Ok) {
+                        begin += consumed;
+                        --count;
+                    }
+                    std::memmove(client.input.data(), client.input.data() + begin, client.inputEnd - begin);
+                    client.inputEnd -= begin;
+                }
+            }
+        };
 
-    using OrderMap = std::map<Price, OrderList>;
-    OrderMap bids;  // Price-ordered map of bid orders
-    OrderMap asks;  // Price-ordered map of ask orders
-    std::unordered_map<OrderId, OrderEntry> orders;  // Quick lookup by order ID
+        const std::uint64_t logonStart = NowNanos();
+        for (Client& client : clients) {
+            writer.Begin("A", client.compId, config.senderCompId, client.seqNum++, clock.Now());
+            writer.Add(98, 0);
+            writer.Add(108, 30);
+            send(client, writer.Finish());
+        }
+        receive(sessionCount);
+        logonSeconds = static_cast<double>(NowNanos() - logonStart) / 1e9;
 
-    /**
-     * Checks if an order can be matched at the given price
-     * @returns true if the order can be matched with existing orders
-     */
-    bool CanMatch(Side side, Price price) const {
-        if (side == Side::Buy) {
-            if (asks.empty()) return false;
-            return price >= asks.begin()->first;
-        } else {
-            if (bids.empty()) return false;
-            return price <= bids.begin()->first;
+        const std::uint64_t start = NowNanos();
+        for (std::size_t round = 0; round < rounds; ++round) {
+            const std::uint64_t roundStart = NowNanos();
+            const std::string clOrdId = "O" + std::to_string(round);
+            const std::string cancelId = "X" + std::to_string(round);
+            for (std::size_t i = 0; i < sessionCount; ++i) {
+                Client& client = clients[i];
+                // Resting bids only, so every order is acked and then canceled
+                writer.Begin("D", client.compId, config.senderCompId, client.seqNum++, clock.Now());
+                writer.Add(11, clOrdId);
+                writer.Add(55, std::string_view("SYM"));
+                writer.Add(54, '1');
+                writer.Add(38, 10);
+                writer.Add(40, '2');
+                writer.Add(44, 1000 + i % 100);
+                std::string batch(writer.Finish());
+                writer.Begin("F", client.compId, config.senderCompId, client.seqNum++, clock.Now());
+                writer.Add(11, cancelId);
+                writer.Add(41, clOrdId);
+                writer.Add(55, std::string_view("SYM"));
+                writer.Add(54, '1');
+                batch += writer.Finish();
+                send(client, batch);
+            }
+            receive(2 * sessionCount);
+            roundTimes.Record(NowNanos() - roundStart);
         }
+        seconds = static_cast<double>(NowNanos() - start) / 1e9;
+
+        for (Client& client : clients) {
+            writer.Begin("5", client.compId, config.senderCompId, client.seqNum++, clock.Now());
+            send(client, writer.Finish());
+        }
+        receive(sessionCount);
+    } catch (...) {
+        acceptor.Stop();
+        server.join();
+        throw;
     }
+    acceptor.Stop();
+    server.join();
+    for (Client& client : clients) close(client.fd);
+    close(epollFd);
 
-    /**
-     * Helper function to process order insertion
-     * Adds order to the appropriate price level and maintains order book structure
-     */
-    void ProcessOrder(OrderPtr order, OrderMap& orderMap) {
-        OrderList& orderList = orderMap[order->GetPrice()];
-        orderList.push_back(order);
-        auto it = std::prev(orderList.end());
-        orders.emplace(order->GetOrderId(), OrderEntry(order, it));
+    const FixAcceptorStats& stats = acceptor.GetStats();
+    const double orderMessages = static_cast<double>(2 * sessionCount * rounds);
+    std::cout << "sessions=" << sessionCount << " logon=" << logonSeconds << "s rounds=" << rounds
+              << " order messages=" << orderMessages << " in " << seconds << "s ("
+              << orderMessages / seconds << " msgs/s, " << seconds * 1e9 / orderMessages << " ns/msg)\n";
+    std::cout << "round (one order + cancel per session): ";
+    roundTimes.Print(std::cout);
+    std::cout << "acceptor in=" << stats.messagesIn << " out=" << stats.messagesOut
+              << " executionReports=" << stats.executionReports << "\n";
+    std::cout << "coroutine frames=" << stats.framePool.allocations << " pool chunks=" << stats.framePool.chunks
+              << " oversized=" << stats.framePool.oversized << " leaked=" << stats.framePool.framesInUse << "\n";
+    return 0;
+}
+
+/**
+ * Checks the acceptor's fill reports end to end: a seller rests an ask at
+ * 100.00 and a buyer crosses it with a bid at 105.00. Both ExecutionReports
+ * must show LastPx(31) and AvgPx(6) at the resting price, not the buyer's
+ * limit. Exits non-zero on a mismatch.
+ * Usage: main fixcheck
+ */
+static int RunFixCheck(int, char*[]) {
+    FixAcceptorConfig config;
+    config.bindAddress = "127.0.0.1";
+    config.port = 0;
+    config.priceScale = 100;
+    FixAcceptor acceptor(config);
+    std::thread server([&] { acceptor.Run(); });
+
+    struct Client {
+        int fd = -1;
+        std::string compId;
+        std::uint64_t seqNum = 1;
+        std::vector<char> input = std::vector<char>(1 << 14);
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+    Client seller{-1, "SELLER"};
+    Client buyer{-1, "BUYER"};
+    int failures = 0;
+    try {
+        FixWriter writer;
+        FixClock clock;
+        FixMessage message;
+        auto send = [&](Client& client) {
+            std::string_view bytes = writer.Finish();
+            if (write(client.fd, bytes.data(), bytes.size()) != static_cast<ssize_t>(bytes.size())) {
+                throw std::runtime_error("fixcheck: short write");
+            }
+        };
+        // @returns the client's next message; valid until the next call
+        auto next = [&](Client& client) -> const FixMessage& {
+            for (;;) {
+                std::size_t consumed = 0;
+                if (ParseFixMessage(client.input.data() + client.begin, client.end - client.begin, message,
+                                    consumed) == FixParseStatus::Ok) {
+                    client.begin += consumed;
+                    return message;
+                }
+                std::memmove(client.input.data(), client.input.data() + client.begin, client.end - client.begin);
+                client.end -= client.begin;
+                client.begin = 0;
+                ssize_t r = read(client.fd, client.input.data() + client.end, client.input.size() - client.end);
+                if (r <= 0) throw std::runtime_error("fixcheck: no reply from the acceptor");
+                client.end += static_cast<std::size_t>(r);
+            }
+        };
+        auto logon = [&](Client& client) {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(acceptor.GetPort());
+            inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+            client.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (client.fd < 0 || connect(client.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                throw std::runtime_error("fixcheck: connect failed: " + std::string(std::strerror(errno)));
+            }
+            timeval timeout{5, 0};
+            setsockopt(client.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            writer.Begin("A", client.compId, config.senderCompId, client.seqNum++, clock.Now());
+            writer.Add(98, 0);
+            writer.Add(108, 30);
+            send(client);
+            if (next(client).GetType() != "A") throw std::runtime_error("fixcheck: logon refused");
+        };
+        auto order = [&](Client& client, char side, std::string_view price) {
+            writer.Begin("D", client.compId, config.senderCompId, client.seqNum++, clock.Now());
+            writer.Add(11, client.compId);
+            writer.Add(55, std::string_view("SYM"));
+            writer.Add(54, side);
+            writer.Add(38, 10);
+            writer.Add(40, '2');
+            writer.Add(44, price);
+            send(client);
+        };
+        // Skips acks up to the fill and checks its prices
+        auto expectFill = [&](Client& client) {
+            for (;;) {
+                const FixMessage& report = next(client);
+                if (report.GetType() != "8") throw std::runtime_error("fixcheck: expected an ExecutionReport");
+                if (report.Get(150) == "0") continue;
+                if (report.Get(150) != "F") throw std::runtime_error("fixcheck: order was not filled");
+                const bool ok = report.Get(31) == "100.00" && report.Get(6) == "100.0000";
+                std::cout << client.compId << " fill: LastPx=" << report.Get(31) << " AvgPx=" << report.Get(6)
+                          << (ok ? " ok" : " expected LastPx=100.00 AvgPx=100.0000") << "\n";
+                failures += !ok;
+                return;
+            }
+        };
+
+        logon(seller);
+        logon(buyer);
+        order(seller, '2', "100.00");
+        if (next(seller).Get(150) != "0") throw std::runtime_error("fixcheck: resting order was not acknowledged");
+        order(buyer, '1', "105.00");
+        expectFill(buyer);
+        expectFill(seller);
+    } catch (...) {
+        acceptor.Stop();
+        server.join();
+        throw;
     }
+    acceptor.Stop();
+    server.join();
+    close(seller.fd);
+    close(buyer.fd);
+    std::cout << (failures ? "FAILED" : "passed") << "\n";
+    return failures ? 1 : 0;
+}
+#endif
 
-    /**
-     * Core matching engine that pairs compatible buy and sell orders
-     * Implements price-time priority matching algorithm
-     * @returns vector of executed trades
-     */
-    Trades MatchOrders() {
-        Trades trades;
-        trades.reserve(orders.size());
+/**
+ * Writes a synthetic client-side FIX log: a Logon followed by a mix of
+ * NewOrderSingle (70%), OrderCancelRequest (20%) and
+ * OrderCancelReplaceRequest (10%), one message per line
+ * Usage: main fixgen <path> [--messages <n>]
+ */
+static int RunFixLogGenerator(int argc, char* argv[]) {
+    if (argc < 3) throw std::invalid_argument("usage: fixgen <path> [--messages <n>]");
+    const std::uint64_t count = GetNumericOption(argc, argv, "--messages", 1000000);
+    std::ofstream out(argv[2], std::ios::binary);
+    if (!out) throw std::runtime_error(std::string("cannot create ") + argv[2]);
 
-        while (!bids.empty() && !asks.empty()) {
-            auto bidIt = bids.begin();
-            auto askIt = asks.begin();
-            
-            if (bidIt->first < askIt->first) break;
+    FixWriter writer;
+    FixClock clock;
+    std::mt19937_64 random(42);
+    std::uint64_t seqNum = 1;
+    std::uint64_t nextClOrdId = 1;
+    auto emit = [&] {
+        std::string_view bytes = writer.Finish();
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        out.put('\n');
+    };
 
-            OrderList& bidList = bidIt->second;
-            OrderList& askList = askIt->second;
+    writer.Begin("A", "CLIENT1", "ORDERBOOK", seqNum++, clock.Now());
+    writer.Add(98, 0);
+    writer.Add(108, 30);
+    emit();
 
-            while (!bidList.empty() && !askList.empty()) {
-                OrderPtr bid = bidList.front();
-                OrderPtr ask = askList.front();
+    for (std::uint64_t i = 1; i < count; ++i) {
+        const int kind = static_cast<int>(random() % 10);
+        const std::uint64_t clOrdId = nextClOrdId++;
+        const bool buy = random() & 1;
+        const std::int64_t price = 10000 + static_cast<std::int64_t>(random() % 200) - (buy ? 100 : 0);
+        const std::uint64_t quantity = 1 + random() % 500;
+        char id[24];
+        char original[24];
+        std::snprintf(id, sizeof(id), "ORD%llu", static_cast<unsigned long long>(clOrdId));
+        std::snprintf(original, sizeof(original), "ORD%llu",
+                      static_cast<unsigned long long>(clOrdId > 1 ? 1 + random() % (clOrdId - 1) : 1));
 
-                Quantity quantity = std::min(
-                    bid->GetRemainingQuantity(),
-                    ask->GetRemainingQuantity()
-                );
+        writer.Begin(kind < 7 ? "D" : kind < 9 ? "F" : "G", "CLIENT1", "ORDERBOOK", seqNum++, clock.Now());
+        writer.Add(11, std::string_view(id));
+        if (kind >= 7) writer.Add(41, std::string_view(original));
+        if (kind < 7) writer.Add(21, '1');
+        writer.Add(55, std::string_view("XYZ"));
+        writer.Add(54, buy ? '1' : '2');
+        writer.Add(60, clock.Now());
+        if (kind != 7 && kind != 8) {
+            writer.Add(38, quantity);
+            writer.Add(40, '2');
+            writer.AddPrice(44, price, 100);
+            writer.Add(59, kind < 7 && random() % 4 == 0 ? '3' : '0');
+        }
+        emit();
+    }
+    std::cout << "Wrote " << count << " FIX messages to " << argv[2] << "\n";
+    return 0;
+}
 
-                bid->Fill(quantity);
-                ask->Fill(quantity);
+/**
+ * Measures FIX parse throughput (framing, checksum, field split and
+ * conversion to Commands) on a recorded log, with the scalar and the SIMD
+ * field scanner. Bytes between messages (newlines, log timestamps) are skipped.
+ * Usage: main fixbench <log> [--passes <n>] [--price-scale <ticks per unit>]
+ */
+static int RunFixBenchmark(int argc, char* argv[]) {
+    if (argc < 3) throw std::invalid_argument("usage: fixbench <log> [--passes <n>] [--price-scale <n>]");
+    std::ifstream in(argv[2], std::ios::binary);
+    if (!in) throw std::runtime_error(std::string("cannot open ") + argv[2]);
+    const std::string log((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const std::uint64_t passes = GetNumericOption(argc, argv, "--passes", 5);
+    const std::int64_t priceScale = static_cast<std::int64_t>(GetNumericOption(argc, argv, "--price-scale", 100));
 
-                trades.emplace_back(
-                    TradeInfo(bid->GetOrderId(), bid->GetPrice(), quantity),
-                    TradeInfo(ask->GetOrderId(), ask->GetPrice(), quantity)
-                );
+    auto run = [&](const char* name, auto useSimd) {
+        constexpr bool UseSimd = decltype(useSimd)::value;
+        FixMessage message;
+        std::uint64_t messages = 0;
+        std::uint64_t orders = 0;
+        std::uint64_t rejected = 0;
+        std::uint64_t skippedBytes = 0;
+        std::uint64_t digest = 0;  // Keeps the conversion from being optimized away
 
-                if (bid->IsFilled()) {
-                    bidList.pop_front();
-                    orders.erase(bid->GetOrderId());
+        const std::uint64_t start = NowNanos();
+        for (std::uint64_t pass = 0; pass < passes; ++pass) {
+            const char* p = log.data();
+            const char* end = p + log.size();
+            while (p < end) {
+                if (*p == '\n' || *p == '\r') {
+                    ++p;
+                    continue;
+                }
+                std::size_t consumed = 0;
+                FixParseStatus status = ParseFixMessage<UseSimd>(p, static_cast<std::size_t>(end - p), message, consumed);
+                if (status != FixParseStatus::Ok) {
+                    // Resynchronize on the next BeginString
+                    const void* next = memmem(p + 1, static_cast<std::size_t>(end - p - 1), "8=FIX.4.4\x01", 10);
+                    const char* resume = next ? static_cast<const char*>(next) : end;
+                    skippedBytes += static_cast<std::uint64_t>(resume - p);
+                    p = resume;
+                    continue;
                 }
-                if (ask->IsFilled()) {
-                    askList.pop_front();
-                    orders.erase(ask->GetOrderId());
+                p += consumed;
+                ++messages;
+
+                const std::string_view type = message.GetType();
+                if (type == "D" || type == "F" || type == "G") {
+                    Command command;
+                    if (FixToCommand(message, message.Get(49), priceScale, command)) {
+                        ++rejected;
+                    } else {
+                        ++orders;
+                        digest += command.orderId ^ static_cast<std::uint64_t>(command.price);
+                    }
                 }
-                
-                if (bidList.empty()) bids.erase(bidIt);
-                if (askList.empty()) asks.erase(askIt);
             }
         }
+        const double seconds = static_cast<double>(NowNanos() - start) / 1e9;
+
+        std::cout << "== " << name << " ==\n"
+                  << "messages=" << messages << " orders=" << orders << " rejected=" << rejected
+                  << " skippedBytes=" << skippedBytes << " digest=" << (digest & 0xffff) << "\n"
+                  << "throughput: " << static_cast<std::uint64_t>(static_cast<double>(messages) / seconds)
+                  << " msgs/sec, " << static_cast<double>(log.size() * passes) / seconds / 1e6 << " MB/s, "
+                  << seconds * 1e9 / static_cast<double>(messages ? messages : 1) << " ns/msg\n";
+    };
+    run("scalar scanner", std::false_type{});
+    run("simd scanner", std::true_type{});
+    return 0;
+}
+
+/**
+ * Writes a synthetic ITCH feed: a Stock Directory per symbol, then a random
+ * but self-consistent stream of adds (45%), executions (15%), partial
+ * cancels (10%), deletes (20%) and replaces (10%). Bids rest below and asks
+ * above a fixed mid price, so a correct book never crosses. Once a symbol
+ * holds a few thousand orders its adds turn into deletes to bound depth.
+ * Usage: main itchgen <path> [--messages <n>] [--symbols <n>]
+ */
+static int RunItchGenerator(int argc, char* argv[]) {
+    if (argc < 3) throw std::invalid_argument("usage: itchgen <path> [--messages <n>] [--symbols <n>]");
+    const std::uint64_t count = GetNumericOption(argc, argv, "--messages", 10000000);
+    const auto symbolCount = static_cast<std::uint16_t>(GetNumericOption(argc, argv, "--symbols", 8));
+    std::ofstream out(argv[2], std::ios::binary);
+    if (!out) throw std::runtime_error(std::string("cannot create ") + argv[2]);
 
-        // Handle unfilled FillAndKill orders
-        for (const auto& orderPair : bids) {
-            const OrderList& orderList = orderPair.second;
-            if (!orderList.empty() && 
-                orderList.front()->GetOrderType() == OrderType::FillAndKill) {
-                CancelOrder(orderList.front()->GetOrderId());
+    struct LiveOrder {
+        OrderId id;
+        std::uint32_t shares;
+        Side side;
+    };
+    constexpr std::uint32_t Mid = 1000000;  // 100.0000
+    constexpr std::uint32_t Tick = 100;     // 0.01
+    constexpr std::size_t TargetDepth = 5000;
+
+    ItchWriter writer;
+    std::mt19937_64 random(7);
+    std::vector<std::vector<LiveOrder>> live(symbolCount);
+    std::vector<std::string> symbols;
+    OrderId nextId = 1;
+    std::uint64_t timestamp = 34200ULL * 1000000000ULL;  // 09:30
+    std::uint64_t written = 0;
+
+    for (std::uint16_t locate = 1; locate <= symbolCount; ++locate) {
+        symbols.push_back("SYM" + std::to_string(locate));
+        writer.StockDirectory(locate, timestamp, symbols.back());
+        ++written;
+    }
+    auto price = [&](Side side) {
+        const auto offset = static_cast<std::uint32_t>(1 + random() % 20) * Tick;
+        return side == Side::Buy ? Mid - offset : Mid + offset;
+    };
+
+    while (written < count) {
+        const auto locate = static_cast<std::uint16_t>(1 + random() % symbolCount);
+        std::vector<LiveOrder>& orders = live[locate - 1];
+        timestamp += random() % 1000;
+        int action = static_cast<int>(random() % 100);
+        if (orders.empty()) action = 0;
+        if (orders.size() > TargetDepth && action < 45) action = 80;  // At target depth adds become deletes
+
+        if (action < 45) {
+            LiveOrder order{nextId++, static_cast<std::uint32_t>(1 + random() % 1000), (random() & 1) ? Side::Buy : Side::Sell};
+            writer.AddOrder(locate, timestamp, order.id, order.side, order.shares, symbols[locate - 1], price(order.side));
+            orders.push_back(order);
+        } else {
+            const std::size_t index = random() % orders.size();
+            LiveOrder& order = orders[index];
+            bool removed = false;
+            if (action < 70) {
+                const auto shares = static_cast<std::uint32_t>(1 + random() % order.shares);
+                if (action < 60) {
+                    writer.OrderExecuted(locate, timestamp, order.id, shares, written);
+                } else {
+                    writer.OrderCancel(locate, timestamp, order.id, shares);
+                }
+                order.shares -= shares;
+                removed = order.shares == 0;
+            } else if (action < 90) {
+                writer.OrderDelete(locate, timestamp, order.id);
+                removed = true;
+            } else {
+                const OrderId newId = nextId++;
+                const auto shares = static_cast<std::uint32_t>(1 + random() % 1000);
+                writer.OrderReplace(locate, timestamp, order.id, newId, shares, price(order.side));
+                order.id = newId;
+                order.shares = shares;
+            }
+            if (removed) {
+                order = orders.back();
+                orders.pop_back();
             }
         }
+        ++written;
+
+        if (writer.GetBuffer().size() > (1 << 20)) {
+            out.write(writer.GetBuffer().data(), static_cast<std::streamsize>(writer.GetBuffer().size()));
+            writer.Clear();
+        }
+    }
+    out.write(writer.GetBuffer().data(), static_cast<std::streamsize>(writer.GetBuffer().size()));
+    std::cout << "Wrote " << written << " ITCH messages for " << symbolCount << " symbols to " << argv[2] << "\n";
+    return 0;
+}
+
+/**
+ * Rebuilds per-symbol books from a recorded ITCH feed, reports decode/apply
+ * throughput and the resulting top of book for each symbol; --watch reports
+ * where one order reference stands in its level's queue at the end
+ * Usage: main itch <path> [--passes <n>] [--watch <order reference>]
+ */
+static int RunItchReplay(int argc, char* argv[]) {
+    if (argc < 3) throw std::invalid_argument("usage: itch <path> [--passes <n>] [--watch <order reference>]");
+    const std::uint64_t passes = GetNumericOption(argc, argv, "--passes", 1);
+
+    std::unique_ptr<ItchFeedHandler> handler;
+    double best = 0;
+    for (std::uint64_t pass = 0; pass < passes; ++pass) {
+        handler = std::make_unique<ItchFeedHandler>();
+        const std::uint64_t start = NowNanos();
+        handler->ApplyFile(argv[2]);
+        const double seconds = static_cast<double>(NowNanos() - start) / 1e9;
+        best = std::max(best, static_cast<double>(handler->GetStats().messages) / seconds);
+    }
+
+    const ItchStats& stats = handler->GetStats();
+    std::cout << "messages=" << stats.messages << " adds=" << stats.adds << " executions=" << stats.executions
+              << " cancels=" << stats.cancels << " deletes=" << stats.deletes << " replaces=" << stats.replaces
+              << " skipped=" << stats.skipped << "\n"
+              << "unknownOrders=" << stats.unknownOrders << " inconsistent=" << stats.inconsistent
+              << " crosses=" << stats.crosses << "\n"
+              << "throughput: " << static_cast<std::uint64_t>(best) << " msgs/sec (best of " << passes << ")\n";
+
+    const std::uint64_t watch = GetNumericOption(argc, argv, "--watch", 0);
+    for (std::size_t locate = 0; locate < ItchFeedHandler::MaxLocates; ++locate) {
+        const OrderBook* book = handler->GetBook(static_cast<std::uint16_t>(locate));
+        if (!book) continue;
+        if (const auto position = handler->GetQueuePosition(static_cast<std::uint16_t>(locate), watch)) {
+            const std::optional<Order> order = book->FindOrder(watch);
+            std::cout << "order " << watch << ": " << order->GetRemainingQuantity() << "@" << order->GetPrice()
+                      << " ahead=" << position->ahead << " behind=" << position->behind << "\n";
+        }
+        OrderbookLevelInfos infos = book->GetOrderInfos();
+        std::cout << handler->GetSymbol(static_cast<std::uint16_t>(locate)) << " orders=" << book->Size()
+                  << " levels=" << infos.GetBids().size() << "x" << infos.GetAsks().size();
+        if (!infos.GetBids().empty()) {
+            std::cout << " bid=" << infos.GetBids().front().quantity << "@" << infos.GetBids().front().price;
+        }
+        if (!infos.GetAsks().empty()) {
+            std::cout << " ask=" << infos.GetAsks().front().quantity << "@" << infos.GetAsks().front().price;
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
+
+static PipelineConfig ParsePipelineConfig(int argc, char* argv[]) {
+    PipelineConfig config;
+    config.ringSize = GetNumericOption(argc, argv, "--ring", config.ringSize);
+    config.journalPath = GetOption(argc, argv, "--journal", "");
+    std::istringstream cpus(GetOption(argc, argv, "--cpus", ""));
+    for (std::string cpu; std::getline(cpus, cpu, ',');) config.cpus.push_back(std::stoi(cpu));
+    return config;
+}
+
+static void PrintPipelineStats(const PipelineStats& stats) {
+    std::cout << "events=" << stats.events << " malformed=" << stats.malformed
+              << " riskRejects=" << stats.riskRejects << "\n";
+    for (std::size_t stage = 0; stage < PipelineStats::StageCount; ++stage) {
+        const PipelineStageStats& s = stats.stages[stage];
+        std::cout << "  " << PipelineStats::StageNames[stage] << ": entries=" << s.entries << " batches=" << s.batches
+                  << " avgBatch=" << (s.batches ? s.entries / s.batches : 0)
+                  << " busy=" << s.busyNanos / 1000000 << "ms\n";
+    }
+}
+
+/**
+ * Runs a file of REPL commands through the staged pipeline and prints the events
+ * Usage: main pipeline <path> [--journal <path>] [--cpus <decode,risk,match,publish>] [--ring <entries>]
+ */
+static int RunPipeline(int argc, char* argv[]) {
+    if (argc < 3) throw std::invalid_argument("usage: pipeline <path> [--journal <path>] [--cpus <a,b,c,d>]");
+    std::ifstream file(argv[2], std::ios::binary);
+    if (!file) throw std::runtime_error(std::string("cannot open ") + argv[2]);
+    const std::string input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    OrderPipeline pipeline(ParsePipelineConfig(argc, argv));
+    pipeline.Run(input, &std::cout);
+    PrintPipelineStats(pipeline.GetStats());
+    return 0;
+}
+
+/**
+ * Compares the staged pipeline with the same stages run on one thread, over
+ * a generated command file, and checks both produce identical output
+ * Usage: main pipelinebench [--commands <n>] [--cpus <a,b,c,d>] [--ring <entries>]
+ */
+static int RunPipelineBenchmark(int argc, char* argv[]) {
+    const std::uint64_t commands = GetNumericOption(argc, argv, "--commands", 1000000);
+    const PipelineConfig config = ParsePipelineConfig(argc, argv);
+
+    std::string input;
+    std::mt19937_64 random(42);
+    std::vector<OrderId> live;
+    for (std::uint64_t i = 0; i < commands; ++i) {
+        const Command command = MakeRandomCommand(random, live, i);
+        if (command.type == CommandType::Cancel) {
+            input += "CANCEL " + std::to_string(command.orderId) + "\n";
+            continue;
+        }
+        input += command.orderType == OrderType::GoodTilCancel ? "ADD GTC " : "ADD FAK ";
+        input += command.side == Side::Buy ? "BUY " : "SELL ";
+        input += std::to_string(command.orderId) + " " + std::to_string(command.price) + " " +
+                 std::to_string(command.quantity) + "\n";
+    }
+
+    auto run = [&](const char* name, bool staged) {
+        OrderPipeline pipeline(config);
+        std::ostringstream out;
+        const std::uint64_t start = NowNanos();
+        if (staged) {
+            pipeline.Run(input, &out);
+        } else {
+            pipeline.RunSequential(input, &out);
+        }
+        const double seconds = static_cast<double>(NowNanos() - start) / 1e9;
+        std::cout << name << ": " << static_cast<std::uint64_t>(static_cast<double>(commands) / seconds)
+                  << " commands/sec\n";
+        PrintPipelineStats(pipeline.GetStats());
+        return out.str();
+    };
+
+    const std::string sequential = run("sequential", false);
+    const std::string staged = run("pipelined", true);
+    std::cout << (sequential == staged ? "outputs match" : "OUTPUTS DIFFER") << " (" << sequential.size()
+              << " bytes)\n";
+    return sequential == staged ? 0 : 1;
+}
+
+/**
+ * Feeds skewed order flow to the engine scheduler with stealing off and on.
+ * Instruments owned by worker 0 at start are hot and get --hot percent of
+ * all commands; both runs must produce the same events on every instrument.
+ * Usage: main schedbench [--commands <n>] [--instruments <n>] [--workers <n>] [--hot <percent>] [--cpus <a,b,...>]
+ */
+static int RunSchedulerBenchmark(int argc, char* argv[]) {
+    const std::uint64_t commands = GetNumericOption(argc, argv, "--commands", 2000000);
+    const std::uint64_t instrumentCount = GetNumericOption(argc, argv, "--instruments", 16);
+    const std::uint64_t hotPercent = GetNumericOption(argc, argv, "--hot", 80);
+    EngineSchedulerConfig config;
+    config.workers = GetNumericOption(argc, argv, "--workers", 4);
+    std::istringstream cpus(GetOption(argc, argv, "--cpus", ""));
+    for (std::string cpu; std::getline(cpus, cpu, ',');) config.cpus.push_back(std::stoi(cpu));
+    if (instrumentCount < config.workers) throw std::invalid_argument("need at least one instrument per worker");
+
+    // Instruments are dealt round-robin, so those with id % workers == 0 start on worker 0
+    std::vector<InstrumentId> hot, cold;
+    for (InstrumentId id = 0; id < instrumentCount; ++id) (id % config.workers == 0 ? hot : cold).push_back(id);
+    std::vector<std::pair<InstrumentId, Command>> flow;
+    flow.reserve(commands);
+    std::mt19937_64 random(7);
+    std::vector<std::vector<OrderId>> live(instrumentCount);
+    for (std::uint64_t i = 0; i < commands; ++i) {
+        const std::vector<InstrumentId>& pool = (random() % 100 < hotPercent || cold.empty()) ? hot : cold;
+        const InstrumentId id = pool[random() % pool.size()];
+        flow.emplace_back(id, MakeRandomCommand(random, live[id], i));
+    }
+
+    auto run = [&](bool stealing) {
+        config.stealing = stealing;
+        EngineScheduler scheduler(instrumentCount, config);
+        const std::uint64_t start = NowNanos();
+        scheduler.Start();
+        for (const auto& [id, command] : flow) scheduler.Submit(id, command);
+        scheduler.Stop();
+        const double seconds = static_cast<double>(NowNanos() - start) / 1e9;
+
+        std::cout << (stealing ? "stealing" : "static") << ": "
+                  << static_cast<std::uint64_t>(static_cast<double>(commands) / seconds) << " commands/sec\n";
+        for (std::size_t w = 0; w < scheduler.GetWorkerCount(); ++w) {
+            const EngineWorkerStats& stats = scheduler.GetWorkerStats(w);
+            std::cout << "  worker " << w << ": commands=" << stats.commands << " utilization="
+                      << static_cast<int>(stats.GetUtilization() * 100) << "% stolen=" << stats.stolen
+                      << " lost=" << stats.lost << " instruments=" << stats.instruments << "\n";
+        }
+        std::vector<std::uint64_t> checksums;
+        std::uint64_t migrations = 0;
+        for (InstrumentId id = 0; id < instrumentCount; ++id) {
+            checksums.push_back(scheduler.GetInstrumentStats(id).eventChecksum);
+            migrations += scheduler.GetInstrumentStats(id).migrations;
+        }
+        std::cout << "  migrations=" << migrations << "\n";
+        return checksums;
+    };
+
+    const std::vector<std::uint64_t> fixed = run(false);
+    const bool same = fixed == run(true);
+    std::cout << (same ? "per-instrument events match" : "PER-INSTRUMENT EVENTS DIFFER") << "\n";
+    return same ? 0 : 1;
+}
+
+/**
+ * Times a kill switch on one participant: cancelling all of its resting
+ * orders one CancelOrder at a time versus one owner mass cancel
+ * Usage: main masscancelbench [--orders <n>] [--owners <n>]
+ */
+static int RunMassCancelBenchmark(int argc, char* argv[]) {
+    const std::uint64_t ordersPerOwner = GetNumericOption(argc, argv, "--orders", 50000);
+    const std::uint64_t owners = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--owners", 4), 1);
+
+    // Owners' orders interleave across 200 levels per side without crossing
+    auto build = [&](OrderBook& book, std::vector<OrderId>& target) {
+        std::mt19937_64 random(11);
+        for (std::uint64_t i = 0; i < ordersPerOwner * owners; ++i) {
+            const OwnerId owner = 1 + i % owners;
+            const Side side = (random() & 1) ? Side::Buy : Side::Sell;
+            const Price price = side == Side::Buy ? 999 - static_cast<Price>(random() % 200)
+                                                  : 1001 + static_cast<Price>(random() % 200);
+            book.AddOrder(Order(OrderType::GoodTilCancel, i + 1, side, price, 1 + random() % 100), owner);
+            if (owner == 1) target.push_back(i + 1);
+        }
+    };
+
+    OrderBook oneByOne;
+    std::vector<OrderId> target;
+    build(oneByOne, target);
+    std::uint64_t start = NowNanos();
+    for (OrderId id : target) oneByOne.CancelOrder(id);
+    const std::uint64_t loopNanos = NowNanos() - start;
+
+    OrderBook mass;
+    std::vector<OrderId> ignored;
+    build(mass, ignored);
+    MassCancelFilter filter;
+    filter.owner = 1;
+    start = NowNanos();
+    const std::size_t cancelled = mass.CancelOrders(filter, [](const Order&) {});
+    const std::uint64_t massNanos = NowNanos() - start;
+
+    std::cout << "cancelled " << cancelled << " of " << ordersPerOwner * owners << " orders\n"
+              << "  CancelOrder loop: " << loopNanos / 1000 << " us (" << loopNanos / target.size() << " ns/order)\n"
+              << "  owner mass cancel: " << massNanos / 1000 << " us (" << massNanos / std::max<std::size_t>(cancelled, 1)
+              << " ns/order)\n";
+    return oneByOne.Size() == mass.Size() ? 0 : 1;
+}
+
+/**
+ * Measures what in-engine trade analytics cost per command: random order
+ * flow with simulated time (--step nanoseconds per command) through an
+ * engine without a listener, then with TradeAnalytics
+ * Usage: main analyticsbench [--commands <n>] [--step <ns>] [--bar <ns>]
+ */
+static int RunAnalyticsBenchmark(int argc, char* argv[]) {
+    const std::uint64_t commands = GetNumericOption(argc, argv, "--commands", 2000000);
+    const std::uint64_t step = GetNumericOption(argc, argv, "--step", 10000);
+    TradeAnalyticsConfig config;
+    config.barIntervalNanos = GetNumericOption(argc, argv, "--bar", config.barIntervalNanos);
+
+    std::vector<Command> flow;
+    flow.reserve(commands);
+    std::mt19937_64 random(5);
+    std::vector<OrderId> live;
+    for (std::uint64_t i = 0; i < commands; ++i) flow.push_back(MakeRandomCommand(random, live, i));
+
+    Quantity filled = 0;
+    auto count = [&filled](const Event& event) {
+        if (event.type == MessageType::Fill) filled += event.quantity;
+    };
+
+    MatchingEngine plain;
+    std::uint64_t start = NowNanos();
+    for (const Command& command : flow) plain.Process(command, count);
+    const std::uint64_t plainNanos = NowNanos() - start;
+
+    MatchingEngine engine;
+    TradeAnalytics analytics(config);
+    start = NowNanos();
+    for (std::uint64_t i = 0; i < commands; ++i) {
+        analytics.Advance(i * step);
+        engine.Process(flow[i], count, analytics);
+    }
+    const std::uint64_t analyticsNanos = NowNanos() - start;
+
+    std::cout << "without analytics: " << plainNanos / commands << " ns/command\n"
+              << "with analytics:    " << analyticsNanos / commands << " ns/command\n"
+              << "trades=" << analytics.GetTradeCount() << " volume=" << analytics.GetVolume()
+              << " vwap=" << analytics.GetVwap() << " last=" << analytics.GetLastPrice()
+              << " rollingVolume=" << analytics.GetRollingVolume() << " bars=" << analytics.GetBarCount() << "\n";
+    if (analytics.GetBarCount() > 0) {
+        const Bar& bar = analytics.GetBar(0);
+        std::cout << "last bar: o=" << bar.open << " h=" << bar.high << " l=" << bar.low << " c=" << bar.close
+                  << " v=" << bar.volume << " vwap=" << bar.GetVwap() << "\n";
+    }
+    // Every fill is reported to both sides, both runs included
+    const bool consistent = filled == 4 * analytics.GetVolume();
+    std::cout << (consistent ? "volume matches fills" : "VOLUME DOES NOT MATCH FILLS") << "\n";
+    return consistent ? 0 : 1;
+}
+
+/**
+ * Compares cost-to-fill and depth-to-price answers from the book's depth
+ * ladder with the same answers computed by walking a GetOrderInfos snapshot
+ * Usage: main depthbench [--orders <n>] [--levels <n>] [--queries <n>]
+ */
+static int RunDepthBenchmark(int argc, char* argv[]) {
+    const std::uint64_t orders = GetNumericOption(argc, argv, "--orders", 200000);
+    const std::uint64_t levels = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--levels", 2000), 1);
+    const std::uint64_t queries = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--queries", 100000), 1);
+
+    // Resting orders on both sides of 10000, never crossing
+    OrderBook book;
+    std::mt19937_64 random(17);
+    Quantity askTotal = 0;
+    for (std::uint64_t i = 0; i < orders; ++i) {
+        const Side side = (random() & 1) ? Side::Buy : Side::Sell;
+        const Price offset = 1 + static_cast<Price>(random() % levels);
+        const Quantity quantity = 1 + random() % 100;
+        if (side == Side::Sell) askTotal += quantity;
+        book.AddOrder(Order(OrderType::GoodTilCancel, i + 1, side, side == Side::Buy ? 10000 - offset : 10000 + offset,
+                            quantity));
+    }
+
+    std::vector<std::pair<Quantity, Price>> asks;  // Quantity to buy, limit price
+    for (std::uint64_t i = 0; i < queries; ++i) {
+        asks.emplace_back(1 + random() % std::max<Quantity>(askTotal, 1), 10000 + static_cast<Price>(random() % levels));
+    }
+
+    // The first query builds the ladders from the levels
+    std::uint64_t start = NowNanos();
+    std::int64_t ladderSum = 0;
+    book.EstimateFill(Side::Buy, 0);
+    const std::uint64_t buildNanos = NowNanos() - start;
+    start = NowNanos();
+    for (const auto& [quantity, limit] : asks) {
+        ladderSum += book.EstimateFill(Side::Buy, quantity).notional;
+        ladderSum += static_cast<std::int64_t>(book.GetQuantityUpTo(Side::Buy, limit));
+    }
+    const std::uint64_t ladderNanos = NowNanos() - start;
+
+    std::int64_t walkSum = 0;
+    start = NowNanos();
+    for (const auto& [quantity, limit] : asks) {
+        const OrderbookLevelInfos infos = book.GetOrderInfos();
+        Quantity filled = 0;
+        for (const LevelInfo& level : infos.GetAsks()) {
+            if (filled == quantity) break;
+            const Quantity take = std::min(level.quantity, quantity - filled);
+            filled += take;
+            walkSum += static_cast<std::int64_t>(take) * level.price;
+        }
+        for (const LevelInfo& level : infos.GetAsks()) {
+            if (level.price > limit) break;
+            walkSum += static_cast<std::int64_t>(level.quantity);
+        }
+    }
+    const std::uint64_t walkNanos = NowNanos() - start;
+
+    std::cout << book.GetOrderInfos().GetAsks().size() << " ask levels, " << queries << " query pairs\n"
+              << "  ladder build:       " << buildNanos / 1000 << " us (first query)\n"
+              << "  depth ladder:       " << ladderNanos / queries << " ns/pair\n"
+              << "  GetOrderInfos walk: " << walkNanos / queries << " ns/pair\n"
+              << (ladderSum == walkSum ? "answers match" : "ANSWERS DIFFER") << "\n";
+    return ladderSum == walkSum ? 0 : 1;
+}
+
+/**
+ * Operations levelbench replays against each level container, generated
+ * once so every container sees the same sequence
+ */
+struct LevelWorkload {
+    std::vector<Price> initial;                     // Levels inserted up front, in random order
+    std::vector<Price> finds;                       // Lookups of resting levels
+    std::vector<std::pair<Price, Price>> replaces;  // Erase a resting level, insert a new one
+    std::uint64_t touches = 0;                      // Best level consumed and re-added
+    std::uint64_t walks = 0;                        // Full walks best to worst
+};
+
+struct LevelTimings {
+    std::uint64_t build = 0;  // ns per level
+    std::uint64_t find = 0;   // ns per operation from here on
+    std::uint64_t touch = 0;
+    std::uint64_t replace = 0;
+    double walk = 0;          // ns per level
+    std::uint64_t checksum = 0;
+};
+
+template <typename Levels>
+static LevelTimings TimeLevels(const LevelWorkload& work) {
+    LevelTimings timings;
+    Levels levels;
+    auto perOp = [](std::uint64_t nanos, std::size_t ops) { return nanos / std::max<std::size_t>(ops, 1); };
+
+    std::uint64_t start = NowNanos();
+    for (const Price price : work.initial) levels[price] = static_cast<Quantity>(price);
+    timings.build = perOp(NowNanos() - start, work.initial.size());
+
+    start = NowNanos();
+    for (const Price price : work.finds) timings.checksum += levels.find(price)->second;
+    timings.find = perOp(NowNanos() - start, work.finds.size());
+
+    start = NowNanos();
+    for (std::uint64_t walk = 0; walk < work.walks; ++walk) {
+        for (const auto& [price, quantity] : levels) timings.checksum += quantity;
+    }
+    timings.walk = static_cast<double>(NowNanos() - start) /
+                   static_cast<double>(std::max<std::uint64_t>(work.walks * levels.size(), 1));
+
+    // MatchOrders' pattern: the best level empties and a new order rests there
+    start = NowNanos();
+    for (std::uint64_t touch = 0; touch < work.touches; ++touch) {
+        const Price best = levels.begin()->first;
+        levels.erase(levels.begin());
+        levels[best] = static_cast<Quantity>(best);
+    }
+    timings.touch = perOp(NowNanos() - start, work.touches);
+
+    start = NowNanos();
+    for (const auto& [erased, added] : work.replaces) {
+        levels.erase(erased);
+        levels[added] = static_cast<Quantity>(added);
+    }
+    timings.replace = perOp(NowNanos() - start, work.replaces.size());
+
+    for (const auto& [price, quantity] : levels) timings.checksum += static_cast<Quantity>(price) ^ quantity;
+    return timings;
+}
+
+/**
+ * Times the level containers a book can store its sides in, std::map,
+ * HybridLevelMap and BTreeLevelMap, on the operations the book makes of
+ * them, with the levels spread over eight times as many ticks
+ * Usage: main levelbench [--levels <n>] [--ops <n>]
+ */
+static int RunLevelBenchmark(int argc, char* argv[]) {
+    const std::uint64_t count = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--levels", 10000), 1);
+    const std::uint64_t ops = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--ops", 1000000), 1);
+
+    // One candidate price in every four ticks; half of them rest at the start
+    std::mt19937_64 random(23);
+    std::vector<Price> resting;
+    for (std::uint64_t i = 0; i < 2 * count; ++i) {
+        resting.push_back(10000 + static_cast<Price>(4 * i + random() % 4));
+    }
+    std::shuffle(resting.begin(), resting.end(), random);
+    std::vector<Price> spare(resting.begin() + static_cast<std::ptrdiff_t>(count), resting.end());
+    resting.resize(count);
+
+    LevelWorkload work;
+    work.initial = resting;
+    for (std::uint64_t i = 0; i < ops; ++i) work.finds.push_back(resting[random() % count]);
+    for (std::uint64_t i = 0; i < ops; ++i) {
+        Price& erased = resting[random() % count];
+        Price& added = spare[random() % count];
+        work.replaces.emplace_back(erased, added);
+        std::swap(erased, added);
+    }
+    work.touches = ops;
+    work.walks = std::max<std::uint64_t>(ops / count, 1);
+
+    std::cout << "levels=" << count << " over " << 8 * count << " ticks, ops=" << ops << "\n";
+    auto report = [](const char* name, const LevelTimings& timings) {
+        std::cout << "  " << name << "build " << timings.build << " ns/level, find " << timings.find
+                  << " ns, touch " << timings.touch << " ns, replace " << timings.replace << " ns, walk "
+                  << timings.walk << " ns/level\n";
+        return timings.checksum;
+    };
+    const std::uint64_t mapSum = report("std::map:      ", TimeLevels<StdMapLevels::Map<Quantity, false>>(work));
+    const std::uint64_t hybridSum = report("HybridLevelMap:", TimeLevels<HybridLevels::Map<Quantity, false>>(work));
+    const std::uint64_t treeSum = report("BTreeLevelMap: ", TimeLevels<BTreeLevels::Map<Quantity, false>>(work));
+    const bool match = mapSum == hybridSum && mapSum == treeSum;
+    std::cout << (match ? "checksums match" : "CHECKSUMS DIFFER") << "\n";
+    return match ? 0 : 1;
+}
+
+/**
+ * @returns bytes the allocator has handed out and not yet had back (heap
+ * chunks plus blocks large enough to be mapped on their own), 0 where that
+ * is not available
+ */
+static std::size_t HeapBytesInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Measures what a resting order costs in memory and how fast the book
+ * matches: --orders resting orders across --levels ticks a side, then
+ * --ops FillAndKill orders alternately lifting offers and hitting bids by
+ * up to 300 lots, each followed by resting orders that replace what it took
+ * Usage: main matchbench [--orders <n>] [--levels <n>] [--ops <n>]
+ */
+static int RunMatchBenchmark(int argc, char* argv[]) {
+    const std::uint64_t orders = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--orders", 1000000), 1);
+    const std::uint64_t levels = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--levels", 200), 1);
+    const std::uint64_t ops = GetNumericOption(argc, argv, "--ops", 1000000);
+
+    std::mt19937_64 random(29);
+    OrderId nextId = 1;
+    auto rest = [&](OrderBook& book, Side side) {
+        const Price offset = 1 + static_cast<Price>(random() % levels);
+        const Quantity quantity = 1 + random() % 100;
+        book.AddOrder(Order(OrderType::GoodTilCancel, nextId++, side, side == Side::Buy ? 10000 - offset : 10000 + offset,
+                            quantity));
+        return quantity;
+    };
+
+    const std::size_t heapBefore = HeapBytesInUse();
+    auto book = std::make_unique<OrderBook>();
+    std::uint64_t start = NowNanos();
+    for (std::uint64_t i = 0; i < orders; ++i) rest(*book, (i & 1) ? Side::Sell : Side::Buy);
+    const std::uint64_t buildNanos = NowNanos() - start;
+    const std::size_t heapAfter = HeapBytesInUse();
+
+    std::uint64_t fills = 0;
+    Quantity filled = 0;
+    start = NowNanos();
+    for (std::uint64_t i = 0; i < ops; ++i) {
+        const Side side = (i & 1) ? Side::Sell : Side::Buy;
+        const Price limit = side == Side::Buy ? 10000 + static_cast<Price>(levels) : 10000 - static_cast<Price>(levels);
+        const Trades trades = book->AddOrder(Order(OrderType::FillAndKill, nextId++, side, limit, 1 + random() % 300));
+        Quantity taken = 0;
+        for (const Trade& trade : trades) taken += trade.GetBidTrade().quantity;
+        fills += trades.size();
+        filled += taken;
+        const Side resting = side == Side::Buy ? Side::Sell : Side::Buy;
+        for (Quantity added = 0; added < taken;) added += rest(*book, resting);
+    }
+    const std::uint64_t matchNanos = NowNanos() - start;
+
+    std::cout << orders << " resting orders over " << levels << " levels a side\n"
+              << "  build: " << buildNanos / orders << " ns/order";
+    if (heapAfter > heapBefore) std::cout << ", " << (heapAfter - heapBefore) / orders << " heap bytes/order";
+    std::cout << "\n  match: " << ops << " orders, " << fills << " fills, " << filled << " lots, "
+              << matchNanos / std::max<std::uint64_t>(ops, 1) << " ns/order, "
+              << matchNanos / std::max<std::uint64_t>(fills, 1) << " ns/fill\n"
+              << "  " << book->Size() << " orders resting after\n";
+    return 0;
+}
 
-        for (const auto& orderPair : asks) {
-            const OrderList& orderList = orderPair.second;
-            if (!orderList.empty() && 
-                orderList.front()->GetOrderType() == OrderType::FillAndKill) {
-                CancelOrder(orderList.front()->GetOrderId());
+/**
+ * Times large orders sweeping the book: each round rests --levels ask
+ * levels of --orders-per-level orders of 1 to 5 lots, then one FillAndKill
+ * buy takes every level. Only the sweep is timed. The same rounds run
+ * first with whole-level sweeps turned off, as the per-order baseline.
+ * --depth 1 asks a depth query first, so the book also maintains its
+ * depth ladders.
+ * Usage: main sweepbench [--levels <n>] [--orders-per-level <n>] [--rounds <n>] [--depth 0|1]
+ */
+static int RunSweepBenchmark(int argc, char* argv[]) {
+    const std::uint64_t levels = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--levels", 20), 1);
+    const std::uint64_t perLevel = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--orders-per-level", 1000), 1);
+    const std::uint64_t rounds = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--rounds", 50), 1);
+    const bool depth = GetNumericOption(argc, argv, "--depth", 0) != 0;
+
+    std::cout << rounds << " sweeps through " << levels << " levels of " << perLevel << " orders\n";
+    // @returns nanoseconds spent sweeping, or 0 if a round left the book inconsistent
+    auto run = [&](const char* name, bool levelSweeps) -> std::uint64_t {
+        std::mt19937_64 random(31);
+        OrderBook book;
+        book.SetLevelSweeps(levelSweeps);
+        OrderId nextId = 1;
+        std::uint64_t fills = 0;
+        std::uint64_t sweepNanos = 0;
+        if (depth) book.EstimateFill(Side::Buy, 0);
+        for (std::uint64_t round = 0; round < rounds; ++round) {
+            Quantity total = 0;
+            for (std::uint64_t level = 0; level < levels; ++level) {
+                for (std::uint64_t i = 0; i < perLevel; ++i) {
+                    const Quantity quantity = 1 + random() % 5;
+                    book.AddOrder(Order(OrderType::GoodTilCancel, nextId++, Side::Sell,
+                                        10001 + static_cast<Price>(level), quantity));
+                    total += quantity;
+                }
             }
+            const std::uint64_t start = NowNanos();
+            const Trades trades = book.AddOrder(Order(OrderType::FillAndKill, nextId++, Side::Buy,
+                                                      10000 + static_cast<Price>(levels), total));
+            sweepNanos += NowNanos() - start;
+            fills += trades.size();
         }
+        std::cout << "  " << name << ": " << sweepNanos / rounds / 1000 << " us/sweep, "
+                  << sweepNanos / std::max<std::uint64_t>(fills, 1) << " ns/fill\n";
+        return book.Size() == 0 && fills == rounds * levels * perLevel ? std::max<std::uint64_t>(sweepNanos, 1) : 0;
+    };
+    const std::uint64_t perOrder = run("per-order loop", false);
+    const std::uint64_t swept = run("level sweeps  ", true);
+    if (perOrder == 0 || swept == 0) return 1;
+    std::cout << "  speedup: " << static_cast<double>(perOrder) / static_cast<double>(swept) << "x\n";
+    return 0;
+}
 
+/**
+ * ReferenceBook is the plainest price-time book there is: one vector of
+ * resting orders, scanned in full for every match and every query. It is
+ * far too slow to serve, which is what makes it easy to trust; selftest
+ * checks BasicOrderBook against it.
+ */
+class ReferenceBook {
+public:
+    struct Entry {
+        OrderId id;
+        Side side;
+        OrderType type;
+        Price price;
+        Quantity quantity;
+        std::uint64_t sequence;  // Arrival order; the FIFO position within a price
+        OwnerId owner;
+    };
+
+    Trades Add(OrderType type, OrderId id, Side side, Price price, Quantity quantity, OwnerId owner) {
+        Trades trades;
+        if (Find(id)) return trades;
+        if (type == OrderType::FillAndKill) {
+            const Entry* best = Best(side == Side::Buy ? Side::Sell : Side::Buy);
+            if (!best || (side == Side::Buy ? price < best->price : price > best->price)) return trades;
+        }
+        orders.push_back(Entry{id, side, type, price, quantity, nextSequence++, owner});
+        for (;;) {
+            Entry* bid = Best(Side::Buy);
+            Entry* ask = Best(Side::Sell);
+            if (!bid || !ask || bid->price < ask->price) break;
+            const Quantity quantity = std::min(bid->quantity, ask->quantity);
+            bid->quantity -= quantity;
+            ask->quantity -= quantity;
+            trades.emplace_back(TradeInfo(bid->id, bid->price, quantity), TradeInfo(ask->id, ask->price, quantity));
+            const OrderId bidId = bid->id;
+            const OrderId askId = ask->id;
+            if (bid->quantity == 0) Cancel(bidId);
+            if (ask->quantity == 0) Cancel(askId);
+        }
+        if (type == OrderType::FillAndKill) Cancel(id);
         return trades;
     }
 
-public:
+    void Cancel(OrderId id) {
+        auto it = std::find_if(orders.begin(), orders.end(), [id](const Entry& entry) { return entry.id == id; });
+        if (it != orders.end()) orders.erase(it);
+    }
+
+    void Reduce(OrderId id, Quantity quantity) {
+        Entry* entry = Find(id);
+        if (entry && (entry->quantity -= quantity) == 0) Cancel(id);
+    }
+
+    std::size_t CancelMatching(const MassCancelFilter& filter) {
+        return std::erase_if(orders, [&filter](const Entry& entry) {
+            return (filter.owner == 0 || entry.owner == filter.owner) && filter.Matches(entry.side, entry.price);
+        });
+    }
+
+    Entry* Find(OrderId id) {
+        for (Entry& entry : orders) {
+            if (entry.id == id) return &entry;
+        }
+        return nullptr;
+    }
+
+    const std::vector<Entry>& GetOrders() const { return orders; }
+
     /**
-     * Adds a new order to the book
-     * @returns vector of trades if order was matched
+     * @returns the side's levels, best price first
      */
-    Trades AddOrder(OrderPtr order) {
-        if (orders.find(order->GetOrderId()) != orders.end()) {
-            return Trades();
+    LevelInfos GetLevels(Side side) const {
+        std::map<Price, Quantity> levels;
+        for (const Entry& entry : orders) {
+            if (entry.side == side) levels[entry.price] += entry.quantity;
         }
+        LevelInfos infos;
+        for (const auto& [price, quantity] : levels) infos.emplace_back(price, quantity);
+        if (side == Side::Buy) std::reverse(infos.begin(), infos.end());
+        return infos;
+    }
+
+    FillEstimate EstimateFill(Side side, Quantity quantity) const {
+        FillEstimate estimate;
+        for (const LevelInfo& level : GetLevels(side == Side::Buy ? Side::Sell : Side::Buy)) {
+            if (estimate.quantity >= quantity) break;
+            const Quantity taken = std::min(level.quantity, quantity - estimate.quantity);
+            estimate.quantity += taken;
+            estimate.notional += static_cast<std::int64_t>(taken) * level.price;
+            estimate.worstPrice = level.price;
+        }
+        return estimate;
+    }
+
+    Quantity GetQuantityUpTo(Side side, Price limit) const {
+        Quantity total = 0;
+        for (const Entry& entry : orders) {
+            if (entry.side != side && (side == Side::Buy ? entry.price <= limit : entry.price >= limit)) {
+                total += entry.quantity;
+            }
+        }
+        return total;
+    }
 
-        if (order->GetOrderType() == OrderType::FillAndKill && 
-            !CanMatch(order->GetSide(), order->GetPrice())) {
-            return Trades();
+    QueuePosition GetQueuePosition(const Entry& order) const {
+        QueuePosition position;
+        for (const Entry& entry : orders) {
+            if (entry.side != order.side || entry.price != order.price || entry.id == order.id) continue;
+            (entry.sequence < order.sequence ? position.ahead : position.behind) += entry.quantity;
         }
+        return position;
+    }
+
+private:
+    Entry* Best(Side side) {
+        Entry* best = nullptr;
+        for (Entry& entry : orders) {
+            if (entry.side != side) continue;
+            if (!best || (side == Side::Buy ? entry.price > best->price : entry.price < best->price) ||
+                (entry.price == best->price && entry.sequence < best->sequence)) {
+                best = &entry;
+            }
+        }
+        return best;
+    }
+
+    std::vector<Entry> orders;
+    std::uint64_t nextSequence = 0;
+};
 
-        if (order->GetSide() == Side::Buy) {
-            ProcessOrder(order, bids);
+static bool SameTrades(const Trades& lhs, const Trades& rhs) {
+    auto same = [](const TradeInfo& a, const TradeInfo& b) {
+        return a.orderId == b.orderId && a.price == b.price && a.quantity == b.quantity;
+    };
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [&same](const Trade& a, const Trade& b) {
+        return same(a.GetBidTrade(), b.GetBidTrade()) && same(a.GetAskTrade(), b.GetAskTrade());
+    });
+}
+
+static bool SameLevels(const LevelInfos& lhs, const LevelInfos& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const LevelInfo& a, const LevelInfo& b) {
+        return a.price == b.price && a.quantity == b.quantity;
+    });
+}
+
+/**
+ * Replays one seeded flow of adds (some duplicates, some FillAndKill, a few
+ * far from the touch), cancels, modifies, mass cancels, level-3 executions
+ * and reductions, and replaces through a book and a ReferenceBook. After
+ * every step it compares the trades, both sides' levels, the order count,
+ * every resting order's queue position and a depth query per side.
+ * @returns the first difference, or an empty string if there was none
+ */
+template <typename LevelStore>
+static std::string CheckAgainstReference(std::uint64_t seed, std::uint64_t steps, bool levelSweeps) {
+    std::mt19937_64 random(seed);
+    BasicOrderBook<LevelStore> book;
+    book.SetLevelSweeps(levelSweeps);
+    ReferenceBook reference;
+    std::vector<OrderId> ids;
+    OrderId nextId = 1;
+    const Price span = seed % 2 ? 11 : 3;  // Odd seeds spread orders out, even ones stack deep queues
+
+    auto randomSide = [&random] { return (random() & 1) ? Side::Sell : Side::Buy; };
+    auto randomPrice = [&random] { return 95 + static_cast<Price>(random() % 11); };
+    auto randomQuantity = [&random] { return 1 + random() % (random() % 8 == 0 ? 200 : 20); };
+
+    for (std::uint64_t step = 0; step < steps; ++step) {
+        const std::string where = "seed " + std::to_string(seed) + " step " + std::to_string(step) + ": ";
+        const OrderId pick = ids.empty() ? 999999 : ids[random() % ids.size()];
+        const std::uint64_t action = random() % 10;
+        if (action < 5) {
+            const Side side = randomSide();
+            const OrderType type = random() % 6 == 0 ? OrderType::FillAndKill : OrderType::GoodTilCancel;
+            Price price = 95 + static_cast<Price>(random() % span);
+            const std::uint64_t far = random() % 300;
+            if (far == 0) {
+                price += 3000000;  // Wider than the depth ladders cover
+            } else if (far < 3) {
+                price += 5000 + static_cast<Price>(random() % 3);  // Outside the level window
+            }
+            const Quantity quantity = randomQuantity();
+            const OrderId id = random() % 20 == 0 && !ids.empty() ? pick : nextId++;
+            const OwnerId owner = id % 4;
+            const Trades trades = book.AddOrder(Order(type, id, side, price, quantity), owner);
+            if (!SameTrades(trades, reference.Add(type, id, side, price, quantity, owner))) return where + "add trades";
+            ids.push_back(id);
+        } else if (action < 7 && random() % 40 == 0) {
+            MassCancelFilter filter;
+            filter.owner = random() % 4;
+            if (random() & 1) filter.side = randomSide();
+            if (random() & 1) {
+                filter.minPrice = randomPrice();
+                filter.maxPrice = filter.minPrice + static_cast<Price>(random() % 5);
+            }
+            std::size_t reported = 0;
+            const std::size_t cancelled = book.CancelOrders(filter, [&reported](const Order&) { ++reported; });
+            if (cancelled != reference.CancelMatching(filter) || reported != cancelled) return where + "mass cancel";
+        } else if (action < 7) {
+            book.CancelOrder(pick);
+            reference.Cancel(pick);
+        } else if (action < 8) {
+            const Side side = randomSide();
+            const Price price = randomPrice();
+            const Quantity quantity = randomQuantity();
+            const Trades trades = book.ModifyOrder(OrderModify(pick, side, price, quantity));
+            Trades expected;
+            if (const ReferenceBook::Entry* entry = reference.Find(pick)) {
+                const ReferenceBook::Entry original = *entry;
+                reference.Cancel(pick);
+                expected = reference.Add(original.type, pick, side, price, quantity, original.owner);
+            }
+            if (!SameTrades(trades, expected)) return where + "modify trades";
+        } else if (action < 9) {
+            if (const ReferenceBook::Entry* entry = reference.Find(pick)) {
+                const Quantity quantity = 1 + random() % entry->quantity;
+                const bool found = (random() & 1) ? book.ExecuteOrder(pick, quantity) : book.ReduceOrder(pick, quantity);
+                if (!found) return where + "resting order not found";
+                reference.Reduce(pick, quantity);
+            } else if (book.ExecuteOrder(pick, 1)) {
+                return where + "executed an order that is not resting";
+            }
         } else {
-            ProcessOrder(order, asks);
+            const Price price = randomPrice();
+            const Quantity quantity = randomQuantity();
+            const OrderId id = nextId++;
+            const Trades trades = book.ReplaceOrder(pick, id, price, quantity);
+            Trades expected;
+            if (const ReferenceBook::Entry* entry = reference.Find(pick)) {
+                const ReferenceBook::Entry original = *entry;
+                reference.Cancel(pick);
+                expected = reference.Add(original.type, id, original.side, price, quantity, original.owner);
+            }
+            if (!SameTrades(trades, expected)) return where + "replace trades";
+            ids.push_back(id);
         }
 
-        return MatchOrders();
+        const OrderbookLevelInfos infos = book.GetOrderInfos();
+        if (!SameLevels(infos.GetBids(), reference.GetLevels(Side::Buy)) ||
+            !SameLevels(infos.GetAsks(), reference.GetLevels(Side::Sell)) ||
+            book.Size() != reference.GetOrders().size()) {
+            return where + "levels";
+        }
+        for (const ReferenceBook::Entry& entry : reference.GetOrders()) {
+            const std::optional<QueuePosition> position = book.GetQueuePosition(entry.id);
+            const QueuePosition expected = reference.GetQueuePosition(entry);
+            if (!position || position->ahead != expected.ahead || position->behind != expected.behind) {
+                return where + "queue position of " + std::to_string(entry.id);
+            }
+        }
+        for (const Side side : {Side::Buy, Side::Sell}) {
+            const Quantity wanted = 1 + random() % 150;
+            const FillEstimate estimate = book.EstimateFill(side, wanted);
+            const FillEstimate expected = reference.EstimateFill(side, wanted);
+            if (estimate.quantity != expected.quantity || estimate.notional != expected.notional ||
+                (expected.quantity && estimate.worstPrice != expected.worstPrice)) {
+                return where + "fill estimate";
+            }
+            const Price limit = random() % 10 == 0 ? 95 + 3000000 : 90 + static_cast<Price>(random() % 20);
+            if (book.GetQuantityUpTo(side, limit) != reference.GetQuantityUpTo(side, limit)) {
+                return where + "quantity up to " + std::to_string(limit);
+            }
+        }
     }
+    return {};
+}
 
-    /**
-     * Cancels an existing order
-     * Removes order from both price level and ID lookup
-     */
-    void CancelOrder(OrderId orderId) {
-        auto it = orders.find(orderId);
-        if (it == orders.end()) return;
+/**
+ * Checks every level policy, with and without whole-level sweeps, against
+ * ReferenceBook over --seeds random flows of --steps operations each. Build
+ * with -DORDER_BOOK_HANDLE_CHECKS to also catch stale handles.
+ * Usage: main selftest [--seeds <n>] [--steps <n>]
+ */
+static int RunSelfTest(int argc, char* argv[]) {
+    const std::uint64_t seeds = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--seeds", 20), 1);
+    const std::uint64_t steps = GetNumericOption(argc, argv, "--steps", 4000);
 
-        OrderPtr order = it->second.order;
-        auto& orderMap = (order->GetSide() == Side::Buy) ? bids : asks;
-        
-        OrderList& orderList = orderMap[order->GetPrice()];
-        orderList.erase(it->second.location);
-        
-        if (orderList.empty()) {
-            orderMap.erase(order->GetPrice());
+    bool passed = true;
+    auto check = [&](const char* name, auto&& run) {
+        for (const bool levelSweeps : {true, false}) {
+            std::string failure;
+            for (std::uint64_t seed = 1; seed <= seeds && failure.empty(); ++seed) failure = run(seed, levelSweeps);
+            std::cout << name << (levelSweeps ? ", level sweeps:    " : ", per-order fills: ")
+                      << (failure.empty() ? "ok" : "FAILED at " + failure) << "\n";
+            passed = passed && failure.empty();
         }
-        
-        orders.erase(orderId);
+    };
+    check("HybridLevels", [steps](std::uint64_t seed, bool levelSweeps) {
+        return CheckAgainstReference<HybridLevels>(seed, steps, levelSweeps);
+    });
+    check("BTreeLevels ", [steps](std::uint64_t seed, bool levelSweeps) {
+        return CheckAgainstReference<BTreeLevels>(seed, steps, levelSweeps);
+    });
+    check("StdMapLevels", [steps](std::uint64_t seed, bool levelSweeps) {
+        return CheckAgainstReference<StdMapLevels>(seed, steps, levelSweeps);
+    });
+    return passed ? 0 : 1;
+}
+
+/**
+ * The REPL's previous parser, kept as the baseline for parsebench: one
+ * std::istringstream and a std::string per token
+ */
+static bool ParseWithStream(const std::string& line, Command& command) {
+    std::istringstream iss(line);
+    std::string verb, typeStr, sideStr;
+    iss >> verb;
+    command = Command{};
+    if (verb == "ADD") {
+        if (!(iss >> typeStr >> sideStr >> command.orderId >> command.price >> command.quantity)) return false;
+        command.type = CommandType::Add;
+        command.orderType = typeStr == "GTC" ? OrderType::GoodTilCancel : OrderType::FillAndKill;
+        command.side = sideStr == "BUY" ? Side::Buy : Side::Sell;
+        return true;
+    }
+    if (verb == "CANCEL") {
+        command.type = CommandType::Cancel;
+        return static_cast<bool>(iss >> command.orderId);
     }
+    if (verb == "MODIFY") {
+        if (!(iss >> command.orderId >> sideStr >> command.price >> command.quantity)) return false;
+        command.type = CommandType::Modify;
+        command.side = sideStr == "BUY" ? Side::Buy : Side::Sell;
+        return true;
+    }
+    if (verb == "COST") {
+        if (!(iss >> sideStr >> command.quantity)) return false;
+        command.side = sideStr == "BUY" ? Side::Buy : Side::Sell;
+        return true;
+    }
+    return false;
+}
 
-    /**
-     * Modifies an existing order
-     * Implements modification as cancel-and-replace
-     * @returns vector of trades if modified order was matched
-     */
-    Trades ModifyOrder(const OrderModify& modify) {
-        auto it = orders.find(modify.GetOrderId());
-        if (it == orders.end()) return Trades();
+/**
+ * Compares lines/second of the text command parser with the istringstream
+ * parser it replaced, over random ADD/CANCEL/MODIFY/COST lines, and checks
+ * that both produce the same Commands
+ * Usage: main parsebench [--lines <n>] [--rounds <n>]
+ */
+static int RunParseBenchmark(int argc, char* argv[]) {
+    const std::uint64_t count = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--lines", 1000000), 1);
+    const std::uint64_t rounds = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--rounds", 3), 1);
 
-        OrderType type = it->second.order->GetOrderType();
-        CancelOrder(modify.GetOrderId());
-        return AddOrder(modify.ToOrderPtr(type));
+    std::vector<std::string> lines;
+    lines.reserve(count);
+    std::mt19937_64 random(9);
+    std::vector<OrderId> live;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        const Command command = MakeRandomCommand(random, live, i);
+        const std::string side = command.side == Side::Buy ? "BUY" : "SELL";
+        if (command.type == CommandType::Cancel) {
+            lines.push_back("CANCEL " + std::to_string(command.orderId));
+        } else if (i % 10 == 0 && !live.empty()) {
+            lines.push_back("MODIFY " + std::to_string(live[random() % live.size()]) + " " + side + " " +
+                            std::to_string(command.price) + " " + std::to_string(command.quantity));
+        } else if (i % 10 == 5) {
+            lines.push_back("COST " + side + " " + std::to_string(command.quantity));
+        } else {
+            lines.push_back(std::string("ADD ") + (command.orderType == OrderType::GoodTilCancel ? "GTC " : "FAK ") +
+                            side + " " + std::to_string(command.orderId) + " " + std::to_string(command.price) + " " +
+                            std::to_string(command.quantity));
+        }
     }
 
-    /**
-     * @returns current number of active orders in the book
-     */
-    std::size_t Size() const { 
-        return orders.size(); 
+    std::uint64_t mismatches = 0;
+    for (const std::string& line : lines) {
+        Command expected;
+        Command parsed;
+        TextVerb verb;
+        const bool ok = ParseWithStream(line, expected);
+        if (ok != ParseTextCommand(line, verb, parsed) || std::memcmp(&expected, &parsed, sizeof(Command)) != 0) {
+            ++mismatches;
+        }
     }
 
-    /**
-     * Creates a snapshot of current order book state
-     * @returns aggregated level information for both sides of the book
-     */
-    OrderbookLevelInfos GetOrderInfos() const {
-        LevelInfos bidInfos, askInfos;
-        
-        for (const auto& [price, orderList] : bids) {
-            Quantity total = 0;
-            for (const auto& order : orderList) {
-                total += order->GetRemainingQuantity();
+    // Sum a field of every Command so neither loop can be optimised away
+    auto time = [&](auto&& parse) {
+        std::uint64_t best = ~0ULL;
+        std::uint64_t checksum = 0;
+        for (std::uint64_t round = 0; round < rounds; ++round) {
+            const std::uint64_t start = NowNanos();
+            for (const std::string& line : lines) {
+                Command command;
+                if (parse(line, command)) checksum += command.quantity;
             }
-            bidInfos.emplace_back(price, total);
+            best = std::min(best, NowNanos() - start);
         }
-        
-        for (const auto& [price, orderList] : asks) {
-            Quantity total = 0;
-            for (const auto& order : orderList) {
-                total += order->GetRemainingQuantity();
+        return std::pair(best, checksum);
+    };
+    const auto [streamNanos, streamSum] = time([](const std::string& line, Command& command) {
+        return ParseWithStream(line, command);
+    });
+    const auto [textNanos, textSum] = time([](const std::string& line, Command& command) {
+        TextVerb verb;
+        return ParseTextCommand(line, verb, command);
+    });
+
+    auto rate = [count](std::uint64_t nanos) {
+        return static_cast<double>(count) * 1e3 / static_cast<double>(nanos);  // Millions per second
+    };
+    std::cout << "lines=" << count << " (best of " << rounds << " rounds)\n"
+              << "istringstream: " << rate(streamNanos) << " M lines/s (" << streamNanos / count << " ns/line)\n"
+              << "text parser:   " << rate(textNanos) << " M lines/s (" << textNanos / count << " ns/line)\n"
+              << "speedup: " << static_cast<double>(streamNanos) / static_cast<double>(textNanos) << "x\n"
+              << "mismatches=" << mismatches << (streamSum == textSum ? "" : " CHECKSUMS DIFFER") << "\n";
+    return mismatches == 0 && streamSum == textSum ? 0 : 1;
+}
+
+/**
+ * Sample backtest strategy: joins the best bid and ask with one order each,
+ * re-quoting when the touch moves away, and every takeEvery events crosses
+ * the spread with a FillAndKill order in the direction that reduces its
+ * position. Quoting stops on a side once the position reaches the limit.
+ */
+struct TouchQuoter {
+    Quantity size = 100;
+    std::uint64_t takeEvery = 0;
+    std::int64_t positionLimit = 1000;
+
+    std::int64_t position = 0;
+    std::int64_t cash = 0;  // Ticks
+    std::uint64_t events = 0;
+    OrderId quotes[2] = {0, 0};  // Buy, Sell
+    bool cancelling[2] = {false, false};
+
+    template <typename Sim>
+    void OnFill(Sim&, const BacktestFill& fill) {
+        const auto quantity = static_cast<std::int64_t>(fill.quantity);
+        position += fill.side == Side::Buy ? quantity : -quantity;
+        cash += (fill.side == Side::Buy ? -quantity : quantity) * fill.price;
+    }
+
+    template <typename Sim>
+    void OnEvent(Sim& sim) {
+        ++events;
+        for (const Side side : {Side::Buy, Side::Sell}) Quote(sim, side);
+        if (takeEvery && events % takeEvery == 0) {
+            const Side side = position > 0 ? Side::Sell : Side::Buy;
+            const std::optional<Price> touch = sim.GetBook().GetBestPrice(side == Side::Buy ? Side::Sell : Side::Buy);
+            if (touch) sim.Submit(OrderType::FillAndKill, side, *touch, size);
+        }
+    }
+
+    template <typename Sim>
+    void Quote(Sim& sim, Side side) {
+        const int index = side == Side::Buy ? 0 : 1;
+        const std::optional<Price> touch = sim.GetBook().GetBestPrice(side);
+        if (quotes[index]) {
+            const BacktestOrder& quote = sim.GetOrder(quotes[index]);
+            if (quote.status == BacktestOrderStatus::Pending) return;
+            if (quote.status == BacktestOrderStatus::Resting) {
+                if (!cancelling[index] && touch && *touch != quote.price) {
+                    sim.Cancel(quote.id);
+                    cancelling[index] = true;
+                }
+                return;
             }
-            askInfos.emplace_back(price, total);
         }
+        quotes[index] = 0;
+        cancelling[index] = false;
+        const bool atLimit = side == Side::Buy ? position >= positionLimit : -position >= positionLimit;
+        if (touch && !atLimit) quotes[index] = sim.Submit(OrderType::GoodTilCancel, side, *touch, size);
+    }
+};
+
+/**
+ * Backtests the sample quoting strategy against one instrument of a
+ * recorded ITCH feed and reports fills, slippage and queue position
+ * Usage: main backtest <path> [--locate <n>] [--latency <ns>] [--jitter <ns>] [--size <n>]
+ *                      [--take-every <events>] [--limit <position>] [--queue-fills 0|1]
+ */
+static int RunBacktest(int argc, char* argv[]) {
+    if (argc < 3) throw std::invalid_argument("usage: backtest <path> [--locate <n>] [--latency <ns>] [--jitter <ns>]");
+    BacktestConfig config;
+    config.locate = static_cast<std::uint16_t>(GetNumericOption(argc, argv, "--locate", config.locate));
+    config.orderLatencyNanos = GetNumericOption(argc, argv, "--latency", config.orderLatencyNanos);
+    config.cancelLatencyNanos = config.orderLatencyNanos;
+    config.latencyJitterNanos = GetNumericOption(argc, argv, "--jitter", config.latencyJitterNanos);
+    config.queueFills = GetNumericOption(argc, argv, "--queue-fills", 1) != 0;
+    TouchQuoter strategy;
+    strategy.size = GetNumericOption(argc, argv, "--size", strategy.size);
+    strategy.takeEvery = GetNumericOption(argc, argv, "--take-every", 1000);
+    strategy.positionLimit = static_cast<std::int64_t>(GetNumericOption(argc, argv, "--limit", 1000));
+
+    Backtester<TouchQuoter> sim(strategy, config);
+    const std::uint64_t start = NowNanos();
+    sim.RunFile(argv[2]);
+    const double seconds = static_cast<double>(NowNanos() - start) / 1e9;
+
+    const BacktestStats& stats = sim.GetStats();
+    std::cout << "events=" << stats.events << " (other instruments skipped: " << stats.otherEvents << ") in "
+              << seconds << " s: "
+              << static_cast<std::uint64_t>(static_cast<double>(stats.events) / seconds * 3600 / 1e6)
+              << "M events/hour\n"
+              << "orders=" << stats.ordersSubmitted << " arrived=" << stats.ordersArrived
+              << " cancels=" << stats.cancelsArrived << " fills=" << stats.fills << " (aggressive "
+              << stats.aggressiveFills << ", passive " << stats.passiveFills << ", queue " << stats.queueFills
+              << ") quantity=" << stats.filledQuantity << "\n";
+
+    double slippage[2] = {0, 0};  // Quantity-weighted, takers then quotes
+    Quantity filled[2] = {0, 0};
+    Quantity queueAhead = 0;
+    std::uint64_t rested = 0;
+    for (const BacktestOrder& order : sim.GetOrders()) {
+        const int kind = order.type == OrderType::FillAndKill ? 0 : 1;
+        slippage[kind] += order.GetSlippage() * static_cast<double>(order.filled);
+        filled[kind] += order.filled;
+        if (order.queueAhead) {
+            queueAhead += *order.queueAhead;
+            ++rested;
+        }
+    }
+    for (int kind = 0; kind < 2; ++kind) {
+        std::cout << (kind == 0 ? "takers" : "quotes") << ": filled=" << filled[kind] << " slippage="
+                  << (filled[kind] ? slippage[kind] / static_cast<double>(filled[kind]) : 0.0)
+                  << " ticks vs decision mid\n";
+    }
+    std::cout << "average queue ahead on arrival: " << (rested ? queueAhead / rested : 0) << "\n";
+
+    const std::optional<Price> bid = sim.GetBook().GetBestPrice(Side::Buy);
+    const std::optional<Price> ask = sim.GetBook().GetBestPrice(Side::Sell);
+    const double mid = bid && ask ? (static_cast<double>(*bid) + static_cast<double>(*ask)) / 2 : 0.0;
+    std::cout << "position=" << strategy.position << " pnl="
+              << static_cast<double>(strategy.cash) + static_cast<double>(strategy.position) * mid
+              << " ticks at final mid " << mid << "\n"
+              << "feed orders consumed by the strategy: " << sim.GetFeedStats().unknownOrders << " later references\n";
+    return 0;
+}
+
+/**
+ * Runs the sample strategy over every (day file, instrument) pair on a
+ * worker pool and merges the results
+ * Usage: main backtestbatch <path>... [--workers <n>] [--latency <ns>] [--jitter <ns>] [--size <n>]
+ *                           [--take-every <events>] [--limit <position>] [--verbose 0|1]
+ */
+static int RunBacktestBatch(int argc, char* argv[]) {
+    std::vector<std::string> paths;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--", 2) == 0) {
+            ++i;  // Skip the option's value
+            continue;
+        }
+        paths.emplace_back(argv[i]);
+    }
+    if (paths.empty()) throw std::invalid_argument("usage: backtestbatch <path>... [--workers <n>] [--latency <ns>]");
+
+    BacktestRunnerConfig config;
+    config.workers = std::max<std::uint64_t>(GetNumericOption(argc, argv, "--workers", std::thread::hardware_concurrency()), 1);
+    config.backtest.orderLatencyNanos = GetNumericOption(argc, argv, "--latency", config.backtest.orderLatencyNanos);
+    config.backtest.cancelLatencyNanos = config.backtest.orderLatencyNanos;
+    config.backtest.latencyJitterNanos = GetNumericOption(argc, argv, "--jitter", config.backtest.latencyJitterNanos);
+    TouchQuoter prototype;
+    prototype.size = GetNumericOption(argc, argv, "--size", prototype.size);
+    prototype.takeEvery = GetNumericOption(argc, argv, "--take-every", 1000);
+    prototype.positionLimit = static_cast<std::int64_t>(GetNumericOption(argc, argv, "--limit", 1000));
+    const bool verbose = GetNumericOption(argc, argv, "--verbose", 0) != 0;
+
+    const std::vector<BacktestJob> jobs = MakeBacktestJobs(paths);
+    BacktestRunner<TouchQuoter> runner(config);
+    const auto results = runner.Run(jobs, prototype);
+
+    BacktestStats stats;
+    BacktestSummary summary;
+    std::int64_t position = 0;
+    std::int64_t cash = 0;
+    std::uint64_t cpuNanos = 0;
+    for (const auto& result : results) {
+        stats.Merge(result.stats);
+        summary.Merge(result.summary);
+        position += result.strategy.position;
+        cash += result.strategy.cash;
+        cpuNanos += result.cpuNanos;
+        if (verbose) {
+            std::cout << result.job.path << " " << result.symbol << ": events=" << result.stats.events
+                      << " fills=" << result.stats.fills << " position=" << result.strategy.position
+                      << " worker=" << result.worker << " " << result.nanos / 1000000 << " ms\n";
+        }
+    }
 
-        return OrderbookLevelInfos(bidInfos, askInfos);
+    const double seconds = static_cast<double>(runner.GetWallNanos()) / 1e9;
+    std::cout << jobs.size() << " jobs (" << paths.size() << " days) on " << config.workers << " workers in "
+              << seconds << " s\n"
+              << "events=" << stats.events << ": "
+              << static_cast<std::uint64_t>(static_cast<double>(stats.events) / seconds * 3600 / 1e6)
+              << "M events/hour; core utilisation "
+              << static_cast<double>(cpuNanos) / static_cast<double>(runner.GetWallNanos() * config.workers) << "\n"
+              << "orders=" << summary.orders << " fills=" << stats.fills << " (aggressive " << stats.aggressiveFills
+              << ", passive " << stats.passiveFills << ", queue " << stats.queueFills << ") quantity=" << summary.filled
+              << "\n"
+              << "slippage=" << summary.GetAverageSlippage() << " ticks vs decision mid; average queue ahead on arrival "
+              << (summary.rested ? summary.queueAhead / summary.rested : 0) << "\n"
+              << "net position=" << position << " cash=" << cash << " ticks\n";
+    for (std::size_t worker = 0; worker < runner.GetWorkerNanos().size(); ++worker) {
+        std::cout << "  worker " << worker << ": cpu " << runner.GetWorkerNanos()[worker] / 1000000 << " ms\n";
     }
+    return 0;
+}
+
+/**
+ * Output of the REPL: responses are formatted with std::to_chars into one
+ * reusable buffer and written to stdout in bulk, not per << as std::cout
+ * would. Doubles use the same "%g" style as the default ostream.
+ */
+class ReplOutput {
+public:
+    static constexpr std::size_t FlushThreshold = 1 << 16;
+
+    ReplOutput() { text.reserve(2 * FlushThreshold); }
+    ~ReplOutput() { Flush(); }
+
+    ReplOutput& operator<<(std::string_view value) {
+        text.append(value);
+        return *this;
+    }
+
+    ReplOutput& operator<<(char value) {
+        text.push_back(value);
+        return *this;
+    }
+
+    template <typename Integer, typename = std::enable_if_t<std::is_integral_v<Integer>>>
+    ReplOutput& operator<<(Integer value) {
+        char digits[24];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        text.append(digits, static_cast<std::size_t>(result.ptr - digits));
+        return *this;
+    }
+
+    ReplOutput& operator<<(double value) {
+        char digits[32];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+        text.append(digits, static_cast<std::size_t>(result.ptr - digits));
+        return *this;
+    }
+
+    /**
+     * Writes out the buffer once it holds at least FlushThreshold bytes
+     */
+    void FlushIfFull() {
+        if (text.size() >= FlushThreshold) Flush();
+    }
+
+    void Flush() {
+        if (text.empty()) return;
+        std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+        std::cout.flush();
+        text.clear();
+    }
+
+private:
+    std::string text;
 };
 
+static void PrintTrades(ReplOutput& out, const Trades& trades) {
+    for (const Trade& trade : trades) {
+        const TradeInfo& bid = trade.GetBidTrade();
+        const TradeInfo& ask = trade.GetAskTrade();
+        out << "  Trade: bid " << bid.orderId << ' ' << bid.quantity << '@' << bid.price << " ask " << ask.orderId
+            << ' ' << ask.quantity << '@' << ask.price << '\n';
+    }
+}
+
 /**
- * Example usage of the OrderBook system
+ * Example usage of the OrderBook system: reads commands from stdin. The
+ * interactive REPL prompts and flushes after every command; batch mode
+ * (interactive == false) prints no banner or prompts and flushes in bulk,
+ * for scripted and piped input. With printTrades each ADD/MODIFY also lists
+ * its trades.
  */
-int main() {
+static int RunInteractive(bool interactive, bool printTrades) {
     OrderBook orderbook;
+    TradeAnalytics analytics;
+    ReplOutput out;
     std::string line;
 
-    std::cout << "Welcome to the Order Book System.\n";
-    std::cout << "Commands: ADD, CANCEL, MODIFY, SNAPSHOT, EXIT\n";
+    if (interactive) {
+        out << "Welcome to the Order Book System.\n";
+        out << "Commands: ADD, CANCEL, MODIFY, MASSCANCEL, QUEUE, COST, DEPTH, STATS, BARS, SNAPSHOT, EXIT\n";
+    } else {
+        std::ios::sync_with_stdio(false);  // Let std::cin buffer its own reads
+    }
 
     while (true) {
-        std::cout << "\nEnter command: ";
-        std::getline(std::cin, line);
+        if (interactive) {
+            out << "\nEnter command: ";
+            out.Flush();
+        } else {
+            out.FlushIfFull();
+        }
+        if (!std::getline(std::cin, line)) break;
 
-        // Use a string stream to parse the command
-        std::istringstream iss(line);
-        std::string command;
-        iss >> command;
+        TextVerb verb;
+        Command command;
+        if (!ParseTextCommand(line, verb, command)) {
+            if (verb == TextVerb::Unknown) {
+                out << "Unknown command. Please try again.\n";
+            } else if (verb != TextVerb::None) {
+                out << "Invalid input format for " << GetTextVerbName(verb) << ".\n";
+            }
+            continue;
+        }
+        if (verb == TextVerb::Exit) break;
 
-        if (command == "EXIT") {
+        switch (verb) {
+        case TextVerb::Add: {
+            Trades trades = orderbook.AddOrder(
+                Order(command.orderType, command.orderId, command.side, command.price, command.quantity));
+            analytics.Advance(NowNanos());
+            for (const Trade& trade : trades) analytics.OnTrade(trade, command.side);
+            out << "Order added. Trades executed: " << trades.size() << "\n";
+            if (printTrades) PrintTrades(out, trades);
+            break;
+        }
+        case TextVerb::Cancel:
+            orderbook.CancelOrder(command.orderId);
+            out << "Order " << command.orderId << " cancelled.\n";
+            break;
+        case TextVerb::Modify: {
+            Trades trades = orderbook.ModifyOrder(
+                OrderModify(command.orderId, command.side, command.price, command.quantity));
+            analytics.Advance(NowNanos());
+            for (const Trade& trade : trades) analytics.OnTrade(trade, command.side);
+            out << "Order modified. Trades executed: " << trades.size() << "\n";
+            if (printTrades) PrintTrades(out, trades);
             break;
         }
-        else if (command == "ADD") {
-            // Expected format:
-            // ADD <OrderType> <Side> <OrderId> <Price> <Quantity>
-            std::string orderTypeStr, sideStr;
-            OrderId id;
-            Price price;
-            Quantity quantity;
-            if (!(iss >> orderTypeStr >> sideStr >> id >> price >> quantity)) {
-                std::cout << "Invalid input format for ADD.\n";
-                continue;
-            }
-            // Map string to enum values
-            OrderType orderType = (orderTypeStr == "GTC") ? OrderType::GoodTilCancel : OrderType::FillAndKill;
-            Side side = (sideStr == "BUY") ? Side::Buy : Side::Sell;
-
-            auto order = std::make_shared<Order>(orderType, id, side, price, quantity);
-            Trades trades = orderbook.AddOrder(order);
-
-            std::cout << "Order added. Trades executed: " << trades.size() << "\n";
-            // Optionally, you can print details of each trade here.
-        }
-        else if (command == "CANCEL") {
-            // Expected format: CANCEL <OrderId>
-            OrderId id;
-            if (!(iss >> id)) {
-                std::cout << "Invalid input format for CANCEL.\n";
-                continue;
-            }
-            orderbook.CancelOrder(id);
-            std::cout << "Order " << id << " cancelled.\n";
-        }
-        else if (command == "MODIFY") {
-            // Expected format:
-            // MODIFY <OrderId> <Side> <Price> <Quantity>
-            OrderId id;
-            std::string sideStr;
-            Price price;
-            Quantity quantity;
-            if (!(iss >> id >> sideStr >> price >> quantity)) {
-                std::cout << "Invalid input format for MODIFY.\n";
-                continue;
-            }
-            Side side = (sideStr == "BUY") ? Side::Buy : Side::Sell;
-            OrderModify modify(id, side, price, quantity);
-            Trades trades = orderbook.ModifyOrder(modify);
-            std::cout << "Order modified. Trades executed: " << trades.size() << "\n";
-        }
-        else if (command == "SNAPSHOT") {
+        case TextVerb::MassCancel: {
+            MassCancelFilter filter;
+            if (!command.allSides) filter.side = command.side;
+            filter.minPrice = command.price;
+            filter.maxPrice = command.maxPrice;
+            const std::size_t cancelled = orderbook.CancelOrders(filter, [](const Order&) {});
+            out << "Orders cancelled: " << cancelled << "\n";
+            break;
+        }
+        case TextVerb::Queue: {
+            const auto position = orderbook.GetQueuePosition(command.orderId);
+            if (!position) {
+                out << "Order " << command.orderId << " is not resting.\n";
+                break;
+            }
+            out << "Ahead: " << position->ahead << " Behind: " << position->behind << "\n";
+            break;
+        }
+        case TextVerb::Cost: {
+            const FillEstimate estimate = orderbook.EstimateFill(command.side, command.quantity);
+            out << "Fillable: " << estimate.quantity << " Average price: " << estimate.GetAveragePrice()
+                << " Worst price: " << estimate.worstPrice << "\n";
+            break;
+        }
+        case TextVerb::Depth:
+            out << "Available up to " << command.price << ": "
+                << orderbook.GetQuantityUpTo(command.side, command.price) << "\n";
+            break;
+        case TextVerb::Stats: {
+            // Running trade statistics
+            analytics.Advance(NowNanos());
+            const Bar& bar = analytics.GetOpenBar();
+            out << "Last: " << analytics.GetLastPrice() << " VWAP: " << analytics.GetVwap()
+                << " Volume: " << analytics.GetVolume() << " Trades: " << analytics.GetTradeCount()
+                << " Rolling volume: " << analytics.GetRollingVolume() << "\n";
+            if (bar.trades > 0) {
+                out << "Open bar: O " << bar.open << " H " << bar.high << " L " << bar.low << " C " << bar.close
+                    << " V " << bar.volume << "\n";
+            }
+            break;
+        }
+        case TextVerb::Bars: {
+            analytics.Advance(NowNanos());
+            const std::size_t count = std::min<std::size_t>(command.quantity, analytics.GetBarCount());
+            for (std::size_t age = count; age-- > 0;) {
+                const Bar& bar = analytics.GetBar(age);
+                out << "Bar " << bar.startNanos << ": O " << bar.open << " H " << bar.high << " L " << bar.low
+                    << " C " << bar.close << " V " << bar.volume << " VWAP " << bar.GetVwap() << "\n";
+            }
+            break;
+        }
+        case TextVerb::Snapshot: {
             // Print a summary of the current order book state.
             OrderbookLevelInfos infos = orderbook.GetOrderInfos();
-            const LevelInfos& bidLevels = infos.GetBids();
-            const LevelInfos& askLevels = infos.GetAsks();
-            
-            std::cout << "\nOrder Book Snapshot:\n";
-            std::cout << "Bids:\n";
-            for (const auto& level : bidLevels) {
-                std::cout << "Price: " << level.price << " Quantity: " << level.quantity << "\n";
+            out << "\nOrder Book Snapshot:\n";
+            out << "Bids:\n";
+            for (const auto& level : infos.GetBids()) {
+                out << "Price: " << level.price << " Quantity: " << level.quantity << "\n";
             }
-            std::cout << "Asks:\n";
-            for (const auto& level : askLevels) {
-                std::cout << "Price: " << level.price << " Quantity: " << level.quantity << "\n";
+            out << "Asks:\n";
+            for (const auto& level : infos.GetAsks()) {
+                out << "Price: " << level.price << " Quantity: " << level.quantity << "\n";
             }
+            break;
         }
-        else {
-            std::cout << "Unknown command. Please try again.\n";
+        default:
+            break;
         }
     }
 
-    std::cout << "Exiting Order Book System.\n";
+    if (interactive) out << "Exiting Order Book System.\n";
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    const std::string mode = argc > 1 ? argv[1] : "";
+    try {
+#if defined(__linux__)
+        if (mode == "gateway") return RunGateway(argc, argv);
+        if (mode == "loadgen") return RunLoadGenerator(argc, argv);
+        if (mode == "gatewaybench") return RunGatewayBenchmark(argc, argv);
+        if (mode == "replay") return RunJournalReplay(argc, argv);
+        if (mode == "shm-server") return RunShmServer(argc, argv);
+        if (mode == "shmbench") return RunShmBenchmark(argc, argv);
+        if (mode == "fix") return RunFixAcceptor(argc, argv);
+        if (mode == "fixsessions") return RunFixSessionBenchmark(argc, argv);
+        if (mode == "fixcheck") return RunFixCheck(argc, argv);
+        if (mode == "mdlisten") return RunMarketDataListener(argc, argv);
+        if (mode == "mdbench") return RunMarketDataBenchmark(argc, argv);
+        if (mode == "dropcopy") return RunDropCopyListener(argc, argv);
+        if (mode == "dropcopybench") return RunDropCopyBenchmark(argc, argv);
+#endif
+        if (mode == "fixgen") return RunFixLogGenerator(argc, argv);
+        if (mode == "fixbench") return RunFixBenchmark(argc, argv);
+        if (mode == "itchgen") return RunItchGenerator(argc, argv);
+        if (mode == "itch") return RunItchReplay(argc, argv);
+        if (mode == "pipeline") return RunPipeline(argc, argv);
+        if (mode == "pipelinebench") return RunPipelineBenchmark(argc, argv);
+        if (mode == "schedbench") return RunSchedulerBenchmark(argc, argv);
+        if (mode == "masscancelbench") return RunMassCancelBenchmark(argc, argv);
+        if (mode == "analyticsbench") return RunAnalyticsBenchmark(argc, argv);
+        if (mode == "depthbench") return RunDepthBenchmark(argc, argv);
+        if (mode == "parsebench") return RunParseBenchmark(argc, argv);
+        if (mode == "levelbench") return RunLevelBenchmark(argc, argv);
+        if (mode == "matchbench") return RunMatchBenchmark(argc, argv);
+        if (mode == "sweepbench") return RunSweepBenchmark(argc, argv);
+        if (mode == "selftest") return RunSelfTest(argc, argv);
+        if (mode == "backtest") return RunBacktest(argc, argv);
+        if (mode == "backtestbatch") return RunBacktestBatch(argc, argv);
+        if (mode == "batch") return RunInteractive(false, GetNumericOption(argc, argv, "--trades", 0) != 0);
+        if (mode.empty()) return RunInteractive(true, false);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    std::cerr << "Unknown mode: " << mode << "\n";
+    return 1;
+}
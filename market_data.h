@@ -0,0 +1,444 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "latency_recorder.h"
+#include "order_book.h"
+
+/**
+ * Market-Data Egress
+ *
+ * MarketDataPublisher is a MatchingEngine market-data listener that turns
+ * trades and level changes into fixed-size binary messages, numbers them
+ * with a gap-free sequence and batches as many as fit into each UDP
+ * datagram (MoldUDP64-style: a packet carries the sequence number of its
+ * first message and a message count).
+ *
+ * Every published message is also kept in a retransmission ring. A
+ * receiver that sees a sequence gap sends a RetransmitRequest to the
+ * publisher's retransmission port and is answered by unicast with the
+ * missing range, or, if the range has already been overwritten, with an
+ * empty packet whose sequence is the oldest one still available.
+ *
+ * Integers are in host byte order, as in protocol.h.
+ */
+
+enum class MarketDataType : std::uint8_t {
+    Level = 'L',  // Aggregate quantity at a price level changed (0 = level removed)
+    Trade = 'T'   // Execution at the resting order's price
+};
+
+#pragma pack(push, 1)
+
+struct MarketDataPacketHeader {
+    std::uint64_t sequence;   // Sequence number of the first message
+    std::uint64_t timestamp;  // Publisher clock (NowNanos) when the packet was sent
+    std::uint16_t count;      // Messages in this packet
+};
+
+struct MarketDataMessage {
+    MarketDataType type;
+    std::uint8_t side;  // Level: the level's side; Trade: the aggressor's side (0 = Buy, 1 = Sell)
+    Price price;
+    Quantity quantity;
+};
+
+struct RetransmitRequest {
+    std::uint64_t sequence;
+    std::uint16_t count;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(MarketDataPacketHeader) == 18);
+static_assert(sizeof(MarketDataMessage) == 14);
+
+struct MarketDataConfig {
+    std::string address = "127.0.0.1";         // Unicast or multicast (224.0.0.0/4) destination
+    std::uint16_t port = 9100;
+    std::string retransmitAddress = "127.0.0.1";  // Where the publisher answers gap fills
+    std::uint16_t retransmitPort = 9101;          // 0 picks an ephemeral port
+    std::size_t maxPacketSize = 1400;             // Stays under a 1500-byte Ethernet MTU
+    std::size_t historyCapacity = 1 << 20;        // Messages kept for retransmission
+    int multicastTtl = 1;
+};
+
+struct MarketDataStats {
+    std::uint64_t messages = 0;
+    std::uint64_t packets = 0;
+    std::uint64_t bytes = 0;  // UDP payload bytes, headers included
+    std::uint64_t retransmitRequests = 0;
+    std::uint64_t retransmittedMessages = 0;
+    std::uint64_t sendErrors = 0;
+};
+
+inline sockaddr_in MakeSocketAddress(const std::string& address, std::uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        throw std::invalid_argument("invalid IPv4 address " + address);
+    }
+    return addr;
+}
+
+class MarketDataPublisher {
+public:
+    explicit MarketDataPublisher(const MarketDataConfig& config)
+        : config(config),
+          destination(MakeSocketAddress(config.address, config.port)),
+          capacity(RoundUpToPowerOfTwo(config.historyCapacity)),
+          history(capacity),
+          messagesPerPacket((config.maxPacketSize - sizeof(MarketDataPacketHeader)) / sizeof(MarketDataMessage)) {
+        if (config.maxPacketSize < sizeof(MarketDataPacketHeader) + sizeof(MarketDataMessage)) {
+            throw std::invalid_argument("MarketDataPublisher: packet size too small");
+        }
+        sendFd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        retransmitFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sendFd < 0 || retransmitFd < 0) {
+            throw std::runtime_error("MarketDataPublisher: socket() failed: " + std::string(std::strerror(errno)));
+        }
+        if (IN_MULTICAST(ntohl(destination.sin_addr.s_addr))) {
+            unsigned char ttl = static_cast<unsigned char>(config.multicastTtl);
+            unsigned char loop = 1;
+            setsockopt(sendFd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+            setsockopt(sendFd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        }
+        int bufferSize = 4 << 20;
+        setsockopt(sendFd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+        sockaddr_in bindAddr = MakeSocketAddress(config.retransmitAddress, config.retransmitPort);
+        if (bind(retransmitFd, reinterpret_cast<sockaddr*>(&bindAddr), sizeof(bindAddr)) < 0) {
+            std::string error = std::strerror(errno);
+            Close();
+            throw std::runtime_error("MarketDataPublisher: cannot bind retransmission port: " + error);
+        }
+        packet.reserve(config.maxPacketSize);
+    }
+
+    ~MarketDataPublisher() { Close(); }
+
+    MarketDataPublisher(const MarketDataPublisher&) = delete;
+    MarketDataPublisher& operator=(const MarketDataPublisher&) = delete;
+
+    // MatchingEngine market-data listener interface
+
+    void OnTrade(const Trade& trade, Side aggressor) {
+        const TradeInfo& resting = aggressor == Side::Buy ? trade.GetAskTrade() : trade.GetBidTrade();
+        Append(MarketDataMessage{MarketDataType::Trade, SideCode(aggressor), resting.price, resting.quantity});
+    }
+
+    void OnLevel(Side side, Price price, Quantity quantity) {
+        Append(MarketDataMessage{MarketDataType::Level, SideCode(side), price, quantity});
+    }
+
+    /**
+     * Sends the partially filled packet, if any. Call once per batch of
+     * commands: fewer calls mean fuller packets, more calls lower latency.
+     */
+    void Flush() {
+        if (pendingCount == 0) return;
+        SendPacket(destination, packetSequence, pendingCount, packet.data(), packet.size());
+        packetSequence = nextSequence;
+        pendingCount = 0;
+        packet.clear();
+    }
+
+    /**
+     * Answers queued retransmission requests without blocking
+     * @returns number of requests served
+     */
+    std::size_t ServiceRetransmissions() {
+        std::size_t served = 0;
+        while (true) {
+            RetransmitRequest request;
+            sockaddr_in from{};
+            socklen_t fromLength = sizeof(from);
+            ssize_t n = recvfrom(retransmitFd, &request, sizeof(request), 0, reinterpret_cast<sockaddr*>(&from),
+                                 &fromLength);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return served;
+            }
+            if (static_cast<std::size_t>(n) != sizeof(request)) continue;
+            ++stats.retransmitRequests;
+            ++served;
+            Retransmit(from, request);
+        }
+    }
+
+    /**
+     * @returns the sequence number the next message will get
+     */
+    std::uint64_t GetNextSequence() const { return nextSequence; }
+
+    /**
+     * For event loops that wait for retransmission requests themselves; call
+     * ServiceRetransmissions once it is readable
+     */
+    int GetRetransmitFd() const { return retransmitFd; }
+
+    std::uint16_t GetRetransmitPort() const {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(retransmitFd, reinterpret_cast<sockaddr*>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+    const MarketDataStats& GetStats() const { return stats; }
+
+private:
+    static std::size_t RoundUpToPowerOfTwo(std::size_t n) {
+        std::size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    static std::uint8_t SideCode(Side side) { return side == Side::Buy ? 0 : 1; }
+
+    void Close() {
+        if (sendFd >= 0) close(sendFd);
+        if (retransmitFd >= 0) close(retransmitFd);
+        sendFd = retransmitFd = -1;
+    }
+
+    void Append(const MarketDataMessage& message) {
+        history[nextSequence & (capacity - 1)] = message;
+        ++nextSequence;
+        ++stats.messages;
+
+        const char* bytes = reinterpret_cast<const char*>(&message);
+        packet.insert(packet.end(), bytes, bytes + sizeof(message));
+        if (++pendingCount == messagesPerPacket) Flush();
+    }
+
+    void SendPacket(const sockaddr_in& to, std::uint64_t sequence, std::size_t count, const char* body,
+                    std::size_t bodyLength) {
+        MarketDataPacketHeader header{sequence, NowNanos(), static_cast<std::uint16_t>(count)};
+        iovec parts[2] = {{&header, sizeof(header)}, {const_cast<char*>(body), bodyLength}};
+        msghdr message{};
+        message.msg_name = const_cast<sockaddr_in*>(&to);
+        message.msg_namelen = sizeof(to);
+        message.msg_iov = parts;
+        message.msg_iovlen = bodyLength ? 2 : 1;
+        while (sendmsg(sendFd, &message, 0) < 0) {
+            if (errno == EINTR) continue;
+            ++stats.sendErrors;  // UDP is lossy anyway; receivers recover through retransmission
+            return;
+        }
+        ++stats.packets;
+        stats.bytes += sizeof(header) + bodyLength;
+    }
+
+    void Retransmit(const sockaddr_in& to, const RetransmitRequest& request) {
+        const std::uint64_t oldest = nextSequence > capacity ? nextSequence - capacity : 1;
+        if (request.sequence < oldest) {
+            SendPacket(to, oldest, 0, nullptr, 0);  // Range is gone; tell the receiver where to resume
+            return;
+        }
+        std::uint64_t sequence = request.sequence;
+        const std::uint64_t end = std::min<std::uint64_t>(request.sequence + request.count, nextSequence);
+        std::vector<char> body;
+        body.reserve(messagesPerPacket * sizeof(MarketDataMessage));
+        while (sequence < end) {
+            const std::uint64_t count = std::min<std::uint64_t>(end - sequence, messagesPerPacket);
+            body.clear();
+            for (std::uint64_t s = sequence; s < sequence + count; ++s) {
+                const char* bytes = reinterpret_cast<const char*>(&history[s & (capacity - 1)]);
+                body.insert(body.end(), bytes, bytes + sizeof(MarketDataMessage));
+            }
+            SendPacket(to, sequence, count, body.data(), body.size());
+            stats.retransmittedMessages += count;
+            sequence += count;
+        }
+    }
+
+    MarketDataConfig config;
+    sockaddr_in destination;
+    int sendFd = -1;
+    int retransmitFd = -1;
+
+    std::size_t capacity;
+    std::vector<MarketDataMessage> history;  // Indexed by sequence & (capacity - 1)
+    std::uint64_t nextSequence = 1;
+
+    std::size_t messagesPerPacket;
+    std::vector<char> packet;  // Body of the packet being filled
+    std::uint64_t packetSequence = 1;
+    std::size_t pendingCount = 0;
+    MarketDataStats stats;
+};
+
+struct MarketDataReceiverStats {
+    std::uint64_t packets = 0;
+    std::uint64_t messages = 0;        // Delivered in sequence
+    std::uint64_t gaps = 0;            // Times a sequence gap was detected
+    std::uint64_t requests = 0;        // Retransmission requests sent
+    std::uint64_t lostMessages = 0;    // Skipped because the publisher no longer had them
+    std::uint64_t duplicates = 0;      // Messages received more than once
+};
+
+/**
+ * MarketDataReceiver consumes a publisher's packets, delivering messages
+ * strictly in sequence. Packets that arrive after a gap are buffered
+ * while the gap is requested from the publisher.
+ */
+class MarketDataReceiver {
+public:
+    MarketDataReceiver(const MarketDataConfig& config, std::uint16_t retransmitPort)
+        : retransmitTo(MakeSocketAddress(config.retransmitAddress, retransmitPort)) {
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw std::runtime_error("MarketDataReceiver: socket() failed: " + std::string(std::strerror(errno)));
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        int bufferSize = 4 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+        const sockaddr_in group = MakeSocketAddress(config.address, config.port);
+        const bool multicast = IN_MULTICAST(ntohl(group.sin_addr.s_addr));
+        sockaddr_in bindAddr = multicast ? group : MakeSocketAddress("0.0.0.0", config.port);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&bindAddr), sizeof(bindAddr)) < 0) {
+            std::string error = std::strerror(errno);
+            close(fd);
+            throw std::runtime_error("MarketDataReceiver: cannot bind port " + std::to_string(config.port) + ": " + error);
+        }
+        if (multicast) {
+            ip_mreq membership{};
+            membership.imr_multiaddr = group.sin_addr;
+            membership.imr_interface.s_addr = htonl(INADDR_ANY);
+            if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0) {
+                std::string error = std::strerror(errno);
+                close(fd);
+                throw std::runtime_error("MarketDataReceiver: cannot join " + config.address + ": " + error);
+            }
+        }
+    }
+
+    ~MarketDataReceiver() { close(fd); }
+
+    MarketDataReceiver(const MarketDataReceiver&) = delete;
+    MarketDataReceiver& operator=(const MarketDataReceiver&) = delete;
+
+    /**
+     * Drains the socket without blocking, calling handler(const MarketDataMessage&)
+     * for every message that is next in sequence
+     * @returns number of messages delivered
+     */
+    template <typename Handler>
+    std::size_t Poll(Handler&& handler) {
+        std::size_t delivered = 0;
+        char buffer[65536];
+        while (true) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (static_cast<std::size_t>(n) < sizeof(MarketDataPacketHeader)) continue;
+            ++stats.packets;
+
+            MarketDataPacketHeader header;
+            std::memcpy(&header, buffer, sizeof(header));
+            const std::size_t count = std::min<std::size_t>(
+                header.count, (static_cast<std::size_t>(n) - sizeof(header)) / sizeof(MarketDataMessage));
+            const char* body = buffer + sizeof(header);
+
+            if (count == 0) {
+                // The publisher no longer has what we asked for; resume at its oldest message
+                if (header.sequence > expected) {
+                    stats.lostMessages += header.sequence - expected;
+                    expected = header.sequence;
+                    requestedUpTo = 0;
+                }
+            } else if (header.sequence <= expected) {
+                delivered += Deliver(header.sequence, body, count, handler);
+            } else {
+                pending[header.sequence].assign(body, body + count * sizeof(MarketDataMessage));
+            }
+            delivered += DrainPending(handler);
+        }
+        RequestGap();
+        return delivered;
+    }
+
+    /**
+     * @returns the sequence number of the next message to be delivered
+     */
+    std::uint64_t GetExpectedSequence() const { return expected; }
+
+    const MarketDataReceiverStats& GetStats() const { return stats; }
+
+private:
+    static constexpr std::uint64_t RetryNanos = 5'000'000;
+
+    template <typename Handler>
+    std::size_t Deliver(std::uint64_t sequence, const char* body, std::size_t count, Handler& handler) {
+        std::size_t delivered = 0;
+        for (std::size_t i = 0; i < count; ++i, ++sequence) {
+            if (sequence < expected) {
+                ++stats.duplicates;
+                continue;
+            }
+            MarketDataMessage message;
+            std::memcpy(&message, body + i * sizeof(MarketDataMessage), sizeof(message));
+            handler(message);
+            ++expected;
+            ++delivered;
+        }
+        stats.messages += delivered;
+        return delivered;
+    }
+
+    template <typename Handler>
+    std::size_t DrainPending(Handler& handler) {
+        std::size_t delivered = 0;
+        while (!pending.empty() && pending.begin()->first <= expected) {
+            auto it = pending.begin();
+            delivered += Deliver(it->first, it->second.data(), it->second.size() / sizeof(MarketDataMessage), handler);
+            pending.erase(it);
+        }
+        return delivered;
+    }
+
+    /**
+     * Requests the range between the next expected message and the first
+     * buffered packet; repeats the request if it stays unanswered
+     */
+    void RequestGap() {
+        if (pending.empty()) return;
+        const std::uint64_t gapEnd = pending.begin()->first;
+        const std::uint64_t now = NowNanos();
+        if (requestedUpTo >= gapEnd && now - lastRequest < RetryNanos) return;
+        if (requestedUpTo < expected) ++stats.gaps;  // A new gap rather than a retry
+
+        const std::uint64_t count = std::min<std::uint64_t>(gapEnd - expected, 0xffff);
+        RetransmitRequest request{expected, static_cast<std::uint16_t>(count)};
+        sendto(fd, &request, sizeof(request), 0, reinterpret_cast<const sockaddr*>(&retransmitTo), sizeof(retransmitTo));
+        ++stats.requests;
+        requestedUpTo = expected + count;
+        lastRequest = now;
+    }
+
+    int fd = -1;
+    sockaddr_in retransmitTo;
+    std::uint64_t expected = 1;
+    std::map<std::uint64_t, std::vector<char>> pending;  // Out-of-sequence packets by first sequence
+    std::uint64_t requestedUpTo = 0;
+    std::uint64_t lastRequest = 0;
+    MarketDataReceiverStats stats;
+};
+
+#endif  // __linux__
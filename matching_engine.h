@@ -0,0 +1,348 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "drop_copy.h"
+#include "latency_recorder.h"
+#include "order_book.h"
+#include "order_status.h"
+#include "protocol.h"
+
+/**
+ * MatchingEngine applies transport-neutral Commands to an OrderBook and
+ * reports the outcome as Events addressed to the owning session.
+ *
+ * It is deliberately single-threaded: transports hand it commands through
+ * whatever queue suits them and drain the emitted events on their own side.
+ *
+ * Public market data is reported separately to an optional listener with
+ *   void OnTrade(const Trade& trade, Side aggressor)
+ *   void OnLevel(Side side, Price price, Quantity quantity)  // New aggregate, 0 = level gone
+ * called after the private events of each command. Every level whose
+ * aggregate may have changed is reported, normally once per command.
+ *
+ * With SetDropCopy every fill is also written to an ExecutionReportRing,
+ * one report per side, for back-office style consumers (see drop_copy.h).
+ *
+ * GetOrderStatus reports any order the engine has seen: live orders from
+ * their routing entry, finished ones (filled, cancelled, rejected) from a
+ * bounded history of terminal records (see order_status.h).
+ */
+
+/**
+ * Listener that ignores market data
+ */
+struct NoMarketData {
+    void OnTrade(const Trade&, Side) {}
+    void OnLevel(Side, Price, Quantity) {}
+};
+
+class MatchingEngine {
+public:
+    static constexpr std::size_t DefaultStatusHistory = 1 << 16;
+
+    /**
+     * @param statusHistory terminal order records kept for GetOrderStatus
+     */
+    explicit MatchingEngine(std::size_t statusHistory = DefaultStatusHistory) : history(statusHistory) {}
+
+    /**
+     * Processes one command, invoking emit(const Event&) for every response
+     */
+    template <typename Emit>
+    void Process(const Command& command, Emit&& emit) {
+        NoMarketData none;
+        Process(command, emit, none);
+    }
+
+    /**
+     * Same as above, also reporting trades and level changes to marketData
+     */
+    template <typename Emit, typename MarketData>
+    void Process(const Command& command, Emit&& emit, MarketData& marketData) {
+        switch (command.type) {
+        case CommandType::Add: {
+            if (owners.find(command.orderId) != owners.end()) {
+                emit(MakeReject(command, RejectReason::DuplicateOrderId));
+                history.Record(OrderStatus{command.orderId, command.session, 0, command.price, command.quantity, 0,
+                                           command.side, OrderState::Rejected, RejectReason::DuplicateOrderId});
+                return;
+            }
+            owners.emplace(command.orderId, LiveOrder{command.session, 0, command.quantity, 0});
+            Trades trades = book.AddOrder(Order(
+                command.orderType, command.orderId, command.side, command.price, command.quantity), command.session);
+            emit(MakeAck(command, MessageType::Ack));
+            EmitFills(command, trades, emit);
+            EmitExpiry(command, trades, emit);
+            Forget(command.orderId, command.side, command.price);
+            PublishMarketData(command, trades, marketData);
+            return;
+        }
+        case CommandType::Cancel: {
+            const std::optional<Order> order = book.FindOrder(command.orderId);
+            if (!order || !OwnedBy(command.orderId, command.session)) {
+                emit(MakeReject(command, RejectReason::UnknownOrderId));
+                return;
+            }
+            const Side side = order->GetSide();
+            const Price price = order->GetPrice();
+            book.CancelOrder(command.orderId);
+            Retire(owners.find(command.orderId), command.orderId, side, price, OrderState::Cancelled);
+            emit(MakeAck(command, MessageType::CancelAck));
+            marketData.OnLevel(side, price, book.GetLevelQuantity(side, price));
+            return;
+        }
+        case CommandType::Modify: {
+            const std::optional<Order> order = book.FindOrder(command.orderId);
+            if (!order || !OwnedBy(command.orderId, command.session)) {
+                emit(MakeReject(command, RejectReason::UnknownOrderId));
+                return;
+            }
+            const Side oldSide = order->GetSide();
+            const Price oldPrice = order->GetPrice();
+            if (auto it = owners.find(command.orderId); it != owners.end()) {
+                it->second.quantity = it->second.filled + command.quantity;  // Modify sets the open quantity
+            }
+            Trades trades = book.ModifyOrder(
+                OrderModify(command.orderId, command.side, command.price, command.quantity));
+            emit(MakeAck(command, MessageType::Ack));
+            EmitFills(command, trades, emit);
+            EmitExpiry(command, trades, emit);
+            Forget(command.orderId, command.side, command.price);
+            if (oldSide != command.side || oldPrice != command.price || !book.Contains(command.orderId)) {
+                marketData.OnLevel(oldSide, oldPrice, book.GetLevelQuantity(oldSide, oldPrice));
+            }
+            PublishMarketData(command, trades, marketData);
+            return;
+        }
+        case CommandType::MassCancel: {
+            if (command.session == 0) {  // Owner 0 would select every owner's orders
+                emit(MakeReject(command, RejectReason::Malformed));
+                return;
+            }
+            MassCancelFilter filter;
+            filter.owner = command.session;
+            if (!command.allSides) filter.side = command.side;
+            filter.minPrice = command.price;
+            filter.maxPrice = command.maxPrice;
+            const std::size_t cancelled = MassCancel(filter, command.clientTag, emit, marketData);
+            emit(Event{MessageType::MassCancelAck, RejectReason::None, command.session, command.clientTag, 0, 0,
+                       cancelled});
+            return;
+        }
+        }
+    }
+
+    /**
+     * Cancels every resting order that matches filter, whoever owns it (a
+     * risk kill switch, for instance). Each owner gets a CancelAck tagged
+     * clientTag per order; every level that changed is reported once.
+     * @returns the number of orders cancelled
+     */
+    template <typename Emit>
+    std::size_t MassCancel(const MassCancelFilter& filter, std::uint64_t clientTag, Emit&& emit) {
+        NoMarketData none;
+        return MassCancel(filter, clientTag, emit, none);
+    }
+
+    template <typename Emit, typename MarketData>
+    std::size_t MassCancel(const MassCancelFilter& filter, std::uint64_t clientTag, Emit&& emit,
+                           MarketData& marketData) {
+        touchedLevels.clear();
+        const std::size_t cancelled = book.CancelOrders(filter, [&](const Order& order) {
+            auto it = owners.find(order.GetOrderId());
+            const SessionId owner = it == owners.end() ? 0 : it->second.session;
+            Retire(it, order.GetOrderId(), order.GetSide(), order.GetPrice(), OrderState::Cancelled);
+            emit(Event{MessageType::CancelAck, RejectReason::None, owner, clientTag, order.GetOrderId(),
+                       order.GetPrice(), order.GetRemainingQuantity()});
+            touchedLevels.emplace_back(order.GetSide(), order.GetPrice());
+        });
+        std::sort(touchedLevels.begin(), touchedLevels.end());
+        touchedLevels.erase(std::unique(touchedLevels.begin(), touchedLevels.end()), touchedLevels.end());
+        for (const auto& [side, price] : touchedLevels) {
+            marketData.OnLevel(side, price, book.GetLevelQuantity(side, price));
+        }
+        return cancelled;
+    }
+
+    const OrderBook& GetBook() const { return book; }
+
+    /**
+     * @returns the status of a live order, or the most recent retained
+     * terminal record for orderId; nullopt if the engine never saw it or its
+     * record has been evicted from the history
+     */
+    std::optional<OrderStatus> GetOrderStatus(OrderId orderId) const {
+        auto it = owners.find(orderId);
+        if (it == owners.end()) return history.Find(orderId);
+        const LiveOrder& live = it->second;
+        const std::optional<Order> order = book.FindOrder(orderId);  // Every routed order is in the book between commands
+        const OrderState state = live.filled ? OrderState::PartiallyFilled : OrderState::New;
+        return OrderStatus{orderId, live.session, live.notional, order->GetPrice(), live.quantity, live.filled,
+                           order->GetSide(), state, RejectReason::None};
+    }
+
+    const OrderStatusHistory& GetStatusHistory() const { return history; }
+
+    /**
+     * Copies every subsequent fill to ring (nullptr stops copying). The
+     * engine's thread becomes the ring's only writer.
+     */
+    void SetDropCopy(ExecutionReportRing* ring) { dropCopy = ring; }
+
+private:
+    /**
+     * Routing entry and running fill totals of an order in the book; price
+     * and side come from the book. Kept small: one is touched per fill.
+     */
+    struct LiveOrder {
+        SessionId session;
+        std::int64_t notional;  // Sum of execution price * quantity
+        Quantity quantity;      // Total: filled + open
+        Quantity filled;
+    };
+
+    static Event MakeAck(const Command& command, MessageType type) {
+        return Event{type, RejectReason::None, command.session, command.clientTag,
+                     command.orderId, command.price, command.quantity};
+    }
+
+    static Event MakeReject(const Command& command, RejectReason reason) {
+        return Event{MessageType::Reject, reason, command.session, command.clientTag,
+                     command.orderId, command.price, command.quantity};
+    }
+
+    /**
+     * Cancel and Modify may only touch the sender's own orders; one without a
+     * routing entry was not placed through the engine and stays open to all
+     */
+    bool OwnedBy(OrderId orderId, SessionId session) const {
+        auto it = owners.find(orderId);
+        return it == owners.end() || it->second.session == session;
+    }
+
+    /**
+     * Sends a Fill to each side of every trade (and to the drop copy), then
+     * drops routing entries for orders that left the book. Cleanup is a
+     * second pass because an aggressive order usually appears in several trades.
+     */
+    template <typename Emit>
+    void EmitFills(const Command& command, const Trades& trades, Emit& emit) {
+        const std::uint64_t timestamp = dropCopy && !trades.empty() ? NowNanos() : 0;
+        for (const Trade& trade : trades) {
+            // Both sides execute at the resting order's price
+            const Price price = command.side == Side::Buy ? trade.GetAskTrade().price : trade.GetBidTrade().price;
+            const SessionId buyer = EmitFill(trade.GetBidTrade(), price, emit);
+            const SessionId seller = EmitFill(trade.GetAskTrade(), price, emit);
+            if (dropCopy) {
+                const std::uint64_t matchId = ++lastMatchId;
+                const bool buyerAggressed = command.side == Side::Buy;
+                CopyFill(matchId, timestamp, buyer, trade.GetBidTrade(), price, trade.GetAskTrade().orderId,
+                         Side::Buy, buyerAggressed);
+                CopyFill(matchId, timestamp, seller, trade.GetAskTrade(), price, trade.GetBidTrade().orderId,
+                         Side::Sell, !buyerAggressed);
+            }
+        }
+        for (const Trade& trade : trades) {
+            Forget(trade.GetBidTrade().orderId, Side::Buy, trade.GetBidTrade().price);
+            Forget(trade.GetAskTrade().orderId, Side::Sell, trade.GetAskTrade().price);
+        }
+    }
+
+    /**
+     * @returns the owning session, 0 if unknown
+     */
+    template <typename Emit>
+    SessionId EmitFill(const TradeInfo& info, Price executionPrice, Emit& emit) {
+        auto it = owners.find(info.orderId);
+        if (it == owners.end()) return 0;
+        LiveOrder& live = it->second;
+        live.filled += info.quantity;
+        live.notional += static_cast<std::int64_t>(executionPrice) * info.quantity;
+        emit(Event{MessageType::Fill, RejectReason::None, live.session, 0,
+                   info.orderId, executionPrice, info.quantity});
+        return live.session;
+    }
+
+    /**
+     * Tells the owner that the unfilled rest of a FillAndKill was discarded
+     * rather than rested. Cancel and Modify only reach the owner's orders, so
+     * the command's session is the owner.
+     */
+    template <typename Emit>
+    void EmitExpiry(const Command& command, const Trades& trades, Emit& emit) {
+        if (book.Contains(command.orderId)) return;
+        // EmitFills may already have retired the order, so count its fills here
+        Quantity filled = 0;
+        for (const Trade& trade : trades) {
+            filled += (command.side == Side::Buy ? trade.GetBidTrade() : trade.GetAskTrade()).quantity;
+        }
+        if (filled >= command.quantity) return;
+        emit(Event{MessageType::Expired, RejectReason::None, command.session, command.clientTag,
+                   command.orderId, command.price, command.quantity - filled});
+    }
+
+    void CopyFill(std::uint64_t matchId, std::uint64_t timestamp, SessionId session, const TradeInfo& info,
+                  Price executionPrice, OrderId contraOrderId, Side side, bool aggressor) {
+        dropCopy->Publish(ExecutionReport{matchId, timestamp, session, info.orderId, contraOrderId,
+                                          info.quantity, executionPrice, side, aggressor});
+    }
+
+    /**
+     * Reports the trades of an add/modify and the levels they touched: the
+     * incoming order's level if it rests, and each resting level it traded
+     * against (trades arrive level by level, so repeats are adjacent)
+     */
+    template <typename MarketData>
+    void PublishMarketData(const Command& command, const Trades& trades, MarketData& marketData) {
+        for (const Trade& trade : trades) marketData.OnTrade(trade, command.side);
+
+        if (book.Contains(command.orderId)) {
+            marketData.OnLevel(command.side, command.price, book.GetLevelQuantity(command.side, command.price));
+        }
+        const Side resting = command.side == Side::Buy ? Side::Sell : Side::Buy;
+        for (std::size_t i = 0; i < trades.size(); ++i) {
+            const Price price = resting == Side::Buy ? trades[i].GetBidTrade().price : trades[i].GetAskTrade().price;
+            const Price previous = i == 0 ? price : (resting == Side::Buy ? trades[i - 1].GetBidTrade().price
+                                                                          : trades[i - 1].GetAskTrade().price);
+            if (i > 0 && price == previous) continue;
+            marketData.OnLevel(resting, price, book.GetLevelQuantity(resting, price));
+        }
+    }
+
+    /**
+     * Drops the routing entry of an order that left the book: filled, or the
+     * unfilled remainder of a FillAndKill/Market order was discarded
+     */
+    void Forget(OrderId orderId, Side side, Price price) {
+        if (book.Contains(orderId)) return;
+        auto it = owners.find(orderId);
+        if (it == owners.end()) return;
+        Retire(it, orderId, side, price,
+               it->second.filled >= it->second.quantity ? OrderState::Filled : OrderState::Cancelled);
+    }
+
+    /**
+     * Moves an order's status into the history and drops its routing entry
+     */
+    void Retire(std::unordered_map<OrderId, LiveOrder>::iterator it, OrderId orderId, Side side, Price price,
+                OrderState state) {
+        if (it == owners.end()) return;
+        const LiveOrder& live = it->second;
+        history.Record(OrderStatus{orderId, live.session, live.notional, price, live.quantity, live.filled, side,
+                                   state, RejectReason::None});
+        owners.erase(it);
+    }
+
+    OrderBook book;
+    std::unordered_map<OrderId, LiveOrder> owners;  // Routes fills back to the submitting session
+    OrderStatusHistory history;
+    ExecutionReportRing* dropCopy = nullptr;
+    std::uint64_t lastMatchId = 0;
+    std::vector<std::pair<Side, Price>> touchedLevels;  // Scratch for mass cancels
+};
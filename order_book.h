@@ -0,0 +1,1277 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "handle_pool.h"
+#include "level_map.h"
+
+/**
+ * OrderBook System Architecture
+ * 
+ * This implementation represents a limit order book system commonly used in financial trading.
+ * The system maintains two primary order lists:
+ * 1. Bids (buy orders) - sorted in descending order by price
+ * 2. Asks (sell orders) - sorted in ascending order by price
+ * 
+ * Key Components:
+ * - Order matching engine with price-time priority
+ * - Support for GoodTilCancel and FillAndKill order types
+ * - Real-time order book level information
+ * - Order modification and cancellation capabilities
+ * - Level-3 feed operations (execute, partial cancel, replace) for rebuilding
+ *   a book from exchange market data
+ * - Mass cancel by owner, side and price band
+ * - Cost-to-fill and depth-up-to-price queries in O(log ticks)
+ * - Queue position (open quantity ahead of an order at its level)
+ * 
+ * Performance Considerations:
+ * - Price levels live in a HybridLevelMap by default: a dense window of
+ *   ticks from just ahead of the best price is O(1) to find, add and remove
+ *   a level, and levels beyond it spill into a std::map (O(log n)), so the
+ *   price range is unbounded. A book over a wide, sparse range can use a
+ *   cache-line B+tree instead (BasicOrderBook<BTreeLevels>)
+ * - Resting orders live in a pool indexed by 32-bit handles: a 32-byte hot
+ *   record (id, open quantity, price, queue links, flags) that matching
+ *   works on, and a parallel cold record (level, owner, queue slot) it
+ *   rarely reads. Each level's FIFO queue is linked through the hot
+ *   records, so adding, cancelling and filling an order allocate nothing
+ * - Levels are pooled too, and every cross-reference (ID -> order, order ->
+ *   level, queue and owner links) is a typed 32-bit handle; building with
+ *   ORDER_BOOK_HANDLE_CHECKS makes the pools catch stale handles
+ * - An order that covers a whole opposite level sweeps it in one pass,
+ *   updating totals and depth once per level rather than once per fill
+ * - Each level keeps its aggregate quantity, so depth snapshots are O(levels)
+ * - Uses std::unordered_map for order lookup by ID (O(1) average case)
+ * - Each owner's orders form an intrusive list through their cold records,
+ *   so cancelling everything an owner has is one walk with no searching
+ * - Once depth is queried, each side mirrors its level quantities into a
+ *   DepthLadder (Fenwick tree over the tick ladder), an extra O(log ticks)
+ *   per level change
+ * - Queue position comes from per-level counters: fills leave from the
+ *   front and are one running total, while quantity that leaves from the
+ *   middle of a queue (cancels, L3 reductions and executions) goes into a
+ *   Fenwick tree over the level's queue slots, so it costs O(log queue)
+ */
+
+enum class OrderType {
+    GoodTilCancel,
+    FillAndKill
+};
+
+/**
+ * Side indicates whether the order is a buy or sell order
+ */
+enum class Side {
+    Buy,
+    Sell
+};
+
+// Type aliases for better code readability and maintenance
+using Price = std::int32_t;     // Signed integer for price to allow for negative values
+using Quantity = std::uint64_t;  // Unsigned integer for quantity (cannot be negative)
+using OrderId = std::uint64_t;   // Unique identifier for orders
+using OwnerId = std::uint64_t;   // Account or session that owns an order; 0 = not tracked
+
+/**
+ * LevelInfo represents aggregated information for a price level
+ * Contains the price and total quantity of all orders at that price
+ */
+struct LevelInfo {
+    Price price;
+    Quantity quantity;
+
+    LevelInfo(Price p, Quantity q) : price(p), quantity(q) {}
+};
+
+using LevelInfos = std::vector<LevelInfo>;
+
+/**
+ * OrderbookLevelInfos provides a snapshot of the entire order book
+ * Contains vectors of LevelInfo for both bid and ask sides
+ */
+class OrderbookLevelInfos {
+public:
+    OrderbookLevelInfos(const LevelInfos& bids, const LevelInfos& asks) 
+        : bids(bids), asks(asks) {}
+
+    const LevelInfos& GetBids() const { return bids; }
+    const LevelInfos& GetAsks() const { return asks; }
+
+private:
+    LevelInfos bids;  // Bid price levels sorted high to low
+    LevelInfos asks;  // Ask price levels sorted low to high
+};
+
+/**
+ * Order class represents a single order in the system
+ * Contains all essential order information and methods to manage its lifecycle
+ */
+class Order {
+public:
+    Order(OrderType type, OrderId id, Side s, Price p, Quantity q) 
+        : orderType(type), orderId(id), side(s), price(p),
+          initialQuantity(q), remainingQuantity(q) {}
+
+    // An order part of which has already been filled
+    Order(OrderType type, OrderId id, Side s, Price p, Quantity initial, Quantity remaining)
+        : orderType(type), orderId(id), side(s), price(p),
+          initialQuantity(initial), remainingQuantity(remaining) {}
+
+    // Getters for order properties
+    OrderId GetOrderId() const { return orderId; }
+    Side GetSide() const { return side; }
+    Price GetPrice() const { return price; }
+    OrderType GetOrderType() const { return orderType; }
+    Quantity GetInitialQuantity() const { return initialQuantity; }
+    Quantity GetRemainingQuantity() const { return remainingQuantity; }
+    Quantity GetFilledQuantity() const { return initialQuantity - remainingQuantity; }
+    bool IsFilled() const { return remainingQuantity == 0; }
+
+    /**
+     * Fill a portion of the order
+     * @throws std::runtime_error if fill quantity exceeds remaining quantity
+     */
+    void Fill(Quantity quantity) {
+        if (quantity > remainingQuantity) {
+            throw std::runtime_error(
+                "Order (" + std::to_string(orderId) + 
+                ") cannot be filled for more than its remaining quantity.");
+        }
+        remainingQuantity -= quantity;
+    }
+
+    /**
+     * Cancel part of the open quantity (the order shrinks, nothing is filled)
+     * @throws std::runtime_error if quantity exceeds remaining quantity
+     */
+    void Reduce(Quantity quantity) {
+        if (quantity > remainingQuantity) {
+            throw std::runtime_error(
+                "Order (" + std::to_string(orderId) +
+                ") cannot be reduced by more than its remaining quantity.");
+        }
+        initialQuantity -= quantity;
+        remainingQuantity -= quantity;
+    }
+
+private:
+    OrderType orderType;
+    OrderId orderId;
+    Side side;
+    Price price;
+    Quantity initialQuantity;
+    Quantity remainingQuantity;
+};
+
+/**
+ * OrderModify represents a request to modify an existing order
+ * Used to change price or quantity of an existing order
+ */
+class OrderModify {
+public:
+    OrderModify(OrderId id, Side s, Price p, Quantity q) 
+        : orderId(id), side(s), price(p), quantity(q) {}
+
+    OrderId GetOrderId() const { return orderId; }
+    Side GetSide() const { return side; }
+    Price GetPrice() const { return price; }
+    Quantity GetQuantity() const { return quantity; }
+
+    /**
+     * Creates a new Order object with modified parameters
+     */
+    Order ToOrder(OrderType type) const {
+        return Order(type, orderId, side, price, quantity);
+    }
+
+private:
+    OrderId orderId;
+    Side side;
+    Price price;
+    Quantity quantity;
+};
+
+/**
+ * TradeInfo represents one side of a trade (either buy or sell)
+ * Contains the order ID, executed price, and quantity
+ */
+struct TradeInfo {
+    OrderId orderId;
+    Price price;
+    Quantity quantity;
+
+    TradeInfo(OrderId id, Price p, Quantity q) 
+        : orderId(id), price(p), quantity(q) {}
+};
+
+/**
+ * Trade represents a matched trade between a buy and sell order
+ * Contains TradeInfo for both sides of the trade
+ */
+class Trade {
+public:
+    Trade(const TradeInfo& bid, const TradeInfo& ask) 
+        : bidTrade(bid), askTrade(ask) {}
+
+    const TradeInfo& GetBidTrade() const { return bidTrade; }
+    const TradeInfo& GetAskTrade() const { return askTrade; }
+
+private:
+    TradeInfo bidTrade;
+    TradeInfo askTrade;
+};
+
+using Trades = std::vector<Trade>;
+
+/**
+ * MassCancelFilter selects the resting orders a mass cancel removes; an
+ * order must match every field
+ */
+struct MassCancelFilter {
+    OwnerId owner = 0;          // 0 = orders of every owner
+    std::optional<Side> side;   // Empty = both sides
+    Price minPrice = std::numeric_limits<Price>::min();
+    Price maxPrice = std::numeric_limits<Price>::max();
+
+    bool Matches(Side orderSide, Price price) const {
+        return (!side || *side == orderSide) && price >= minPrice && price <= maxPrice;
+    }
+};
+
+/**
+ * FillEstimate is what an order of a given size would get by sweeping the
+ * book right now (ignoring its own limit)
+ */
+struct FillEstimate {
+    Quantity quantity = 0;      // Fillable; less than requested if the side is too thin
+    std::int64_t notional = 0;  // Sum of price * quantity over the levels consumed
+    Price worstPrice = 0;       // Last level touched; 0 if nothing is fillable
+
+    double GetAveragePrice() const {
+        return quantity ? static_cast<double>(notional) / static_cast<double>(quantity) : 0.0;
+    }
+};
+
+/**
+ * DepthLadder keeps one side's level quantities in a Fenwick tree indexed
+ * by tick, in priority order (best price first), so cumulative depth and
+ * cost-to-fill are O(log ticks) prefix queries instead of level walks.
+ *
+ * Design Notes:
+ * - The ladder covers a window of ticks; a price outside it makes the
+ *   owner rebuild a wider, re-centred window from its levels
+ * - Windows wider than MaxTicks are not built: the ladder reports itself
+ *   disabled and the book answers queries by walking its levels instead.
+ *   It remembers the two levels that made the span too wide; new levels
+ *   cannot narrow it, so only removing one of those ends allows a retry
+ * - Each node holds open quantity and notional (price * quantity) together,
+ *   so an update or query touches one cache line per tree level
+ */
+class DepthLadder {
+public:
+    static constexpr std::size_t MinTicks = 1024;
+    static constexpr std::size_t MaxTicks = 1 << 20;
+
+    explicit DepthLadder(bool descending) : descending(descending) {}
+
+    bool IsEnabled() const { return !nodes.empty(); }
+
+    bool Covers(Price price) const {
+        return IsEnabled() && price >= low && static_cast<std::int64_t>(price) - low < static_cast<std::int64_t>(Size());
+    }
+
+    /**
+     * @returns true if the ladder is disabled by a span that is still too
+     * wide: one of the levels at its ends remains
+     */
+    bool IsTooWide() const { return tooWide; }
+
+    /**
+     * Widens the recorded span of a too-wide ladder to a new level at price
+     * @returns false if the ladder is not known to be too wide (the caller
+     * must cover price itself)
+     */
+    bool StaysDisabled(Price price) {
+        if (!tooWide) return false;
+        spanLow = std::min(spanLow, price);
+        spanHigh = std::max(spanHigh, price);
+        return true;
+    }
+
+    /**
+     * Notes that the level at price is gone; losing an end of the recorded
+     * span may let the side fit again, so the next cover or query retries
+     */
+    void OnLevelRemoved(Price price) {
+        if (tooWide && (price == spanLow || price == spanHigh)) tooWide = false;
+    }
+
+    /**
+     * Re-centres the ladder on [minPrice, maxPrice] and clears it, or
+     * disables it if that span needs more than MaxTicks
+     * @returns false if disabled; the caller then re-adds nothing
+     */
+    bool Reset(Price minPrice, Price maxPrice) {
+        const std::int64_t span = static_cast<std::int64_t>(maxPrice) - minPrice + 1;
+        std::size_t size = MinTicks;
+        while (static_cast<std::int64_t>(size) < 2 * span && size < MaxTicks) size <<= 1;
+        tooWide = static_cast<std::int64_t>(size) < span;
+        if (tooWide) {
+            nodes.clear();
+            spanLow = minPrice;
+            spanHigh = maxPrice;
+            return false;
+        }
+        const std::int64_t start = static_cast<std::int64_t>(minPrice) - (static_cast<std::int64_t>(size) - span) / 2;
+        low = static_cast<Price>(std::clamp<std::int64_t>(start, std::numeric_limits<Price>::min(),
+                                                          std::numeric_limits<Price>::max() - static_cast<std::int64_t>(size) + 1));
+        nodes.assign(size + 1, Node());
+        return true;
+    }
+
+    /**
+     * Applies a change in the open quantity at price (which must be covered)
+     */
+    void Add(Price price, std::int64_t quantity) {
+        const std::int64_t notional = quantity * price;
+        for (std::size_t i = Position(price) + 1; i < nodes.size(); i += i & (~i + 1)) {
+            nodes[i].quantity += static_cast<Quantity>(quantity);
+            nodes[i].notional += notional;
+        }
+    }
+
+    /**
+     * @returns open quantity at prices at least as good as limit
+     */
+    Quantity GetQuantityUpTo(Price limit) const {
+        const std::int64_t position = descending ? static_cast<std::int64_t>(High()) - limit
+                                                 : static_cast<std::int64_t>(limit) - low;
+        if (position < 0) return 0;
+        Quantity total = 0;
+        for (std::size_t i = std::min<std::size_t>(static_cast<std::size_t>(position) + 1, Size()); i > 0;
+             i -= i & (~i + 1)) {
+            total += nodes[i].quantity;
+        }
+        return total;
+    }
+
+    /**
+     * Sweeps best prices first until quantity is reached: a Fenwick descent
+     * finds the last tick whose cumulative depth falls short, and the next
+     * tick supplies the rest
+     */
+    FillEstimate EstimateFill(Quantity quantity) const {
+        FillEstimate estimate;
+        if (quantity == 0) return estimate;
+        std::size_t position = 0;
+        for (std::size_t step = Size(); step > 0; step >>= 1) {
+            const std::size_t next = position + step;
+            if (next < nodes.size() && estimate.quantity + nodes[next].quantity < quantity) {
+                position = next;
+                estimate.quantity += nodes[next].quantity;
+                estimate.notional += nodes[next].notional;
+            }
+        }
+        // position ticks fall short; tick `position` (0-based) completes the order, if it exists
+        if (position < Size()) {
+            const Price price = PriceAt(position);
+            estimate.notional += static_cast<std::int64_t>(quantity - estimate.quantity) * price;
+            estimate.quantity = quantity;
+            estimate.worstPrice = price;
+        } else if (estimate.quantity > 0) {
+            estimate.worstPrice = WorstNonEmptyPrice();
+        }
+        return estimate;
+    }
+
+private:
+    struct Node {
+        Quantity quantity = 0;
+        std::int64_t notional = 0;
+    };
+
+    std::size_t Size() const { return nodes.empty() ? 0 : nodes.size() - 1; }
+    Price High() const { return static_cast<Price>(static_cast<std::int64_t>(low) + static_cast<std::int64_t>(Size()) - 1); }
+
+    std::size_t Position(Price price) const {
+        return static_cast<std::size_t>(descending ? static_cast<std::int64_t>(High()) - price
+                                                   : static_cast<std::int64_t>(price) - low);
+    }
+
+    Price PriceAt(std::size_t position) const {
+        return static_cast<Price>(descending ? static_cast<std::int64_t>(High()) - static_cast<std::int64_t>(position)
+                                             : static_cast<std::int64_t>(low) + static_cast<std::int64_t>(position));
+    }
+
+    /**
+     * @returns the price of the last tick with quantity (only when the whole side is consumed)
+     */
+    Price WorstNonEmptyPrice() const {
+        // Descend for the last position whose prefix is below the total
+        const Quantity total = GetQuantityUpTo(descending ? low : High());
+        std::size_t position = 0;
+        Quantity below = 0;
+        for (std::size_t step = Size(); step > 0; step >>= 1) {
+            const std::size_t next = position + step;
+            if (next < nodes.size() && below + nodes[next].quantity < total) {
+                position = next;
+                below += nodes[next].quantity;
+            }
+        }
+        return PriceAt(position);
+    }
+
+    bool descending;  // Bids: best (highest) price at position 0
+    Price low = 0;    // Lowest price covered
+    std::vector<Node> nodes;  // Fenwick tree, 1-based; empty when disabled
+    bool tooWide = false;     // Disabled by [spanLow, spanHigh], both prices of resting levels
+    Price spanLow = 0;
+    Price spanHigh = 0;
+};
+
+/**
+ * QueuePosition is where a resting order stands in its level's FIFO queue
+ */
+struct QueuePosition {
+    Quantity ahead = 0;   // Open quantity that trades before this order
+    Quantity behind = 0;  // Open quantity queued after it
+};
+
+/**
+ * Level storage policies: each side of a BasicOrderBook is a
+ * LevelStore::Map<Level, Descending>, an ordered map from price to level
+ * with the best price first whose levels never move in memory.
+ *
+ * HybridLevels suits most instruments, whose activity sits near the
+ * touch. BTreeLevels suits wide, thinly populated price ranges, where a
+ * tick window holds few levels. StdMapLevels is the plain red-black tree.
+ */
+struct HybridLevels {
+    template <typename Level, bool Descending>
+    using Map = HybridLevelMap<Price, Level, Descending>;
+};
+
+struct BTreeLevels {
+    template <typename Level, bool Descending>
+    using Map = BTreeLevelMap<Price, Level, Descending>;
+};
+
+struct StdMapLevels {
+    template <typename Level, bool Descending>
+    using Map = std::map<Price, Level, std::conditional_t<Descending, std::greater<Price>, std::less<Price>>>;
+};
+
+/**
+ * BasicOrderBook is the main class that manages the entire order book system
+ * Handles order addition, modification, cancellation, and matching
+ * @tparam LevelStore how each side stores its price levels, chosen per book
+ */
+template <typename LevelStore = HybridLevels>
+class BasicOrderBook {
+private:
+    struct LevelTag;
+    struct OrderTag;
+    using LevelHandle = Handle<LevelTag>;
+    using OrderHandle = Handle<OrderTag>;
+
+    /**
+     * Level is one price level: its FIFO queue plus the aggregate open
+     * quantity, kept up to date so depth queries need not walk the queue.
+     * The queue is linked through the order records (head is the oldest).
+     * Levels live in a pool, one cache line each; the level containers map
+     * a price to its level's handle.
+     *
+     * Each order takes the next queue slot and records how much quantity had
+     * been queued before it (its offset). The quantity ahead of it is then
+     * offset - matched - (quantity that left slots before its own), where
+     * matched counts fills off the front and departed is a Fenwick tree of
+     * the rest. Slots run out after a while; the queue is then renumbered
+     * from the live orders (RenumberQueue), which resets both counters.
+     */
+    struct alignas(64) Level {
+        OrderHandle head;
+        OrderHandle tail;
+        Quantity quantity = 0;
+        Quantity queued = 0;               // Quantity enqueued since the last renumbering
+        Quantity matched = 0;              // Quantity matched off the front since then
+        std::uint32_t slotsUsed = 0;
+        std::uint32_t slots = 0;           // Power of two; 0 until the first order arrives
+        std::vector<Quantity> departed;    // Fenwick tree over slots, 1-based; allocated on first use
+
+        bool IsEmpty() const { return head.IsNull(); }
+    };
+
+    static constexpr std::uint32_t MinQueueSlots = 64;
+
+    static constexpr std::uint8_t SellFlag = 1;
+    static constexpr std::uint8_t FillAndKillFlag = 2;
+
+    /**
+     * OrderRecord is the hot half of a resting order: everything matching
+     * reads or writes per fill, in 32 bytes, so two records share a cache
+     * line and walking a level's queue touches nothing else
+     */
+    struct alignas(32) OrderRecord {
+        OrderId orderId = 0;
+        Quantity remaining = 0;
+        Price price = 0;
+        OrderHandle prev;          // Neighbours in the level's queue
+        OrderHandle next;
+        std::uint8_t flags = 0;    // SellFlag, FillAndKillFlag
+
+        Side GetSide() const { return flags & SellFlag ? Side::Sell : Side::Buy; }
+        OrderType GetOrderType() const {
+            return flags & FillAndKillFlag ? OrderType::FillAndKill : OrderType::GoodTilCancel;
+        }
+    };
+    static_assert(HandleChecks || sizeof(OrderRecord) == 32, "OrderRecord should fill half a cache line");
+
+    /**
+     * OrderCold is the rest of a resting order, at the same index in a
+     * parallel array: read by cancels, queue queries and mass cancels, and
+     * once when an order fills, never per fill
+     */
+    struct OrderCold {
+        Quantity initialQuantity = 0;
+        Quantity queueOffset = 0;    // Level's queued quantity when this order joined
+        OwnerId owner = 0;
+        LevelHandle level;
+        OrderHandle ownerPrev;       // Links of the owner's intrusive list
+        OrderHandle ownerNext;
+        std::uint32_t queueSlot = 0; // 1-based slot in the level's departed tree
+    };
+
+    using OrderIndex = std::unordered_map<OrderId, OrderHandle>;
+
+    // Both containers keep the best price at begin()
+    using BidLevels = typename LevelStore::template Map<LevelHandle, true>;
+    using AskLevels = typename LevelStore::template Map<LevelHandle, false>;
+    BidLevels bids;  // Bid levels, highest price first
+    AskLevels asks;  // Ask levels, lowest price first
+    HandlePool<LevelTag, Level> levelPool;
+    HandlePool<OrderTag, OrderRecord> records;  // Resting orders
+    std::vector<OrderCold> colds;               // Indexed like records
+    OrderIndex orders;                          // Quick lookup by order ID
+    std::unordered_map<OwnerId, OrderHandle> ownerOrders;  // Head of each owner's list, newest first
+    std::vector<std::pair<Side, Price>> emptiedLevels;     // Scratch for mass cancels
+    // Cumulative depth over the tick ladder, per side. Built on the first
+    // depth query (a book nobody asks pays nothing) and maintained after.
+    mutable DepthLadder bidDepth{true};
+    mutable DepthLadder askDepth{false};
+    mutable bool depthTracked = false;
+    bool levelSweeps = true;  // See SetLevelSweeps
+
+    /**
+     * Checks if an order can be matched at the given price
+     * @returns true if the order can be matched with existing orders
+     */
+    bool CanMatch(Side side, Price price) const {
+        if (side == Side::Buy) {
+            if (asks.empty()) return false;
+            return price >= asks.begin()->first;
+        } else {
+            if (bids.empty()) return false;
+            return price <= bids.begin()->first;
+        }
+    }
+
+    OrderHandle AllocateRecord() {
+        const OrderHandle handle = records.Allocate();
+        if (handle.Index() == colds.size()) colds.emplace_back();
+        return handle;
+    }
+
+    OrderCold& Cold(OrderHandle handle) {
+        records.Check(handle);
+        return colds[handle.Index()];
+    }
+
+    const OrderCold& Cold(OrderHandle handle) const {
+        records.Check(handle);
+        return colds[handle.Index()];
+    }
+
+    /**
+     * @returns a fresh level from the pool; a reused one keeps its departed
+     * tree's storage
+     */
+    LevelHandle AllocateLevel() {
+        const LevelHandle handle = levelPool.Allocate();
+        Level& level = levelPool[handle];
+        level.head = level.tail = OrderHandle();
+        level.quantity = level.queued = level.matched = 0;
+        level.slotsUsed = level.slots = 0;
+        level.departed.clear();
+        return handle;
+    }
+
+    /**
+     * @returns a copy of a resting order as an Order
+     */
+    Order ToOrder(OrderHandle handle) const {
+        const OrderRecord& record = records[handle];
+        return Order(record.GetOrderType(), record.orderId, record.GetSide(), record.price,
+                     Cold(handle).initialQuantity, record.remaining);
+    }
+
+    void Enqueue(Level& level, OrderHandle handle) {
+        OrderRecord& record = records[handle];
+        record.prev = level.tail;
+        record.next = OrderHandle();
+        if (!level.tail.IsNull()) {
+            records[level.tail].next = handle;
+        } else {
+            level.head = handle;
+        }
+        level.tail = handle;
+    }
+
+    void Dequeue(Level& level, OrderHandle handle) {
+        const OrderRecord& record = records[handle];
+        if (!record.prev.IsNull()) {
+            records[record.prev].next = record.next;
+        } else {
+            level.head = record.next;
+        }
+        if (!record.next.IsNull()) {
+            records[record.next].prev = record.prev;
+        } else {
+            level.tail = record.prev;
+        }
+    }
+
+    /**
+     * Helper function to process order insertion
+     * Adds order to the appropriate price level and maintains order book structure
+     */
+    template <typename Levels>
+    void ProcessOrder(const Order& order, Levels& levels, OwnerId owner) {
+        CoverDepth(order.GetSide(), order.GetPrice(), levels);
+        LevelHandle& levelHandle = levels[order.GetPrice()];
+        if (levelHandle.IsNull()) levelHandle = AllocateLevel();
+        Level& level = levelPool[levelHandle];
+        if (level.slotsUsed == level.slots) RenumberQueue(level);
+        const OrderHandle handle = AllocateRecord();
+        OrderRecord& record = records[handle];
+        record.orderId = order.GetOrderId();
+        record.remaining = order.GetRemainingQuantity();
+        record.price = order.GetPrice();
+        record.flags = static_cast<std::uint8_t>((order.GetSide() == Side::Sell ? SellFlag : 0) |
+                                                 (order.GetOrderType() == OrderType::FillAndKill ? FillAndKillFlag : 0));
+        Enqueue(level, handle);
+        OrderCold& cold = Cold(handle);
+        cold = OrderCold();
+        cold.initialQuantity = order.GetInitialQuantity();
+        cold.queueOffset = level.queued;
+        cold.owner = owner;
+        cold.level = levelHandle;
+        cold.queueSlot = ++level.slotsUsed;
+        level.quantity += record.remaining;
+        level.queued += record.remaining;
+        AdjustDepth(order.GetSide(), order.GetPrice(), static_cast<std::int64_t>(record.remaining));
+        orders.emplace(record.orderId, handle);
+        if (owner != 0) LinkOwner(handle);
+    }
+
+    /**
+     * Gives the level's live orders fresh slots and offsets, in queue order,
+     * with room for as many new orders again. Amortised O(1) per insertion.
+     */
+    void RenumberQueue(Level& level) {
+        Quantity queued = 0;
+        std::uint32_t slot = 0;
+        for (OrderHandle handle = level.head; !handle.IsNull(); handle = records[handle].next) {
+            OrderCold& cold = Cold(handle);
+            cold.queueOffset = queued;
+            cold.queueSlot = ++slot;
+            queued += records[handle].remaining;
+        }
+        level.queued = queued;
+        level.matched = 0;
+        level.slotsUsed = slot;
+        level.slots = std::max(MinQueueSlots, std::bit_ceil(2 * slot + 1));
+        level.departed.clear();
+    }
+
+    /**
+     * Records quantity leaving an order's queue slot other than by matching
+     * at the front (cancel, L3 reduction or execution)
+     */
+    static void DepartQueue(Level& level, const OrderCold& cold, Quantity quantity) {
+        if (quantity == 0) return;
+        if (level.departed.empty()) level.departed.assign(level.slots + 1, 0);
+        for (std::size_t i = cold.queueSlot; i < level.departed.size(); i += i & (~i + 1)) level.departed[i] += quantity;
+    }
+
+    /**
+     * Mirrors a change in a level's quantity into the side's ladder
+     */
+    void AdjustDepth(Side side, Price price, std::int64_t quantity) {
+        DepthLadder& ladder = side == Side::Buy ? bidDepth : askDepth;
+        if (ladder.IsEnabled()) ladder.Add(price, quantity);
+    }
+
+    /**
+     * Makes sure the side's ladder covers price before an order rests there,
+     * rebuilding it around the side's levels if not
+     */
+    template <typename Levels>
+    void CoverDepth(Side side, Price price, const Levels& levels) {
+        DepthLadder& ladder = side == Side::Buy ? bidDepth : askDepth;
+        if (!depthTracked || ladder.Covers(price) || ladder.StaysDisabled(price)) return;
+        RebuildDepth(ladder, levels, price);
+    }
+
+    /**
+     * Re-centres a ladder on the side's levels plus price and reloads it
+     */
+    template <typename Levels>
+    void RebuildDepth(DepthLadder& ladder, const Levels& levels, Price price) const {
+        Price minPrice = price;
+        Price maxPrice = price;
+        for (const auto& [levelPrice, level] : levels) {
+            minPrice = std::min(minPrice, levelPrice);
+            maxPrice = std::max(maxPrice, levelPrice);
+        }
+        if (!ladder.Reset(minPrice, maxPrice)) return;
+        for (const auto& [levelPrice, level] : levels) {
+            ladder.Add(levelPrice, static_cast<std::int64_t>(levelPool[level].quantity));
+        }
+    }
+
+    /**
+     * Builds the ladders on the first depth query, and rebuilds a disabled
+     * one whose side may fit again since a far level was removed
+     */
+    void TrackDepth() const {
+        depthTracked = true;
+        if (!bidDepth.IsEnabled() && !bidDepth.IsTooWide() && !bids.empty()) {
+            RebuildDepth(bidDepth, bids, bids.begin()->first);
+        }
+        if (!askDepth.IsEnabled() && !askDepth.IsTooWide() && !asks.empty()) {
+            RebuildDepth(askDepth, asks, asks.begin()->first);
+        }
+    }
+
+    void LinkOwner(OrderHandle handle) {
+        OrderCold& cold = Cold(handle);
+        OrderHandle& head = ownerOrders[cold.owner];
+        cold.ownerNext = head;
+        if (!head.IsNull()) Cold(head).ownerPrev = handle;
+        head = handle;
+    }
+
+    void UnlinkOwner(OrderHandle handle) {
+        const OrderCold& cold = Cold(handle);
+        if (cold.owner == 0) return;
+        if (!cold.ownerNext.IsNull()) Cold(cold.ownerNext).ownerPrev = cold.ownerPrev;
+        if (!cold.ownerPrev.IsNull()) {
+            Cold(cold.ownerPrev).ownerNext = cold.ownerNext;
+        } else if (!cold.ownerNext.IsNull()) {
+            ownerOrders[cold.owner] = cold.ownerNext;
+        } else {
+            ownerOrders.erase(cold.owner);
+        }
+    }
+
+    /**
+     * Drops an order from the ID lookup and its owner's list and frees its
+     * record (it must already be out of its level's queue)
+     */
+    void EraseEntry(typename OrderIndex::iterator it) {
+        const OrderHandle handle = it->second;
+        UnlinkOwner(handle);
+        orders.erase(it);
+        records.Release(handle);
+    }
+
+    template <typename Levels>
+    void EraseLevel(Levels& levels, typename Levels::iterator it) {
+        (std::is_same_v<Levels, BidLevels> ? bidDepth : askDepth).OnLevelRemoved(it->first);
+        levelPool.Release(it->second);
+        levels.erase(it);
+    }
+
+    void EraseLevel(Side side, Price price) {
+        if (side == Side::Buy) {
+            EraseLevel(bids, bids.find(price));
+        } else {
+            EraseLevel(asks, asks.find(price));
+        }
+    }
+
+    /**
+     * Takes an order out of its level's queue and totals; an emptied level
+     * stays for the caller to erase
+     * @returns the order's level
+     */
+    Level& Unqueue(OrderHandle handle) {
+        const OrderRecord& record = records[handle];
+        const OrderCold& cold = Cold(handle);
+        Level& level = levelPool[cold.level];
+        Dequeue(level, handle);
+        level.quantity -= record.remaining;
+        if (!level.IsEmpty()) DepartQueue(level, cold, record.remaining);
+        AdjustDepth(record.GetSide(), record.price, -static_cast<std::int64_t>(record.remaining));
+        return level;
+    }
+
+    void RemoveOrder(typename OrderIndex::iterator it) {
+        const OrderRecord& record = records[it->second];
+        if (Unqueue(it->second).IsEmpty()) EraseLevel(record.GetSide(), record.price);
+        EraseEntry(it);
+    }
+
+    /**
+     * Mass cancel by owner: one walk of the owner's list. Emptied levels are
+     * erased together at the end, so no level is looked up per order.
+     */
+    template <typename OnCancel>
+    std::size_t CancelOwnerOrders(const MassCancelFilter& filter, OnCancel& onCancel) {
+        auto head = ownerOrders.find(filter.owner);
+        if (head == ownerOrders.end()) return 0;
+        std::size_t cancelled = 0;
+        emptiedLevels.clear();
+        for (OrderHandle handle = head->second; !handle.IsNull();) {
+            const OrderHandle next = Cold(handle).ownerNext;
+            const OrderRecord& record = records[handle];
+            if (filter.Matches(record.GetSide(), record.price)) {
+                const Order order = ToOrder(handle);
+                onCancel(order);
+                if (Unqueue(handle).IsEmpty()) emptiedLevels.emplace_back(record.GetSide(), record.price);
+                EraseEntry(orders.find(record.orderId));
+                ++cancelled;
+            }
+            handle = next;
+        }
+        for (const auto& [side, price] : emptiedLevels) EraseLevel(side, price);
+        return cancelled;
+    }
+
+    /**
+     * Mass cancel by side/band: walks the levels in the band and erases them
+     * as one range
+     */
+    template <typename Levels, typename OnCancel>
+    std::size_t CancelLevelRange(Side side, Levels& levels, typename Levels::iterator first,
+                                 typename Levels::iterator last, OnCancel& onCancel) {
+        std::size_t cancelled = 0;
+        for (auto it = first; it != last; ++it) {
+            const Level& level = levelPool[it->second];
+            AdjustDepth(side, it->first, -static_cast<std::int64_t>(level.quantity));
+            (side == Side::Buy ? bidDepth : askDepth).OnLevelRemoved(it->first);
+            for (OrderHandle handle = level.head; !handle.IsNull();) {
+                const OrderHandle next = records[handle].next;
+                const Order order = ToOrder(handle);
+                onCancel(order);
+                EraseEntry(orders.find(records[handle].orderId));
+                ++cancelled;
+                handle = next;
+            }
+            levelPool.Release(it->second);
+        }
+        levels.erase(first, last);
+        return cancelled;
+    }
+
+    /**
+     * Fills every order at the swept level against the taker, the only
+     * order at its own level, whose open quantity covers the whole of the
+     * swept level. Still one trade per resting order, but the taker, both
+     * levels' totals and the depth ladders are updated once, and the
+     * swept queue is dropped whole instead of unlinked order by order.
+     * The swept level is left empty for the caller to erase.
+     */
+    void SweepLevel(Side takerSide, Level& takerLevel, Level& swept, Price sweptPrice, Trades& trades) {
+        const OrderHandle takerHandle = takerLevel.head;
+        OrderRecord& taker = records[takerHandle];
+        for (OrderHandle handle = swept.head; !handle.IsNull();) {
+            const OrderRecord& maker = records[handle];
+            const OrderHandle next = maker.next;
+            if (takerSide == Side::Buy) {
+                trades.emplace_back(TradeInfo(taker.orderId, taker.price, maker.remaining),
+                                    TradeInfo(maker.orderId, maker.price, maker.remaining));
+            } else {
+                trades.emplace_back(TradeInfo(maker.orderId, maker.price, maker.remaining),
+                                    TradeInfo(taker.orderId, taker.price, maker.remaining));
+            }
+            EraseEntry(orders.find(maker.orderId));
+            handle = next;
+        }
+
+        const Quantity quantity = swept.quantity;
+        taker.remaining -= quantity;
+        takerLevel.quantity -= quantity;
+        takerLevel.matched += quantity;
+        AdjustDepth(takerSide, taker.price, -static_cast<std::int64_t>(quantity));
+        AdjustDepth(takerSide == Side::Buy ? Side::Sell : Side::Buy, sweptPrice, -static_cast<std::int64_t>(quantity));
+        swept.head = swept.tail = OrderHandle();
+        swept.quantity = 0;
+        if (taker.remaining == 0) {
+            Dequeue(takerLevel, takerHandle);
+            EraseEntry(orders.find(taker.orderId));
+        }
+    }
+
+    /**
+     * Core matching engine that pairs compatible buy and sell orders
+     * Implements price-time priority matching algorithm
+     * @returns vector of executed trades
+     */
+    Trades MatchOrders() {
+        Trades trades;
+
+        while (!bids.empty() && !asks.empty()) {
+            auto bidIt = bids.begin();
+            auto askIt = asks.begin();
+            
+            if (bidIt->first < askIt->first) break;
+
+            Level& bidLevel = levelPool[bidIt->second];
+            Level& askLevel = levelPool[askIt->second];
+
+            while (!bidLevel.IsEmpty() && !askLevel.IsEmpty()) {
+                // An incoming order is alone at its level, so it is usually
+                // the one that can take a whole level at once
+                if (levelSweeps) {
+                    if (bidLevel.head == bidLevel.tail && records[bidLevel.head].remaining >= askLevel.quantity) {
+                        SweepLevel(Side::Buy, bidLevel, askLevel, askIt->first, trades);
+                        break;
+                    }
+                    if (askLevel.head == askLevel.tail && records[askLevel.head].remaining >= bidLevel.quantity) {
+                        SweepLevel(Side::Sell, askLevel, bidLevel, bidIt->first, trades);
+                        break;
+                    }
+                }
+
+                const OrderHandle bidHandle = bidLevel.head;
+                const OrderHandle askHandle = askLevel.head;
+                OrderRecord& bid = records[bidHandle];
+                OrderRecord& ask = records[askHandle];
+
+                Quantity quantity = std::min(bid.remaining, ask.remaining);
+
+                bid.remaining -= quantity;
+                ask.remaining -= quantity;
+                bidLevel.quantity -= quantity;
+                askLevel.quantity -= quantity;
+                bidLevel.matched += quantity;
+                askLevel.matched += quantity;
+                AdjustDepth(Side::Buy, bidIt->first, -static_cast<std::int64_t>(quantity));
+                AdjustDepth(Side::Sell, askIt->first, -static_cast<std::int64_t>(quantity));
+
+                trades.emplace_back(
+                    TradeInfo(bid.orderId, bid.price, quantity),
+                    TradeInfo(ask.orderId, ask.price, quantity)
+                );
+
+                if (bid.remaining == 0) {
+                    Dequeue(bidLevel, bidHandle);
+                    EraseEntry(orders.find(bid.orderId));
+                }
+                if (ask.remaining == 0) {
+                    Dequeue(askLevel, askHandle);
+                    EraseEntry(orders.find(ask.orderId));
+                }
+            }
+
+            // Erase exhausted levels only after the inner loop stops touching them
+            if (bidLevel.IsEmpty()) EraseLevel(bids, bidIt);
+            if (askLevel.IsEmpty()) EraseLevel(asks, askIt);
+        }
+
+        return trades;
+    }
+
+private:
+    // Level walks answering depth queries when a side's ladder is disabled
+
+    template <typename Levels>
+    Quantity WalkQuantityUpTo(const Levels& levels, typename Levels::const_iterator end) const {
+        Quantity total = 0;
+        for (auto it = levels.begin(); it != end; ++it) total += levelPool[it->second].quantity;
+        return total;
+    }
+
+    template <typename Levels>
+    FillEstimate WalkFill(const Levels& levels, Quantity quantity) const {
+        FillEstimate estimate;
+        for (auto it = levels.begin(); it != levels.end() && estimate.quantity < quantity; ++it) {
+            const Quantity take = std::min(levelPool[it->second].quantity, quantity - estimate.quantity);
+            estimate.quantity += take;
+            estimate.notional += static_cast<std::int64_t>(take) * it->first;
+            estimate.worstPrice = it->first;
+        }
+        return estimate;
+    }
+
+public:
+    /**
+     * Adds a new order to the book; a non-zero owner makes it reachable by
+     * owner mass cancels
+     * @returns vector of trades if order was matched
+     */
+    Trades AddOrder(const Order& order, OwnerId owner = 0) {
+        if (orders.find(order.GetOrderId()) != orders.end()) {
+            return Trades();
+        }
+
+        if (order.GetOrderType() == OrderType::FillAndKill && 
+            !CanMatch(order.GetSide(), order.GetPrice())) {
+            return Trades();
+        }
+
+        if (order.GetSide() == Side::Buy) {
+            ProcessOrder(order, bids, owner);
+        } else {
+            ProcessOrder(order, asks, owner);
+        }
+
+        Trades trades = MatchOrders();
+
+        // Only the incoming order can be an unfilled FillAndKill: every
+        // earlier one was removed by the AddOrder call that submitted it
+        if (order.GetOrderType() == OrderType::FillAndKill) CancelOrder(order.GetOrderId());
+        return trades;
+    }
+
+    /**
+     * Cancels an existing order
+     * Removes order from both price level and ID lookup
+     */
+    void CancelOrder(OrderId orderId) {
+        auto it = orders.find(orderId);
+        if (it == orders.end()) return;
+        RemoveOrder(it);
+    }
+
+    /**
+     * Modifies an existing order
+     * Implements modification as cancel-and-replace
+     * @returns vector of trades if modified order was matched
+     */
+    Trades ModifyOrder(const OrderModify& modify) {
+        auto it = orders.find(modify.GetOrderId());
+        if (it == orders.end()) return Trades();
+
+        OrderType type = records[it->second].GetOrderType();
+        const OwnerId owner = Cold(it->second).owner;
+        RemoveOrder(it);
+        return AddOrder(modify.ToOrder(type), owner);
+    }
+
+    /**
+     * Cancels every resting order that matches filter, calling
+     * onCancel(const Order&) for each just before it leaves the book
+     * @returns the number of orders cancelled
+     */
+    template <typename OnCancel>
+    std::size_t CancelOrders(const MassCancelFilter& filter, OnCancel&& onCancel) {
+        if (filter.owner != 0) return CancelOwnerOrders(filter, onCancel);
+        if (filter.minPrice > filter.maxPrice) return 0;
+        std::size_t cancelled = 0;
+        if (!filter.side || *filter.side == Side::Buy) {
+            cancelled += CancelLevelRange(Side::Buy, bids, bids.lower_bound(filter.maxPrice), bids.upper_bound(filter.minPrice),
+                                          onCancel);
+        }
+        if (!filter.side || *filter.side == Side::Sell) {
+            cancelled += CancelLevelRange(Side::Sell, asks, asks.lower_bound(filter.minPrice), asks.upper_bound(filter.maxPrice),
+                                          onCancel);
+        }
+        return cancelled;
+    }
+
+    /**
+     * Level-3 feed operation: the order traded `quantity` against an order
+     * that is not in this book (e.g. an exchange execution message).
+     * The order keeps its queue position and leaves the book once filled.
+     * @returns false if the order is not in the book
+     * @throws std::runtime_error if quantity exceeds the remaining quantity
+     */
+    bool ExecuteOrder(OrderId orderId, Quantity quantity) {
+        auto it = orders.find(orderId);
+        if (it == orders.end()) return false;
+        OrderRecord& record = records[it->second];
+        if (quantity > record.remaining) {
+            throw std::runtime_error(
+                "Order (" + std::to_string(orderId) +
+                ") cannot be filled for more than its remaining quantity.");
+        }
+        record.remaining -= quantity;
+        OrderCold& cold = Cold(it->second);
+        levelPool[cold.level].quantity -= quantity;
+        DepartQueue(levelPool[cold.level], cold, quantity);
+        AdjustDepth(record.GetSide(), record.price, -static_cast<std::int64_t>(quantity));
+        if (record.remaining == 0) RemoveOrder(it);
+        return true;
+    }
+
+    /**
+     * Level-3 feed operation: cancels part of an order's open quantity
+     * without losing queue position; the order leaves the book at zero
+     * @returns false if the order is not in the book
+     * @throws std::runtime_error if quantity exceeds the remaining quantity
+     */
+    bool ReduceOrder(OrderId orderId, Quantity quantity) {
+        auto it = orders.find(orderId);
+        if (it == orders.end()) return false;
+        OrderRecord& record = records[it->second];
+        if (quantity > record.remaining) {
+            throw std::runtime_error(
+                "Order (" + std::to_string(orderId) +
+                ") cannot be reduced by more than its remaining quantity.");
+        }
+        record.remaining -= quantity;
+        OrderCold& cold = Cold(it->second);
+        cold.initialQuantity -= quantity;
+        levelPool[cold.level].quantity -= quantity;
+        DepartQueue(levelPool[cold.level], cold, quantity);
+        AdjustDepth(record.GetSide(), record.price, -static_cast<std::int64_t>(quantity));
+        if (record.remaining == 0) RemoveOrder(it);
+        return true;
+    }
+
+    /**
+     * Level-3 feed operation: removes an order and enters a new one with a
+     * new id, price and quantity on the same side (losing time priority)
+     * @returns trades if the replacement crossed, empty if the original is unknown
+     */
+    Trades ReplaceOrder(OrderId orderId, OrderId newOrderId, Price price, Quantity quantity) {
+        auto it = orders.find(orderId);
+        if (it == orders.end()) return Trades();
+
+        const OrderType type = records[it->second].GetOrderType();
+        const Side side = records[it->second].GetSide();
+        const OwnerId owner = Cold(it->second).owner;
+        RemoveOrder(it);
+        return AddOrder(Order(type, newOrderId, side, price, quantity), owner);
+    }
+
+    /**
+     * @returns true if the order is currently resting in the book
+     */
+    bool Contains(OrderId orderId) const {
+        return orders.find(orderId) != orders.end();
+    }
+
+    /**
+     * @returns a copy of the resting order with this id, empty if it is not resting
+     */
+    std::optional<Order> FindOrder(OrderId orderId) const {
+        auto it = orders.find(orderId);
+        if (it == orders.end()) return std::nullopt;
+        return ToOrder(it->second);
+    }
+
+    /**
+     * @returns open quantity ahead of and behind a resting order at its
+     * level, in O(log orders at the level); empty if the order is not resting
+     */
+    std::optional<QueuePosition> GetQueuePosition(OrderId orderId) const {
+        auto it = orders.find(orderId);
+        if (it == orders.end()) return std::nullopt;
+        const OrderCold& cold = Cold(it->second);
+        const Level& level = levelPool[cold.level];
+        QueuePosition position;
+        if (level.head != it->second) {
+            Quantity departed = 0;
+            if (!level.departed.empty()) {
+                for (std::size_t i = cold.queueSlot - 1; i > 0; i -= i & (~i + 1)) departed += level.departed[i];
+            }
+            position.ahead = cold.queueOffset - level.matched - departed;
+        }
+        position.behind = level.quantity - position.ahead - records[it->second].remaining;
+        return position;
+    }
+
+    /**
+     * @returns the best bid (Buy) or best ask (Sell), empty if that side is empty
+     */
+    std::optional<Price> GetBestPrice(Side side) const {
+        if (side == Side::Buy) return bids.empty() ? std::nullopt : std::optional<Price>(bids.begin()->first);
+        return asks.empty() ? std::nullopt : std::optional<Price>(asks.begin()->first);
+    }
+
+    /**
+     * @returns total open quantity at a price level (0 if the level is empty)
+     */
+    Quantity GetLevelQuantity(Side side, Price price) const {
+        if (side == Side::Buy) {
+            auto it = bids.find(price);
+            return it == bids.end() ? 0 : levelPool[it->second].quantity;
+        }
+        auto it = asks.find(price);
+        return it == asks.end() ? 0 : levelPool[it->second].quantity;
+    }
+
+    /**
+     * @returns how much an order on side could take at prices up to and
+     * including limit (for a buy, the ask quantity priced at or below limit)
+     */
+    Quantity GetQuantityUpTo(Side side, Price limit) const {
+        TrackDepth();
+        if (side == Side::Buy) {
+            if (askDepth.IsEnabled()) return askDepth.GetQuantityUpTo(limit);
+            return WalkQuantityUpTo(asks, asks.upper_bound(limit));
+        }
+        if (bidDepth.IsEnabled()) return bidDepth.GetQuantityUpTo(limit);
+        return WalkQuantityUpTo(bids, bids.upper_bound(limit));
+    }
+
+    /**
+     * @returns what an order on side for quantity would get sweeping the
+     * opposite side now: fillable quantity, notional and worst price
+     */
+    FillEstimate EstimateFill(Side side, Quantity quantity) const {
+        TrackDepth();
+        if (side == Side::Buy) return askDepth.IsEnabled() ? askDepth.EstimateFill(quantity) : WalkFill(asks, quantity);
+        return bidDepth.IsEnabled() ? bidDepth.EstimateFill(quantity) : WalkFill(bids, quantity);
+    }
+
+    /**
+     * Turns whole-level sweeps off (or back on), so every fill goes through
+     * the per-order loop. Trades are the same either way; this exists so
+     * sweepbench can time the loop as its baseline.
+     */
+    void SetLevelSweeps(bool enabled) { levelSweeps = enabled; }
+
+    /**
+     * @returns current number of active orders in the book
+     */
+    std::size_t Size() const { 
+        return orders.size(); 
+    }
+
+    /**
+     * Creates a snapshot of current order book state
+     * @returns aggregated level information for both sides of the book
+     */
+    OrderbookLevelInfos GetOrderInfos() const {
+        LevelInfos bidInfos, askInfos;
+        bidInfos.reserve(bids.size());
+        askInfos.reserve(asks.size());
+
+        for (const auto& [price, level] : bids) {
+            bidInfos.emplace_back(price, levelPool[level].quantity);
+        }
+
+        for (const auto& [price, level] : asks) {
+            askInfos.emplace_back(price, levelPool[level].quantity);
+        }
+
+        return OrderbookLevelInfos(bidInfos, askInfos);
+    }
+};
+
+using OrderBook = BasicOrderBook<>;
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "protocol.h"
+
+/**
+ * Order Status History
+ *
+ * Answers "what happened to order X" after the order has left the book.
+ * MatchingEngine keeps the status of live orders next to their routing
+ * entry; when an order is filled, cancelled or rejected its final status is
+ * moved into an OrderStatusHistory.
+ *
+ * Design Notes:
+ * - The history is a fixed ring of terminal records allocated once; the
+ *   oldest record is overwritten when it is full, so memory stays bounded
+ *   however long the engine runs
+ * - A flat open-addressing index of 8-byte (hash, ring slot) entries, twice
+ *   the ring size with linear probing and backward-shift deletion, finds a
+ *   record in O(1) and, like the ring, never allocates after construction
+ * - An evicted record only removes its index entry if no newer record for
+ *   the same OrderId has replaced it
+ * - Lookups return the most recent record for an OrderId
+ */
+
+enum class OrderState : std::uint8_t {
+    New,              // Resting, nothing filled yet
+    PartiallyFilled,  // Resting with some quantity filled
+    Filled,
+    Cancelled,        // Cancelled by its owner, a mass cancel, or an unfilled FillAndKill remainder
+    Rejected
+};
+
+/**
+ * Status of one order; quantity is the order's total (filled + open)
+ * quantity, notional the sum of execution price * quantity in ticks
+ */
+struct OrderStatus {
+    OrderId orderId = 0;
+    SessionId session = 0;
+    std::int64_t notional = 0;
+    Price price = 0;
+    Quantity quantity = 0;
+    Quantity filled = 0;
+    Side side = Side::Buy;
+    OrderState state = OrderState::New;
+    RejectReason reason = RejectReason::None;  // Set for Rejected only
+
+    Quantity GetOpenQuantity() const {
+        return state == OrderState::New || state == OrderState::PartiallyFilled ? quantity - filled : 0;
+    }
+
+    /**
+     * @returns the average execution price, 0 before the first fill
+     */
+    double GetAveragePrice() const {
+        return filled ? static_cast<double>(notional) / static_cast<double>(filled) : 0.0;
+    }
+
+    bool IsTerminal() const {
+        return state == OrderState::Filled || state == OrderState::Cancelled || state == OrderState::Rejected;
+    }
+};
+
+class OrderStatusHistory {
+public:
+    explicit OrderStatusHistory(std::size_t capacity) : records(capacity) {
+        if (capacity == 0 || capacity > std::numeric_limits<std::uint32_t>::max() / 2) {
+            throw std::runtime_error("OrderStatusHistory: capacity must be between 1 and 2^31");
+        }
+        std::size_t size = 2;
+        while (size < 2 * capacity) size *= 2;  // Load factor at most 1/2
+        index.resize(size);
+        mask = size - 1;
+    }
+
+    /**
+     * Stores a terminal record, evicting the oldest if the ring is full
+     */
+    void Record(const OrderStatus& status) {
+        const std::uint32_t slot = static_cast<std::uint32_t>(next % records.size());
+        if (next >= records.size()) Unindex(records[slot].orderId, slot);
+        records[slot] = status;
+        ++next;
+
+        const std::uint32_t hash = Hash(status.orderId);
+        std::size_t i = hash & mask;
+        for (; index[i].slot != Empty; i = (i + 1) & mask) {
+            if (index[i].hash == hash && records[index[i].slot].orderId == status.orderId) {
+                index[i].slot = slot;  // The previous record stays in the ring, unindexed
+                return;
+            }
+        }
+        index[i] = Entry{hash, slot};
+        ++size;
+    }
+
+    /**
+     * @returns the most recent retained record for orderId
+     */
+    std::optional<OrderStatus> Find(OrderId orderId) const {
+        const std::uint32_t hash = Hash(orderId);
+        for (std::size_t i = hash & mask; index[i].slot != Empty; i = (i + 1) & mask) {
+            if (index[i].hash == hash && records[index[i].slot].orderId == orderId) return records[index[i].slot];
+        }
+        return std::nullopt;
+    }
+
+    std::size_t GetCapacity() const { return records.size(); }
+    std::size_t GetSize() const { return size; }  // Distinct OrderIds retained
+    std::uint64_t GetRecorded() const { return next; }  // Including evicted records
+
+private:
+    static constexpr std::uint32_t Empty = std::numeric_limits<std::uint32_t>::max();
+
+    /**
+     * 8 bytes: the OrderId itself is read from the record, only to confirm a
+     * hash match
+     */
+    struct Entry {
+        std::uint32_t hash = 0;
+        std::uint32_t slot = Empty;  // Ring slot of the newest record for its OrderId
+    };
+
+    static std::uint32_t Hash(OrderId orderId) {
+        // Fibonacci hashing: OrderIds are often sequential
+        return static_cast<std::uint32_t>((orderId * 0x9E3779B97F4A7C15ULL) >> 32);
+    }
+
+    /**
+     * Removes the entry pointing at slot, if orderId's newest record is
+     * still there, shifting later entries of the probe run back so lookups
+     * need no tombstones
+     */
+    void Unindex(OrderId orderId, std::uint32_t slot) {
+        std::size_t hole = Hash(orderId) & mask;
+        while (index[hole].slot != Empty && index[hole].slot != slot) hole = (hole + 1) & mask;
+        if (index[hole].slot == Empty) return;  // Superseded by a newer record
+        --size;
+        for (std::size_t i = (hole + 1) & mask; index[i].slot != Empty; i = (i + 1) & mask) {
+            // Entry i may fill the hole unless its home lies cyclically in (hole, i]
+            if (((i - index[i].hash) & mask) >= ((i - hole) & mask)) {
+                index[hole] = index[i];
+                hole = i;
+            }
+        }
+        index[hole] = Entry{};
+    }
+
+    std::vector<OrderStatus> records;  // Ring; the record with sequence s lives at s % capacity
+    std::vector<Entry> index;          // Open addressing, linear probing
+    std::size_t mask = 0;
+    std::size_t size = 0;
+    std::uint64_t next = 0;
+};
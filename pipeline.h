@@ -0,0 +1,415 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "journal.h"
+#include "latency_recorder.h"
+#include "matching_engine.h"
+#include "protocol.h"
+#include "spsc_queue.h"
+#include "text_command.h"
+
+/**
+ * Staged Order Pipeline
+ *
+ * Splits the work the REPL does in one loop (parse, match, print) into four
+ * stages, each on its own thread and optionally pinned to its own core:
+ * 1. Decode  - splits the input into lines and parses each into a Command
+ * 2. Risk    - pre-trade limits; a failing order becomes a reject and never
+ *              reaches the book
+ * 3. Match   - runs the MatchingEngine, recording events in the entry
+ * 4. Publish - formats events as text and journals accepted commands
+ *
+ * Stages share one pre-allocated ring of PipelineEntry (Disruptor style):
+ * each stage updates an entry in place, nothing is copied between stages.
+ * Every stage publishes a counter of entries it has finished. A stage takes
+ * everything up to its upstream counter as one batch and publishes its own
+ * counter once per batch, so a stage that falls behind catches up in larger
+ * batches. Decode, the producer, reuses an entry only after Publish is done
+ * with it. Throughput is bounded by the slowest stage, not the sum of all four.
+ *
+ * Input lines use the REPL syntax:
+ *   ADD <GTC|FAK> <BUY|SELL> <OrderId> <Price> <Quantity>
+ *   CANCEL <OrderId>
+ *   MODIFY <OrderId> <BUY|SELL> <Price> <Quantity>
+ *   MASSCANCEL <BUY|SELL|ALL> [<MinPrice> <MaxPrice>]
+ */
+
+/**
+ * Static pre-trade limits applied to adds and modifies
+ */
+struct RiskLimits {
+    Quantity maxOrderQuantity = 1'000'000;
+    std::int64_t maxOrderNotional = 1'000'000'000;  // Price * quantity, in ticks
+    Price minPrice = 1;
+    Price maxPrice = 1'000'000;
+};
+
+struct PipelineConfig {
+    std::size_t ringSize = 4096;  // Rounded up to a power of two
+    RiskLimits risk;
+    std::string journalPath;      // Empty disables journaling
+    std::vector<int> cpus;        // Empty, or one CPU per stage (Decode, Risk, Match, Publish)
+};
+
+struct PipelineStageStats {
+    std::uint64_t entries = 0;
+    std::uint64_t batches = 0;
+    std::uint64_t busyNanos = 0;  // Time spent inside batches (excludes waiting)
+};
+
+struct PipelineStats {
+    static constexpr std::size_t StageCount = 4;
+    static constexpr const char* StageNames[StageCount] = {"decode", "risk", "match", "publish"};
+
+    PipelineStageStats stages[StageCount];
+    std::uint64_t malformed = 0;
+    std::uint64_t riskRejects = 0;
+    std::uint64_t events = 0;
+};
+
+/**
+ * One slot of the ring, reused for the whole run
+ */
+struct alignas(64) PipelineEntry {
+    static constexpr std::size_t InlineEvents = 8;
+
+    std::string_view line;  // Set by Decode; a view into the caller's input
+    Command command{};
+    RejectReason reject = RejectReason::None;  // Malformed (Decode) or RiskLimit (Risk)
+    std::uint32_t eventCount = 0;
+    std::array<Event, InlineEvents> events;
+    std::vector<Event> overflow;  // Events past InlineEvents; keeps its capacity across reuse
+
+    void AddEvent(const Event& event) {
+        if (eventCount < InlineEvents) {
+            events[eventCount] = event;
+        } else {
+            overflow.push_back(event);
+        }
+        ++eventCount;
+    }
+
+    const Event& GetEvent(std::uint32_t index) const {
+        return index < InlineEvents ? events[index] : overflow[index - InlineEvents];
+    }
+};
+
+class OrderPipeline {
+public:
+    explicit OrderPipeline(const PipelineConfig& config)
+        : config(config), ringMask(RoundUpToPowerOfTwo(config.ringSize) - 1),
+          ring(std::make_unique<PipelineEntry[]>(ringMask + 1)) {
+        if (!config.cpus.empty() && config.cpus.size() != PipelineStats::StageCount) {
+            throw std::runtime_error("OrderPipeline: give one CPU per stage (4) or none");
+        }
+#if defined(__linux__)
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        for (int cpu : config.cpus) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)) {
+                throw std::runtime_error("OrderPipeline: CPU " + std::to_string(cpu) + " is not available");
+            }
+        }
+#endif
+        if (!config.journalPath.empty()) journal = std::make_unique<Journal>(config.journalPath);
+        text.reserve(OutputChunk + 256);
+    }
+
+    OrderPipeline(const OrderPipeline&) = delete;
+    OrderPipeline& operator=(const OrderPipeline&) = delete;
+
+    /**
+     * Pushes every line of input through the four stage threads and returns
+     * once all of it has been published. out may be null to discard output.
+     */
+    void Run(std::string_view input, std::ostream* out) {
+        this->input = input;
+        this->out = out;
+        std::vector<std::thread> threads;
+        threads.emplace_back([this] { RunStage(0, [this] { RunDecodeStage(); }); });
+        threads.emplace_back([this] { RunStage(1, [this] { RunConsumerStage(1, &OrderPipeline::CheckRisk); }); });
+        threads.emplace_back([this] { RunStage(2, [this] { RunConsumerStage(2, &OrderPipeline::Match); }); });
+        threads.emplace_back([this] { RunStage(3, [this] { RunConsumerStage(3, &OrderPipeline::Publish); }); });
+        for (std::thread& thread : threads) thread.join();
+        if (error) std::rethrow_exception(error);
+        Finish();
+    }
+
+    /**
+     * The same four steps on the calling thread, one line at a time
+     */
+    void RunSequential(std::string_view input, std::ostream* out) {
+        this->input = input;
+        this->out = out;
+        PipelineEntry& entry = ring[0];
+        std::uint64_t count = 0;
+        while (NextLine(entry)) {
+            Decode(entry);
+            CheckRisk(entry);
+            Match(entry);
+            Publish(entry);
+            ++count;
+        }
+        for (PipelineStageStats& stage : stats.stages) stage.entries = stage.batches = count;
+        Finish();
+    }
+
+    /**
+     * Only meaningful once Run() or RunSequential() has returned
+     */
+    const PipelineStats& GetStats() const { return stats; }
+    const MatchingEngine& GetEngine() const { return engine; }
+
+private:
+    static constexpr std::size_t ProducerBatch = 64;  // Decode publishes at least this often
+    static constexpr std::size_t OutputChunk = 1 << 16;
+    static constexpr std::uint64_t Unknown = std::numeric_limits<std::uint64_t>::max();
+    static constexpr SessionId InputSession = 1;
+
+    struct alignas(64) StageCursor {
+        std::atomic<std::uint64_t> value{0};  // Entries this stage has finished
+    };
+
+    static std::size_t RoundUpToPowerOfTwo(std::size_t n) {
+        std::size_t power = 2;
+        while (power < n) power <<= 1;
+        return power;
+    }
+
+    template <typename Body>
+    void RunStage(std::size_t stage, Body&& body) {
+#if defined(__linux__)
+        if (!config.cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(config.cpus[stage], &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+#endif
+        try {
+            body();
+        } catch (...) {
+            if (!failed.exchange(true)) error = std::current_exception();
+        }
+    }
+
+    /**
+     * Spins briefly, then yields, so idle stages do not starve busy ones
+     * when there are fewer cores than stages
+     */
+    static void Backoff(unsigned& spins) {
+        if (++spins < 256) {
+            CpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    void RunDecodeStage() {
+        PipelineStageStats& stageStats = stats.stages[0];
+        std::uint64_t next = 0;
+        unsigned spins = 0;
+        bool more = true;
+        while (more) {
+            const std::uint64_t limit = cursors[3].value.load(std::memory_order_acquire) + ringMask + 1;
+            if (next == limit) {
+                if (failed.load(std::memory_order_relaxed)) return;
+                Backoff(spins);
+                continue;
+            }
+            spins = 0;
+            const std::uint64_t start = NowNanos();
+            const std::uint64_t end = std::min<std::uint64_t>(limit, next + ProducerBatch);
+            for (; next < end; ++next) {
+                PipelineEntry& entry = ring[next & ringMask];
+                if (!NextLine(entry)) {
+                    more = false;
+                    break;
+                }
+                Decode(entry);
+            }
+            cursors[0].value.store(next, std::memory_order_release);
+            stageStats.busyNanos += NowNanos() - start;
+            ++stageStats.batches;
+        }
+        stageStats.entries = next;
+        total.store(next, std::memory_order_release);
+    }
+
+    /**
+     * Batching consumer: handles everything the upstream stage has finished
+     */
+    void RunConsumerStage(std::size_t stage, void (OrderPipeline::*handle)(PipelineEntry&)) {
+        PipelineStageStats& stageStats = stats.stages[stage];
+        const StageCursor& upstream = cursors[stage - 1];
+        std::uint64_t next = 0;
+        unsigned spins = 0;
+        while (true) {
+            const std::uint64_t available = upstream.value.load(std::memory_order_acquire);
+            if (available == next) {
+                if (next == total.load(std::memory_order_acquire) || failed.load(std::memory_order_relaxed)) break;
+                Backoff(spins);
+                continue;
+            }
+            spins = 0;
+            const std::uint64_t start = NowNanos();
+            for (; next < available; ++next) (this->*handle)(ring[next & ringMask]);
+            cursors[stage].value.store(next, std::memory_order_release);
+            stageStats.busyNanos += NowNanos() - start;
+            ++stageStats.batches;
+        }
+        stageStats.entries = next;
+    }
+
+    // ---------------------------------------------------------------------
+    // Stages
+    // ---------------------------------------------------------------------
+
+    /**
+     * @returns false once the input is exhausted
+     */
+    bool NextLine(PipelineEntry& entry) {
+        while (position < input.size()) {
+            std::size_t end = input.find('\n', position);
+            if (end == std::string_view::npos) end = input.size();
+            entry.line = input.substr(position, end - position);
+            position = end + 1;
+            if (entry.line.find_first_not_of(" \t\r") != std::string_view::npos) return true;  // Skip blank lines
+        }
+        return false;
+    }
+
+    void Decode(PipelineEntry& entry) {
+        entry.eventCount = 0;
+        entry.overflow.clear();
+        entry.reject = DecodeTextCommand(entry.line, entry.command) ? RejectReason::None : RejectReason::Malformed;
+        entry.command.session = InputSession;
+    }
+
+    void CheckRisk(PipelineEntry& entry) {
+        if (entry.reject != RejectReason::None || entry.command.type == CommandType::Cancel ||
+            entry.command.type == CommandType::MassCancel) {
+            return;
+        }
+        const Command& command = entry.command;
+        const RiskLimits& limits = config.risk;
+        if (command.quantity == 0 || command.quantity > limits.maxOrderQuantity || command.price < limits.minPrice ||
+            command.price > limits.maxPrice ||
+            static_cast<std::int64_t>(command.price) * static_cast<std::int64_t>(command.quantity) >
+                limits.maxOrderNotional) {
+            entry.reject = RejectReason::RiskLimit;
+        }
+    }
+
+    void Match(PipelineEntry& entry) {
+        if (entry.reject != RejectReason::None) {
+            const Command& command = entry.command;
+            entry.AddEvent(Event{MessageType::Reject, entry.reject, command.session, command.clientTag,
+                                 command.orderId, command.price, command.quantity});
+            return;
+        }
+        engine.Process(entry.command, [&entry](const Event& event) { entry.AddEvent(event); });
+    }
+
+    void Publish(PipelineEntry& entry) {
+        if (entry.reject == RejectReason::Malformed) ++stats.malformed;
+        if (entry.reject == RejectReason::RiskLimit) ++stats.riskRejects;
+        if (journal && entry.reject == RejectReason::None && !journal->Append(entry.command)) {
+            journal->FlushSync();
+            journal->Append(entry.command);
+        }
+        for (std::uint32_t i = 0; i < entry.eventCount; ++i) Format(entry.GetEvent(i));
+        stats.events += entry.eventCount;
+        if (text.size() >= OutputChunk) FlushOutput();
+    }
+
+    /**
+     * One line per event, e.g. "FILL 42 10@1000"
+     */
+    void Format(const Event& event) {
+        char line[96];
+        char* p = line;
+        char* const end = line + sizeof(line) - 8;  // Room for the separators
+        auto append = [&p](std::string_view word) {
+            std::memcpy(p, word.data(), word.size());
+            p += word.size();
+        };
+        switch (event.type) {
+        case MessageType::Ack: append("ACK "); break;
+        case MessageType::CancelAck: append("CANCELED "); break;
+        case MessageType::MassCancelAck: append("MASSCANCELED "); break;
+        case MessageType::Expired: append("EXPIRED "); break;
+        case MessageType::Fill: append("FILL "); break;
+        default: append("REJECT "); break;
+        }
+        p = std::to_chars(p, end, event.type == MessageType::MassCancelAck ? event.quantity : event.orderId).ptr;
+        if (event.type == MessageType::Expired) {
+            *p++ = ' ';
+            p = std::to_chars(p, end, event.quantity).ptr;
+        } else if (event.type == MessageType::Fill) {
+            *p++ = ' ';
+            p = std::to_chars(p, end, event.quantity).ptr;
+            *p++ = '@';
+            p = std::to_chars(p, end, event.price).ptr;
+        } else if (event.type == MessageType::Reject) {
+            *p++ = ' ';
+            p = std::to_chars(p, end, static_cast<int>(event.reason)).ptr;
+        }
+        *p++ = '\n';
+        text.append(line, static_cast<std::size_t>(p - line));
+    }
+
+    void FlushOutput() {
+        if (out) out->write(text.data(), static_cast<std::streamsize>(text.size()));
+        text.clear();
+    }
+
+    void Finish() {
+        FlushOutput();
+        if (out) out->flush();
+        if (journal) journal->FlushSync();
+    }
+
+    PipelineConfig config;
+    std::size_t ringMask;
+    std::unique_ptr<PipelineEntry[]> ring;
+    StageCursor cursors[PipelineStats::StageCount];
+    alignas(64) std::atomic<std::uint64_t> total{Unknown};  // Entries produced, once Decode is done
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    // Decode stage
+    std::string_view input;
+    std::size_t position = 0;
+
+    // Match stage
+    MatchingEngine engine;
+
+    // Publish stage
+    std::unique_ptr<Journal> journal;
+    std::ostream* out = nullptr;
+    std::string text;
+
+    PipelineStats stats;
+};
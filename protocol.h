@@ -0,0 +1,337 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "order_book.h"
+
+/**
+ * Binary order-entry protocol spoken by the TCP gateway
+ *
+ * Every frame starts with a MessageHeader whose length covers the whole frame
+ * (header included), so a reader can always find the next frame boundary.
+ * Integers are sent in host byte order; every host we deploy on is little-endian.
+ */
+
+using SessionId = std::uint64_t;
+
+enum class MessageType : std::uint8_t {
+    // Client -> engine
+    NewOrder = 'N',
+    CancelOrder = 'C',
+    ModifyOrder = 'M',
+    MassCancel = 'K',
+    // Engine -> client
+    Ack = 'A',
+    Reject = 'R',
+    Fill = 'F',
+    CancelAck = 'X',
+    MassCancelAck = 'Y',
+    Expired = 'E'  // The unfilled rest of a FillAndKill left the book
+};
+
+enum class RejectReason : std::uint8_t {
+    None = 0,
+    DuplicateOrderId,
+    UnknownOrderId,  // Also sent for another session's order, so ids are not probed
+    Malformed,
+    RiskLimit  // Refused by pre-trade risk checks (see pipeline.h)
+};
+
+#pragma pack(push, 1)
+
+struct MessageHeader {
+    std::uint16_t length;
+    MessageType type;
+};
+
+/**
+ * clientTag is opaque to the engine and echoed back in the response,
+ * which lets clients correlate requests without a lookup table
+ */
+struct NewOrderMessage {
+    static constexpr MessageType Type = MessageType::NewOrder;
+    MessageHeader header;
+    std::uint64_t clientTag;
+    OrderId orderId;
+    Price price;
+    Quantity quantity;
+    std::uint8_t orderType;  // 0 = GoodTilCancel, 1 = FillAndKill
+    std::uint8_t side;       // 0 = Buy, 1 = Sell
+};
+
+struct CancelOrderMessage {
+    static constexpr MessageType Type = MessageType::CancelOrder;
+    MessageHeader header;
+    std::uint64_t clientTag;
+    OrderId orderId;
+};
+
+struct ModifyOrderMessage {
+    static constexpr MessageType Type = MessageType::ModifyOrder;
+    MessageHeader header;
+    std::uint64_t clientTag;
+    OrderId orderId;
+    Price price;
+    Quantity quantity;
+    std::uint8_t side;
+};
+
+/**
+ * Cancels the sender's own resting orders on one or both sides within a
+ * price band; each cancelled order gets a CancelAck carrying this clientTag,
+ * then a MassCancelAck reports the total
+ */
+struct MassCancelMessage {
+    static constexpr MessageType Type = MessageType::MassCancel;
+    MessageHeader header;
+    std::uint64_t clientTag;
+    Price minPrice;
+    Price maxPrice;
+    std::uint8_t side;  // 0 = Buy, 1 = Sell, 2 = both
+};
+
+struct AckMessage {
+    static constexpr MessageType Type = MessageType::Ack;
+    MessageHeader header;
+    std::uint64_t clientTag;
+    OrderId orderId;
+};
+
+struct RejectMessage {
+    static constexpr MessageType Type = MessageType::Reject;
+    MessageHeader header;
+    std::uint64_t clientTag;
+    OrderId orderId;
+    RejectReason reason;
+};
+
+struct FillMessage {
+    static constexpr MessageType Type = MessageType::Fill;
+    MessageHeader header;
+    OrderId orderId;
+    Price price;
+    Quantity quantity;
+};
+
+struct CancelAckMessage {
+    static constexpr MessageType Type = MessageType::CancelAck;
+    MessageHeader header;
+    std::uint64_t clientTag;
+    OrderId orderId;
+};
+
+struct MassCancelAckMessage {
+    static constexpr MessageType Type = MessageType::MassCancelAck;
+    MessageHeader header;
+    std::uint64_t clientTag;
+    std::uint64_t cancelled;
+};
+
+struct ExpiredMessage {
+    static constexpr MessageType Type = MessageType::Expired;
+    MessageHeader header;
+    std::uint64_t clientTag;  // Of the order or modify that left the remainder
+    OrderId orderId;
+    Quantity quantity;        // Unfilled quantity that was discarded
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(MessageHeader) == 3);
+static_assert(sizeof(NewOrderMessage) == 33);
+static_assert(sizeof(FillMessage) == 23);
+
+constexpr std::size_t MaxMessageSize = 64;
+
+/**
+ * @returns a zeroed message with its header filled in
+ */
+template <typename Message>
+Message MakeMessage() {
+    Message message{};
+    message.header.length = sizeof(Message);
+    message.header.type = Message::Type;
+    return message;
+}
+
+/**
+ * Command is the transport-neutral form of a client request.
+ * Decoders fill it in; the matching engine consumes it.
+ */
+enum class CommandType : std::uint8_t {
+    Add,
+    Cancel,
+    Modify,
+    MassCancel  // The session's orders with price..maxPrice, on side unless allSides
+};
+
+struct Command {
+    CommandType type;
+    OrderType orderType;
+    Side side;
+    bool allSides;   // MassCancel only
+    SessionId session;
+    std::uint64_t clientTag;
+    OrderId orderId;
+    Price price;
+    Price maxPrice;  // MassCancel only
+    Quantity quantity;
+};
+
+// allSides and maxPrice occupy what used to be padding, so journal records keep their layout
+static_assert(sizeof(Command) == 56);
+
+/**
+ * @returns the command a transport submits when a session drops: cancel
+ * every order the session still has resting
+ */
+inline Command MakeCancelOnDisconnect(SessionId session) {
+    Command command{};
+    command.type = CommandType::MassCancel;
+    command.allSides = true;
+    command.session = session;
+    command.price = std::numeric_limits<Price>::min();
+    command.maxPrice = std::numeric_limits<Price>::max();
+    return command;
+}
+
+/**
+ * Event is the transport-neutral form of an engine response.
+ * For fills, clientTag is unused and price/quantity describe the execution.
+ * For a MassCancelAck, quantity is the number of orders cancelled.
+ * For an Expired, quantity is the unfilled remainder that was discarded.
+ */
+struct Event {
+    MessageType type;
+    RejectReason reason;
+    SessionId session;
+    std::uint64_t clientTag;
+    OrderId orderId;
+    Price price;
+    Quantity quantity;
+};
+
+/**
+ * Decodes a single complete frame into a Command
+ * @returns false if the frame is not a well-formed client request
+ */
+inline bool DecodeCommand(const char* frame, std::size_t length, SessionId session, Command& command) {
+    if (length < sizeof(MessageHeader)) return false;
+    MessageHeader header;
+    std::memcpy(&header, frame, sizeof(header));
+    if (header.length != length) return false;
+
+    command.session = session;
+    switch (header.type) {
+    case MessageType::NewOrder: {
+        NewOrderMessage m;
+        if (length != sizeof(m)) return false;
+        std::memcpy(&m, frame, sizeof(m));
+        if (m.orderType > 1 || m.side > 1 || m.quantity == 0) return false;  // A 0-lot order would rest forever
+        command.type = CommandType::Add;
+        command.orderType = m.orderType == 0 ? OrderType::GoodTilCancel : OrderType::FillAndKill;
+        command.side = m.side == 0 ? Side::Buy : Side::Sell;
+        command.clientTag = m.clientTag;
+        command.orderId = m.orderId;
+        command.price = m.price;
+        command.quantity = m.quantity;
+        return true;
+    }
+    case MessageType::CancelOrder: {
+        CancelOrderMessage m;
+        if (length != sizeof(m)) return false;
+        std::memcpy(&m, frame, sizeof(m));
+        command.type = CommandType::Cancel;
+        command.clientTag = m.clientTag;
+        command.orderId = m.orderId;
+        return true;
+    }
+    case MessageType::ModifyOrder: {
+        ModifyOrderMessage m;
+        if (length != sizeof(m)) return false;
+        std::memcpy(&m, frame, sizeof(m));
+        if (m.side > 1 || m.quantity == 0) return false;  // Cancel, not a 0-lot modify, removes an order
+        command.type = CommandType::Modify;
+        command.side = m.side == 0 ? Side::Buy : Side::Sell;
+        command.clientTag = m.clientTag;
+        command.orderId = m.orderId;
+        command.price = m.price;
+        command.quantity = m.quantity;
+        return true;
+    }
+    case MessageType::MassCancel: {
+        MassCancelMessage m;
+        if (length != sizeof(m)) return false;
+        std::memcpy(&m, frame, sizeof(m));
+        if (m.side > 2) return false;
+        command.type = CommandType::MassCancel;
+        command.side = m.side == 1 ? Side::Sell : Side::Buy;
+        command.allSides = m.side == 2;
+        command.clientTag = m.clientTag;
+        command.price = m.minPrice;
+        command.maxPrice = m.maxPrice;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+ * Encodes an Event into out, which must hold at least MaxMessageSize bytes
+ * @returns number of bytes written
+ */
+inline std::size_t EncodeEvent(const Event& event, char* out) {
+    switch (event.type) {
+    case MessageType::Ack: {
+        auto m = MakeMessage<AckMessage>();
+        m.clientTag = event.clientTag;
+        m.orderId = event.orderId;
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    case MessageType::Reject: {
+        auto m = MakeMessage<RejectMessage>();
+        m.clientTag = event.clientTag;
+        m.orderId = event.orderId;
+        m.reason = event.reason;
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    case MessageType::Fill: {
+        auto m = MakeMessage<FillMessage>();
+        m.orderId = event.orderId;
+        m.price = event.price;
+        m.quantity = event.quantity;
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    case MessageType::CancelAck: {
+        auto m = MakeMessage<CancelAckMessage>();
+        m.clientTag = event.clientTag;
+        m.orderId = event.orderId;
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    case MessageType::MassCancelAck: {
+        auto m = MakeMessage<MassCancelAckMessage>();
+        m.clientTag = event.clientTag;
+        m.cancelled = event.quantity;
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    case MessageType::Expired: {
+        auto m = MakeMessage<ExpiredMessage>();
+        m.clientTag = event.clientTag;
+        m.orderId = event.orderId;
+        m.quantity = event.quantity;
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    default:
+        return 0;
+    }
+}
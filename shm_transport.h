@@ -0,0 +1,307 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "broadcast_ring.h"
+#include "matching_engine.h"
+#include "protocol.h"
+#include "spsc_queue.h"
+
+/**
+ * Shared-Memory Transport Architecture
+ *
+ * Co-located clients talk to the engine through a file in /dev/shm that
+ * both sides mmap, so submitting an order is a store into shared memory
+ * rather than a system call:
+ * - Each client claims one slot and owns the producer side of that slot's
+ *   inbound FixedSpscRing of Commands
+ * - The engine owns a single outbound BroadcastRing of Events that every
+ *   client reads; clients skip events addressed to other sessions
+ * - The engine busy-polls all claimed slots on one thread
+ * - A slot whose client detached or died is drained, the client's resting
+ *   orders are canceled, and the slot is freed for reuse
+ *
+ * Everything in the region is address-free (no pointers), so each process
+ * may map it at a different address.
+ */
+
+/**
+ * ShmRegion is the layout of the shared file
+ */
+struct ShmRegion {
+    static constexpr std::uint64_t Magic = 0x4f424f4f4b53484dULL;  // "OBOOKSHM"
+    static constexpr std::uint32_t Version = 2;
+    static constexpr std::uint32_t MaxClients = 16;
+    static constexpr std::size_t InboundCapacity = 1024;
+    static constexpr std::size_t OutboundCapacity = 1 << 16;
+
+    enum SlotState : std::uint32_t {
+        Free = 0,
+        Active,
+        Closing  // Client detached or died; engine frees the slot once its ring is drained
+    };
+
+    struct alignas(64) ClientSlot {
+        std::atomic<std::uint32_t> state{Free};
+        std::uint32_t generation = 0;  // Bumped on every claim so session ids are never reused
+        std::atomic<std::int32_t> pid{0};  // Claiming process, for the server's liveness check; 0 until set
+        FixedSpscRing<Command, InboundCapacity> inbound;
+    };
+
+    using OutboundRing = BroadcastRing<Event, OutboundCapacity>;
+
+    std::atomic<std::uint64_t> magic{0};
+    std::uint32_t version;
+    std::atomic<std::uint32_t> stopRequested{0};
+    ClientSlot clients[MaxClients];
+    OutboundRing outbound;
+
+    /**
+     * Session ids carry the slot index and its claim generation
+     */
+    static SessionId MakeSessionId(std::uint32_t slot, std::uint32_t generation) {
+        return (static_cast<SessionId>(generation) << 8) | slot;
+    }
+
+    static std::string Path(const std::string& name) {
+        return "/dev/shm/" + name;
+    }
+
+    /**
+     * Maps the region file, creating and initializing it when create is true
+     */
+    static ShmRegion* Map(const std::string& name, bool create) {
+        const std::string path = Path(name);
+        int fd = open(path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC) : (O_RDWR | O_CLOEXEC), 0600);
+        if (fd < 0) throw std::runtime_error("ShmRegion: cannot open " + path + ": " + std::strerror(errno));
+        if (create && ftruncate(fd, sizeof(ShmRegion)) < 0) {
+            close(fd);
+            throw std::runtime_error("ShmRegion: cannot size " + path + ": " + std::strerror(errno));
+        }
+        void* memory = mmap(nullptr, sizeof(ShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) {
+            throw std::runtime_error("ShmRegion: cannot map " + path + ": " + std::strerror(errno));
+        }
+
+        if (create) {
+            ShmRegion* region = new (memory) ShmRegion();
+            region->version = Version;
+            region->magic.store(Magic, std::memory_order_release);  // Last: clients treat a matching magic as "ready"
+            return region;
+        }
+        auto* region = static_cast<ShmRegion*>(memory);
+        if (region->magic.load(std::memory_order_acquire) != Magic || region->version != Version) {
+            munmap(memory, sizeof(ShmRegion));
+            throw std::runtime_error("ShmRegion: " + path + " is not an initialized order book region");
+        }
+        return region;
+    }
+};
+
+/**
+ * ShmServer owns the region and runs the matching loop over it
+ */
+class ShmServer {
+public:
+    explicit ShmServer(const std::string& name) : name(name), region(ShmRegion::Map(name, true)) {}
+
+    ~ShmServer() {
+        munmap(region, sizeof(ShmRegion));
+        unlink(ShmRegion::Path(name).c_str());
+    }
+
+    ShmServer(const ShmServer&) = delete;
+    ShmServer& operator=(const ShmServer&) = delete;
+
+    /**
+     * Polls client rings until Stop() or a client sets stopRequested
+     */
+    void Run() {
+        Command command;
+        auto publish = [this](const Event& event) { region->outbound.Publish(event); };
+        unsigned idleSpins = 0;
+
+        while (!region->stopRequested.load(std::memory_order_relaxed)) {
+            if (++iterations % LivenessInterval == 0) ReapDeadClients();
+            std::size_t processed = 0;
+            for (std::uint32_t i = 0; i < ShmRegion::MaxClients; ++i) {
+                ShmRegion::ClientSlot& slot = region->clients[i];
+                const std::uint32_t state = slot.state.load(std::memory_order_acquire);
+                if (state == ShmRegion::Free) continue;
+
+                for (std::size_t n = 0; n < BatchSize && slot.inbound.TryPop(command); ++n) {
+                    // Any process mapping the region can write the field; the slot decides the session.
+                    // The client wrote generation before pushing, so the pop makes it visible.
+                    command.session = ShmRegion::MakeSessionId(i, slot.generation);
+                    engine.Process(command, publish);
+                    ++processed;
+                }
+                if (state == ShmRegion::Closing && slot.inbound.Empty()) {
+                    // Its events go to a session nobody reads; other clients see the book change
+                    engine.Process(MakeCancelOnDisconnect(ShmRegion::MakeSessionId(i, slot.generation)), publish);
+                    ++clientsReclaimed;
+                    slot.inbound.~FixedSpscRing();
+                    new (&slot.inbound) FixedSpscRing<Command, ShmRegion::InboundCapacity>();
+                    slot.pid.store(0, std::memory_order_relaxed);
+                    slot.state.store(ShmRegion::Free, std::memory_order_release);
+                }
+            }
+            commandsProcessed += processed;
+
+            if (processed > 0) {
+                idleSpins = 0;
+            } else if (++idleSpins < 4096) {
+                CpuRelax();
+            } else {
+                std::this_thread::yield();  // Stay polite when sharing a core with clients
+            }
+        }
+    }
+
+    void Stop() { region->stopRequested.store(1, std::memory_order_release); }
+
+    std::uint64_t GetCommandsProcessed() const { return commandsProcessed; }
+
+    /**
+     * @returns how many detached or dead clients had their orders mass canceled
+     */
+    std::uint64_t GetClientsReclaimed() const { return clientsReclaimed; }
+
+private:
+    static constexpr std::size_t BatchSize = 64;
+    static constexpr std::uint64_t LivenessInterval = 1 << 16;  // Polling loops between liveness checks
+
+    /**
+     * Marks the slots of clients that exited without detaching (crashed or
+     * were killed) as Closing, so their orders do not rest forever. A reused
+     * pid keeps a dead client's slot until that process exits too.
+     */
+    void ReapDeadClients() {
+        for (ShmRegion::ClientSlot& slot : region->clients) {
+            if (slot.state.load(std::memory_order_acquire) != ShmRegion::Active) continue;
+            const pid_t pid = slot.pid.load(std::memory_order_acquire);
+            if (pid == 0 || kill(pid, 0) == 0 || errno != ESRCH) continue;
+            std::uint32_t expected = ShmRegion::Active;
+            slot.state.compare_exchange_strong(expected, ShmRegion::Closing, std::memory_order_acq_rel);
+        }
+    }
+
+    std::string name;
+    ShmRegion* region;
+    MatchingEngine engine;
+    std::uint64_t commandsProcessed = 0;
+    std::uint64_t iterations = 0;
+    std::uint64_t clientsReclaimed = 0;
+};
+
+/**
+ * ShmClient is the client library: claims a slot, submits commands and
+ * reads the events addressed to its session
+ */
+class ShmClient {
+public:
+    explicit ShmClient(const std::string& name) : region(ShmRegion::Map(name, false)) {
+        for (std::uint32_t i = 0; i < ShmRegion::MaxClients; ++i) {
+            std::uint32_t expected = ShmRegion::Free;
+            if (region->clients[i].state.compare_exchange_strong(expected, ShmRegion::Active, std::memory_order_acq_rel)) {
+                slotIndex = i;
+                break;
+            }
+        }
+        if (slotIndex == ShmRegion::MaxClients) {
+            munmap(region, sizeof(ShmRegion));
+            throw std::runtime_error("ShmClient: all client slots are in use");
+        }
+        ShmRegion::ClientSlot& slot = region->clients[slotIndex];
+        session = ShmRegion::MakeSessionId(slotIndex, ++slot.generation);
+        slot.pid.store(getpid(), std::memory_order_release);  // After the generation, which the server reads
+        readSequence = region->outbound.GetCursor();
+    }
+
+    ~ShmClient() {
+        region->clients[slotIndex].state.store(ShmRegion::Closing, std::memory_order_release);
+        munmap(region, sizeof(ShmRegion));
+    }
+
+    ShmClient(const ShmClient&) = delete;
+    ShmClient& operator=(const ShmClient&) = delete;
+
+    SessionId GetSession() const { return session; }
+
+    /**
+     * @returns false if the inbound ring is full (the engine is behind)
+     */
+    bool Submit(Command command) {
+        command.session = session;
+        return region->clients[slotIndex].inbound.TryPush(command);
+    }
+
+    bool SubmitNewOrder(std::uint64_t clientTag, OrderType type, Side side, OrderId id, Price price, Quantity quantity) {
+        return Submit(Command{CommandType::Add, type, side, false, session, clientTag, id, price, 0, quantity});
+    }
+
+    bool SubmitCancel(std::uint64_t clientTag, OrderId id) {
+        return Submit(Command{CommandType::Cancel, OrderType::GoodTilCancel, Side::Buy, false, session, clientTag, id, 0, 0, 0});
+    }
+
+    bool SubmitModify(std::uint64_t clientTag, OrderId id, Side side, Price price, Quantity quantity) {
+        return Submit(Command{CommandType::Modify, OrderType::GoodTilCancel, side, false, session, clientTag, id, price, 0, quantity});
+    }
+
+    /**
+     * Returns the next event for this session, skipping other sessions' events.
+     * If the client fell a whole ring behind it resynchronizes to the newest
+     * event and counts the lost range in GetEventsMissed().
+     * @returns false if no event is available right now
+     */
+    bool Poll(Event& event) {
+        while (true) {
+            switch (region->outbound.TryRead(readSequence, event)) {
+            case ShmRegion::OutboundRing::ReadResult::NotReady:
+                return false;
+            case ShmRegion::OutboundRing::ReadResult::Overrun: {
+                const std::uint64_t cursor = region->outbound.GetCursor();
+                eventsMissed += cursor - readSequence;
+                readSequence = cursor;
+                continue;
+            }
+            case ShmRegion::OutboundRing::ReadResult::Ok:
+                ++readSequence;
+                if (event.session == session) return true;
+                continue;
+            }
+        }
+    }
+
+    /**
+     * Asks the server to exit its polling loop
+     */
+    void RequestServerStop() { region->stopRequested.store(1, std::memory_order_release); }
+
+    std::uint64_t GetEventsMissed() const { return eventsMissed; }
+
+private:
+    ShmRegion* region;
+    std::uint32_t slotIndex = ShmRegion::MaxClients;
+    SessionId session = 0;
+    std::uint64_t readSequence = 0;
+    std::uint64_t eventsMissed = 0;
+};
+
+#endif  // __linux__
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+/**
+ * Tells the CPU we are in a spin-wait loop (saves power and, on SMT cores,
+ * yields execution resources to the sibling thread)
+ */
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * SpscQueue is a bounded lock-free ring for exactly one producer thread and
+ * one consumer thread.
+ *
+ * Design Notes:
+ * - Capacity is rounded up to a power of two so indices wrap with a mask
+ * - Head and tail live on separate cache lines to avoid false sharing
+ * - Each side caches the other side's index and only reloads it (an acquire
+ *   load of a contended line) when the cached value says the ring is full/empty
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity)
+        : mask(RoundUpToPowerOfTwo(capacity) - 1),
+          slots(std::make_unique<T[]>(mask + 1)) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * Producer side: copies value into the ring
+     * @returns false if the ring is full
+     */
+    bool TryPush(const T& value) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) return false;
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side: copies the oldest element into out
+     * @returns false if the ring is empty
+     */
+    bool TryPop(T& out) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        out = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @returns approximate number of queued elements (exact if called by either endpoint while the other is idle)
+     */
+    std::size_t Size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    std::size_t Capacity() const { return mask + 1; }
+
+private:
+    static std::size_t RoundUpToPowerOfTwo(std::size_t n) {
+        if (n < 2) throw std::invalid_argument("SpscQueue capacity must be at least 2");
+        std::size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    static constexpr std::size_t CacheLineSize = 64;
+
+    // Consumer-owned line
+    alignas(CacheLineSize) std::atomic<std::size_t> head{0};
+    std::size_t cachedTail = 0;
+
+    // Producer-owned line
+    alignas(CacheLineSize) std::atomic<std::size_t> tail{0};
+    std::size_t cachedHead = 0;
+
+    // Read-only after construction
+    alignas(CacheLineSize) const std::size_t mask;
+    std::unique_ptr<T[]> slots;
+};
+
+/**
+ * FixedSpscRing is the same single-producer/single-consumer protocol as
+ * SpscQueue with the slots stored inline. It holds no pointers, so it can
+ * be placed in memory shared between processes (see shm_transport.h).
+ */
+template <typename T, std::size_t Capacity>
+class FixedSpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "Elements are copied across address spaces");
+
+public:
+    bool TryPush(const T& value) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead >= Capacity) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead >= Capacity) return false;
+        }
+        slots[t & (Capacity - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& out) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return false;
+        }
+        out = slots[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr std::size_t CacheLineSize = 64;
+
+    alignas(CacheLineSize) std::atomic<std::size_t> head{0};
+    std::size_t cachedTail = 0;
+
+    alignas(CacheLineSize) std::atomic<std::size_t> tail{0};
+    std::size_t cachedHead = 0;
+
+    alignas(CacheLineSize) T slots[Capacity];
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <system_error>
+
+#include "protocol.h"
+
+/**
+ * Text Command Parser
+ *
+ * Parses the REPL's line format (also the pipeline's input) into the same
+ * Command the binary protocol carries. Nothing is allocated: tokens are
+ * views into the line, numbers are read with std::from_chars, and the verb
+ * is found with a perfect hash of its first character and length followed
+ * by a single string compare.
+ *
+ * Order verbs fill in Command as the binary path would:
+ *   ADD <GTC|FAK> <BUY|SELL> <OrderId> <Price> <Quantity>
+ *   CANCEL <OrderId>
+ *   MODIFY <OrderId> <BUY|SELL> <Price> <Quantity>
+ *   MASSCANCEL <BUY|SELL|ALL> [<MinPrice> <MaxPrice>]
+ * Query verbs reuse its fields for their arguments:
+ *   QUEUE <OrderId>             orderId
+ *   COST <BUY|SELL> <Quantity>  side, quantity
+ *   DEPTH <BUY|SELL> <Price>    side, price
+ *   BARS [<Count>]              quantity (10 if absent)
+ *   STATS, SNAPSHOT, EXIT
+ * Tokens after the last argument are ignored.
+ */
+
+enum class TextVerb : std::uint8_t {
+    None,     // Blank line
+    Unknown,
+    Add,
+    Cancel,
+    Modify,
+    MassCancel,
+    Queue,
+    Cost,
+    Depth,
+    Stats,
+    Bars,
+    Snapshot,
+    Exit
+};
+
+constexpr std::string_view GetTextVerbName(TextVerb verb) {
+    switch (verb) {
+    case TextVerb::Add: return "ADD";
+    case TextVerb::Cancel: return "CANCEL";
+    case TextVerb::Modify: return "MODIFY";
+    case TextVerb::MassCancel: return "MASSCANCEL";
+    case TextVerb::Queue: return "QUEUE";
+    case TextVerb::Cost: return "COST";
+    case TextVerb::Depth: return "DEPTH";
+    case TextVerb::Stats: return "STATS";
+    case TextVerb::Bars: return "BARS";
+    case TextVerb::Snapshot: return "SNAPSHOT";
+    case TextVerb::Exit: return "EXIT";
+    default: return {};
+    }
+}
+
+constexpr std::size_t HashTextVerb(std::string_view token) {
+    return (static_cast<unsigned char>(token[0]) * 4 + token.size()) % 16;
+}
+
+/**
+ * Perfect hash table of the verbs: HashTextVerb is distinct for every verb
+ * (checked at compile time), so one lookup and one compare identify a token
+ */
+inline constexpr auto TextVerbTable = [] {
+    std::array<TextVerb, 16> table{};
+    table.fill(TextVerb::Unknown);
+    for (auto verb = static_cast<std::uint8_t>(TextVerb::Add); verb <= static_cast<std::uint8_t>(TextVerb::Exit);
+         ++verb) {
+        std::size_t slot = HashTextVerb(GetTextVerbName(static_cast<TextVerb>(verb)));
+        if (table[slot] != TextVerb::Unknown) throw "TextVerbTable: verb hash collision";
+        table[slot] = static_cast<TextVerb>(verb);
+    }
+    return table;
+}();
+
+inline TextVerb LookupTextVerb(std::string_view token) {
+    if (token.empty()) return TextVerb::Unknown;
+    const TextVerb verb = TextVerbTable[HashTextVerb(token)];
+    return GetTextVerbName(verb) == token ? verb : TextVerb::Unknown;
+}
+
+/**
+ * Splits a line into tokens separated by spaces, tabs or carriage returns
+ */
+class TextTokenizer {
+public:
+    explicit TextTokenizer(std::string_view line) : position(line.data()), end(line.data() + line.size()) {}
+
+    /**
+     * @returns the next token, empty at the end of the line
+     */
+    std::string_view Next() {
+        SkipSpace();
+        const char* begin = position;
+        while (position != end && !IsSpace(*position)) ++position;
+        return std::string_view(begin, static_cast<std::size_t>(position - begin));
+    }
+
+    /**
+     * Parses the next token as a whole number
+     * @returns false if it is missing, malformed or out of range for value
+     */
+    template <typename Integer>
+    bool NextNumber(Integer& value) {
+        const std::string_view token = Next();
+        auto [last, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+        return !token.empty() && ec == std::errc() && last == token.data() + token.size();
+    }
+
+    bool NextSide(Side& side) {
+        const std::string_view token = Next();
+        side = token == "SELL" ? Side::Sell : Side::Buy;
+        return token == "BUY" || token == "SELL";
+    }
+
+    bool AtEnd() {
+        SkipSpace();
+        return position == end;
+    }
+
+private:
+    static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    void SkipSpace() {
+        while (position != end && IsSpace(*position)) ++position;
+    }
+
+    const char* position;
+    const char* end;
+};
+
+/**
+ * Parses one command line
+ * @param verb set to the line's verb (None for a blank line, Unknown if unrecognised)
+ * @returns false if the verb is unknown or its arguments are malformed
+ */
+inline bool ParseTextCommand(std::string_view line, TextVerb& verb, Command& command) {
+    TextTokenizer tokens(line);
+    command = Command{};
+    const std::string_view first = tokens.Next();
+    if (first.empty()) {
+        verb = TextVerb::None;
+        return false;
+    }
+    verb = LookupTextVerb(first);
+
+    switch (verb) {
+    case TextVerb::Add: {
+        const std::string_view type = tokens.Next();
+        if (type != "GTC" && type != "FAK") return false;
+        command.type = CommandType::Add;
+        command.orderType = type == "GTC" ? OrderType::GoodTilCancel : OrderType::FillAndKill;
+        return tokens.NextSide(command.side) && tokens.NextNumber(command.orderId) &&
+               tokens.NextNumber(command.price) && tokens.NextNumber(command.quantity);
+    }
+    case TextVerb::Cancel:
+        command.type = CommandType::Cancel;
+        return tokens.NextNumber(command.orderId);
+    case TextVerb::Modify:
+        command.type = CommandType::Modify;
+        return tokens.NextNumber(command.orderId) && tokens.NextSide(command.side) &&
+               tokens.NextNumber(command.price) && tokens.NextNumber(command.quantity);
+    case TextVerb::MassCancel: {
+        command.type = CommandType::MassCancel;
+        const std::string_view sides = tokens.Next();
+        if (sides != "BUY" && sides != "SELL" && sides != "ALL") return false;
+        command.side = sides == "SELL" ? Side::Sell : Side::Buy;
+        command.allSides = sides == "ALL";
+        command.price = std::numeric_limits<Price>::min();
+        command.maxPrice = std::numeric_limits<Price>::max();
+        if (tokens.AtEnd()) return true;  // No band
+        return tokens.NextNumber(command.price) && tokens.NextNumber(command.maxPrice);
+    }
+    case TextVerb::Queue:
+        return tokens.NextNumber(command.orderId);
+    case TextVerb::Cost:
+        return tokens.NextSide(command.side) && tokens.NextNumber(command.quantity);
+    case TextVerb::Depth:
+        return tokens.NextSide(command.side) && tokens.NextNumber(command.price);
+    case TextVerb::Bars:
+        command.quantity = 10;
+        return tokens.AtEnd() || tokens.NextNumber(command.quantity);
+    case TextVerb::Stats:
+    case TextVerb::Snapshot:
+    case TextVerb::Exit:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Parses an order command line (ADD, CANCEL, MODIFY or MASSCANCEL)
+ * @returns false for anything else, or malformed arguments
+ */
+inline bool DecodeTextCommand(std::string_view line, Command& command) {
+    TextVerb verb;
+    if (!ParseTextCommand(line, verb, command)) return false;
+    return verb == TextVerb::Add || verb == TextVerb::Cancel || verb == TextVerb::Modify ||
+           verb == TextVerb::MassCancel;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "order_book.h"
+
+/**
+ * Streaming Trade Analytics
+ *
+ * Keeps the statistics downstream consumers used to rebuild from the trade
+ * stream (last price, VWAP, OHLCV bars, rolling volume) inside the engine.
+ * TradeAnalytics is a market-data listener, so it plugs straight into
+ * MatchingEngine::Process, or can be fed the Trades that AddOrder returns.
+ *
+ * Design Notes:
+ * - Every fill is O(1): it updates the running totals, the open bar and one
+ *   rolling-volume bucket
+ * - All storage (completed-bar ring, rolling buckets) is sized once in the
+ *   constructor; nothing allocates afterwards
+ * - Time comes from Advance(now), called by the owner (once per command or
+ *   batch), so a backtest can drive it with simulated time and a live
+ *   engine pays for one clock read per batch rather than per fill
+ * - Bars are aligned to multiples of the interval; intervals without trades
+ *   produce no bar
+ */
+
+struct TradeAnalyticsConfig {
+    std::uint64_t barIntervalNanos = 1'000'000'000;       // 1 s bars
+    std::size_t barHistory = 1024;                        // Completed bars kept
+    std::uint64_t rollingWindowNanos = 60'000'000'000;    // 1 min rolling volume
+    std::size_t rollingBuckets = 60;                      // Window resolution
+};
+
+/**
+ * One OHLCV bar; notional is the sum of price * quantity in ticks
+ */
+struct Bar {
+    std::uint64_t startNanos = 0;
+    Price open = 0;
+    Price high = 0;
+    Price low = 0;
+    Price close = 0;
+    Quantity volume = 0;
+    std::int64_t notional = 0;
+    std::uint64_t trades = 0;
+
+    double GetVwap() const { return volume ? static_cast<double>(notional) / static_cast<double>(volume) : 0.0; }
+};
+
+class TradeAnalytics {
+public:
+    explicit TradeAnalytics(const TradeAnalyticsConfig& config = TradeAnalyticsConfig())
+        : config(config), bars(config.barHistory), buckets(config.rollingBuckets) {
+        if (config.barIntervalNanos == 0 || config.barHistory == 0) {
+            throw std::runtime_error("TradeAnalytics: bar interval and history must be non-zero");
+        }
+        if (config.rollingBuckets == 0 || config.rollingWindowNanos < config.rollingBuckets) {
+            throw std::runtime_error("TradeAnalytics: rolling window must span at least one nanosecond per bucket");
+        }
+        bucketWidth = config.rollingWindowNanos / config.rollingBuckets;
+    }
+
+    /**
+     * Moves the clock forward: closes the open bar once its interval has
+     * passed and expires rolling-volume buckets. Earlier times are ignored.
+     */
+    void Advance(std::uint64_t nowNanos) {
+        if (nowNanos < now) return;
+        now = nowNanos;
+        if (open.trades > 0 && now >= open.startNanos + config.barIntervalNanos) CloseBar();
+        ExpireBuckets(now / bucketWidth);
+    }
+
+    /**
+     * Records one execution at the current time
+     */
+    void RecordTrade(Price price, Quantity quantity) {
+        if (quantity == 0) return;
+        const std::int64_t notional = static_cast<std::int64_t>(price) * static_cast<std::int64_t>(quantity);
+        lastPrice = price;
+        totalVolume += quantity;
+        totalNotional += notional;
+        ++totalTrades;
+
+        if (open.trades == 0) {
+            open.startNanos = now - now % config.barIntervalNanos;
+            open.open = open.high = open.low = price;
+        }
+        open.high = std::max(open.high, price);
+        open.low = std::min(open.low, price);
+        open.close = price;
+        open.volume += quantity;
+        open.notional += notional;
+        ++open.trades;
+
+        buckets[headBucket % buckets.size()] += quantity;
+        rollingVolume += quantity;
+    }
+
+    // Market-data listener interface (see MatchingEngine)
+
+    void OnTrade(const Trade& trade, Side aggressor) {
+        const TradeInfo& resting = aggressor == Side::Buy ? trade.GetAskTrade() : trade.GetBidTrade();
+        RecordTrade(resting.price, resting.quantity);
+    }
+
+    void OnLevel(Side, Price, Quantity) {}
+
+    // Queries
+
+    Price GetLastPrice() const { return lastPrice; }
+    Quantity GetVolume() const { return totalVolume; }
+    std::uint64_t GetTradeCount() const { return totalTrades; }
+
+    /**
+     * @returns volume-weighted average price of every trade so far, 0 before the first
+     */
+    double GetVwap() const {
+        return totalVolume ? static_cast<double>(totalNotional) / static_cast<double>(totalVolume) : 0.0;
+    }
+
+    /**
+     * @returns volume traded within the rolling window ending at the last Advance()
+     * (bucket resolution: up to one bucket width older)
+     */
+    Quantity GetRollingVolume() const { return rollingVolume; }
+
+    /**
+     * @returns the bar still collecting trades (trades == 0 if none yet)
+     */
+    const Bar& GetOpenBar() const { return open; }
+
+    /**
+     * @returns the number of completed bars retained (at most barHistory)
+     */
+    std::size_t GetBarCount() const { return std::min<std::uint64_t>(closedBars, bars.size()); }
+
+    /**
+     * @returns a completed bar; 0 is the most recent
+     * @throws std::runtime_error if fewer bars are retained
+     */
+    const Bar& GetBar(std::size_t age) const {
+        if (age >= GetBarCount()) throw std::runtime_error("TradeAnalytics: bar not retained");
+        return bars[(closedBars - 1 - age) % bars.size()];
+    }
+
+    const TradeAnalyticsConfig& GetConfig() const { return config; }
+
+private:
+    void CloseBar() {
+        bars[closedBars % bars.size()] = open;
+        ++closedBars;
+        open = Bar();
+    }
+
+    /**
+     * Clears the buckets between the newest one and bucket; a long idle gap
+     * costs at most one pass over the buckets
+     */
+    void ExpireBuckets(std::uint64_t bucket) {
+        if (bucket <= headBucket) return;
+        const std::uint64_t steps = std::min<std::uint64_t>(bucket - headBucket, buckets.size());
+        for (std::uint64_t i = 1; i <= steps; ++i) {
+            Quantity& expired = buckets[(headBucket + i) % buckets.size()];
+            rollingVolume -= expired;
+            expired = 0;
+        }
+        headBucket = bucket;
+    }
+
+    TradeAnalyticsConfig config;
+    std::uint64_t now = 0;
+
+    Price lastPrice = 0;
+    Quantity totalVolume = 0;
+    std::int64_t totalNotional = 0;
+    std::uint64_t totalTrades = 0;
+
+    Bar open;
+    std::vector<Bar> bars;  // Ring of completed bars
+    std::uint64_t closedBars = 0;
+
+    std::vector<Quantity> buckets;  // Ring of per-bucket volume; headBucket is the newest
+    std::uint64_t bucketWidth = 0;
+    std::uint64_t headBucket = 0;
+    Quantity rollingVolume = 0;
+};
@@ -0,0 +1,538 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "drop_copy.h"
+#include "gateway.h"
+#include "io_uring.h"
+#include "journal.h"
+#include "matching_engine.h"
+#include "protocol.h"
+
+/**
+ * io_uring Gateway Backend
+ *
+ * A single thread owns the sockets, the MatchingEngine and the journal.
+ * Each loop iteration is exactly one io_uring_enter call that both submits
+ * the work queued during the previous iteration and waits for completions:
+ * - Multishot accept and multishot receive stay armed across completions
+ * - Received bytes land in a kernel-selected provided buffer and are
+ *   decoded in place; only a frame split across buffers is copied
+ * - Responses for a session are batched into one send per iteration,
+ *   double-buffered so new events accumulate while a send is in flight
+ * - Journal batches go out with WRITE_FIXED from registered buffers
+ * - Market data (--market-data) is flushed once per iteration; a poll on
+ *   the retransmission socket wakes the loop for gap requests
+ *
+ * There are no queues or thread hand-offs: commands are matched as soon
+ * as they are decoded, which removes the cross-core latency of the epoll
+ * backend at the cost of doing all work on one core.
+ */
+class UringGateway {
+public:
+    explicit UringGateway(const GatewayConfig& config)
+        : config(config), ring(RingEntries), buffers(ring, BufferGroup, BufferCount, BufferSize) {
+        if (!config.journalPath.empty()) {
+            journal = std::make_unique<Journal>(config.journalPath);
+            iovec registered[Journal::BufferCount];
+            for (unsigned i = 0; i < Journal::BufferCount; ++i) {
+                registered[i].iov_base = journal->GetBuffer(i);
+                registered[i].iov_len = journal->GetBufferSize();
+            }
+            ring.RegisterBuffers(registered, Journal::BufferCount);
+        }
+        if (!config.dropCopyName.empty()) {
+            dropCopy = std::make_unique<DropCopyPublisher>(config.dropCopyName);
+            engine.SetDropCopy(&dropCopy->GetRing());
+        }
+        if (!config.marketDataAddress.empty()) {
+            MarketDataConfig marketDataConfig;
+            marketDataConfig.address = config.marketDataAddress;
+            marketDataConfig.port = config.marketDataPort;
+            marketDataConfig.retransmitAddress = config.bindAddress;
+            marketDataConfig.retransmitPort = config.retransmitPort;
+            marketData = std::make_unique<MarketDataPublisher>(marketDataConfig);
+        }
+        listenFd = CreateListenSocket();
+        wakeFd = eventfd(0, EFD_CLOEXEC);
+        if (wakeFd < 0) throw std::runtime_error("UringGateway: eventfd failed");
+    }
+
+    ~UringGateway() {
+        for (auto& [id, session] : sessions) close(session.fd);
+        close(wakeFd);
+        close(listenFd);
+    }
+
+    UringGateway(const UringGateway&) = delete;
+    UringGateway& operator=(const UringGateway&) = delete;
+
+    /**
+     * Runs the event loop on the calling thread until Stop() is called
+     */
+    void Run() {
+        running.store(true);
+        ring.Enable();
+        ArmAccept();
+        ArmWake();
+        if (marketData) ArmRetransmitPoll();
+
+        while (running.load(std::memory_order_relaxed)) {
+            ring.Submit(1);
+            ring.ForEachCompletion([this](const io_uring_cqe& cqe) { HandleCompletion(cqe); });
+            buffers.Publish();
+            if (marketData) marketData->Flush();
+            QueueSends();
+            QueueJournalWrite();
+        }
+
+        // Let in-flight sends and the last journal batch complete
+        if (marketData) marketData->Flush();
+        QueueSends();
+        QueueJournalWrite();
+        while (OutstandingWrites() > 0) {
+            ring.Submit(1);
+            ring.ForEachCompletion([this](const io_uring_cqe& cqe) { HandleCompletion(cqe); });
+            QueueJournalWrite();
+        }
+        stats.syscalls = ring.GetSyscallCount() + extraSyscalls;
+    }
+
+    /**
+     * Requests shutdown. Safe to call from any thread or a signal handler.
+     */
+    void Stop() {
+        running.store(false);
+        std::uint64_t one = 1;
+        [[maybe_unused]] ssize_t n = write(wakeFd, &one, sizeof(one));
+    }
+
+    std::uint16_t GetPort() const {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+    /**
+     * Only meaningful once Run() has returned
+     */
+    const GatewayStats& GetStats() const { return stats; }
+
+private:
+    static constexpr unsigned RingEntries = 4096;
+    static constexpr std::uint16_t BufferGroup = 0;
+    static constexpr std::uint16_t BufferCount = 512;
+    static constexpr std::uint32_t BufferSize = 16 * 1024;
+
+    enum class Operation : std::uint8_t {
+        Accept = 1,
+        Receive,
+        Send,
+        JournalWrite,
+        Wake,
+        Retransmit
+    };
+
+    /**
+     * user_data layout: operation in the top byte, session id below
+     */
+    static std::uint64_t Token(Operation op, SessionId id = 0) {
+        return (static_cast<std::uint64_t>(op) << 56) | id;
+    }
+
+    struct Session {
+        int fd = -1;
+        std::vector<char> partial;        // Bytes of a frame split across receive buffers
+        std::vector<char> output[2];      // Double-buffered responses
+        unsigned filling = 0;             // Buffer collecting new responses
+        bool sending = false;             // output[filling ^ 1] is in flight
+        std::size_t sendOffset = 0;
+        bool dirty = false;
+        bool closing = false;
+        unsigned operationsInFlight = 0;  // Receive + send; the session outlives both
+    };
+
+    int CreateListenSocket() {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw std::runtime_error("UringGateway: socket() failed");
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config.port);
+        if (inet_pton(AF_INET, config.bindAddress.c_str(), &addr.sin_addr) != 1 ||
+            bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+            std::string error = std::strerror(errno);
+            close(fd);
+            throw std::runtime_error("UringGateway: cannot listen on " + config.bindAddress + ":" +
+                                     std::to_string(config.port) + ": " + error);
+        }
+        return fd;
+    }
+
+    void ArmAccept() {
+        io_uring_sqe* sqe = ring.GetSqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listenFd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = Token(Operation::Accept);
+    }
+
+    void ArmWake() {
+        io_uring_sqe* sqe = ring.GetSqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = wakeFd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(&wakeValue);
+        sqe->len = sizeof(wakeValue);
+        sqe->user_data = Token(Operation::Wake);
+    }
+
+    void ArmRetransmitPoll() {
+        io_uring_sqe* sqe = ring.GetSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = marketData->GetRetransmitFd();
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = Token(Operation::Retransmit);
+    }
+
+    void ArmReceive(SessionId id, Session& session) {
+        io_uring_sqe* sqe = ring.GetSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = session.fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = buffers.GetGroupId();
+        sqe->user_data = Token(Operation::Receive, id);
+        ++session.operationsInFlight;
+    }
+
+    void HandleCompletion(const io_uring_cqe& cqe) {
+        const auto op = static_cast<Operation>(cqe.user_data >> 56);
+        const SessionId id = cqe.user_data & ((std::uint64_t{1} << 56) - 1);
+        switch (op) {
+        case Operation::Accept:
+            OnAccept(cqe);
+            break;
+        case Operation::Receive:
+            OnReceive(id, cqe);
+            break;
+        case Operation::Send:
+            OnSend(id, cqe);
+            break;
+        case Operation::JournalWrite:
+            OnJournalWrite(cqe);
+            break;
+        case Operation::Wake:
+            if (running.load(std::memory_order_relaxed)) ArmWake();
+            break;
+        case Operation::Retransmit:
+            marketData->ServiceRetransmissions();
+            if (running.load(std::memory_order_relaxed)) ArmRetransmitPoll();
+            break;
+        }
+    }
+
+    void OnAccept(const io_uring_cqe& cqe) {
+        if (!(cqe.flags & IORING_CQE_F_MORE) && running.load(std::memory_order_relaxed)) ArmAccept();
+        if (cqe.res < 0) return;
+
+        int one = 1;
+        setsockopt(cqe.res, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        ++extraSyscalls;
+
+        SessionId id = nextSessionId++;
+        Session& session = sessions[id];
+        session.fd = cqe.res;
+        ArmReceive(id, session);
+        ++stats.sessionsAccepted;
+    }
+
+    void OnReceive(SessionId id, const io_uring_cqe& cqe) {
+        auto it = sessions.find(id);
+        if (it == sessions.end()) return;
+        Session& session = it->second;
+        const bool more = cqe.flags & IORING_CQE_F_MORE;
+        if (!more) --session.operationsInFlight;
+
+        if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+            const auto bufferId = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            const bool ok = Consume(id, session, buffers.GetBuffer(bufferId), static_cast<std::size_t>(cqe.res));
+            buffers.Recycle(bufferId);
+            if (!ok) return BeginClose(id, session);
+        }
+
+        if (!more) {
+            // Multishot ended: EOF/error closes, buffer exhaustion just rearms
+            if ((cqe.res > 0 || cqe.res == -ENOBUFS) && !session.closing) {
+                ArmReceive(id, session);
+            } else {
+                BeginClose(id, session);
+            }
+        }
+        MaybeFinishClose(id);
+    }
+
+    /**
+     * Decodes frames straight out of the receive buffer; only a trailing
+     * partial frame (or data following one) goes through session.partial
+     * @returns false on an unrecoverable framing error
+     */
+    bool Consume(SessionId id, Session& session, const char* data, std::size_t length) {
+        if (!session.partial.empty()) {
+            session.partial.insert(session.partial.end(), data, data + length);
+            std::size_t used = 0;
+            if (!ParseFrames(id, session.partial.data(), session.partial.size(), used)) return false;
+            session.partial.erase(session.partial.begin(), session.partial.begin() + static_cast<std::ptrdiff_t>(used));
+            return true;
+        }
+        std::size_t used = 0;
+        if (!ParseFrames(id, data, length, used)) return false;
+        session.partial.assign(data + used, data + length);
+        return true;
+    }
+
+    bool ParseFrames(SessionId id, const char* data, std::size_t length, std::size_t& used) {
+        while (length - used >= sizeof(MessageHeader)) {
+            std::uint16_t frameLength;
+            std::memcpy(&frameLength, data + used, sizeof(frameLength));
+            if (frameLength < sizeof(MessageHeader) || frameLength > MaxMessageSize) return false;
+            if (length - used < frameLength) break;
+
+            Command command;
+            if (DecodeCommand(data + used, frameLength, id, command)) {
+                ++stats.commandsIn;
+                if (journal && !journal->Append(command)) {
+                    // A burst filled the buffer before the previous batch
+                    // completed; fall back to one blocking write
+                    journal->FlushSync();
+                    ++extraSyscalls;
+                    journal->Append(command);
+                }
+                Match(command);
+            } else {
+                ++stats.malformed;
+                Deliver(Event{MessageType::Reject, RejectReason::Malformed, id, 0, 0, 0, 0});
+            }
+            used += frameLength;
+        }
+        return true;
+    }
+
+    void Match(const Command& command) {
+        auto deliver = [this](const Event& event) { Deliver(event); };
+        if (marketData) {
+            engine.Process(command, deliver, *marketData);
+        } else {
+            engine.Process(command, deliver);
+        }
+    }
+
+    void Deliver(const Event& event) {
+        auto it = sessions.find(event.session);
+        if (it == sessions.end() || it->second.closing) return;
+        Session& session = it->second;
+        char frame[MaxMessageSize];
+        std::size_t length = EncodeEvent(event, frame);
+        std::vector<char>& out = session.output[session.filling];
+        out.insert(out.end(), frame, frame + length);
+        ++stats.eventsOut;
+        if (!session.dirty) {
+            session.dirty = true;
+            dirtySessions.push_back(event.session);
+        }
+    }
+
+    /**
+     * A session whose responses pile up behind a send the client is not
+     * draining is closed here rather than from Deliver, which runs inside
+     * the engine and so cannot submit the cancel-on-disconnect
+     */
+    void QueueSends() {
+        for (SessionId id : dirtySessions) {
+            auto it = sessions.find(id);
+            if (it == sessions.end()) continue;
+            Session& session = it->second;
+            session.dirty = false;
+            if (!session.sending) {
+                StartSend(id, session);
+            } else if (PendingOutput(session) > config.maxPendingOutput) {
+                ++stats.slowReaders;
+                BeginClose(id, session);
+            }
+        }
+        dirtySessions.clear();
+    }
+
+    static std::size_t PendingOutput(const Session& session) {
+        return session.output[session.filling].size() + session.output[session.filling ^ 1].size() - session.sendOffset;
+    }
+
+    void StartSend(SessionId id, Session& session) {
+        if (session.closing || session.output[session.filling].empty()) return;
+        session.sending = true;
+        session.sendOffset = 0;
+        session.filling ^= 1;
+        SubmitSend(id, session);
+    }
+
+    void SubmitSend(SessionId id, Session& session) {
+        const std::vector<char>& out = session.output[session.filling ^ 1];
+        io_uring_sqe* sqe = ring.GetSqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = session.fd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(out.data() + session.sendOffset);
+        sqe->len = static_cast<std::uint32_t>(out.size() - session.sendOffset);
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = Token(Operation::Send, id);
+        ++session.operationsInFlight;
+    }
+
+    void OnSend(SessionId id, const io_uring_cqe& cqe) {
+        auto it = sessions.find(id);
+        if (it == sessions.end()) return;
+        Session& session = it->second;
+        --session.operationsInFlight;
+
+        std::vector<char>& out = session.output[session.filling ^ 1];
+        if (cqe.res < 0) {
+            session.sending = false;
+            BeginClose(id, session);
+        } else {
+            session.sendOffset += static_cast<std::size_t>(cqe.res);
+            if (session.sendOffset < out.size() && !session.closing) {
+                SubmitSend(id, session);
+            } else {
+                out.clear();
+                session.sending = false;
+                StartSend(id, session);
+            }
+        }
+        MaybeFinishClose(id);
+    }
+
+    /**
+     * Shutting the socket down makes the armed receive complete, after
+     * which the session can be freed without racing the kernel
+     */
+    void BeginClose(SessionId id, Session& session) {
+        if (session.closing) return;
+        session.closing = true;
+        shutdown(session.fd, SHUT_RDWR);
+        ++extraSyscalls;
+        if (config.cancelOnDisconnect) CancelOnDisconnect(id);
+    }
+
+    /**
+     * Pulls a dropped session's resting orders at once; its own acks are
+     * discarded by Deliver, everyone else sees the book change
+     */
+    void CancelOnDisconnect(SessionId id) {
+        const Command command = MakeCancelOnDisconnect(id);
+        if (journal && !journal->Append(command)) {
+            journal->FlushSync();
+            ++extraSyscalls;
+            journal->Append(command);
+        }
+        Match(command);
+        ++stats.disconnectCancels;
+    }
+
+    void MaybeFinishClose(SessionId id) {
+        auto it = sessions.find(id);
+        if (it == sessions.end() || !it->second.closing || it->second.operationsInFlight > 0) return;
+        close(it->second.fd);
+        ++extraSyscalls;
+        sessions.erase(it);
+        ++stats.sessionsClosed;
+    }
+
+    void QueueJournalWrite() {
+        if (!journal || !journal->HasPending() || !journal->CanSeal()) return;
+        SubmitJournalWrite(journal->Seal());
+    }
+
+    void SubmitJournalWrite(const Journal::Segment& segment) {
+        journalSegments[segment.bufferIndex] = segment;
+        io_uring_sqe* sqe = ring.GetSqe();
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->fd = journal->GetFd();
+        sqe->addr = reinterpret_cast<std::uint64_t>(segment.data);
+        sqe->len = static_cast<std::uint32_t>(segment.length);
+        sqe->off = segment.fileOffset;
+        sqe->buf_index = static_cast<std::uint16_t>(segment.bufferIndex);
+        sqe->user_data = Token(Operation::JournalWrite, segment.bufferIndex);
+        ++journalWritesInFlight;
+    }
+
+    /**
+     * Releases the buffer once its whole segment is on disk; a short write
+     * (disk full, signal, file size limit) resubmits the rest at the advanced offset
+     */
+    void OnJournalWrite(const io_uring_cqe& cqe) {
+        --journalWritesInFlight;
+        const auto index = static_cast<unsigned>(cqe.user_data & 0xff);
+        if (cqe.res < 0) {
+            throw std::runtime_error("UringGateway: journal write failed: " + std::string(std::strerror(-cqe.res)));
+        }
+        if (cqe.res == 0) throw std::runtime_error("UringGateway: journal write made no progress");
+        Journal::Segment& segment = journalSegments[index];
+        const auto written = static_cast<std::size_t>(cqe.res);
+        if (written < segment.length) {
+            Journal::Segment rest = segment;
+            rest.data += written;
+            rest.length -= written;
+            rest.fileOffset += written;
+            SubmitJournalWrite(rest);
+            return;
+        }
+        journal->Release(index);
+    }
+
+    std::size_t OutstandingWrites() const {
+        std::size_t count = journalWritesInFlight;
+        for (const auto& [id, session] : sessions) count += session.sending ? 1 : 0;
+        return count;
+    }
+
+    GatewayConfig config;
+    IoUring ring;
+    ProvidedBufferRing buffers;
+    std::unique_ptr<Journal> journal;
+    Journal::Segment journalSegments[Journal::BufferCount] = {};  // What each in-flight write still has to cover
+    std::unique_ptr<DropCopyPublisher> dropCopy;
+    std::unique_ptr<MarketDataPublisher> marketData;
+    MatchingEngine engine;
+    int listenFd = -1;
+    int wakeFd = -1;
+    std::uint64_t wakeValue = 0;
+    std::atomic<bool> running{false};
+
+    std::unordered_map<SessionId, Session> sessions;
+    std::vector<SessionId> dirtySessions;
+    SessionId nextSessionId = 1;
+    unsigned journalWritesInFlight = 0;
+    std::uint64_t extraSyscalls = 0;  // Non-ring calls: setsockopt, shutdown, close, sync journal writes
+    GatewayStats stats;
+};
+
+#endif  // __linux__